@@ -0,0 +1,81 @@
+/*                         _
+ *   ___  __ _  __ _ _   _(_)
+ *  / __|/ _` |/ _` | | | | |
+ *  \__ \ (_| | (_| | |_| | |
+ *  |___/\__,_|\__, |\__,_|_|
+ *             |___/
+ *
+ * Cross-platform library which helps to develop web servers or frameworks.
+ *
+ * Copyright (C) 2016-2020 Silvio Clecio <silvioprog@gmail.com>
+ *
+ * Sagui library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * Sagui library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Sagui library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "sg_bench.h"
+
+#include <string.h>
+#include "sg_macros.h"
+#include "sg_digest.h"
+#include <sagui.h>
+
+/* Hashes a buffer through the streaming digest, fed in upload-sized chunks,
+ * to measure the cost added to each received byte. CRC32C and SHA-256 use
+ * the hardware paths when the CPU provides them. */
+
+#define ITERS(size) ((size) < 1000000 ? 200 : 10)
+#define CHUNK 32768
+
+static void digest(unsigned int algos, const char *buf, size_t size) {
+  struct sg__digest dg;
+  size_t len;
+  sg__digest_init(&dg, algos);
+  while (size > 0) {
+    len = size < CHUNK ? size : CHUNK;
+    sg__digest_update(&dg, buf, len);
+    buf += len;
+    size -= len;
+  }
+  if (algos & SG_DIGEST_CRC32C)
+    sg__digest_hex(&dg, SG_DIGEST_CRC32C);
+  if (algos & SG_DIGEST_SHA256)
+    sg__digest_hex(&dg, SG_DIGEST_SHA256);
+}
+
+int main(void) {
+  const size_t sizes[] = {65536, 1048576, 16777216};
+  char name[64];
+  char *buf;
+  size_t i, j;
+  for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+    buf = malloc(sizes[i]);
+    for (j = 0; j < sizes[i]; j++)
+      buf[j] = (char) (j * 2654435761u >> 13);
+    snprintf(name, sizeof(name), "crc32c         %9lu bytes",
+             (unsigned long) sizes[i]);
+    BENCH(name, ITERS(sizes[i]), sizes[i],
+          { digest(SG_DIGEST_CRC32C, buf, sizes[i]); });
+    snprintf(name, sizeof(name), "sha256         %9lu bytes",
+             (unsigned long) sizes[i]);
+    BENCH(name, ITERS(sizes[i]), sizes[i],
+          { digest(SG_DIGEST_SHA256, buf, sizes[i]); });
+    snprintf(name, sizeof(name), "crc32c+sha256  %9lu bytes",
+             (unsigned long) sizes[i]);
+    BENCH(name, ITERS(sizes[i]), sizes[i],
+          { digest(SG__DIGEST_ALL, buf, sizes[i]); });
+    free(buf);
+  }
+  return EXIT_SUCCESS;
+}
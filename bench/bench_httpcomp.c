@@ -0,0 +1,117 @@
+/*                         _
+ *   ___  __ _  __ _ _   _(_)
+ *  / __|/ _` |/ _` | | | | |
+ *  \__ \ (_| | (_| | |_| | |
+ *  |___/\__,_|\__, |\__,_|_|
+ *             |___/
+ *
+ * Cross-platform library which helps to develop web servers or frameworks.
+ *
+ * Copyright (C) 2016-2020 Silvio Clecio <silvioprog@gmail.com>
+ *
+ * Sagui library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * Sagui library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Sagui library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "sg_bench.h"
+
+#include <string.h>
+#include "zlib.h"
+#include "sg_macros.h"
+#include "sg_extra.h"
+#include "sg_httpcomp.h"
+#include <sagui.h>
+
+/* Compares the one-shot compression of JSON documents through the encoders
+ * (libdeflate when built with SG_HTTP_COMPRESSION_LIBDEFLATE) against the
+ * plain zlib stream loop. */
+
+#define ITERS(size) ((size) < 500000 ? 200 : 20)
+
+static char *make_json(size_t size) {
+  char *json = malloc(size + 1);
+  size_t len = 0;
+  unsigned long i;
+  json[len++] = '[';
+  for (i = 0; len < size - 128; i++)
+    len += (size_t) snprintf(
+      json + len, size - len,
+      "{\"id\":%lu,\"name\":\"user%lu\",\"active\":%s,\"score\":%lu.%02lu,"
+      "\"tags\":[\"a%lu\",\"b%lu\"]},",
+      i, i * 7919 % 10007, (i % 3) ? "true" : "false", i * 31 % 1000, i % 100,
+      i % 17, i % 29);
+  json[len - 1] = ']';
+  json[len] = '\0';
+  return json;
+}
+
+static void bench_zlib_stream(const char *json, size_t size, int level) {
+  uLongf zsize = compressBound((uLong) size);
+  Bytef *zbuf = malloc(zsize);
+  char name[64];
+  uLongf dest_size;
+  snprintf(name, sizeof(name), "zlib stream  %7zu B, level %d", size, level);
+  BENCH(name, ITERS(size), size, {
+    dest_size = zsize;
+    sg__zcompress((z_const Bytef *) json, (uLong) size, zbuf, &dest_size,
+                  level);
+  });
+  printf("%-44s %11.1f%%\n", "  ratio",
+         100.0 * (double) dest_size / (double) size);
+  free(zbuf);
+}
+
+static void bench_encoder(const char *token, const char *json, size_t size,
+                          int level) {
+  const struct sg__httpcomp *comp = sg__httpcomp_find(token);
+  char name[64];
+  void *dest = NULL;
+  size_t dest_size = 0;
+  if (!comp)
+    return;
+  snprintf(name, sizeof(name), "%-7s      %7zu B, level %d", token, size,
+           level);
+  BENCH(name, ITERS(size), size, {
+    sg__httpcomp_compress(comp, level, json, size, &dest, &dest_size);
+    sg_free(dest);
+  });
+  printf("%-44s %11.1f%%\n", "  ratio",
+         100.0 * (double) dest_size / (double) size);
+}
+
+int main(void) {
+  const size_t sizes[] = {100 * 1024, 500 * 1024, 1024 * 1024};
+  const int levels[] = {1, 6, 9};
+  char *json;
+  size_t i, j;
+  printf("zlib: %s, one-shot deflate: %s\n", zlibVersion(),
+#ifdef SG_HTTP_COMPRESSION_LIBDEFLATE
+         "libdeflate"
+#else  /* SG_HTTP_COMPRESSION_LIBDEFLATE */
+         "zlib"
+#endif /* SG_HTTP_COMPRESSION_LIBDEFLATE */
+  );
+  for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+    json = make_json(sizes[i]);
+    for (j = 0; j < sizeof(levels) / sizeof(levels[0]); j++) {
+      bench_zlib_stream(json, strlen(json), levels[j]);
+      bench_encoder("deflate", json, strlen(json), levels[j]);
+      bench_encoder("gzip", json, strlen(json), levels[j]);
+    }
+    bench_encoder("br", json, strlen(json), -1);
+    bench_encoder("zstd", json, strlen(json), -1);
+    free(json);
+  }
+  return EXIT_SUCCESS;
+}
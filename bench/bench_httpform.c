@@ -0,0 +1,127 @@
+/*                         _
+ *   ___  __ _  __ _ _   _(_)
+ *  / __|/ _` |/ _` | | | | |
+ *  \__ \ (_| | (_| | |_| | |
+ *  |___/\__,_|\__, |\__,_|_|
+ *             |___/
+ *
+ * Cross-platform library which helps to develop web servers or frameworks.
+ *
+ * Copyright (C) 2016-2020 Silvio Clecio <silvioprog@gmail.com>
+ *
+ * Sagui library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * Sagui library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Sagui library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "sg_bench.h"
+
+#include <string.h>
+#include "sg_macros.h"
+#include "sg_httpform.h"
+#include <sagui.h>
+
+/* Parses large forms as they arrive from the socket, in 32 kB pieces: a
+ * multipart form carrying a file, and an URL-encoded form with many fields
+ * (half of them percent-encoded). */
+
+#define ITERS(size) ((size) < 1000000 ? 200 : 10)
+#define CHUNK 32768
+#define BOUNDARY "----SaguiFormBoundary7MA4YWxkTrZu0gW"
+
+static enum MHD_Result count_iter(void *cls, enum MHD_ValueKind kind,
+                                  const char *key, const char *filename,
+                                  const char *content_type,
+                                  const char *transfer_encoding,
+                                  const char *data, uint64_t off,
+                                  size_t size) {
+  (void) kind;
+  (void) key;
+  (void) filename;
+  (void) content_type;
+  (void) transfer_encoding;
+  (void) data;
+  (void) off;
+  *((uint64_t *) cls) += size;
+  return MHD_YES;
+}
+
+static char *make_multipart(size_t size, size_t *len) {
+  static const char head[] =
+    "--" BOUNDARY "\r\n"
+    "Content-Disposition: form-data; name=\"file\"; filename=\"a.bin\"\r\n"
+    "Content-Type: application/octet-stream\r\n\r\n";
+  static const char tail[] = "\r\n--" BOUNDARY "--\r\n";
+  char *body = malloc(sizeof(head) + size + sizeof(tail));
+  size_t i;
+  memcpy(body, head, sizeof(head) - 1);
+  /* binary data, with CRs and dashes as in real files */
+  for (i = 0; i < size; i++)
+    body[sizeof(head) - 1 + i] = (char) (i * 2654435761u >> 13);
+  memcpy(body + sizeof(head) - 1 + size, tail, sizeof(tail));
+  *len = sizeof(head) - 1 + size + sizeof(tail) - 1;
+  return body;
+}
+
+static char *make_urlencoded(size_t size, size_t *len) {
+  struct sg_str *str = sg_str_new();
+  char *body;
+  unsigned long i;
+  for (i = 0; sg_str_length(str) < size; i++)
+    sg_str_printf(str,
+                  (i % 2) ? "field%lu=caf%%C3%%A9+au+lait&"
+                          : "field%lu=plain-value-%lu&",
+                  i, i);
+  *len = sg_str_length(str);
+  body = malloc(*len);
+  memcpy(body, sg_str_content(str), *len);
+  sg_str_free(str);
+  return body;
+}
+
+static void parse(const char *type, const char *body, size_t len) {
+  struct sg__httpform *form = sg__httpform_new(type, 4096, count_iter);
+  uint64_t total = 0;
+  size_t size;
+  while (len > 0) {
+    size = len < CHUNK ? len : CHUNK;
+    sg__httpform_parse(form, &total, body, size);
+    body += size;
+    len -= size;
+  }
+  sg__httpform_free(form);
+}
+
+int main(void) {
+  const size_t sizes[] = {65536, 1048576, 16777216};
+  char name[64];
+  char *body;
+  size_t i, len;
+  for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+    body = make_multipart(sizes[i], &len);
+    snprintf(name, sizeof(name), "multipart   %9lu bytes",
+             (unsigned long) sizes[i]);
+    BENCH(name, ITERS(sizes[i]), len, {
+      parse("multipart/form-data; boundary=" BOUNDARY, body, len);
+    });
+    free(body);
+    body = make_urlencoded(sizes[i], &len);
+    snprintf(name, sizeof(name), "urlencoded  %9lu bytes",
+             (unsigned long) sizes[i]);
+    BENCH(name, ITERS(sizes[i]), len, {
+      parse(MHD_HTTP_POST_ENCODING_FORM_URLENCODED, body, len);
+    });
+    free(body);
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,98 @@
+/*                         _
+ *   ___  __ _  __ _ _   _(_)
+ *  / __|/ _` |/ _` | | | | |
+ *  \__ \ (_| | (_| | |_| | |
+ *  |___/\__,_|\__, |\__,_|_|
+ *             |___/
+ *
+ * Cross-platform library which helps to develop web servers or frameworks.
+ *
+ * Copyright (C) 2016-2020 Silvio Clecio <silvioprog@gmail.com>
+ *
+ * Sagui library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * Sagui library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Sagui library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+
+#include "sg_bench.h"
+
+#include <string.h>
+#include <sagui.h>
+
+/* Compares building the same JSON document through sg_str_printf() against
+ * the sg_json writer. */
+
+#define ROWS 1000
+#define ITERS 200
+
+static void build_printf(struct sg_str *str) {
+  unsigned long i;
+  sg_str_write(str, "[", 1);
+  for (i = 0; i < ROWS; i++)
+    sg_str_printf(str,
+                  "%s{\"id\":%lu,\"name\":\"user%lu\",\"active\":%s,"
+                  "\"score\":%.17g,\"tags\":[\"a\\tb\",\"c\\\"d\"]}",
+                  i ? "," : "", i, i * 7919 % 10007,
+                  (i % 3) ? "true" : "false", (double) i / 7);
+  sg_str_write(str, "]", 1);
+}
+
+static void build_json(struct sg_str *str) {
+  struct sg_json *json = sg_json_new(str);
+  char name[32];
+  unsigned long i;
+  sg_json_begin_array(json);
+  for (i = 0; i < ROWS; i++) {
+    sg_json_begin_object(json);
+    sg_json_key(json, "id");
+    sg_json_uint(json, i);
+    sg_json_key(json, "name");
+    snprintf(name, sizeof(name), "user%lu", i * 7919 % 10007);
+    sg_json_string(json, name);
+    sg_json_key(json, "active");
+    sg_json_bool(json, (i % 3) != 0);
+    sg_json_key(json, "score");
+    sg_json_double(json, (double) i / 7);
+    sg_json_key(json, "tags");
+    sg_json_begin_array(json);
+    sg_json_string(json, "a\tb");
+    sg_json_string(json, "c\"d");
+    sg_json_end_array(json);
+    sg_json_end_object(json);
+  }
+  sg_json_end_array(json);
+  sg_json_free(json);
+}
+
+int main(void) {
+  struct sg_str *str = sg_str_new();
+  size_t size;
+  build_printf(str);
+  size = sg_str_length(str);
+  sg_str_clear(str);
+  BENCH("sg_str_printf", ITERS, size, {
+    sg_str_clear(str);
+    build_printf(str);
+  });
+  sg_str_clear(str);
+  build_json(str);
+  size = sg_str_length(str);
+  sg_str_clear(str);
+  BENCH("sg_json", ITERS, size, {
+    sg_str_clear(str);
+    build_json(str);
+  });
+  sg_str_free(str);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,104 @@
+/*                         _
+ *   ___  __ _  __ _ _   _(_)
+ *  / __|/ _` |/ _` | | | | |
+ *  \__ \ (_| | (_| | |_| | |
+ *  |___/\__,_|\__, |\__,_|_|
+ *             |___/
+ *
+ * Cross-platform library which helps to develop web servers or frameworks.
+ *
+ * Copyright (C) 2016-2020 Silvio Clecio <silvioprog@gmail.com>
+ *
+ * Sagui library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * Sagui library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Sagui library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+
+#include "sg_bench.h"
+
+#include <sagui.h>
+
+/* Builds a large CSV export through sg_str (one contiguous buffer, grown by
+ * reallocation) and through sg_rope (pooled fixed-size chunks). */
+
+#define ITERS 10
+
+static void build_str(struct sg_str *str, unsigned long rows) {
+  unsigned long i;
+  for (i = 0; i < rows; i++)
+    sg_str_printf(str, "%lu,user%lu,%lu.%02lu,%s\n", i, i * 7919 % 10007,
+                  i * 31 % 1000, i % 100, (i % 3) ? "true" : "false");
+}
+
+static void build_rope(struct sg_rope *rope, unsigned long rows) {
+  unsigned long i;
+  for (i = 0; i < rows; i++)
+    sg_rope_printf(rope, "%lu,user%lu,%lu.%02lu,%s\n", i, i * 7919 % 10007,
+                   i * 31 % 1000, i % 100, (i % 3) ? "true" : "false");
+}
+
+static const char row[] = "123456,user7919,31.42,true\n";
+
+static void write_str(struct sg_str *str, unsigned long rows) {
+  unsigned long i;
+  for (i = 0; i < rows; i++)
+    sg_str_write(str, row, sizeof(row) - 1);
+}
+
+static void write_rope(struct sg_rope *rope, unsigned long rows) {
+  unsigned long i;
+  for (i = 0; i < rows; i++)
+    sg_rope_write(rope, row, sizeof(row) - 1);
+}
+
+int main(void) {
+  const unsigned long rows[] = {10000, 100000, 1000000};
+  struct sg_str *str;
+  struct sg_rope *rope;
+  char name[64];
+  uint64_t size;
+  size_t i;
+  for (i = 0; i < sizeof(rows) / sizeof(rows[0]); i++) {
+    rope = sg_rope_new();
+    build_rope(rope, rows[i]);
+    size = sg_rope_length(rope);
+    sg_rope_free(rope);
+    snprintf(name, sizeof(name), "sg_str_printf  %8lu rows", rows[i]);
+    BENCH(name, ITERS, size, {
+      str = sg_str_new();
+      build_str(str, rows[i]);
+      sg_str_free(str);
+    });
+    snprintf(name, sizeof(name), "sg_rope_printf %8lu rows", rows[i]);
+    BENCH(name, ITERS, size, {
+      rope = sg_rope_new();
+      build_rope(rope, rows[i]);
+      sg_rope_free(rope);
+    });
+    size = (uint64_t) rows[i] * (sizeof(row) - 1);
+    snprintf(name, sizeof(name), "sg_str_write   %8lu rows", rows[i]);
+    BENCH(name, ITERS, size, {
+      str = sg_str_new();
+      write_str(str, rows[i]);
+      sg_str_free(str);
+    });
+    snprintf(name, sizeof(name), "sg_rope_write  %8lu rows", rows[i]);
+    BENCH(name, ITERS, size, {
+      rope = sg_rope_new();
+      write_rope(rope, rows[i]);
+      sg_rope_free(rope);
+    });
+  }
+  return EXIT_SUCCESS;
+}
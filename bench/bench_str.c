@@ -0,0 +1,107 @@
+/*                         _
+ *   ___  __ _  __ _ _   _(_)
+ *  / __|/ _` |/ _` | | | | |
+ *  \__ \ (_| | (_| | |_| | |
+ *  |___/\__,_|\__, |\__,_|_|
+ *             |___/
+ *
+ * Cross-platform library which helps to develop web servers or frameworks.
+ *
+ * Copyright (C) 2016-2020 Silvio Clecio <silvioprog@gmail.com>
+ *
+ * Sagui library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * Sagui library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Sagui library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+
+#include "sg_bench.h"
+
+#include <string.h>
+#include <sagui.h>
+
+/* Measures the cases covered by test_str, comparing the printf-based appends
+ * against the dedicated appenders. */
+
+#define ITERS 1000000
+
+int main(void) {
+  const char *val = "abc123def456";
+  const size_t len = strlen(val);
+  struct sg_str *str;
+  char *buf;
+  unsigned long i = 0;
+
+  BENCH("sg_str_new/free", ITERS, 0, {
+    str = sg_str_new();
+    sg_str_free(str);
+  });
+  BENCH("sg_str_new/write/free (12 B)", ITERS, len, {
+    str = sg_str_new();
+    sg_str_write(str, val, len);
+    sg_str_free(str);
+  });
+  BENCH("sg_str_new/write/detach (12 B)", ITERS, len, {
+    str = sg_str_new();
+    sg_str_write(str, val, len);
+    buf = sg_str_detach(str, NULL);
+    sg_str_free(str);
+    sg_free(buf);
+  });
+
+  str = sg_str_new();
+  BENCH("sg_str_write x 100 (grow)", ITERS / 100, len * 100, {
+    sg_str_free(str);
+    str = sg_str_new();
+    for (i = 0; i < 100; i++)
+      sg_str_write(str, val, len);
+  });
+  BENCH("sg_str_reserve + sg_str_write x 100", ITERS / 100, len * 100, {
+    sg_str_free(str);
+    str = sg_str_new();
+    sg_str_reserve(str, len * 100);
+    for (i = 0; i < 100; i++)
+      sg_str_write(str, val, len);
+  });
+  BENCH("sg_str_printf(\"%s%d%s%d\")", ITERS, 0, {
+    sg_str_clear(str);
+    sg_str_printf(str, "%s%d%s%d", "abc", 123, "def", 456);
+  });
+
+  BENCH("sg_str_printf(\"%lu\")", ITERS, 0, {
+    sg_str_clear(str);
+    sg_str_printf(str, "%lu", i++ * 7919);
+  });
+  BENCH("sg_str_append_uint", ITERS, 0, {
+    sg_str_clear(str);
+    sg_str_append_uint(str, i++ * 7919);
+  });
+  BENCH("sg_str_printf(\"%c\")", ITERS, 0, {
+    sg_str_clear(str);
+    sg_str_printf(str, "%c", 'a');
+  });
+  BENCH("sg_str_append_char", ITERS, 0, {
+    sg_str_clear(str);
+    sg_str_append_char(str, 'a');
+  });
+  BENCH("sg_str_printf(\"%.17g\")", ITERS, 0, {
+    sg_str_clear(str);
+    sg_str_printf(str, "%.17g", (double) i++ / 7);
+  });
+  BENCH("sg_str_append_double", ITERS, 0, {
+    sg_str_clear(str);
+    sg_str_append_double(str, (double) i++ / 7);
+  });
+  sg_str_free(str);
+  return EXIT_SUCCESS;
+}
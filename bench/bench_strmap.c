@@ -0,0 +1,93 @@
+/*                         _
+ *   ___  __ _  __ _ _   _(_)
+ *  / __|/ _` |/ _` | | | | |
+ *  \__ \ (_| | (_| | |_| | |
+ *  |___/\__,_|\__, |\__,_|_|
+ *             |___/
+ *
+ * Cross-platform library which helps to develop web servers or frameworks.
+ *
+ * Copyright (C) 2016-2020 Silvio Clecio <silvioprog@gmail.com>
+ *
+ * Sagui library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * Sagui library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Sagui library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "sg_bench.h"
+
+#include <string.h>
+#include <sagui.h>
+
+/* Measures building and querying maps of the sizes typical of request
+ * headers, cookies and query-strings. */
+
+#define ITERS 1000000
+
+static const char *names[] = {"Host",
+                              "User-Agent",
+                              "Accept",
+                              "Accept-Language",
+                              "Accept-Encoding",
+                              "Connection",
+                              "Cookie",
+                              "Referer",
+                              "Cache-Control",
+                              "Pragma",
+                              "Upgrade-Insecure-Requests",
+                              "DNT",
+                              "Content-Type",
+                              "Content-Length",
+                              "Origin",
+                              "Authorization"};
+
+static void bench_strmap(unsigned int count) {
+  struct sg_strmap *map = NULL;
+  char keys[64][64], lookup[16][64], label[64];
+  unsigned int i, j;
+  size_t n = 0;
+  for (i = 0; i < count; i++)
+    snprintf(keys[i], sizeof(keys[i]), "%s-%u", names[i % 16], i / 16);
+  /* looks up in mixed case, spread over the whole map */
+  for (i = 0; i < 16; i++) {
+    j = (i * 7) % count;
+    snprintf(lookup[i], sizeof(lookup[i]), "%s-%u", names[j % 16], j / 16);
+    lookup[i][0] = (char) (lookup[i][0] ^ 0x20);
+  }
+  snprintf(label, sizeof(label), "sg_strmap_add x %u + cleanup", count);
+  BENCH(label, ITERS / count, 0, {
+    sg_strmap_cleanup(&map);
+    for (i = 0; i < count; i++)
+      sg_strmap_add(&map, keys[i], "some value");
+  });
+  for (i = 0; i < 16; i++)
+    if (!sg_strmap_get(map, lookup[i]))
+      abort();
+  snprintf(label, sizeof(label), "sg_strmap_get (%u entries, hit)", count);
+  i = 0;
+  BENCH(label, ITERS, 0,
+        { n += strlen(sg_strmap_get(map, lookup[i++ % 16])); });
+  snprintf(label, sizeof(label), "sg_strmap_get (%u entries, miss)", count);
+  BENCH(label, ITERS, 0, { n += sg_strmap_get(map, "X-Missing") ? 1 : 0; });
+  sg_strmap_cleanup(&map);
+  if (n == 0)
+    abort();
+}
+
+int main(void) {
+  bench_strmap(4);
+  bench_strmap(8);
+  bench_strmap(16);
+  bench_strmap(64);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,67 @@
+/*                         _
+ *   ___  __ _  __ _ _   _(_)
+ *  / __|/ _` |/ _` | | | | |
+ *  \__ \ (_| | (_| | |_| | |
+ *  |___/\__,_|\__, |\__,_|_|
+ *             |___/
+ *
+ * Cross-platform library which helps to develop web servers or frameworks.
+ *
+ * Copyright (C) 2016-2020 Silvio Clecio <silvioprog@gmail.com>
+ *
+ * Sagui library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * Sagui library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Sagui library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef SG_BENCH_H
+#define SG_BENCH_H
+
+#ifndef _WIN32
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif /* _GNU_SOURCE */
+#endif /* _WIN32 */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+static uint64_t sg_bench_now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t) ts.tv_sec * 1000000000) + (uint64_t) ts.tv_nsec;
+}
+
+/* Runs `code` `iters` times and prints the average time per iteration. If
+ * `bytes` is non-zero, the throughput of each iteration is also printed. */
+#define BENCH(name, iters, bytes, code)                                        \
+  do {                                                                         \
+    uint64_t _start, _elapsed;                                                 \
+    unsigned long _i;                                                          \
+    _start = sg_bench_now();                                                   \
+    for (_i = 0; _i < (unsigned long) (iters); _i++) {                         \
+      code;                                                                    \
+    }                                                                          \
+    _elapsed = sg_bench_now() - _start;                                        \
+    if ((bytes) > 0)                                                           \
+      printf("%-44s %12.1f ns/op %10.1f MB/s\n", (name),                       \
+             (double) _elapsed / (iters),                                      \
+             ((double) (bytes) * (iters) * 1000) / (double) _elapsed);         \
+    else                                                                       \
+      printf("%-44s %12.1f ns/op\n", (name), (double) _elapsed / (iters));     \
+    fflush(stdout);                                                            \
+  } while (0)
+
+#endif /* SG_BENCH_H */
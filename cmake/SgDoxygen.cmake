@@ -67,6 +67,9 @@ if(SG_BUILD_HTML)
     if(SG_HTTP_COMPRESSION)
       set(SG_HTTP_COMPRESSION_DOC "SG_HTTP_COMPRESSION")
     endif()
+    if(SG_HTTP_WEBSOCKET)
+      set(SG_HTTP_WEBSOCKET_DOC "SG_HTTP_WEBSOCKET")
+    endif()
     if(SG_PATH_ROUTING)
       set(SG_PATH_ROUTING_DOC "SG_PATH_ROUTING")
     endif()
@@ -0,0 +1,116 @@
+#.rst:
+# SgLibdeflate
+# ------------
+#
+# Build libdeflate.
+#
+# Build libdeflate from Sagui building.
+#
+# ::
+#
+# LIBDEFLATE_INCLUDE_DIR - Directory of includes.
+# LIBDEFLATE_ARCHIVE_LIB - AR archive library.
+
+#                         _
+#   ___  __ _  __ _ _   _(_)
+#  / __|/ _` |/ _` | | | | |
+#  \__ \ (_| | (_| | |_| | |
+#  |___/\__,_|\__, |\__,_|_|
+#             |___/
+#
+# Cross-platform library which helps to develop web servers or frameworks.
+#
+# Copyright (C) 2016-2024 Silvio Clecio <silvioprog@gmail.com>
+#
+# Sagui library is free software; you can redistribute it and/or
+# modify it under the terms of the GNU Lesser General Public
+# License as published by the Free Software Foundation; either
+# version 2.1 of the License, or (at your option) any later version.
+#
+# Sagui library is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public
+# License along with Sagui library; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+#
+
+if(__SG_LIBDEFLATE_INCLUDED)
+  return()
+endif()
+set(__SG_LIBDEFLATE_INCLUDED ON)
+
+if(CMAKE_VERSION VERSION_GREATER "3.23")
+  cmake_policy(SET CMP0135 NEW)
+endif()
+
+set(LIBDEFLATE_NAME "libdeflate")
+set(LIBDEFLATE_VER "1.22")
+set(LIBDEFLATE_FULL_NAME "${LIBDEFLATE_NAME}-${LIBDEFLATE_VER}")
+set(LIBDEFLATE_URL
+    "https://github.com/ebiggers/libdeflate/archive/refs/tags/v${LIBDEFLATE_VER}.tar.gz"
+)
+set(LIBDEFLATE_URL_MIRROR
+    "https://github.com/ebiggers/libdeflate/archive/refs/tags/v${LIBDEFLATE_VER}.tar.gz"
+)
+set(LIBDEFLATE_SHA256
+    "7f343c7bf2ba46e774d8a632bf073235e1fd27723ef0a12a90f8947b7fe851d6")
+if(${CMAKE_VERSION} VERSION_LESS "3.7")
+  unset(LIBDEFLATE_URL_MIRROR)
+endif()
+if(CMAKE_C_COMPILER)
+  set(LIBDEFLATE_OPTIONS -DCMAKE_C_COMPILER=${CMAKE_C_COMPILER})
+endif()
+if(CMAKE_RC_COMPILER)
+  set(LIBDEFLATE_OPTIONS ${LIBDEFLATE_OPTIONS}
+                         -DCMAKE_RC_COMPILER=${CMAKE_RC_COMPILER})
+endif()
+if(CMAKE_SYSTEM_NAME)
+  set(LIBDEFLATE_OPTIONS ${LIBDEFLATE_OPTIONS}
+                         -DCMAKE_SYSTEM_NAME=${CMAKE_SYSTEM_NAME})
+endif()
+if(UNIX)
+  set(LIBDEFLATE_OPTIONS ${LIBDEFLATE_OPTIONS}
+                         -DCMAKE_POSITION_INDEPENDENT_CODE=ON)
+endif()
+if(ANDROID)
+  set(LIBDEFLATE_OPTIONS
+      ${LIBDEFLATE_OPTIONS}
+      -DCMAKE_ANDROID_ARM_MODE=${CMAKE_ANDROID_ARM_MODE}
+      -DCMAKE_SYSTEM_VERSION=${CMAKE_SYSTEM_VERSION}
+      -DCMAKE_ANDROID_ARCH_ABI=${CMAKE_ANDROID_ARCH_ABI}
+      -DCMAKE_ANDROID_STANDALONE_TOOLCHAIN=${CMAKE_ANDROID_STANDALONE_TOOLCHAIN}
+  )
+endif()
+set(LIBDEFLATE_OPTIONS
+    ${LIBDEFLATE_OPTIONS}
+    -DCMAKE_BUILD_TYPE=${CMAKE_BUILD_TYPE}
+    -DCMAKE_INSTALL_PREFIX=${CMAKE_BINARY_DIR}/${LIBDEFLATE_FULL_NAME}
+    -DCMAKE_INSTALL_LIBDIR=lib
+    -DLIBDEFLATE_BUILD_STATIC_LIB=ON
+    -DLIBDEFLATE_BUILD_SHARED_LIB=OFF
+    -DLIBDEFLATE_BUILD_GZIP=OFF
+    -DLIBDEFLATE_BUILD_TESTS=OFF
+    -DLIBDEFLATE_DECOMPRESSION_SUPPORT=OFF)
+
+ExternalProject_Add(
+  ${LIBDEFLATE_FULL_NAME}
+  URL ${LIBDEFLATE_URL} ${LIBDEFLATE_URL_MIRROR}
+  URL_HASH SHA256=${LIBDEFLATE_SHA256}
+  TIMEOUT 15
+  DOWNLOAD_DIR ${CMAKE_SOURCE_DIR}/lib
+  DOWNLOAD_NAME ${LIBDEFLATE_FULL_NAME}.tar.gz
+  PREFIX ${CMAKE_BINARY_DIR}/${LIBDEFLATE_FULL_NAME}
+  SOURCE_DIR ${CMAKE_SOURCE_DIR}/lib/${LIBDEFLATE_FULL_NAME}
+  CMAKE_ARGS ${LIBDEFLATE_OPTIONS}
+  LOG_DOWNLOAD ON
+  LOG_CONFIGURE ON
+  LOG_BUILD ON
+  LOG_INSTALL ON)
+
+ExternalProject_Get_Property(${LIBDEFLATE_FULL_NAME} INSTALL_DIR)
+set(LIBDEFLATE_INCLUDE_DIR ${INSTALL_DIR}/include)
+set(LIBDEFLATE_ARCHIVE_LIB ${INSTALL_DIR}/lib/libdeflate.a)
+unset(INSTALL_DIR)
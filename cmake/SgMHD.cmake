@@ -61,6 +61,11 @@ if(SG_HTTPS_SUPPORT AND GNUTLS_FOUND)
 else()
   set(_enable_https "no")
 endif()
+if(SG_HTTP_WEBSOCKET)
+  set(_enable_httpupgrade "yes")
+else()
+  set(_enable_httpupgrade "no")
+endif()
 set(MHD_OPTIONS
     --libdir=${_libdir}
     --enable-static=yes
@@ -69,12 +74,13 @@ set(MHD_OPTIONS
     --enable-https=${_enable_https}
     --enable-asserts=no
     --enable-coverage=no
-    --disable-httpupgrade
+    --enable-httpupgrade=${_enable_httpupgrade}
     --disable-dauth
     --disable-doc
     --disable-examples
     --disable-curl)
 unset(_enable_https)
+unset(_enable_httpupgrade)
 if(MINGW)
   set(MHD_OPTIONS ${MHD_OPTIONS} --quiet)
   set(_manifest_tool MANIFEST_TOOL=:)
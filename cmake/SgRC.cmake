@@ -61,7 +61,20 @@ if(SG_HTTPS_SUPPORT)
   list(APPEND RC_FILE_DESC_MODS "TLS")
 endif()
 if(SG_HTTP_COMPRESSION)
-  list(APPEND RC_FILE_DESC_MODS "ZLIB")
+  if(SG_HTTP_COMPRESSION_ZLIB_NG)
+    list(APPEND RC_FILE_DESC_MODS "ZLIB-NG")
+  else()
+    list(APPEND RC_FILE_DESC_MODS "ZLIB")
+  endif()
+  if(SG_HTTP_COMPRESSION_LIBDEFLATE)
+    list(APPEND RC_FILE_DESC_MODS "LIBDEFLATE")
+  endif()
+  if(SG_HTTP_COMPRESSION_BROTLI)
+    list(APPEND RC_FILE_DESC_MODS "BROTLI")
+  endif()
+  if(SG_HTTP_COMPRESSION_ZSTD)
+    list(APPEND RC_FILE_DESC_MODS "ZSTD")
+  endif()
 endif()
 if(SG_PATH_ROUTING)
   list(APPEND RC_FILE_DESC_MODS "PCRE2")
@@ -85,10 +85,40 @@ endif()
 
 if(SG_HTTP_COMPRESSION)
   set(_http_compression "Yes")
+  unset(_encoders)
+  if(SG_HTTP_COMPRESSION_ZLIB_NG)
+    list(APPEND _encoders "zlib-ng")
+  endif()
+  if(SG_HTTP_COMPRESSION_LIBDEFLATE)
+    list(APPEND _encoders "libdeflate")
+  endif()
+  if(SG_HTTP_COMPRESSION_BROTLI)
+    list(APPEND _encoders "br")
+  endif()
+  if(SG_HTTP_COMPRESSION_ZSTD)
+    list(APPEND _encoders "zstd")
+  endif()
+  if(_encoders)
+    string(REPLACE ";" ", " _encoders "${_encoders}")
+    string(CONCAT _http_compression ${_http_compression} " (${_encoders})")
+  endif()
+  unset(_encoders)
 else()
   set(_http_compression "No")
 endif()
 
+if(SG_HTTP_WEBSOCKET)
+  set(_websocket "Yes")
+else()
+  set(_websocket "No")
+endif()
+
+if(SG_HTTP_UPLD_URING)
+  set(_upld_uring "Yes")
+else()
+  set(_upld_uring "No")
+endif()
+
 if(SG_PATH_ROUTING)
   set(_routing "Yes")
 else()
@@ -163,6 +193,8 @@ Sagui library ${VERSION} - building summary:
   Additional features:
     HTTPS support: ${_https_support}
     HTTP compression: ${_http_compression}
+    WebSocket: ${_websocket}
+    io_uring uploads: ${_upld_uring}
     Path routing: ${_routing}
     Math expression evaluator: ${_expr}
   Examples: ${_build_examples}
@@ -178,6 +210,8 @@ unset(_build_arch)
 unset(_lib_type)
 unset(_https_support)
 unset(_http_compression)
+unset(_websocket)
+unset(_upld_uring)
 unset(_routing)
 unset(_expr)
 unset(_build_examples)
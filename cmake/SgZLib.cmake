@@ -4,7 +4,8 @@
 #
 # Build ZLib.
 #
-# Build ZLib from Sagui building.
+# Build ZLib from Sagui building. If SG_HTTP_COMPRESSION_ZLIB_NG is enabled,
+# zlib-ng is built in zlib compatible mode instead.
 #
 # ::
 #
@@ -46,15 +47,27 @@ if(CMAKE_VERSION VERSION_GREATER "3.23")
   cmake_policy(SET CMP0135 NEW)
 endif()
 
-set(ZLIB_NAME "zlib")
-set(ZLIB_VER "1.3.1")
-set(ZLIB_FULL_NAME "${ZLIB_NAME}-${ZLIB_VER}")
-set(ZLIB_URL "https://zlib.net/${ZLIB_FULL_NAME}.tar.gz")
-set(ZLIB_URL_MIRROR
-    "https://github.com/madler/zlib/releases/download/v${ZLIB_VER}/${ZLIB_FULL_NAME}.tar.gz"
-)
-set(ZLIB_SHA256
-    "9a93b2b7dfdac77ceba5a558a580e74667dd6fede4585b91eefb60f03b72df23")
+if(SG_HTTP_COMPRESSION_ZLIB_NG)
+  set(ZLIB_NAME "zlib-ng")
+  set(ZLIB_VER "2.2.2")
+  set(ZLIB_FULL_NAME "${ZLIB_NAME}-${ZLIB_VER}")
+  set(ZLIB_URL
+      "https://github.com/zlib-ng/zlib-ng/archive/refs/tags/${ZLIB_VER}.tar.gz")
+  set(ZLIB_URL_MIRROR
+      "https://github.com/zlib-ng/zlib-ng/archive/refs/tags/${ZLIB_VER}.tar.gz")
+  set(ZLIB_SHA256
+      "fcb41dd59a3f17002aeb1bb21f04696c9b721404890bb945c5ab39d2cb69654c")
+else()
+  set(ZLIB_NAME "zlib")
+  set(ZLIB_VER "1.3.1")
+  set(ZLIB_FULL_NAME "${ZLIB_NAME}-${ZLIB_VER}")
+  set(ZLIB_URL "https://zlib.net/${ZLIB_FULL_NAME}.tar.gz")
+  set(ZLIB_URL_MIRROR
+      "https://github.com/madler/zlib/releases/download/v${ZLIB_VER}/${ZLIB_FULL_NAME}.tar.gz"
+  )
+  set(ZLIB_SHA256
+      "9a93b2b7dfdac77ceba5a558a580e74667dd6fede4585b91eefb60f03b72df23")
+endif()
 if(${CMAKE_VERSION} VERSION_LESS "3.7")
   unset(ZLIB_URL_MIRROR)
 endif()
@@ -81,6 +94,16 @@ if(ANDROID)
 endif()
 set(ZLIB_OPTIONS ${ZLIB_OPTIONS} -DCMAKE_BUILD_TYPE=${CMAKE_BUILD_TYPE}
                  -DCMAKE_INSTALL_PREFIX=${CMAKE_BINARY_DIR}/${ZLIB_FULL_NAME})
+if(SG_HTTP_COMPRESSION_ZLIB_NG)
+  set(ZLIB_OPTIONS
+      ${ZLIB_OPTIONS}
+      -DCMAKE_INSTALL_LIBDIR=lib
+      -DBUILD_SHARED_LIBS=OFF
+      -DZLIB_COMPAT=ON
+      -DZLIB_ENABLE_TESTS=OFF
+      -DZLIBNG_ENABLE_TESTS=OFF
+      -DWITH_GTEST=OFF)
+endif()
 
 ExternalProject_Add(
   ${ZLIB_FULL_NAME}
@@ -88,6 +111,7 @@ ExternalProject_Add(
   URL_HASH SHA256=${ZLIB_SHA256}
   TIMEOUT 15
   DOWNLOAD_DIR ${CMAKE_SOURCE_DIR}/lib
+  DOWNLOAD_NAME ${ZLIB_FULL_NAME}.tar.gz
   PREFIX ${CMAKE_BINARY_DIR}/${ZLIB_FULL_NAME}
   SOURCE_DIR ${CMAKE_SOURCE_DIR}/lib/${ZLIB_FULL_NAME}
   CMAKE_ARGS ${ZLIB_OPTIONS}
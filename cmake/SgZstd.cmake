@@ -0,0 +1,114 @@
+#.rst:
+# SgZstd
+# ------
+#
+# Build Zstandard.
+#
+# Build Zstandard from Sagui building.
+#
+# ::
+#
+# ZSTD_INCLUDE_DIR - Directory of includes.
+# ZSTD_ARCHIVE_LIB - AR archive library.
+
+#                         _
+#   ___  __ _  __ _ _   _(_)
+#  / __|/ _` |/ _` | | | | |
+#  \__ \ (_| | (_| | |_| | |
+#  |___/\__,_|\__, |\__,_|_|
+#             |___/
+#
+# Cross-platform library which helps to develop web servers or frameworks.
+#
+# Copyright (C) 2016-2024 Silvio Clecio <silvioprog@gmail.com>
+#
+# Sagui library is free software; you can redistribute it and/or
+# modify it under the terms of the GNU Lesser General Public
+# License as published by the Free Software Foundation; either
+# version 2.1 of the License, or (at your option) any later version.
+#
+# Sagui library is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public
+# License along with Sagui library; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+#
+
+if(__SG_ZSTD_INCLUDED)
+  return()
+endif()
+set(__SG_ZSTD_INCLUDED ON)
+
+if(CMAKE_VERSION VERSION_GREATER "3.23")
+  cmake_policy(SET CMP0135 NEW)
+endif()
+
+set(ZSTD_NAME "zstd")
+set(ZSTD_VER "1.5.6")
+set(ZSTD_FULL_NAME "${ZSTD_NAME}-${ZSTD_VER}")
+set(ZSTD_URL
+    "https://github.com/facebook/zstd/releases/download/v${ZSTD_VER}/${ZSTD_FULL_NAME}.tar.gz"
+)
+set(ZSTD_URL_MIRROR
+    "https://github.com/facebook/zstd/releases/download/v${ZSTD_VER}/${ZSTD_FULL_NAME}.tar.gz"
+)
+set(ZSTD_SHA256
+    "8c29e06cf42aacc1eafc4077ae2ec6c6fcb96a626157e0593d5e82a34fd403c1")
+if(${CMAKE_VERSION} VERSION_LESS "3.7")
+  unset(ZSTD_URL_MIRROR)
+endif()
+if(CMAKE_C_COMPILER)
+  set(ZSTD_OPTIONS -DCMAKE_C_COMPILER=${CMAKE_C_COMPILER})
+endif()
+if(CMAKE_RC_COMPILER)
+  set(ZSTD_OPTIONS ${ZSTD_OPTIONS} -DCMAKE_RC_COMPILER=${CMAKE_RC_COMPILER})
+endif()
+if(CMAKE_SYSTEM_NAME)
+  set(ZSTD_OPTIONS ${ZSTD_OPTIONS} -DCMAKE_SYSTEM_NAME=${CMAKE_SYSTEM_NAME})
+endif()
+if(UNIX)
+  set(ZSTD_OPTIONS ${ZSTD_OPTIONS} -DCMAKE_POSITION_INDEPENDENT_CODE=ON)
+endif()
+if(ANDROID)
+  set(ZSTD_OPTIONS
+      ${ZSTD_OPTIONS}
+      -DCMAKE_ANDROID_ARM_MODE=${CMAKE_ANDROID_ARM_MODE}
+      -DCMAKE_SYSTEM_VERSION=${CMAKE_SYSTEM_VERSION}
+      -DCMAKE_ANDROID_ARCH_ABI=${CMAKE_ANDROID_ARCH_ABI}
+      -DCMAKE_ANDROID_STANDALONE_TOOLCHAIN=${CMAKE_ANDROID_STANDALONE_TOOLCHAIN}
+  )
+endif()
+set(ZSTD_OPTIONS
+    ${ZSTD_OPTIONS}
+    -DCMAKE_BUILD_TYPE=${CMAKE_BUILD_TYPE}
+    -DCMAKE_INSTALL_PREFIX=${CMAKE_BINARY_DIR}/${ZSTD_FULL_NAME}
+    -DCMAKE_INSTALL_LIBDIR=lib
+    -DZSTD_BUILD_PROGRAMS=OFF
+    -DZSTD_BUILD_SHARED=OFF
+    -DZSTD_BUILD_STATIC=ON
+    -DZSTD_BUILD_TESTS=OFF
+    -DZSTD_LEGACY_SUPPORT=OFF
+    -DZSTD_MULTITHREAD_SUPPORT=OFF)
+
+ExternalProject_Add(
+  ${ZSTD_FULL_NAME}
+  URL ${ZSTD_URL} ${ZSTD_URL_MIRROR}
+  URL_HASH SHA256=${ZSTD_SHA256}
+  TIMEOUT 15
+  DOWNLOAD_DIR ${CMAKE_SOURCE_DIR}/lib
+  PREFIX ${CMAKE_BINARY_DIR}/${ZSTD_FULL_NAME}
+  SOURCE_DIR ${CMAKE_SOURCE_DIR}/lib/${ZSTD_FULL_NAME}
+  SOURCE_SUBDIR build/cmake
+  CMAKE_ARGS ${ZSTD_OPTIONS}
+  LOG_DOWNLOAD ON
+  LOG_CONFIGURE ON
+  LOG_BUILD ON
+  LOG_INSTALL ON)
+
+ExternalProject_Get_Property(${ZSTD_FULL_NAME} INSTALL_DIR)
+set(ZSTD_INCLUDE_DIR ${INSTALL_DIR}/include)
+set(ZSTD_ARCHIVE_LIB ${INSTALL_DIR}/lib/lib${ZSTD_NAME}.a)
+unset(INSTALL_DIR)
@@ -51,36 +51,16 @@
   "</body>\n"                                                                  \
   "</html>"
 
-static unsigned int COUNT = 0;
-
 #ifdef _WIN32
-#define sleep Sleep
+#define sleep(seconds) Sleep((seconds) * 1000)
 #endif /* _WIN32 */
 
-static ssize_t sse_read_cb(__SG_UNUSED void *handle, uint64_t offset, char *buf,
-                           size_t size) {
-  char msg[20];
-  if (offset == 0) {
-    size = sprintf(msg, "retry: 1000\n");
-  } else {
-    size = sprintf(msg, "data: %d\n\n", ++COUNT);
-    sleep(1);
-  }
-  memcpy(buf, msg, size);
-  msg[size] = '\0';
-  return size;
-}
-
-static void req_cb(__SG_UNUSED void *cls, struct sg_httpreq *req,
-                   struct sg_httpres *res) {
-  struct sg_strmap *pair;
-  struct sg_strmap **req_headers = sg_httpreq_headers(req);
+static void req_cb(void *cls, struct sg_httpreq *req, struct sg_httpres *res) {
+  const char *accept = sg_httpreq_header(req, "Accept");
   struct sg_strmap **res_headers = sg_httpres_headers(res);
-  if (sg_strmap_find(*req_headers, "Accept", &pair) == 0 &&
-      strstr(sg_strmap_val(pair), "text/event-stream")) {
+  if (accept && strstr(accept, "text/event-stream")) {
     sg_strmap_set(res_headers, "Access-Control-Allow-Origin", "*");
-    sg_strmap_set(res_headers, "Content-Type", "text/event-stream");
-    sg_httpres_sendstream(res, 0, sse_read_cb, NULL, NULL, 200);
+    sg_httpsse_subscribe(cls, req);
     return;
   }
   if (strcmp(sg_httpreq_path(req), "/favicon.ico") == 0) {
@@ -91,20 +71,28 @@ static void req_cb(__SG_UNUSED void *cls, struct sg_httpreq *req,
 }
 
 int main(int argc, const char *argv[]) {
+  char data[20];
+  struct sg_httpsse *sse;
   struct sg_httpsrv *srv;
+  unsigned int count = 0;
   if (argc != 2) {
     printf("%s <PORT>\n", argv[0]);
     return EXIT_FAILURE;
   }
-  srv = sg_httpsrv_new(req_cb, NULL);
-  if (!sg_httpsrv_listen(srv, strtol(argv[1], NULL, 10), true)) {
+  sse = sg_httpsse_new(4096, SG_HTTPSSE_DROP);
+  srv = sg_httpsrv_new(req_cb, sse);
+  if (!sg_httpsrv_listen(srv, strtol(argv[1], NULL, 10), false)) {
     sg_httpsrv_free(srv);
+    sg_httpsse_free(sse);
     return EXIT_FAILURE;
   }
   fprintf(stdout, "Server running at http://localhost:%d\n",
           sg_httpsrv_port(srv));
   fflush(stdout);
-  getchar();
-  sg_httpsrv_free(srv);
-  return EXIT_SUCCESS;
+  /* Press Ctrl+C to stop. */
+  for (;;) {
+    sleep(1);
+    snprintf(data, sizeof(data), "%u", ++count);
+    sg_httpsse_publish(sse, NULL, data);
+  }
 }
@@ -0,0 +1,89 @@
+/*                         _
+ *   ___  __ _  __ _ _   _(_)
+ *  / __|/ _` |/ _` | | | | |
+ *  \__ \ (_| | (_| | |_| | |
+ *  |___/\__,_|\__, |\__,_|_|
+ *             |___/
+ *
+ * Cross-platform library which helps to develop web servers or frameworks.
+ *
+ * Copyright (C) 2016-2020 Silvio Clecio <silvioprog@gmail.com>
+ *
+ * Sagui library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * Sagui library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Sagui library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sagui.h>
+
+/* NOTE: Error checking has been omitted to make it clear. */
+
+#define PAGE                                                                   \
+  "<html>\n"                                                                   \
+  "<head>\n"                                                                   \
+  "<title>WebSocket example</title>\n"                                         \
+  "</head><body><input id=\"msg\"><button id=\"send\">Send</button>\n"        \
+  "<pre id=\"log\"></pre>\n"                                                   \
+  "<script>\n"                                                                 \
+  "const ws = new WebSocket('ws://' + location.host + '/ws');\n"               \
+  "ws.onmessage = function (ev) {\n"                                           \
+  "  document.getElementById('log').textContent += ev.data + '\\n';\n"        \
+  "};\n"                                                                       \
+  "document.getElementById('send').onclick = function () {\n"                  \
+  "  ws.send(document.getElementById('msg').value);\n"                         \
+  "};\n"                                                                       \
+  "</script>\n"                                                                \
+  "</body>\n"                                                                  \
+  "</html>"
+
+static void ws_msg_cb(__SG_UNUSED void *cls, struct sg_httpws *ws, bool binary,
+                      const void *buf, size_t size) {
+  sg_httpws_send(ws, binary, buf, size);
+}
+
+static void ws_close_cb(__SG_UNUSED void *cls, __SG_UNUSED struct sg_httpws *ws,
+                        unsigned int code) {
+  printf("Connection closed: %u\n", code);
+}
+
+static void req_cb(__SG_UNUSED void *cls, struct sg_httpreq *req,
+                   struct sg_httpres *res) {
+  if (strcmp(sg_httpreq_path(req), "/ws") == 0) {
+    if (sg_httpws_upgrade(req, ws_msg_cb, ws_close_cb, NULL) != 0)
+      sg_httpres_send(res, "Bad request", "text/plain", 400);
+    return;
+  }
+  sg_httpres_send(res, PAGE, "text/html; charset=utf-8", 200);
+}
+
+int main(int argc, const char *argv[]) {
+  struct sg_httpsrv *srv;
+  if (argc != 2) {
+    printf("%s <PORT>\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+  srv = sg_httpsrv_new(req_cb, NULL);
+  if (!sg_httpsrv_listen(srv, strtol(argv[1], NULL, 10), false)) {
+    sg_httpsrv_free(srv);
+    return EXIT_FAILURE;
+  }
+  fprintf(stdout, "Server running at http://localhost:%d\n",
+          sg_httpsrv_port(srv));
+  fflush(stdout);
+  getchar();
+  sg_httpsrv_free(srv);
+  return EXIT_SUCCESS;
+}
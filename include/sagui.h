@@ -353,6 +353,7 @@ SG_EXTERN void sg_str_free(struct sg_str *str);
  * \param[in] len Length of the string to be written.
  * \retval 0 Success.
  * \retval EINVAL Invalid argument.
+ * \retval ENOMEM Out of memory.
  */
 SG_EXTERN int sg_str_write(struct sg_str *str, const char *val, size_t len);
 
@@ -367,6 +368,7 @@ SG_EXTERN int sg_str_write(struct sg_str *str, const char *val, size_t len);
  * [`va_end()`](https://linux.die.net/man/3/va_end)).
  * \retval 0 Success.
  * \retval EINVAL Invalid argument.
+ * \retval ENOMEM Out of memory.
  */
 SG_EXTERN int sg_str_printf_va(struct sg_str *str, const char *fmt, va_list ap);
 
@@ -380,6 +382,7 @@ SG_EXTERN int sg_str_printf_va(struct sg_str *str, const char *fmt, va_list ap);
  * [`printf()`](https://linux.die.net/man/3/printf) arguments specification).
  * \retval 0 Success.
  * \retval EINVAL Invalid argument.
+ * \retval ENOMEM Out of memory.
  */
 SG_EXTERN int sg_str_printf(struct sg_str *str, const char *fmt, ...)
   __SG_FORMAT(2, 3);
@@ -408,6 +411,81 @@ SG_EXTERN size_t sg_str_length(struct sg_str *str);
  */
 SG_EXTERN int sg_str_clear(struct sg_str *str);
 
+/**
+ * Appends a single character to the string handle \pr{str}.
+ * \param[in] str String handle.
+ * \param[in] c Character to be appended.
+ * \retval 0 Success.
+ * \retval EINVAL Invalid argument.
+ * \retval ENOMEM Out of memory.
+ */
+SG_EXTERN int sg_str_append_char(struct sg_str *str, char c);
+
+/**
+ * Appends the decimal representation of a signed integer to the string handle
+ * \pr{str}, without going through the `printf()` machinery.
+ * \param[in] str String handle.
+ * \param[in] val Integer to be appended.
+ * \retval 0 Success.
+ * \retval EINVAL Invalid argument.
+ * \retval ENOMEM Out of memory.
+ */
+SG_EXTERN int sg_str_append_int(struct sg_str *str, int64_t val);
+
+/**
+ * Appends the decimal representation of an unsigned integer to the string
+ * handle \pr{str}, without going through the `printf()` machinery.
+ * \param[in] str String handle.
+ * \param[in] val Integer to be appended.
+ * \retval 0 Success.
+ * \retval EINVAL Invalid argument.
+ * \retval ENOMEM Out of memory.
+ */
+SG_EXTERN int sg_str_append_uint(struct sg_str *str, uint64_t val);
+
+/**
+ * Appends the shortest representation of a double which reads back to the
+ * same value, e.g. `0.1`, `1.0` or `1e21`.
+ * \param[in] str String handle.
+ * \param[in] val Finite number to be appended.
+ * \retval 0 Success.
+ * \retval EINVAL Invalid argument or \pr{val} is NaN or infinite.
+ * \retval ENOMEM Out of memory.
+ */
+SG_EXTERN int sg_str_append_double(struct sg_str *str, double val);
+
+/**
+ * Reserves space for at least \pr{size} bytes of content, so writes up to that
+ * total length do not reallocate. Short strings are kept inside the handle and
+ * do not allocate at all.
+ * \param[in] str String handle.
+ * \param[in] size Content size to be reserved.
+ * \retval 0 Success.
+ * \retval EINVAL Invalid argument.
+ * \retval ENOMEM Out of memory.
+ */
+SG_EXTERN int sg_str_reserve(struct sg_str *str, size_t size);
+
+/**
+ * Releases the space not used by the content of the string handle \pr{str}.
+ * \param[in] str String handle.
+ * \retval 0 Success.
+ * \retval EINVAL Invalid argument.
+ * \retval ENOMEM Out of memory.
+ */
+SG_EXTERN int sg_str_shrink(struct sg_str *str);
+
+/**
+ * Transfers the content of the string handle \pr{str} to the caller, leaving
+ * the handle empty.
+ * \param[in] str String handle.
+ * \param[out] len Length of the detached content. It can be `NULL`.
+ * \return Null-terminated content which must be freed by #sg_free().
+ * \retval NULL If \pr{str} is null and set the `errno` to `EINVAL`, or if no
+ * memory space is available and set the `errno` to `ENOMEM`.
+ */
+SG_EXTERN char *sg_str_detach(struct sg_str *str, size_t *len) __SG_MALLOC;
+
 /** \} */
 
 /**
@@ -567,6 +645,50 @@ SG_EXTERN int sg_strmap_next(struct sg_strmap **next);
  */
 SG_EXTERN void sg_strmap_cleanup(struct sg_strmap **map);
 
+/**
+ * Handle for an immutable and reference-counted copy of a string map. It
+ * allows to share a common set of pairs, e.g. standard response headers, with
+ * no per-use copies.
+ * \struct sg_strmap_snap
+ */
+struct sg_strmap_snap;
+
+/**
+ * Creates a snapshot copying all the pairs of the \pr{map}.
+ * \param[in] map Pairs map. Use `NULL` for an empty snapshot.
+ * \return New snapshot handle with a single reference.
+ * \retval NULL If no memory space is available and set the `errno` to
+ * `ENOMEM`.
+ */
+SG_EXTERN struct sg_strmap_snap *sg_strmap_snap_new(struct sg_strmap *map)
+  __SG_MALLOC;
+
+/**
+ * Acquires a new reference to the snapshot. It can be called from any thread.
+ * \param[in] snap Snapshot handle.
+ * \return The snapshot itself.
+ * \retval NULL If \pr{snap} is null and set the `errno` to `EINVAL`.
+ */
+SG_EXTERN struct sg_strmap_snap *sg_strmap_snap_ref(
+  struct sg_strmap_snap *snap);
+
+/**
+ * Releases a reference to the snapshot, freeing it after the last one. It can
+ * be called from any thread.
+ * \param[in] snap Snapshot handle.
+ */
+SG_EXTERN void sg_strmap_snap_unref(struct sg_strmap_snap *snap);
+
+/**
+ * Returns the pairs of the snapshot, which can be read by the map functions
+ * such as sg_strmap_get() and sg_strmap_iter().
+ * \param[in] snap Snapshot handle.
+ * \return Pairs map.
+ * \retval NULL If \pr{snap} is null and set the `errno` to `EINVAL`.
+ * \warning The returned map must not be changed.
+ */
+SG_EXTERN struct sg_strmap *sg_strmap_snap_map(struct sg_strmap_snap *snap);
+
 /** \} */
 
 /**
@@ -589,6 +711,33 @@ struct sg_httpauth;
  */
 struct sg_httpupld;
 
+/**
+ * Policies to flush the uploaded files to the storage device when they are
+ * saved.
+ * \enum sg_httpupld_sync
+ */
+enum sg_httpupld_sync {
+  /** Leaves the flushing to the operating system. */
+  SG_HTTPUPLD_SYNC_NONE,
+  /** Flushes the file contents before publishing it. */
+  SG_HTTPUPLD_SYNC_DATA,
+  /** Flushes the file contents and metadata before publishing it, and the
+   * destination directory after publishing it. */
+  SG_HTTPUPLD_SYNC_FULL
+};
+
+/**
+ * Digest algorithms computed while the data is received. They can be combined
+ * with the bitwise OR operator.
+ * \enum sg_digest
+ */
+enum sg_digest {
+  /** CRC-32C (Castagnoli), as 8 hexadecimal digits. */
+  SG_DIGEST_CRC32C = 1,
+  /** SHA-256, as 64 hexadecimal digits. */
+  SG_DIGEST_SHA256 = 2
+};
+
 /**
  * Handle for the request handling. It contains headers, cookies, query-string,
  * fields, payloads, uploads and other data sent by the client.
@@ -667,6 +816,32 @@ typedef int (*sg_httpuplds_iter_cb)(void *cls, struct sg_httpupld *upld);
 typedef void (*sg_httpreq_cb)(void *cls, struct sg_httpreq *req,
                               struct sg_httpres *res);
 
+/**
+ * Callback signature used to receive the request body as it arrives.
+ * \param[out] cls User-defined closure.
+ * \param[out] req Request handle.
+ * \param[out] buf Chunk of the request body.
+ * \param[out] size Size of the chunk.
+ * \return Number of bytes consumed from \pr{buf}. Consuming less than
+ * \pr{size} pauses the reading until #sg_httpreq_resume_body() is called, and
+ * the remaining bytes are passed again after that.
+ * \retval -1 Aborts the request.
+ */
+typedef ssize_t (*sg_httpreq_body_cb)(void *cls, struct sg_httpreq *req,
+                                      const char *buf, size_t size);
+
+/**
+ * Callback signature used to iterate the headers, cookies or query-string
+ * values of a request without copying them.
+ * \param[out] cls User-defined closure.
+ * \param[out] name Value name.
+ * \param[out] val Value content. It can be `NULL`, e.g. for `?flag`.
+ * \retval 0 Success.
+ * \retval E<ERROR> User-defined error to stop the iteration.
+ */
+typedef int (*sg_httpreq_iter_cb)(void *cls, const char *name,
+                                  const char *val);
+
 /**
  * Sets the authentication protection space (realm).
  * \param[in] auth Authentication handle.
@@ -823,6 +998,34 @@ SG_EXTERN const char *sg_httpupld_encoding(struct sg_httpupld *upld);
  */
 SG_EXTERN uint64_t sg_httpupld_size(struct sg_httpupld *upld);
 
+/**
+ * Returns the content of the upload, whose length is given by
+ * sg_httpupld_size(). An upload kept in memory is returned as is, and one
+ * written to disk is loaded once into memory.
+ * \param[in] upld Upload handle.
+ * \return Upload content.
+ * \retval NULL If \pr{upld} is null and set the `errno` to `EINVAL`, or if
+ * the content cannot be read and set the `errno` to the error number, e.g.
+ * `ENOTSUP` when the upload was not handled by the default upload callbacks or
+ * `EBADF` when its file was already saved.
+ * \note The content is freed with the upload.
+ */
+SG_EXTERN const void *sg_httpupld_data(struct sg_httpupld *upld);
+
+/**
+ * Returns a digest of the upload, computed while it was received.
+ * \param[in] upld Upload handle.
+ * \param[in] algo Digest algorithm.
+ * \return Digest as a null-terminated lowercase hexadecimal string.
+ * \retval NULL If \pr{upld} is null or \pr{algo} is unknown and set the
+ * `errno` to `EINVAL`, or if \pr{algo} was not enabled by
+ * sg_httpsrv_set_upld_digests() and set the `errno` to `ENOTSUP`.
+ * \note The digest is final once returned, so it must be requested after the
+ * upload is complete.
+ */
+SG_EXTERN const char *sg_httpupld_digest(struct sg_httpupld *upld,
+                                         enum sg_digest algo);
+
 /**
  * Saves the uploaded file defining the destination path by upload name and
  * directory.
@@ -883,6 +1086,85 @@ SG_EXTERN struct sg_strmap **sg_httpreq_cookies(struct sg_httpreq *req);
  */
 SG_EXTERN struct sg_strmap **sg_httpreq_params(struct sg_httpreq *req);
 
+/**
+ * Looks up a client header by its name, without building the headers map.
+ * \param[in] req Request handle.
+ * \param[in] name Header name (case-insensitive).
+ * \return Header value, or `NULL` if the header was not sent.
+ * \retval NULL If \pr{req} or \pr{name} is null and set the `errno` to
+ * `EINVAL`.
+ * \note The value belongs to the connection and is valid until the request
+ * finishes.
+ */
+SG_EXTERN const char *sg_httpreq_header(struct sg_httpreq *req,
+                                        const char *name);
+
+/**
+ * Looks up a client cookie by its name, without building the cookies map. The
+ * name is case-insensitive, as in #sg_httpreq_cookies().
+ * \param[in] req Request handle.
+ * \param[in] name Cookie name.
+ * \return Cookie value, or `NULL` if the cookie was not sent.
+ * \retval NULL If \pr{req} or \pr{name} is null and set the `errno` to
+ * `EINVAL`.
+ * \note The value belongs to the connection and is valid until the request
+ * finishes.
+ */
+SG_EXTERN const char *sg_httpreq_cookie(struct sg_httpreq *req,
+                                        const char *name);
+
+/**
+ * Looks up a query-string parameter by its name, without building the
+ * query-string map. The name is case-insensitive, as in #sg_httpreq_params().
+ * \param[in] req Request handle.
+ * \param[in] name Parameter name.
+ * \return Parameter value, or `NULL` if the parameter was not sent or has no
+ * value.
+ * \retval NULL If \pr{req} or \pr{name} is null and set the `errno` to
+ * `EINVAL`.
+ * \note The value belongs to the connection and is valid until the request
+ * finishes.
+ */
+SG_EXTERN const char *sg_httpreq_param(struct sg_httpreq *req,
+                                       const char *name);
+
+/**
+ * Iterates over the client headers without building the headers map.
+ * \param[in] req Request handle.
+ * \param[in] cb Callback to iterate the headers.
+ * \param[in,out] cls User-specified value.
+ * \retval 0 Success.
+ * \retval EINVAL Invalid argument.
+ * \return Callback result when it is different from `0`.
+ */
+SG_EXTERN int sg_httpreq_headers_iter(struct sg_httpreq *req,
+                                      sg_httpreq_iter_cb cb, void *cls);
+
+/**
+ * Iterates over the client cookies without building the cookies map.
+ * \param[in] req Request handle.
+ * \param[in] cb Callback to iterate the cookies.
+ * \param[in,out] cls User-specified value.
+ * \retval 0 Success.
+ * \retval EINVAL Invalid argument.
+ * \return Callback result when it is different from `0`.
+ */
+SG_EXTERN int sg_httpreq_cookies_iter(struct sg_httpreq *req,
+                                      sg_httpreq_iter_cb cb, void *cls);
+
+/**
+ * Iterates over the query-string parameters without building the
+ * query-string map.
+ * \param[in] req Request handle.
+ * \param[in] cb Callback to iterate the parameters.
+ * \param[in,out] cls User-specified value.
+ * \retval 0 Success.
+ * \retval EINVAL Invalid argument.
+ * \return Callback result when it is different from `0`.
+ */
+SG_EXTERN int sg_httpreq_params_iter(struct sg_httpreq *req,
+                                     sg_httpreq_iter_cb cb, void *cls);
+
 /**
  * Returns the fields of a HTML form into #sg_strmap map.
  * \param[in] req Request handle.
@@ -925,6 +1207,19 @@ SG_EXTERN const char *sg_httpreq_path(struct sg_httpreq *req);
  */
 SG_EXTERN struct sg_str *sg_httpreq_payload(struct sg_httpreq *req);
 
+/**
+ * Returns a digest of the posting payload.
+ * \param[in] req Request handle.
+ * \param[in] algo Digest algorithm.
+ * \return Digest as a null-terminated lowercase hexadecimal string.
+ * \retval NULL If \pr{req} is null or \pr{algo} is unknown and set the
+ * `errno` to `EINVAL`.
+ * \note The digest is computed once, on the first call, so it must be
+ * requested after the payload is complete.
+ */
+SG_EXTERN const char *sg_httpreq_digest(struct sg_httpreq *req,
+                                        enum sg_digest algo);
+
 /**
  * Checks if the client is uploading data.
  * \param[in] req Request handle.
@@ -962,6 +1257,23 @@ SG_EXTERN void *sg_httpreq_tls_session(struct sg_httpreq *req);
 
 #endif /* SG_HTTPS_SUPPORT */
 
+#ifdef SG_HTTP_COMPRESSION
+
+/**
+ * Negotiates the response content encoding from the request header
+ * `Accept-Encoding`, honoring the client quality values (`q=`). Ties are
+ * broken by the server preference: `zstd`, `br`, `gzip` and `deflate`
+ * (`zstd` and `br` only when enabled at build time).
+ * \param[in] req Request handle.
+ * \return Encoding token to be passed to #sg_httpres_zsendbinary3(),
+ * #sg_httpres_zsendstream3() or #sg_httpres_zsendfile3().
+ * \retval NULL If the client does not accept any available encoding, or if
+ * \pr{req} is null and set the `errno` to `EINVAL`.
+ */
+SG_EXTERN const char *sg_httpreq_zencoding(struct sg_httpreq *req);
+
+#endif /* SG_HTTP_COMPRESSION */
+
 /**
  * Isolates a request from the main event loop to an own dedicated thread,
  * bringing it back when the request finishes.
@@ -980,6 +1292,36 @@ SG_EXTERN void *sg_httpreq_tls_session(struct sg_httpreq *req);
 SG_EXTERN int sg_httpreq_isolate(struct sg_httpreq *req, sg_httpreq_cb cb,
                                  void *cls);
 
+/**
+ * Streams the request body to the callback \pr{cb} instead of accumulating it
+ * in the payload or parsing it as a form, so bodies of any size are handled
+ * in constant memory. It must be set before the body arrives, i.e. from the
+ * callback set by #sg_httpsrv_set_hdr_cb() or from the authentication
+ * callback. The request callback is called as usual when the body is
+ * complete.
+ * \param[in] req Request handle.
+ * \param[in] cb Callback to receive the body chunks.
+ * \param[in] cls User-defined closure.
+ * \retval 0 Success.
+ * \retval EINVAL Invalid argument.
+ * \retval EALREADY The body is already being received.
+ * \note The payload limit does not apply to streamed bodies.
+ * \note Streamed bodies are not decompressed, whatever their
+ * `Content-Encoding`.
+ */
+SG_EXTERN int sg_httpreq_set_body_cb(struct sg_httpreq *req,
+                                     sg_httpreq_body_cb cb, void *cls);
+
+/**
+ * Resumes the reading of a request body paused by its body callback. It can
+ * be called from any thread, even before the callback returns.
+ * \param[in] req Request handle.
+ * \retval 0 Success.
+ * \retval EINVAL Invalid argument.
+ * \note The request must not be resumed after it has finished.
+ */
+SG_EXTERN int sg_httpreq_resume_body(struct sg_httpreq *req);
+
 /**
  * Sets user data to the request handle.
  * \param[in] req Request handle.
@@ -1006,6 +1348,20 @@ SG_EXTERN void *sg_httpreq_user_data(struct sg_httpreq *req);
  */
 SG_EXTERN struct sg_strmap **sg_httpres_headers(struct sg_httpres *res);
 
+/**
+ * Sets a shared set of headers sent with the response. The headers map
+ * returned by sg_httpres_headers() acts as an overlay: only the pairs it adds
+ * or overrides are allocated per response, while the snapshot pairs are sent
+ * without being copied.
+ * \param[in] res Response handle.
+ * \param[in] snap Snapshot of headers. Use `NULL` to remove the current one.
+ * \retval 0 Success.
+ * \retval EINVAL Invalid argument.
+ * \note The response holds its own reference to the snapshot.
+ */
+SG_EXTERN int sg_httpres_set_base_headers(struct sg_httpres *res,
+                                          struct sg_strmap_snap *snap);
+
 /**
  * Sets server cookie to the response handle.
  * \param[in] res Response handle.
@@ -1148,6 +1504,41 @@ SG_EXTERN int sg_httpres_sendstream(struct sg_httpres *res, uint64_t size,
                                     sg_read_cb read_cb, void *handle,
                                     sg_free_cb free_cb, unsigned int status);
 
+/**
+ * Buffer of a scatter-gather response sent by #sg_httpres_sendiov().
+ * \struct sg_httpres_iov
+ */
+struct sg_httpres_iov {
+  /** Buffer content. */
+  const void *buf;
+  /** Buffer size. */
+  size_t size;
+  /** Optional callback to free the buffer after the response is sent. */
+  sg_free_cb free_cb;
+};
+
+/**
+ * Sends a content assembled from multiple buffers to the client. The buffers
+ * are written in order using vectored I/O, without being concatenated or
+ * copied.
+ * \param[in] res Response handle.
+ * \param[in] iov Array of buffers.
+ * \param[in] count Number of buffers in the array.
+ * \param[in] content_type Content type.
+ * \param[in] status HTTP status code.
+ * \retval 0 Success.
+ * \retval EINVAL Invalid argument.
+ * \retval EALREADY Operation already in progress.
+ * \retval ENOMEM Out of memory.
+ * \note The array itself is copied, but the buffers must remain valid until
+ * their `free_cb` is called. The callbacks are also called if the function
+ * fails.
+ */
+SG_EXTERN int sg_httpres_sendiov(struct sg_httpres *res,
+                                 const struct sg_httpres_iov *iov,
+                                 unsigned int count, const char *content_type,
+                                 unsigned int status);
+
 #ifdef SG_HTTP_COMPRESSION
 
 /**
@@ -1171,6 +1562,33 @@ SG_EXTERN int sg_httpres_sendstream(struct sg_httpres *res, uint64_t size,
                          (((val) != NULL) ? strlen((val)) : 0),                \
                          (content_type), (status))
 
+/**
+ * Compresses a binary content using the given content encoding and sends it to
+ * the client.
+ * \param[in] res Response handle.
+ * \param[in] encoding Content encoding token (`deflate`, `gzip`, `br` or
+ * `zstd`), usually obtained from #sg_httpreq_zencoding().
+ * \param[in] level Encoder specific compression level or -1 for default
+ * (`deflate`/`gzip`: 0..9, `br`: 0..11, `zstd`: 1..22).
+ * \param[in] buf Binary content.
+ * \param[in] size Content size.
+ * \param[in] content_type Content type.
+ * \param[in] status HTTP status code.
+ * \retval 0 Success.
+ * \retval EINVAL Invalid argument.
+ * \retval ENOTSUP Content encoding not supported.
+ * \retval ENOMEM Out of memory.
+ * \retval EALREADY Operation already in progress.
+ * \note When compression succeeds, the header `Content-Encoding` is
+ * automatically added to the response. If the compressed content is not
+ * smaller than the original one, the content is sent uncompressed.
+ */
+SG_EXTERN int sg_httpres_zsendbinary3(struct sg_httpres *res,
+                                      const char *encoding, int level,
+                                      void *buf, size_t size,
+                                      const char *content_type,
+                                      unsigned int status);
+
 /**
  * Compresses a binary content and sends it to the client. The compression is
  * done by zlib library using the DEFLATE compression algorithm.
@@ -1215,6 +1633,31 @@ SG_EXTERN int sg_httpres_zsendbinary(struct sg_httpres *res, void *buf,
                                      size_t size, const char *content_type,
                                      unsigned int status);
 
+/**
+ * Compresses a stream using the given content encoding and sends it to the
+ * client.
+ * \param[in] res Response handle.
+ * \param[in] encoding Content encoding token (`deflate`, `gzip`, `br` or
+ * `zstd`), usually obtained from #sg_httpreq_zencoding().
+ * \param[in] level Encoder specific compression level or -1 for default.
+ * \param[in] size Size of the stream.
+ * \param[in] read_cb Callback to read data from stream handle.
+ * \param[in] handle Stream handle.
+ * \param[in] free_cb Callback to free the stream handle.
+ * \param[in] status HTTP status code.
+ * \retval 0 Success.
+ * \retval EINVAL Invalid argument.
+ * \retval ENOTSUP Content encoding not supported.
+ * \retval EALREADY Operation already in progress.
+ * \retval ENOMEM Out of memory.
+ * \note The header `Content-Encoding` is automatically added to the response.
+ */
+SG_EXTERN int sg_httpres_zsendstream3(struct sg_httpres *res,
+                                      const char *encoding, int level,
+                                      uint64_t size, sg_read_cb read_cb,
+                                      void *handle, sg_free_cb free_cb,
+                                      unsigned int status);
+
 /**
  * Compresses a stream and sends it to the client. The compression is done by
  * zlib library using the DEFLATE compression algorithm.
@@ -1296,6 +1739,40 @@ SG_EXTERN int sg_httpres_zsendstream(struct sg_httpres *res, sg_read_cb read_cb,
 #define sg_httpres_zrender(res, filename, status)                              \
   sg_httpres_zsendfile2((res), 1, 0, 0, 0, (filename), "inline", (status))
 
+/**
+ * Compresses a file using the given content encoding and sends it to the
+ * client.
+ * \param[in] res Response handle.
+ * \param[in] encoding Content encoding token (`deflate`, `gzip`, `br` or
+ * `zstd`), usually obtained from #sg_httpreq_zencoding().
+ * \param[in] level Encoder specific compression level or -1 for default.
+ * \param[in] size Size of the file to be sent. Use zero to calculate
+ * automatically.
+ * \param[in] max_size Maximum allowed file size. Use zero for no limit.
+ * \param[in] offset Offset to start reading from in the file to be sent.
+ * \param[in] filename Path of the file to be sent.
+ * \param[in] disposition Content disposition as a null-terminated string
+ * (attachment or inline).
+ * \param[in] status HTTP status code.
+ * \retval 0 Success.
+ * \retval EINVAL Invalid argument.
+ * \retval ENOTSUP Content encoding not supported.
+ * \retval EALREADY Operation already in progress.
+ * \retval EISDIR Is a directory.
+ * \retval EBADF Bad file number.
+ * \retval EFBIG File too large.
+ * \retval ENOMEM Out of memory.
+ * \note The header `Content-Encoding` is automatically added to the response.
+ * \warning The parameter `disposition` is not checked internally, thus any
+ * non-`NULL` value is passed directly to the header `Content-Disposition`.
+ */
+SG_EXTERN int sg_httpres_zsendfile3(struct sg_httpres *res,
+                                    const char *encoding, int level,
+                                    uint64_t size, uint64_t max_size,
+                                    uint64_t offset, const char *filename,
+                                    const char *disposition,
+                                    unsigned int status);
+
 /**
  * Compresses a file in Gzip format and sends it to the client. The compression
  * is done by zlib library using the DEFLATE compression algorithm.
@@ -1598,6 +2075,20 @@ SG_EXTERN bool sg_httpsrv_is_threaded(struct sg_httpsrv *srv);
 SG_EXTERN int sg_httpsrv_set_cli_cb(struct sg_httpsrv *srv,
                                     sg_httpsrv_cli_cb cb, void *cls);
 
+/**
+ * Sets the server callback called as soon as the request headers are
+ * received, before the body. It can install a body callback by
+ * #sg_httpreq_set_body_cb(), or reject the request early by sending a
+ * response, which is dispatched without reading the body.
+ * \param[in] srv Server handle.
+ * \param[in] cb Callback to handle the request headers.
+ * \param[in] cls User-defined closure.
+ * \retval 0 Success.
+ * \retval EINVAL Invalid argument.
+ */
+SG_EXTERN int sg_httpsrv_set_hdr_cb(struct sg_httpsrv *srv, sg_httpreq_cb cb,
+                                    void *cls);
+
 /**
  * Sets the server uploading callbacks.
  * \param[in] srv Server handle.
@@ -1634,48 +2125,117 @@ SG_EXTERN int sg_httpsrv_set_upld_dir(struct sg_httpsrv *srv, const char *dir);
 SG_EXTERN const char *sg_httpsrv_upld_dir(struct sg_httpsrv *srv);
 
 /**
- * Sets a size to the post buffering.
+ * Sets the policy used to flush the uploaded files when they are saved by the
+ * default upload callbacks.
  * \param[in] srv Server handle.
- * \param[in] size Post buffering size.
+ * \param[in] policy Flushing policy. Default: #SG_HTTPUPLD_SYNC_NONE.
  * \retval 0 Success.
  * \retval EINVAL Invalid argument.
  */
-SG_EXTERN int sg_httpsrv_set_post_buf_size(struct sg_httpsrv *srv, size_t size);
+SG_EXTERN int sg_httpsrv_set_upld_sync(struct sg_httpsrv *srv,
+                                       enum sg_httpupld_sync policy);
 
 /**
- * Gets the size of the post buffering.
+ * Gets the policy used to flush the uploaded files when they are saved.
  * \param[in] srv Server handle.
- * \return Post buffering size.
- * \retval 0 If the \pr{srv} is null and set the `errno` to `EINVAL`.
+ * \return Flushing policy.
+ * \retval SG_HTTPUPLD_SYNC_NONE If \pr{srv} is null and set the `errno` to
+ * `EINVAL`.
  */
-SG_EXTERN size_t sg_httpsrv_post_buf_size(struct sg_httpsrv *srv);
+SG_EXTERN enum sg_httpupld_sync sg_httpsrv_upld_sync(struct sg_httpsrv *srv);
 
 /**
- * Sets a limit to the total payload.
+ * Sets the size up to which an uploaded file is kept in memory by the default
+ * upload callbacks. A file exceeding it is moved to a temporary file in the
+ * uploads directory and written there from then on.
  * \param[in] srv Server handle.
- * \param[in] limit Payload total limit. Use zero for no limit.
+ * \param[in] limit In-memory upload limit. Use zero to write all uploaded
+ * files to disk. Default: 16 kB (4 kB on ARM).
  * \retval 0 Success.
  * \retval EINVAL Invalid argument.
  */
-SG_EXTERN int sg_httpsrv_set_payld_limit(struct sg_httpsrv *srv, size_t limit);
+SG_EXTERN int sg_httpsrv_set_upld_mem_limit(struct sg_httpsrv *srv,
+                                            size_t limit);
 
 /**
- * Gets the limit of the total payload.
+ * Gets the size up to which an uploaded file is kept in memory.
  * \param[in] srv Server handle.
- * \return Payload total limit.
+ * \return In-memory upload limit.
  * \retval 0 If the \pr{srv} is null and set the `errno` to `EINVAL`.
  */
-SG_EXTERN size_t sg_httpsrv_payld_limit(struct sg_httpsrv *srv);
+SG_EXTERN size_t sg_httpsrv_upld_mem_limit(struct sg_httpsrv *srv);
 
 /**
- * Sets a limit to the total uploads.
+ * Enables digests of the uploaded files, computed while they are received,
+ * whatever the upload callbacks.
  * \param[in] srv Server handle.
- * \param[in] limit Uploads total limit. Use zero for no limit.
+ * \param[in] algos Bitwise OR of #sg_digest algorithms. Use zero to disable
+ * them. Default: zero.
  * \retval 0 Success.
  * \retval EINVAL Invalid argument.
  */
-SG_EXTERN int sg_httpsrv_set_uplds_limit(struct sg_httpsrv *srv,
-                                         uint64_t limit);
+SG_EXTERN int sg_httpsrv_set_upld_digests(struct sg_httpsrv *srv,
+                                          unsigned int algos);
+
+/**
+ * Gets the digests computed for the uploaded files.
+ * \param[in] srv Server handle.
+ * \return Bitwise OR of #sg_digest algorithms.
+ * \retval 0 If the \pr{srv} is null and set the `errno` to `EINVAL`.
+ */
+SG_EXTERN unsigned int sg_httpsrv_upld_digests(struct sg_httpsrv *srv);
+
+/**
+ * Sets a size to the post buffering. It limits the headers of each part of a
+ * multipart form, and the names of the URL-encoded fields to half of it.
+ * \param[in] srv Server handle.
+ * \param[in] size Post buffering size.
+ * \retval 0 Success.
+ * \retval EINVAL Invalid argument.
+ */
+SG_EXTERN int sg_httpsrv_set_post_buf_size(struct sg_httpsrv *srv, size_t size);
+
+/**
+ * Gets the size of the post buffering.
+ * \param[in] srv Server handle.
+ * \return Post buffering size.
+ * \retval 0 If the \pr{srv} is null and set the `errno` to `EINVAL`.
+ */
+SG_EXTERN size_t sg_httpsrv_post_buf_size(struct sg_httpsrv *srv);
+
+/**
+ * Sets a limit to the total payload. Non-form requests declaring a larger
+ * `Content-Length` are answered with `413 Payload Too Large` before their body
+ * is read, and those within the limit get their payload reserved up front.
+ * When the library is built with HTTP compression, bodies sent with
+ * `Content-Encoding: gzip` or `deflate` are decompressed as they arrive, and
+ * their decompressed size is bounded by this limit (plus the uploads limit
+ * for forms), against compression bombs. Other content codings are answered
+ * with `415 Unsupported Media Type`.
+ * \param[in] srv Server handle.
+ * \param[in] limit Payload total limit. Use zero for no limit.
+ * \retval 0 Success.
+ * \retval EINVAL Invalid argument.
+ */
+SG_EXTERN int sg_httpsrv_set_payld_limit(struct sg_httpsrv *srv, size_t limit);
+
+/**
+ * Gets the limit of the total payload.
+ * \param[in] srv Server handle.
+ * \return Payload total limit.
+ * \retval 0 If the \pr{srv} is null and set the `errno` to `EINVAL`.
+ */
+SG_EXTERN size_t sg_httpsrv_payld_limit(struct sg_httpsrv *srv);
+
+/**
+ * Sets a limit to the total uploads.
+ * \param[in] srv Server handle.
+ * \param[in] limit Uploads total limit. Use zero for no limit.
+ * \retval 0 Success.
+ * \retval EINVAL Invalid argument.
+ */
+SG_EXTERN int sg_httpsrv_set_uplds_limit(struct sg_httpsrv *srv,
+                                         uint64_t limit);
 
 /**
  * Gets the limit of the total uploads.
@@ -1740,6 +2300,73 @@ SG_EXTERN int sg_httpsrv_set_con_limit(struct sg_httpsrv *srv,
  */
 SG_EXTERN unsigned int sg_httpsrv_con_limit(struct sg_httpsrv *srv);
 
+/**
+ * Sets the default headers added to every response, e.g. `Server`, security
+ * or CORS headers. They are compiled once into a single block, and a header
+ * set by the response itself takes precedence over the default one. A `Date`
+ * header, cached once per second, is always added.
+ * \param[in] srv Server handle.
+ * \param[in] headers Map of headers. Use `NULL` to remove the default headers.
+ * \retval 0 Success.
+ * \retval EINVAL Invalid argument or header containing a line break.
+ * \retval EALREADY The server is already listening.
+ * \retval ENOMEM Out of memory.
+ * \note The headers are copied, so the map can be freed after the call.
+ */
+SG_EXTERN int sg_httpsrv_set_headers(struct sg_httpsrv *srv,
+                                     struct sg_strmap *headers);
+
+#ifdef SG_HTTP_COMPRESSION
+
+/**
+ * Sets the number of worker threads used to compress large files in Gzip
+ * format. When greater than zero, files of at least 4 MB sent by
+ * #sg_httpres_zsendfile() and its variants are split into blocks compressed
+ * concurrently and emitted in order, with bounded read-ahead. The threads are
+ * created when the server starts listening and shared by all its responses.
+ * \param[in] srv Server handle.
+ * \param[in] size Number of compression threads of the server. Use zero to
+ * disable the parallel compression. Default: 0.
+ * \retval 0 Success.
+ * \retval EINVAL Invalid argument.
+ */
+SG_EXTERN int sg_httpsrv_set_zthr_pool_size(struct sg_httpsrv *srv,
+                                            unsigned int size);
+
+/**
+ * Gets the number of worker threads used to compress large files.
+ * \param[in] srv Server handle.
+ * \return Number of compression threads of the server.
+ * \retval 0 If the \pr{srv} is null and set the `errno` to `EINVAL`.
+ */
+SG_EXTERN unsigned int sg_httpsrv_zthr_pool_size(struct sg_httpsrv *srv);
+
+#endif /* SG_HTTP_COMPRESSION */
+
+#ifdef SG_HTTP_WEBSOCKET
+
+/**
+ * Sets the interval between the pings sent to the WebSocket clients. A client
+ * which does not answer a ping until the next one is disconnected.
+ * \param[in] srv Server handle.
+ * \param[in] interval Ping interval in seconds. Use zero to disable the
+ * keepalive. Default: 30.
+ * \retval 0 Success.
+ * \retval EINVAL Invalid argument.
+ */
+SG_EXTERN int sg_httpsrv_set_ws_ping_interval(struct sg_httpsrv *srv,
+                                              unsigned int interval);
+
+/**
+ * Gets the interval between the pings sent to the WebSocket clients.
+ * \param[in] srv Server handle.
+ * \return Ping interval in seconds.
+ * \retval 0 If the \pr{srv} is null and set the `errno` to `EINVAL`.
+ */
+SG_EXTERN unsigned int sg_httpsrv_ws_ping_interval(struct sg_httpsrv *srv);
+
+#endif /* SG_HTTP_WEBSOCKET */
+
 /**
  * Returns the MHD instance.
  * \param[in] srv Server handle.
@@ -1751,6 +2378,661 @@ SG_EXTERN void *sg_httpsrv_handle(struct sg_httpsrv *srv);
 
 /** \} */
 
+/**
+ * \ingroup sg_api
+ * \defgroup sg_httpsse Server-Sent Events
+ * Event broadcasting to suspended HTTP connections.
+ * \{
+ */
+
+/**
+ * Handle for a Server-Sent Events channel. Each subscriber holds a bounded
+ * buffer filled by the publishers and drained by the server, while its
+ * connection stays suspended until data is queued, so no thread is pinned per
+ * subscriber.
+ * \struct sg_httpsse
+ */
+struct sg_httpsse;
+
+/**
+ * Policies applied to subscribers too slow to drain their buffers.
+ * \enum sg_httpsse_policy
+ */
+enum sg_httpsse_policy {
+  /** Drops the events which do not fit in the subscriber buffer. */
+  SG_HTTPSSE_DROP,
+  /** Disconnects the subscriber when an event does not fit in its buffer. */
+  SG_HTTPSSE_DISCONNECT
+};
+
+/**
+ * Creates a new Server-Sent Events channel.
+ * \param[in] buf_size Size of the buffer allocated for each subscriber.
+ * \param[in] policy Policy applied to slow subscribers.
+ * \return New channel handle.
+ * \retval NULL If \pr{buf_size} is zero or \pr{policy} is invalid and set the
+ * `errno` to `EINVAL`.
+ * \retval NULL If no memory space is available and set the `errno` to
+ * `ENOMEM`.
+ */
+SG_EXTERN struct sg_httpsse *sg_httpsse_new(size_t buf_size,
+                                            enum sg_httpsse_policy policy)
+  __SG_MALLOC;
+
+/**
+ * Closes the channel. The subscribers receive their pending events and are
+ * disconnected, and the channel is released after the last one.
+ * \param[in] sse Channel handle.
+ * \warning It must be called before the server is shut down.
+ */
+SG_EXTERN void sg_httpsse_free(struct sg_httpsse *sse);
+
+/**
+ * Attaches a request to the channel, sending a `text/event-stream` response
+ * that lasts until the client disconnects or the channel is closed.
+ * \param[in] sse Channel handle.
+ * \param[in] req Request handle.
+ * \retval 0 Success.
+ * \retval EINVAL Invalid argument.
+ * \retval EALREADY Operation already in progress.
+ * \retval ENOMEM Out of memory.
+ */
+SG_EXTERN int sg_httpsse_subscribe(struct sg_httpsse *sse,
+                                   struct sg_httpreq *req);
+
+/**
+ * Publishes an event to all the subscribers of the channel. It can be called
+ * from any thread.
+ * \param[in] sse Channel handle.
+ * \param[in] event Event name. Use `NULL` for the default `message` event.
+ * \param[in] data Event data. Multi-line data is split into multiple `data`
+ * fields, at each CR, LF or CRLF.
+ * \retval 0 Success.
+ * \retval EINVAL Invalid argument.
+ * \retval ENOMEM Out of memory.
+ */
+SG_EXTERN int sg_httpsse_publish(struct sg_httpsse *sse, const char *event,
+                                 const char *data);
+
+/**
+ * Sends a pre-formatted chunk, e.g. `"retry: 1000\n\n"`, to all the
+ * subscribers of the channel. It can be called from any thread.
+ * \param[in] sse Channel handle.
+ * \param[in] buf Chunk content.
+ * \param[in] size Chunk size.
+ * \retval 0 Success.
+ * \retval EINVAL Invalid argument.
+ */
+SG_EXTERN int sg_httpsse_send(struct sg_httpsse *sse, const void *buf,
+                              size_t size);
+
+/**
+ * Returns the number of subscribers attached to the channel.
+ * \param[in] sse Channel handle.
+ * \return Number of subscribers.
+ * \retval 0 If \pr{sse} is null and set the `errno` to `EINVAL`.
+ */
+SG_EXTERN unsigned int sg_httpsse_count(struct sg_httpsse *sse);
+
+/** \} */
+
+/**
+ * \ingroup sg_api
+ * \defgroup sg_httpwrt Streaming writer
+ * Push-style streaming of HTTP responses.
+ * \{
+ */
+
+/**
+ * Handle for a push-style response writer. A producer writes the response
+ * body from any thread while the connection stays suspended as long as
+ * nothing is buffered, so no server thread is parked waiting for data.
+ * \struct sg_httpwrt
+ */
+struct sg_httpwrt;
+
+/**
+ * Callback signature used to notify the producer that a writer which reported
+ * `EAGAIN` has room again, or that its client disconnected. It is called from
+ * the server thread, so it should only wake up the producer.
+ * \param[out] cls User-defined closure.
+ * \param[out] wrt Writer handle.
+ */
+typedef void (*sg_httpwrt_drain_cb)(void *cls, struct sg_httpwrt *wrt);
+
+/**
+ * Creates a writer sending a response of unknown size, in chunked encoding.
+ * \param[in] res Response handle.
+ * \param[in] high_water Amount of buffered bytes from which writes report
+ * backpressure.
+ * \param[in] drain_cb Callback called when the writer has room again.
+ * \param[in] cls User-defined closure.
+ * \param[in] status HTTP status code.
+ * \return New writer handle.
+ * \retval NULL If any argument is invalid and set the `errno` to `EINVAL`.
+ * \retval NULL If a response was already sent and set the `errno` to
+ * `EALREADY`.
+ * \retval NULL If no memory space is available and set the `errno` to
+ * `ENOMEM`.
+ * \warning The writer must be closed by sg_httpwrt_close().
+ */
+SG_EXTERN struct sg_httpwrt *sg_httpwrt_new(struct sg_httpres *res,
+                                            size_t high_water,
+                                            sg_httpwrt_drain_cb drain_cb,
+                                            void *cls, unsigned int status)
+  __SG_MALLOC;
+
+/**
+ * Appends a chunk to the response body. Small chunks are coalesced until a
+ * block is filled or sg_httpwrt_flush() is called. It can be called from any
+ * thread.
+ * \param[in] wrt Writer handle.
+ * \param[in] buf Chunk content.
+ * \param[in] size Chunk size.
+ * \retval 0 Success.
+ * \retval EINVAL Invalid argument.
+ * \retval EAGAIN The buffered data reached the high-water mark and the chunk
+ * was not written.
+ * \retval EPIPE The client disconnected.
+ * \retval ENOMEM Out of memory.
+ */
+SG_EXTERN int sg_httpwrt_write(struct sg_httpwrt *wrt, const void *buf,
+                               size_t size);
+
+/**
+ * Sends the buffered data to the client without waiting for a full block.
+ * \param[in] wrt Writer handle.
+ * \retval 0 Success.
+ * \retval EINVAL Invalid argument.
+ * \retval EPIPE The client disconnected.
+ */
+SG_EXTERN int sg_httpwrt_flush(struct sg_httpwrt *wrt);
+
+/**
+ * Finishes the response after the buffered data is sent and releases the
+ * writer, which must not be used afterwards.
+ * \param[in] wrt Writer handle.
+ * \retval 0 Success.
+ * \retval EINVAL Invalid argument.
+ */
+SG_EXTERN int sg_httpwrt_close(struct sg_httpwrt *wrt);
+
+/**
+ * Returns the amount of bytes written but not yet sent to the client.
+ * \param[in] wrt Writer handle.
+ * \return Amount of buffered bytes.
+ * \retval 0 If \pr{wrt} is null and set the `errno` to `EINVAL`.
+ */
+SG_EXTERN size_t sg_httpwrt_buffered(struct sg_httpwrt *wrt);
+
+/** \} */
+
+/**
+ * \ingroup sg_api
+ * \defgroup sg_tmpl Templates
+ * Compiled templates for rendering dynamic content.
+ * \{
+ */
+
+/**
+ * Handle for a compiled template. The template is compiled once into a list
+ * of literal spans and variable slots: `{{name}}` is replaced by the
+ * HTML-escaped value of the variable `name`, and `{{{name}}}` by its raw
+ * value. Variable names are case-insensitive, and missing variables render as
+ * empty strings.
+ * \struct sg_tmpl
+ */
+struct sg_tmpl;
+
+/**
+ * Compiles a template from a string.
+ * \param[in] src Template source.
+ * \param[in] size Size of the template source.
+ * \return New template handle.
+ * \retval NULL If \pr{src} is null or contains an unterminated or empty tag
+ * and set the `errno` to `EINVAL`.
+ * \retval NULL If no memory space is available and set the `errno` to
+ * `ENOMEM`.
+ */
+SG_EXTERN struct sg_tmpl *sg_tmpl_new(const char *src, size_t size)
+  __SG_MALLOC;
+
+/**
+ * Compiles a template from a file. The file is checked at most once per
+ * second when the template is rendered, and recompiled if it has changed. If
+ * the new version fails to compile, the previous one is kept.
+ * \param[in] filename Path of the template file.
+ * \return New template handle.
+ * \retval NULL If the file cannot be read or compiled and set the `errno`.
+ */
+SG_EXTERN struct sg_tmpl *sg_tmpl_load(const char *filename) __SG_MALLOC;
+
+/**
+ * Frees the template.
+ * \param[in] tmpl Template handle.
+ */
+SG_EXTERN void sg_tmpl_free(struct sg_tmpl *tmpl);
+
+/**
+ * Renders the template into a new buffer allocated with the exact output
+ * size. It can be called from any thread.
+ * \param[in] tmpl Template handle.
+ * \param[in] vars Map of variables.
+ * \param[out] buf Pointer to store the null-terminated output, which must be
+ * freed by sg_free().
+ * \param[out] size Pointer to store the output size.
+ * \retval 0 Success.
+ * \retval EINVAL Invalid argument.
+ * \retval ENOMEM Out of memory.
+ */
+SG_EXTERN int sg_tmpl_render(struct sg_tmpl *tmpl, struct sg_strmap *vars,
+                             char **buf, size_t *size);
+
+/**
+ * Renders the template and sends the result, which is handed over to the
+ * response without being copied.
+ * \param[in] res Response handle.
+ * \param[in] tmpl Template handle.
+ * \param[in] vars Map of variables.
+ * \param[in] content_type Content type, e.g. `text/html; charset=utf-8`.
+ * \param[in] status HTTP status code.
+ * \retval 0 Success.
+ * \retval EINVAL Invalid argument.
+ * \retval EALREADY Operation already in progress.
+ * \retval ENOMEM Out of memory.
+ */
+SG_EXTERN int sg_httpres_sendtmpl(struct sg_httpres *res, struct sg_tmpl *tmpl,
+                                  struct sg_strmap *vars,
+                                  const char *content_type,
+                                  unsigned int status);
+
+/** \} */
+
+/**
+ * \ingroup sg_api
+ * \defgroup sg_json JSON writer
+ * Streaming JSON serialization.
+ * \{
+ */
+
+/**
+ * Handle for a JSON writer. It manages nesting and separators automatically,
+ * escapes strings and formats numbers without the printf machinery: integers
+ * are converted two digits at a time and doubles are written in their
+ * shortest form which reads back to the same value.
+ * \struct sg_json
+ */
+struct sg_json;
+
+/**
+ * Creates a JSON writer which appends to a string.
+ * \param[in] str String handle.
+ * \return New JSON writer handle.
+ * \retval NULL If \pr{str} is null and set the `errno` to `EINVAL`.
+ * \retval NULL If no memory space is available and set the `errno` to
+ * `ENOMEM`.
+ */
+SG_EXTERN struct sg_json *sg_json_new(struct sg_str *str) __SG_MALLOC;
+
+/**
+ * Creates a JSON writer which streams to a response writer. The output is
+ * buffered and sent in blocks, and the remaining data is sent by
+ * sg_json_flush().
+ * \param[in] wrt Response writer handle.
+ * \return New JSON writer handle.
+ * \retval NULL If \pr{wrt} is null and set the `errno` to `EINVAL`.
+ * \retval NULL If no memory space is available and set the `errno` to
+ * `ENOMEM`.
+ */
+SG_EXTERN struct sg_json *sg_json_new2(struct sg_httpwrt *wrt) __SG_MALLOC;
+
+/**
+ * Frees the JSON writer. Neither the target string nor the response writer
+ * are freed.
+ * \param[in] json JSON writer handle.
+ */
+SG_EXTERN void sg_json_free(struct sg_json *json);
+
+/**
+ * Sends the buffered output to the response writer. It does nothing for
+ * writers created by sg_json_new().
+ * \param[in] json JSON writer handle.
+ * \retval 0 Success.
+ * \retval EINVAL Invalid argument.
+ * \retval EAGAIN The response writer reached its high-water mark. The output
+ * is kept and sent by a later call.
+ * \retval EPIPE The client disconnected.
+ */
+SG_EXTERN int sg_json_flush(struct sg_json *json);
+
+/**
+ * Begins an object.
+ * \param[in] json JSON writer handle.
+ * \retval 0 Success.
+ * \retval EINVAL Invalid argument or a value is not allowed here.
+ * \retval EOVERFLOW Nesting deeper than 64 levels.
+ * \retval ENOMEM Out of memory.
+ */
+SG_EXTERN int sg_json_begin_object(struct sg_json *json);
+
+/**
+ * Ends the current object.
+ * \param[in] json JSON writer handle.
+ * \retval 0 Success.
+ * \retval EINVAL Invalid argument or no object to end.
+ * \retval ENOMEM Out of memory.
+ */
+SG_EXTERN int sg_json_end_object(struct sg_json *json);
+
+/**
+ * Begins an array.
+ * \param[in] json JSON writer handle.
+ * \retval 0 Success.
+ * \retval EINVAL Invalid argument or a value is not allowed here.
+ * \retval EOVERFLOW Nesting deeper than 64 levels.
+ * \retval ENOMEM Out of memory.
+ */
+SG_EXTERN int sg_json_begin_array(struct sg_json *json);
+
+/**
+ * Ends the current array.
+ * \param[in] json JSON writer handle.
+ * \retval 0 Success.
+ * \retval EINVAL Invalid argument or no array to end.
+ * \retval ENOMEM Out of memory.
+ */
+SG_EXTERN int sg_json_end_array(struct sg_json *json);
+
+/**
+ * Writes the key of the next object member.
+ * \param[in] json JSON writer handle.
+ * \param[in] key Member key.
+ * \retval 0 Success.
+ * \retval EINVAL Invalid argument or not inside an object.
+ * \retval ENOMEM Out of memory.
+ */
+SG_EXTERN int sg_json_key(struct sg_json *json, const char *key);
+
+/**
+ * Writes a string value.
+ * \param[in] json JSON writer handle.
+ * \param[in] val Null-terminated UTF-8 string.
+ * \retval 0 Success.
+ * \retval EINVAL Invalid argument or a value is not allowed here.
+ * \retval ENOMEM Out of memory.
+ * \note All the value functions can also return the errors of
+ * sg_json_flush() for writers created by sg_json_new2(). The value is kept in
+ * that case.
+ */
+SG_EXTERN int sg_json_string(struct sg_json *json, const char *val);
+
+/**
+ * Writes a signed integer value.
+ * \param[in] json JSON writer handle.
+ * \param[in] val Integer value.
+ * \retval 0 Success.
+ * \retval EINVAL Invalid argument or a value is not allowed here.
+ * \retval ENOMEM Out of memory.
+ */
+SG_EXTERN int sg_json_int(struct sg_json *json, int64_t val);
+
+/**
+ * Writes an unsigned integer value.
+ * \param[in] json JSON writer handle.
+ * \param[in] val Integer value.
+ * \retval 0 Success.
+ * \retval EINVAL Invalid argument or a value is not allowed here.
+ * \retval ENOMEM Out of memory.
+ */
+SG_EXTERN int sg_json_uint(struct sg_json *json, uint64_t val);
+
+/**
+ * Writes a floating-point value.
+ * \param[in] json JSON writer handle.
+ * \param[in] val Finite value.
+ * \retval 0 Success.
+ * \retval EINVAL Invalid argument, infinite or NaN value, or a value is not
+ * allowed here.
+ * \retval ENOMEM Out of memory.
+ */
+SG_EXTERN int sg_json_double(struct sg_json *json, double val);
+
+/**
+ * Writes a boolean value.
+ * \param[in] json JSON writer handle.
+ * \param[in] val Boolean value.
+ * \retval 0 Success.
+ * \retval EINVAL Invalid argument or a value is not allowed here.
+ * \retval ENOMEM Out of memory.
+ */
+SG_EXTERN int sg_json_bool(struct sg_json *json, bool val);
+
+/**
+ * Writes a `null` value.
+ * \param[in] json JSON writer handle.
+ * \retval 0 Success.
+ * \retval EINVAL Invalid argument or a value is not allowed here.
+ * \retval ENOMEM Out of memory.
+ */
+SG_EXTERN int sg_json_null(struct sg_json *json);
+
+/** \} */
+
+/**
+ * \ingroup sg_api
+ * \defgroup sg_rope Rope buffer
+ * Segmented buffer for building large contents.
+ * \{
+ */
+
+/**
+ * Handle for a rope buffer: a list of fixed-size chunks drawn from a shared
+ * pool. Unlike #sg_str, appending never reallocates or moves the content
+ * already written, and the chunks are sent to the client as they are.
+ * \struct sg_rope
+ */
+struct sg_rope;
+
+/**
+ * Creates a new empty rope buffer.
+ * \return Rope buffer handle.
+ * \retval NULL If no memory space is available.
+ */
+SG_EXTERN struct sg_rope *sg_rope_new(void) __SG_MALLOC;
+
+/**
+ * Frees the rope buffer handle, returning its chunks to the pool.
+ * \param[in] rope Rope buffer handle.
+ */
+SG_EXTERN void sg_rope_free(struct sg_rope *rope);
+
+/**
+ * Appends a content to the rope buffer \pr{rope}.
+ * \param[in] rope Rope buffer handle.
+ * \param[in] val Content to be appended.
+ * \param[in] len Length of the content.
+ * \retval 0 Success.
+ * \retval EINVAL Invalid argument.
+ * \retval ENOMEM Out of memory.
+ */
+SG_EXTERN int sg_rope_write(struct sg_rope *rope, const char *val, size_t len);
+
+/**
+ * Appends a formatted string from the argument list to the rope buffer
+ * \pr{rope}. The string is formatted in place whenever it fits the last
+ * chunk.
+ * \param[in] rope Rope buffer handle.
+ * \param[in] fmt Formatted string (following the same
+ * [`printf()`](https://linux.die.net/man/3/printf) format specification).
+ * \param[in] ap Arguments list (handled by
+ * [`va_start()`](https://linux.die.net/man/3/va_start)/
+ * [`va_end()`](https://linux.die.net/man/3/va_end)).
+ * \retval 0 Success.
+ * \retval EINVAL Invalid argument.
+ * \retval ENOMEM Out of memory.
+ */
+SG_EXTERN int sg_rope_printf_va(struct sg_rope *rope, const char *fmt,
+                                va_list ap);
+
+/**
+ * Appends a formatted string to the rope buffer \pr{rope}.
+ * \param[in] rope Rope buffer handle.
+ * \param[in] fmt Formatted string (following the same
+ * [`printf()`](https://linux.die.net/man/3/printf) format specification).
+ * \param[in] ... Additional arguments (following the same
+ * [`printf()`](https://linux.die.net/man/3/printf) arguments specification).
+ * \retval 0 Success.
+ * \retval EINVAL Invalid argument.
+ * \retval ENOMEM Out of memory.
+ */
+SG_EXTERN int sg_rope_printf(struct sg_rope *rope, const char *fmt, ...)
+  __SG_FORMAT(2, 3);
+
+/**
+ * Returns the total content length of the rope buffer \pr{rope}.
+ * \param[in] rope Rope buffer handle.
+ * \return Total content length.
+ * \retval 0 If \pr{rope} is null and set the `errno` to `EINVAL`.
+ */
+SG_EXTERN uint64_t sg_rope_length(struct sg_rope *rope);
+
+/**
+ * Clears the rope buffer \pr{rope}, returning its chunks to the pool.
+ * \param[in] rope Rope buffer handle.
+ * \retval 0 Success.
+ * \retval EINVAL Invalid argument.
+ */
+SG_EXTERN int sg_rope_clear(struct sg_rope *rope);
+
+/**
+ * Sends the content of a rope buffer to the client. The chunks are written in
+ * order using vectored I/O, without being flattened or copied.
+ * \param[in] res Response handle.
+ * \param[in] rope Rope buffer handle.
+ * \param[in] content_type Content type.
+ * \param[in] status HTTP status code.
+ * \retval 0 Success.
+ * \retval EINVAL Invalid argument.
+ * \retval EALREADY Operation already in progress.
+ * \retval EOVERFLOW Content too large for the platform.
+ * \retval ENOMEM Out of memory.
+ * \note The response takes the ownership of \pr{rope}, which is freed after
+ * the response is sent, or right away if the function fails.
+ */
+SG_EXTERN int sg_httpres_sendrope(struct sg_httpres *res, struct sg_rope *rope,
+                                  const char *content_type,
+                                  unsigned int status);
+
+/** \} */
+
+#ifdef SG_HTTP_WEBSOCKET
+
+/**
+ * \ingroup sg_api
+ * \defgroup sg_httpws WebSocket
+ * WebSocket connections upgraded from HTTP requests.
+ * \{
+ */
+
+/**
+ * Handle for a WebSocket connection. All the connections of a server are
+ * served by a single event loop thread.
+ * \struct sg_httpws
+ */
+struct sg_httpws;
+
+/**
+ * Callback signature used to handle the messages received from a WebSocket
+ * client. Fragmented messages are reassembled before being delivered.
+ * \param[out] cls User-defined closure.
+ * \param[out] ws WebSocket handle.
+ * \param[out] binary `true` for binary messages, `false` for text messages.
+ * \param[out] buf Message content.
+ * \param[out] size Message size.
+ * \warning The message content is only valid until the callback returns.
+ */
+typedef void (*sg_httpws_msg_cb)(void *cls, struct sg_httpws *ws, bool binary,
+                                 const void *buf, size_t size);
+
+/**
+ * Callback signature used to notify that a WebSocket connection was closed.
+ * \param[out] cls User-defined closure.
+ * \param[out] ws WebSocket handle, released right after the callback returns.
+ * \param[out] code Close status code, e.g. `1000` for normal closure or
+ * `1006` if the connection was lost.
+ */
+typedef void (*sg_httpws_close_cb)(void *cls, struct sg_httpws *ws,
+                                   unsigned int code);
+
+/**
+ * Accepts the WebSocket handshake of a request and upgrades its connection
+ * when the response is sent. Messages larger than the payload limit set by
+ * #sg_httpsrv_set_payld_limit() are rejected.
+ * \param[in] req Request handle.
+ * \param[in] msg_cb Callback to handle the received messages.
+ * \param[in] close_cb Optional callback to be notified when the connection is
+ * closed.
+ * \param[in] cls User-defined closure.
+ * \retval 0 Success.
+ * \retval EINVAL Invalid argument.
+ * \retval EALREADY Operation already in progress.
+ * \retval EPROTO The request is not a valid WebSocket handshake.
+ * \retval ENOMEM Out of memory.
+ */
+SG_EXTERN int sg_httpws_upgrade(struct sg_httpreq *req,
+                                sg_httpws_msg_cb msg_cb,
+                                sg_httpws_close_cb close_cb, void *cls);
+
+/**
+ * Queues a message to be sent to the WebSocket client. It never blocks and
+ * can be called from any thread. Once about 4 MB are waiting to be sent, new
+ * messages are refused until the client reads the queued ones.
+ * \param[in] ws WebSocket handle.
+ * \param[in] binary `true` to send a binary message, `false` for text.
+ * \param[in] buf Message content.
+ * \param[in] size Message size.
+ * \retval 0 Success.
+ * \retval EINVAL Invalid argument.
+ * \retval ENOTCONN The connection is closing.
+ * \retval EAGAIN The outgoing queue is full.
+ * \retval ENOMEM Out of memory.
+ */
+SG_EXTERN int sg_httpws_send(struct sg_httpws *ws, bool binary,
+                             const void *buf, size_t size);
+
+/**
+ * Starts the closing handshake of a WebSocket connection. The connection is
+ * closed after the queued messages are sent.
+ * \param[in] ws WebSocket handle.
+ * \param[in] code Close status code, e.g. `1000` for normal closure.
+ * \retval 0 Success.
+ * \retval EINVAL Invalid argument.
+ * \retval ENOTCONN The connection is already closing.
+ * \retval ENOMEM Out of memory.
+ */
+SG_EXTERN int sg_httpws_close(struct sg_httpws *ws, unsigned int code);
+
+/**
+ * Sets user data to the WebSocket handle.
+ * \param[in] ws WebSocket handle.
+ * \param[in] data User data pointer.
+ * \retval 0 Success.
+ * \retval EINVAL Invalid argument.
+ */
+SG_EXTERN int sg_httpws_set_user_data(struct sg_httpws *ws, void *data);
+
+/**
+ * Gets user data from the WebSocket handle.
+ * \param[in] ws WebSocket handle.
+ * \return User data pointer.
+ * \retval NULL If \pr{ws} is null and set the `errno` to `EINVAL`.
+ */
+SG_EXTERN void *sg_httpws_user_data(struct sg_httpws *ws);
+
+/** \} */
+
+#endif /* SG_HTTP_WEBSOCKET */
+
 #ifdef SG_PATH_ROUTING
 
 /**
@@ -0,0 +1,387 @@
+/*                         _
+ *   ___  __ _  __ _ _   _(_)
+ *  / __|/ _` |/ _` | | | | |
+ *  \__ \ (_| | (_| | |_| | |
+ *  |___/\__,_|\__, |\__,_|_|
+ *             |___/
+ *
+ * Cross-platform library which helps to develop web servers or frameworks.
+ *
+ * Copyright (C) 2016-2020 Silvio Clecio <silvioprog@gmail.com>
+ *
+ * Sagui library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * Sagui library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Sagui library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include "sg_macros.h"
+#include "sagui.h"
+#include "sg_digest.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define SG__DIGEST_X86 1
+#include <cpuid.h>
+#include <immintrin.h>
+#endif /* __x86_64__ && (__GNUC__ || __clang__) */
+
+#if defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#define SG__DIGEST_ARM_CRC32 1
+#include <arm_acle.h>
+#endif /* __aarch64__ && __ARM_FEATURE_CRC32 */
+
+#define SG__DIGEST_ROR(val, bits) (((val) >> (bits)) | ((val) << (32 - (bits))))
+
+static const uint32_t sg__sha256_k[64] = {
+  0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+  0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+  0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+  0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+  0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+  0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+  0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+  0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+  0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+  0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+  0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+static uint32_t sg__crc32c_table[8][256];
+
+static pthread_once_t sg__digest_once = PTHREAD_ONCE_INIT;
+
+static uint32_t sg__crc32c_sw(uint32_t crc, const unsigned char *p,
+                              size_t size);
+
+static void sg__sha256_blocks_sw(uint32_t state[8], const unsigned char *data,
+                                 size_t blocks);
+
+static uint32_t (*sg__crc32c_fn)(uint32_t crc, const unsigned char *p,
+                                 size_t size) = sg__crc32c_sw;
+
+static void (*sg__sha256_fn)(uint32_t state[8], const unsigned char *data,
+                             size_t blocks) = sg__sha256_blocks_sw;
+
+/* CRC-32C */
+
+/* Slicing-by-8: eight bytes per step through the tables of the polynomial
+ * shifted by zero to seven bytes. */
+static uint32_t sg__crc32c_sw(uint32_t crc, const unsigned char *p,
+                              size_t size) {
+  uint32_t lo, hi;
+  crc = ~crc;
+  for (; size >= 8; size -= 8, p += 8) {
+    lo = crc ^ ((uint32_t) p[0] | ((uint32_t) p[1] << 8) |
+                ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24));
+    hi = (uint32_t) p[4] | ((uint32_t) p[5] << 8) | ((uint32_t) p[6] << 16) |
+         ((uint32_t) p[7] << 24);
+    crc = sg__crc32c_table[7][lo & 0xff] ^
+          sg__crc32c_table[6][(lo >> 8) & 0xff] ^
+          sg__crc32c_table[5][(lo >> 16) & 0xff] ^
+          sg__crc32c_table[4][lo >> 24] ^ sg__crc32c_table[3][hi & 0xff] ^
+          sg__crc32c_table[2][(hi >> 8) & 0xff] ^
+          sg__crc32c_table[1][(hi >> 16) & 0xff] ^
+          sg__crc32c_table[0][hi >> 24];
+  }
+  for (; size > 0; size--, p++)
+    crc = sg__crc32c_table[0][(crc ^ *p) & 0xff] ^ (crc >> 8);
+  return ~crc;
+}
+
+#ifdef SG__DIGEST_X86
+
+__attribute__((target("sse4.2"))) static uint32_t
+sg__crc32c_sse42(uint32_t crc, const unsigned char *p, size_t size) {
+  uint64_t crc64, word;
+  crc = ~crc;
+  for (; (size > 0) && ((uintptr_t) p & 7); size--, p++)
+    crc = __builtin_ia32_crc32qi(crc, *p);
+  crc64 = crc;
+  for (; size >= 8; size -= 8, p += 8) {
+    memcpy(&word, p, sizeof(word));
+    crc64 = __builtin_ia32_crc32di(crc64, word);
+  }
+  crc = (uint32_t) crc64;
+  for (; size > 0; size--, p++)
+    crc = __builtin_ia32_crc32qi(crc, *p);
+  return ~crc;
+}
+
+#endif /* SG__DIGEST_X86 */
+
+#ifdef SG__DIGEST_ARM_CRC32
+
+static uint32_t sg__crc32c_arm(uint32_t crc, const unsigned char *p,
+                               size_t size) {
+  uint64_t word;
+  crc = ~crc;
+  for (; (size > 0) && ((uintptr_t) p & 7); size--, p++)
+    crc = __crc32cb(crc, *p);
+  for (; size >= 8; size -= 8, p += 8) {
+    memcpy(&word, p, sizeof(word));
+    crc = __crc32cd(crc, word);
+  }
+  for (; size > 0; size--, p++)
+    crc = __crc32cb(crc, *p);
+  return ~crc;
+}
+
+#endif /* SG__DIGEST_ARM_CRC32 */
+
+/* SHA-256 */
+
+static void sg__sha256_blocks_sw(uint32_t state[8], const unsigned char *data,
+                                 size_t blocks) {
+  uint32_t w[64], a, b, c, d, e, f, g, h, t1, t2;
+  unsigned char i;
+  for (; blocks > 0; blocks--, data += 64) {
+    for (i = 0; i < 16; i++)
+      w[i] = ((uint32_t) data[i * 4] << 24) |
+             ((uint32_t) data[i * 4 + 1] << 16) |
+             ((uint32_t) data[i * 4 + 2] << 8) | (uint32_t) data[i * 4 + 3];
+    for (i = 16; i < 64; i++)
+      w[i] = (SG__DIGEST_ROR(w[i - 2], 17) ^ SG__DIGEST_ROR(w[i - 2], 19) ^
+              (w[i - 2] >> 10)) +
+             w[i - 7] +
+             (SG__DIGEST_ROR(w[i - 15], 7) ^ SG__DIGEST_ROR(w[i - 15], 18) ^
+              (w[i - 15] >> 3)) +
+             w[i - 16];
+    a = state[0];
+    b = state[1];
+    c = state[2];
+    d = state[3];
+    e = state[4];
+    f = state[5];
+    g = state[6];
+    h = state[7];
+    for (i = 0; i < 64; i++) {
+      t1 = h +
+           (SG__DIGEST_ROR(e, 6) ^ SG__DIGEST_ROR(e, 11) ^
+            SG__DIGEST_ROR(e, 25)) +
+           ((e & f) ^ (~e & g)) + sg__sha256_k[i] + w[i];
+      t2 = (SG__DIGEST_ROR(a, 2) ^ SG__DIGEST_ROR(a, 13) ^
+            SG__DIGEST_ROR(a, 22)) +
+           ((a & b) ^ (a & c) ^ (b & c));
+      h = g;
+      g = f;
+      f = e;
+      e = d + t1;
+      d = c;
+      c = b;
+      b = a;
+      a = t1 + t2;
+    }
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+    state[5] += f;
+    state[6] += g;
+    state[7] += h;
+  }
+}
+
+#ifdef SG__DIGEST_X86
+
+/* SHA extensions: the state is kept as ABEF/CDGH, and each instruction
+ * performs two rounds. */
+__attribute__((target("sha,ssse3,sse4.1"))) static void
+sg__sha256_blocks_shani(uint32_t state[8], const unsigned char *data,
+                        size_t blocks) {
+  const __m128i mask =
+    _mm_set_epi64x(0x0c0d0e0f08090a0bLL, 0x0405060700010203LL);
+  __m128i state0, state1, abef, cdgh, msg, tmp, w[4];
+  unsigned char i;
+  tmp = _mm_loadu_si128((const __m128i *) &state[0]);
+  state1 = _mm_loadu_si128((const __m128i *) &state[4]);
+  tmp = _mm_shuffle_epi32(tmp, 0xb1);
+  state1 = _mm_shuffle_epi32(state1, 0x1b);
+  state0 = _mm_alignr_epi8(tmp, state1, 8);
+  state1 = _mm_blend_epi16(state1, tmp, 0xf0);
+  for (; blocks > 0; blocks--, data += 64) {
+    abef = state0;
+    cdgh = state1;
+    for (i = 0; i < 16; i++) {
+      if (i < 4)
+        w[i] = _mm_shuffle_epi8(
+          _mm_loadu_si128((const __m128i *) (data + i * 16)), mask);
+      else
+        w[i & 3] = _mm_sha256msg2_epu32(
+          _mm_add_epi32(_mm_sha256msg1_epu32(w[i & 3], w[(i + 1) & 3]),
+                        _mm_alignr_epi8(w[(i + 3) & 3], w[(i + 2) & 3], 4)),
+          w[(i + 3) & 3]);
+      msg = _mm_add_epi32(
+        w[i & 3], _mm_loadu_si128((const __m128i *) &sg__sha256_k[i * 4]));
+      state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+      msg = _mm_shuffle_epi32(msg, 0x0e);
+      state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+    }
+    state0 = _mm_add_epi32(state0, abef);
+    state1 = _mm_add_epi32(state1, cdgh);
+  }
+  tmp = _mm_shuffle_epi32(state0, 0x1b);
+  state1 = _mm_shuffle_epi32(state1, 0xb1);
+  state0 = _mm_blend_epi16(tmp, state1, 0xf0);
+  state1 = _mm_alignr_epi8(state1, tmp, 8);
+  _mm_storeu_si128((__m128i *) &state[0], state0);
+  _mm_storeu_si128((__m128i *) &state[4], state1);
+}
+
+#endif /* SG__DIGEST_X86 */
+
+static void sg__digest_setup(void) {
+#ifdef SG__DIGEST_X86
+  unsigned int eax, ebx, ecx, edx;
+#endif /* SG__DIGEST_X86 */
+  uint32_t crc;
+  unsigned int i, j;
+  for (i = 0; i < 256; i++) {
+    crc = i;
+    for (j = 0; j < 8; j++)
+      crc = (crc >> 1) ^ (0x82f63b78 & (0 - (crc & 1)));
+    sg__crc32c_table[0][i] = crc;
+  }
+  for (i = 0; i < 256; i++)
+    for (j = 1; j < 8; j++)
+      sg__crc32c_table[j][i] =
+        (sg__crc32c_table[j - 1][i] >> 8) ^
+        sg__crc32c_table[0][sg__crc32c_table[j - 1][i] & 0xff];
+#ifdef SG__DIGEST_X86
+  if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+    return;
+  if (ecx & bit_SSE4_2)
+    sg__crc32c_fn = sg__crc32c_sse42;
+  if (!(ecx & bit_SSSE3) || !(ecx & bit_SSE4_1) ||
+      (__get_cpuid_max(0, NULL) < 7))
+    return;
+  __cpuid_count(7, 0, eax, ebx, ecx, edx);
+  /* SHA extensions */
+  if (ebx & (1u << 29))
+    sg__sha256_fn = sg__sha256_blocks_shani;
+#endif /* SG__DIGEST_X86 */
+#ifdef SG__DIGEST_ARM_CRC32
+  sg__crc32c_fn = sg__crc32c_arm;
+#endif /* SG__DIGEST_ARM_CRC32 */
+}
+
+uint32_t sg__crc32c(uint32_t crc, const void *data, size_t size) {
+  pthread_once(&sg__digest_once, sg__digest_setup);
+  return sg__crc32c_fn(crc, data, size);
+}
+
+void sg__sha256_blocks(uint32_t state[8], const unsigned char *data,
+                       size_t blocks) {
+  pthread_once(&sg__digest_once, sg__digest_setup);
+  sg__sha256_fn(state, data, blocks);
+}
+
+/* Digest */
+
+static void sg__digest_hexify(char *dest, const unsigned char *src,
+                              size_t size) {
+  static const char hex[] = "0123456789abcdef";
+  size_t i;
+  for (i = 0; i < size; i++) {
+    dest[i * 2] = hex[src[i] >> 4];
+    dest[i * 2 + 1] = hex[src[i] & 0xf];
+  }
+  dest[size * 2] = '\0';
+}
+
+void sg__digest_init(struct sg__digest *digest, unsigned int algos) {
+  static const uint32_t sha256_iv[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372,
+                                        0xa54ff53a, 0x510e527f, 0x9b05688c,
+                                        0x1f83d9ab, 0x5be0cd19};
+  memset(digest, 0, sizeof(struct sg__digest));
+  digest->algos = algos;
+  memcpy(digest->sha256, sha256_iv, sizeof(sha256_iv));
+}
+
+void sg__digest_update(struct sg__digest *digest, const void *data,
+                       size_t size) {
+  const unsigned char *p = data;
+  size_t len;
+  if (digest->done || (size == 0))
+    return;
+  digest->size += size;
+  if (digest->algos & SG_DIGEST_CRC32C)
+    digest->crc32c = sg__crc32c(digest->crc32c, p, size);
+  if (!(digest->algos & SG_DIGEST_SHA256))
+    return;
+  if (digest->blk_len > 0) {
+    len = sizeof(digest->blk) - digest->blk_len;
+    if (len > size)
+      len = size;
+    memcpy(digest->blk + digest->blk_len, p, len);
+    digest->blk_len += len;
+    p += len;
+    size -= len;
+    if (digest->blk_len < sizeof(digest->blk))
+      return;
+    sg__sha256_blocks(digest->sha256, digest->blk, 1);
+    digest->blk_len = 0;
+  }
+  if (size >= 64) {
+    sg__sha256_blocks(digest->sha256, p, size / 64);
+    p += size & ~(size_t) 63;
+    size &= 63;
+  }
+  memcpy(digest->blk, p, size);
+  digest->blk_len = size;
+}
+
+static void sg__digest_finish(struct sg__digest *digest) {
+  unsigned char buf[32];
+  const uint64_t bits = digest->size * 8;
+  unsigned char i;
+  if (digest->algos & SG_DIGEST_CRC32C) {
+    for (i = 0; i < 4; i++)
+      buf[i] = (unsigned char) (digest->crc32c >> (24 - i * 8));
+    sg__digest_hexify(digest->crc32c_hex, buf, 4);
+  }
+  if (digest->algos & SG_DIGEST_SHA256) {
+    digest->blk[digest->blk_len++] = 0x80;
+    if (digest->blk_len > 56) {
+      memset(digest->blk + digest->blk_len, 0,
+             sizeof(digest->blk) - digest->blk_len);
+      sg__sha256_blocks(digest->sha256, digest->blk, 1);
+      digest->blk_len = 0;
+    }
+    memset(digest->blk + digest->blk_len, 0, 56 - digest->blk_len);
+    for (i = 0; i < 8; i++)
+      digest->blk[63 - i] = (unsigned char) (bits >> (i * 8));
+    sg__sha256_blocks(digest->sha256, digest->blk, 1);
+    for (i = 0; i < 32; i++)
+      buf[i] = (unsigned char) (digest->sha256[i / 4] >> (24 - (i % 4) * 8));
+    sg__digest_hexify(digest->sha256_hex, buf, 32);
+  }
+  digest->done = true;
+}
+
+const char *sg__digest_hex(struct sg__digest *digest, enum sg_digest algo) {
+  if ((algo != SG_DIGEST_CRC32C) && (algo != SG_DIGEST_SHA256)) {
+    errno = EINVAL;
+    return NULL;
+  }
+  if (!(digest->algos & (unsigned int) algo)) {
+    errno = ENOTSUP;
+    return NULL;
+  }
+  if (!digest->done)
+    sg__digest_finish(digest);
+  return algo == SG_DIGEST_CRC32C ? digest->crc32c_hex : digest->sha256_hex;
+}
@@ -0,0 +1,65 @@
+/*                         _
+ *   ___  __ _  __ _ _   _(_)
+ *  / __|/ _` |/ _` | | | | |
+ *  \__ \ (_| | (_| | |_| | |
+ *  |___/\__,_|\__, |\__,_|_|
+ *             |___/
+ *
+ * Cross-platform library which helps to develop web servers or frameworks.
+ *
+ * Copyright (C) 2016-2020 Silvio Clecio <silvioprog@gmail.com>
+ *
+ * Sagui library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * Sagui library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Sagui library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef SG_DIGEST_H
+#define SG_DIGEST_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "sg_macros.h"
+#include "sagui.h"
+
+#define SG__DIGEST_ALL (SG_DIGEST_CRC32C | SG_DIGEST_SHA256)
+
+/* Streaming digests, updated as the data arrives. The hexadecimal strings
+ * are produced on the first lookup, after which no more data can be added. */
+struct sg__digest {
+  unsigned int algos;
+  uint32_t crc32c;
+  uint32_t sha256[8];
+  uint64_t size;
+  unsigned char blk[64];
+  size_t blk_len;
+  char crc32c_hex[9];
+  char sha256_hex[65];
+  bool done;
+};
+
+SG__EXTERN void sg__digest_init(struct sg__digest *digest, unsigned int algos);
+
+SG__EXTERN void sg__digest_update(struct sg__digest *digest, const void *data,
+                                  size_t size);
+
+SG__EXTERN const char *sg__digest_hex(struct sg__digest *digest,
+                                      enum sg_digest algo);
+
+SG__EXTERN uint32_t sg__crc32c(uint32_t crc, const void *data, size_t size);
+
+SG__EXTERN void sg__sha256_blocks(uint32_t state[8], const unsigned char *data,
+                                  size_t blocks);
+
+#endif /* SG_DIGEST_H */
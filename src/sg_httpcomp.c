@@ -0,0 +1,537 @@
+/*                         _
+ *   ___  __ _  __ _ _   _(_)
+ *  / __|/ _` |/ _` | | | | |
+ *  \__ \ (_| | (_| | |_| | |
+ *  |___/\__,_|\__, |\__,_|_|
+ *             |___/
+ *
+ * Cross-platform library which helps to develop web servers or frameworks.
+ *
+ * Copyright (C) 2016-2024 Silvio Clecio <silvioprog@gmail.com>
+ *
+ * Sagui library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * Sagui library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Sagui library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include "sg_macros.h"
+#include "zlib.h"
+#ifdef SG_HTTP_COMPRESSION_LIBDEFLATE
+#include "libdeflate.h"
+#endif /* SG_HTTP_COMPRESSION_LIBDEFLATE */
+#ifdef SG_HTTP_COMPRESSION_BROTLI
+#include <brotli/encode.h>
+#endif /* SG_HTTP_COMPRESSION_BROTLI */
+#ifdef SG_HTTP_COMPRESSION_ZSTD
+#include "zstd.h"
+#endif /* SG_HTTP_COMPRESSION_ZSTD */
+#include "sagui.h"
+#include "sg_extra.h"
+#include "sg_httpcomp.h"
+
+int sg__httpcomp_buf_grow(struct sg__httpcomp_buf *buf, size_t size) {
+  size_t cap;
+  void *data;
+  if (buf->cap - buf->size >= size)
+    return 0;
+  cap = buf->cap > 0 ? buf->cap : SG__ZLIB_CHUNK;
+  while (cap - buf->size < size) {
+    if (cap > SIZE_MAX / 2)
+      return ENOMEM;
+    cap *= 2;
+  }
+  data = sg_realloc(buf->data, cap);
+  if (!data)
+    return ENOMEM;
+  buf->data = data;
+  buf->cap = cap;
+  return 0;
+}
+
+void sg__httpcomp_buf_free(struct sg__httpcomp_buf *buf) {
+  sg_free(buf->data);
+  memset(buf, 0, sizeof(struct sg__httpcomp_buf));
+}
+
+/* zlib (deflate and gzip) */
+
+static int sg__httpcomp_zinit(void **ctx, int level, int wbits, int mem_level) {
+  z_stream *stream = sg_alloc(sizeof(z_stream));
+  int errnum;
+  if (!stream)
+    return ENOMEM;
+  stream->zalloc = sg__zalloc;
+  stream->zfree = sg__zfree;
+  errnum = deflateInit2(stream, level, Z_DEFLATED, wbits, mem_level,
+                        Z_DEFAULT_STRATEGY);
+  if (errnum != Z_OK) {
+    sg_free(stream);
+    return errnum == Z_MEM_ERROR ? ENOMEM : EINVAL;
+  }
+  *ctx = stream;
+  return 0;
+}
+
+static int sg__httpcomp_zrun(z_stream *stream, const void *src,
+                             size_t src_size, int flush,
+                             struct sg__httpcomp_buf *dest) {
+  z_const uInt max = (uInt) -1;
+  uInt have;
+  int errnum;
+  stream->next_in = (z_const Bytef *) src;
+  do {
+    stream->avail_in = src_size > (size_t) max ? max : (uInt) src_size;
+    src_size -= stream->avail_in;
+    do {
+      if (sg__httpcomp_buf_grow(dest, SG__ZLIB_CHUNK) != 0)
+        return ENOMEM;
+      have = (dest->cap - dest->size) > (size_t) max ?
+               max :
+               (uInt) (dest->cap - dest->size);
+      stream->next_out = (Bytef *) dest->data + dest->size;
+      stream->avail_out = have;
+      errnum = deflate(stream, src_size > 0 ? Z_NO_FLUSH : flush);
+      if (errnum == Z_STREAM_ERROR)
+        return EIO;
+      dest->size += have - stream->avail_out;
+    } while (stream->avail_out == 0);
+  } while (src_size > 0);
+  return 0;
+}
+
+static int sg__httpcomp_zencode(void *ctx, const void *src, size_t src_size,
+                                struct sg__httpcomp_buf *dest) {
+  return sg__httpcomp_zrun(ctx, src, src_size, Z_NO_FLUSH, dest);
+}
+
+static int sg__httpcomp_zflush(void *ctx, struct sg__httpcomp_buf *dest) {
+  return sg__httpcomp_zrun(ctx, NULL, 0, Z_SYNC_FLUSH, dest);
+}
+
+static int sg__httpcomp_zfinish(void *ctx, struct sg__httpcomp_buf *dest) {
+  return sg__httpcomp_zrun(ctx, NULL, 0, Z_FINISH, dest);
+}
+
+static void sg__httpcomp_zfree(void *ctx) {
+  if (!ctx)
+    return;
+  deflateEnd(ctx);
+  sg_free(ctx);
+}
+
+static int sg__httpcomp_deflate_init(void **ctx, int level) {
+  return sg__httpcomp_zinit(ctx, level, MAX_WBITS, MAX_MEM_LEVEL);
+}
+
+static int sg__httpcomp_gzip_init(void **ctx, int level) {
+  return sg__httpcomp_zinit(ctx, level, MAX_WBITS + 16, 8);
+}
+
+#ifdef SG_HTTP_COMPRESSION_LIBDEFLATE
+
+/* One-shot deflate and gzip through libdeflate, which is considerably faster
+ * than a zlib stream when the whole input is already in memory. */
+
+typedef size_t (*sg__httpcomp_ldcompress_func)(struct libdeflate_compressor *c,
+                                               const void *in,
+                                               size_t in_nbytes, void *out,
+                                               size_t out_nbytes_avail);
+
+static int sg__httpcomp_ldcompress(sg__httpcomp_ldcompress_func func,
+                                   int level, const void *src,
+                                   size_t src_size, void *dest,
+                                   size_t *dest_size) {
+  struct libdeflate_options opts;
+  struct libdeflate_compressor *compressor;
+  size_t size;
+  memset(&opts, 0, sizeof(struct libdeflate_options));
+  opts.sizeof_options = sizeof(struct libdeflate_options);
+  opts.malloc_func = sg_malloc;
+  opts.free_func = sg_free;
+  compressor = libdeflate_alloc_compressor_ex(
+    (level == Z_DEFAULT_COMPRESSION) ? 6 : level, &opts);
+  if (!compressor)
+    return ENOMEM;
+  size = func(compressor, src, src_size, dest, *dest_size);
+  libdeflate_free_compressor(compressor);
+  if (size == 0)
+    return ENOBUFS;
+  *dest_size = size;
+  return 0;
+}
+
+static size_t sg__httpcomp_deflate_bound(size_t src_size) {
+  return libdeflate_deflate_compress_bound(NULL, src_size);
+}
+
+static int sg__httpcomp_deflate_compress(int level, const void *src,
+                                         size_t src_size, void *dest,
+                                         size_t *dest_size) {
+  return sg__httpcomp_ldcompress(libdeflate_deflate_compress, level, src,
+                                 src_size, dest, dest_size);
+}
+
+static size_t sg__httpcomp_gzip_bound(size_t src_size) {
+  return libdeflate_gzip_compress_bound(NULL, src_size);
+}
+
+static int sg__httpcomp_gzip_compress(int level, const void *src,
+                                      size_t src_size, void *dest,
+                                      size_t *dest_size) {
+  return sg__httpcomp_ldcompress(libdeflate_gzip_compress, level, src,
+                                 src_size, dest, dest_size);
+}
+
+#else /* SG_HTTP_COMPRESSION_LIBDEFLATE */
+
+static size_t sg__httpcomp_deflate_bound(size_t src_size) {
+  return compressBound((uLong) src_size);
+}
+
+static int sg__httpcomp_deflate_compress(int level, const void *src,
+                                         size_t src_size, void *dest,
+                                         size_t *dest_size) {
+  uLongf size = (uLongf) *dest_size;
+  if (sg__zcompress((z_const Bytef *) src, (uLong) src_size, dest, &size,
+                    level) != Z_OK)
+    return EIO;
+  *dest_size = size;
+  return 0;
+}
+
+#endif /* SG_HTTP_COMPRESSION_LIBDEFLATE */
+
+#ifdef SG_HTTP_COMPRESSION_BROTLI
+
+/* Brotli (br) */
+
+static void *sg__httpcomp_bralloc(__SG_UNUSED void *opaque, size_t size) {
+  return sg_malloc(size);
+}
+
+static void sg__httpcomp_brfree(__SG_UNUSED void *opaque, void *ptr) {
+  sg_free(ptr);
+}
+
+static int sg__httpcomp_br_init(void **ctx, int level) {
+  BrotliEncoderState *state;
+  state = BrotliEncoderCreateInstance(sg__httpcomp_bralloc,
+                                      sg__httpcomp_brfree, NULL);
+  if (!state)
+    return ENOMEM;
+  if (!BrotliEncoderSetParameter(state, BROTLI_PARAM_QUALITY,
+                                 (uint32_t) level)) {
+    BrotliEncoderDestroyInstance(state);
+    return EINVAL;
+  }
+  *ctx = state;
+  return 0;
+}
+
+static int sg__httpcomp_brrun(BrotliEncoderState *state,
+                              BrotliEncoderOperation op, const void *src,
+                              size_t src_size,
+                              struct sg__httpcomp_buf *dest) {
+  const uint8_t *next_in = src;
+  const uint8_t *out;
+  size_t avail_in = src_size, avail_out = 0, out_size;
+  for (;;) {
+    if (!BrotliEncoderCompressStream(state, op, &avail_in, &next_in,
+                                     &avail_out, NULL, NULL))
+      return EIO;
+    while (BrotliEncoderHasMoreOutput(state)) {
+      out_size = 0;
+      out = BrotliEncoderTakeOutput(state, &out_size);
+      if (sg__httpcomp_buf_grow(dest, out_size) != 0)
+        return ENOMEM;
+      memcpy(dest->data + dest->size, out, out_size);
+      dest->size += out_size;
+    }
+    if (op == BROTLI_OPERATION_FINISH) {
+      if (BrotliEncoderIsFinished(state))
+        break;
+    } else if (avail_in == 0)
+      break;
+  }
+  return 0;
+}
+
+static int sg__httpcomp_br_encode(void *ctx, const void *src, size_t src_size,
+                                  struct sg__httpcomp_buf *dest) {
+  return sg__httpcomp_brrun(ctx, BROTLI_OPERATION_PROCESS, src, src_size,
+                            dest);
+}
+
+static int sg__httpcomp_br_flush(void *ctx, struct sg__httpcomp_buf *dest) {
+  return sg__httpcomp_brrun(ctx, BROTLI_OPERATION_FLUSH, NULL, 0, dest);
+}
+
+static int sg__httpcomp_br_finish(void *ctx, struct sg__httpcomp_buf *dest) {
+  return sg__httpcomp_brrun(ctx, BROTLI_OPERATION_FINISH, NULL, 0, dest);
+}
+
+static void sg__httpcomp_br_free(void *ctx) {
+  if (ctx)
+    BrotliEncoderDestroyInstance(ctx);
+}
+
+static size_t sg__httpcomp_br_bound(size_t src_size) {
+  return BrotliEncoderMaxCompressedSize(src_size);
+}
+
+static int sg__httpcomp_br_compress(int level, const void *src,
+                                    size_t src_size, void *dest,
+                                    size_t *dest_size) {
+  if (!BrotliEncoderCompress(level, BROTLI_DEFAULT_WINDOW, BROTLI_MODE_GENERIC,
+                             src_size, src, dest_size, dest))
+    return EIO;
+  return 0;
+}
+
+#endif /* SG_HTTP_COMPRESSION_BROTLI */
+
+#ifdef SG_HTTP_COMPRESSION_ZSTD
+
+/* Zstandard (zstd) */
+
+static int sg__httpcomp_zstd_init(void **ctx, int level) {
+  ZSTD_CCtx *cctx = ZSTD_createCCtx();
+  if (!cctx)
+    return ENOMEM;
+  if (ZSTD_isError(
+        ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, level))) {
+    ZSTD_freeCCtx(cctx);
+    return EINVAL;
+  }
+  *ctx = cctx;
+  return 0;
+}
+
+static int sg__httpcomp_zstdrun(ZSTD_CCtx *cctx, ZSTD_EndDirective mode,
+                                const void *src, size_t src_size,
+                                struct sg__httpcomp_buf *dest) {
+  ZSTD_inBuffer in;
+  ZSTD_outBuffer out;
+  size_t remaining;
+  in.src = src;
+  in.size = src_size;
+  in.pos = 0;
+  do {
+    if (sg__httpcomp_buf_grow(dest, ZSTD_CStreamOutSize()) != 0)
+      return ENOMEM;
+    out.dst = dest->data + dest->size;
+    out.size = dest->cap - dest->size;
+    out.pos = 0;
+    remaining = ZSTD_compressStream2(cctx, &out, &in, mode);
+    if (ZSTD_isError(remaining))
+      return EIO;
+    dest->size += out.pos;
+  } while ((mode == ZSTD_e_continue) ? (in.pos < in.size) : (remaining != 0));
+  return 0;
+}
+
+static int sg__httpcomp_zstd_encode(void *ctx, const void *src,
+                                    size_t src_size,
+                                    struct sg__httpcomp_buf *dest) {
+  return sg__httpcomp_zstdrun(ctx, ZSTD_e_continue, src, src_size, dest);
+}
+
+static int sg__httpcomp_zstd_flush(void *ctx, struct sg__httpcomp_buf *dest) {
+  return sg__httpcomp_zstdrun(ctx, ZSTD_e_flush, NULL, 0, dest);
+}
+
+static int sg__httpcomp_zstd_finish(void *ctx, struct sg__httpcomp_buf *dest) {
+  return sg__httpcomp_zstdrun(ctx, ZSTD_e_end, NULL, 0, dest);
+}
+
+static void sg__httpcomp_zstd_free(void *ctx) {
+  ZSTD_freeCCtx(ctx);
+}
+
+static size_t sg__httpcomp_zstd_bound(size_t src_size) {
+  return ZSTD_compressBound(src_size);
+}
+
+static int sg__httpcomp_zstd_compress(int level, const void *src,
+                                      size_t src_size, void *dest,
+                                      size_t *dest_size) {
+  size_t size = ZSTD_compress(dest, *dest_size, src, src_size, level);
+  if (ZSTD_isError(size))
+    return EIO;
+  *dest_size = size;
+  return 0;
+}
+
+#endif /* SG_HTTP_COMPRESSION_ZSTD */
+
+/* Available encoders, sorted by server preference. */
+static const struct sg__httpcomp sg__httpcomp_list[] = {
+#ifdef SG_HTTP_COMPRESSION_ZSTD
+  {"zstd", 1, 22, 3, sg__httpcomp_zstd_init, sg__httpcomp_zstd_encode,
+   sg__httpcomp_zstd_flush, sg__httpcomp_zstd_finish, sg__httpcomp_zstd_free,
+   sg__httpcomp_zstd_bound, sg__httpcomp_zstd_compress},
+#endif /* SG_HTTP_COMPRESSION_ZSTD */
+#ifdef SG_HTTP_COMPRESSION_BROTLI
+  {"br", 0, 11, 5, sg__httpcomp_br_init, sg__httpcomp_br_encode,
+   sg__httpcomp_br_flush, sg__httpcomp_br_finish, sg__httpcomp_br_free,
+   sg__httpcomp_br_bound, sg__httpcomp_br_compress},
+#endif /* SG_HTTP_COMPRESSION_BROTLI */
+  {"gzip", 0, 9, Z_DEFAULT_COMPRESSION, sg__httpcomp_gzip_init,
+   sg__httpcomp_zencode, sg__httpcomp_zflush, sg__httpcomp_zfinish,
+#ifdef SG_HTTP_COMPRESSION_LIBDEFLATE
+   sg__httpcomp_zfree, sg__httpcomp_gzip_bound, sg__httpcomp_gzip_compress},
+#else /* SG_HTTP_COMPRESSION_LIBDEFLATE */
+   sg__httpcomp_zfree, NULL, NULL},
+#endif /* SG_HTTP_COMPRESSION_LIBDEFLATE */
+  {"deflate", 0, 9, Z_DEFAULT_COMPRESSION, sg__httpcomp_deflate_init,
+   sg__httpcomp_zencode, sg__httpcomp_zflush, sg__httpcomp_zfinish,
+   sg__httpcomp_zfree, sg__httpcomp_deflate_bound,
+   sg__httpcomp_deflate_compress}};
+
+#define SG__HTTPCOMP_COUNT                                                     \
+  (sizeof(sg__httpcomp_list) / sizeof(sg__httpcomp_list[0]))
+
+static bool sg__httpcomp_token_eq(const char *token, const char *str,
+                                  size_t len) {
+  size_t i;
+  for (i = 0; i < len; i++)
+    if (!token[i] ||
+        (tolower((unsigned char) token[i]) != tolower((unsigned char) str[i])))
+      return false;
+  return token[len] == '\0';
+}
+
+const struct sg__httpcomp *sg__httpcomp_find(const char *token) {
+  size_t i;
+  if (!token)
+    return NULL;
+  for (i = 0; i < SG__HTTPCOMP_COUNT; i++)
+    if (sg__httpcomp_token_eq(sg__httpcomp_list[i].token, token,
+                              strlen(token)))
+      return &sg__httpcomp_list[i];
+  return NULL;
+}
+
+bool sg__httpcomp_level_valid(const struct sg__httpcomp *comp, int level) {
+  return (level == -1) ||
+         ((level >= comp->min_level) && (level <= comp->max_level));
+}
+
+/* Parses a qvalue (RFC 9110, 12.4.2) into thousandths. */
+static int sg__httpcomp_qvalue(const char **str) {
+  const char *p = *str;
+  int q, i;
+  if ((*p != '0') && (*p != '1'))
+    return -1;
+  q = (*p++ - '0') * 1000;
+  if (*p == '.') {
+    p++;
+    for (i = 100; (i > 0) && isdigit((unsigned char) *p); i /= 10)
+      q += (*p++ - '0') * i;
+  }
+  *str = p;
+  return q > 1000 ? 1000 : q;
+}
+
+/* Returns the weight given to `token` in `accept`, or `-1` if not listed. */
+static int sg__httpcomp_weight(const char *accept, const char *token) {
+  const char *p = accept, *name;
+  size_t len;
+  int q, star = -1, found = -1;
+  while (*p) {
+    while ((*p == ' ') || (*p == '\t') || (*p == ','))
+      p++;
+    if (!*p)
+      break;
+    name = p;
+    while (*p && (*p != ',') && (*p != ';') && (*p != ' ') && (*p != '\t'))
+      p++;
+    len = (size_t) (p - name);
+    q = 1000;
+    while (*p && (*p != ',')) {
+      if (*p++ != ';')
+        continue;
+      while ((*p == ' ') || (*p == '\t'))
+        p++;
+      if (((*p == 'q') || (*p == 'Q')) && (p[1] == '=')) {
+        p += 2;
+        q = sg__httpcomp_qvalue(&p);
+        if (q < 0)
+          q = 0;
+      }
+    }
+    if ((len == 1) && (*name == '*'))
+      star = q;
+    else if (sg__httpcomp_token_eq(token, name, len))
+      found = q;
+  }
+  return found >= 0 ? found : star;
+}
+
+const char *sg__httpcomp_negotiate(const char *accept) {
+  const char *token = NULL;
+  size_t i;
+  int q, best = 0;
+  if (!accept)
+    return NULL;
+  for (i = 0; i < SG__HTTPCOMP_COUNT; i++) {
+    q = sg__httpcomp_weight(accept, sg__httpcomp_list[i].token);
+    if (q > best) {
+      best = q;
+      token = sg__httpcomp_list[i].token;
+    }
+  }
+  return token;
+}
+
+int sg__httpcomp_compress(const struct sg__httpcomp *comp, int level,
+                          const void *src, size_t src_size, void **dest,
+                          size_t *dest_size) {
+  struct sg__httpcomp_buf buf;
+  void *ctx = NULL;
+  int errnum;
+  if (level == -1)
+    level = comp->def_level;
+  if (comp->compress) {
+    *dest_size = comp->bound(src_size);
+    *dest = sg_malloc(*dest_size);
+    if (!*dest)
+      return ENOMEM;
+    errnum = comp->compress(level, src, src_size, *dest, dest_size);
+    if (errnum != 0) {
+      sg_free(*dest);
+      *dest = NULL;
+    }
+    return errnum;
+  }
+  memset(&buf, 0, sizeof(struct sg__httpcomp_buf));
+  errnum = comp->init(&ctx, level);
+  if (errnum != 0)
+    return errnum;
+  errnum = comp->encode(ctx, src, src_size, &buf);
+  if (errnum == 0)
+    errnum = comp->finish(ctx, &buf);
+  comp->free(ctx);
+  if (errnum != 0) {
+    sg__httpcomp_buf_free(&buf);
+    return errnum;
+  }
+  *dest = buf.data;
+  *dest_size = buf.size;
+  return 0;
+}
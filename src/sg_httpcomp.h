@@ -0,0 +1,78 @@
+/*                         _
+ *   ___  __ _  __ _ _   _(_)
+ *  / __|/ _` |/ _` | | | | |
+ *  \__ \ (_| | (_| | |_| | |
+ *  |___/\__,_|\__, |\__,_|_|
+ *             |___/
+ *
+ * Cross-platform library which helps to develop web servers or frameworks.
+ *
+ * Copyright (C) 2016-2024 Silvio Clecio <silvioprog@gmail.com>
+ *
+ * Sagui library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * Sagui library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Sagui library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef SG_HTTPCOMP_H
+#define SG_HTTPCOMP_H
+
+#include <stddef.h>
+#include "sg_macros.h"
+#include "sagui.h"
+
+/* Growable output buffer filled by the encoders. */
+struct sg__httpcomp_buf {
+  char *data;
+  size_t size;
+  size_t cap;
+};
+
+/* Content encoder. All functions return `0` on success or an error number,
+ * and append the produced output (if any) to `dest`. */
+struct sg__httpcomp {
+  /* token used in `Content-Encoding` / `Accept-Encoding` headers */
+  const char *token;
+  int min_level;
+  int max_level;
+  int def_level;
+  int (*init)(void **ctx, int level);
+  int (*encode)(void *ctx, const void *src, size_t src_size,
+                struct sg__httpcomp_buf *dest);
+  int (*flush)(void *ctx, struct sg__httpcomp_buf *dest);
+  int (*finish)(void *ctx, struct sg__httpcomp_buf *dest);
+  void (*free)(void *ctx);
+  /* optional one-shot compression of an in-memory buffer */
+  size_t (*bound)(size_t src_size);
+  int (*compress)(int level, const void *src, size_t src_size, void *dest,
+                  size_t *dest_size);
+};
+
+SG__EXTERN int sg__httpcomp_buf_grow(struct sg__httpcomp_buf *buf,
+                                     size_t size);
+
+SG__EXTERN void sg__httpcomp_buf_free(struct sg__httpcomp_buf *buf);
+
+SG__EXTERN const struct sg__httpcomp *sg__httpcomp_find(const char *token);
+
+SG__EXTERN bool sg__httpcomp_level_valid(const struct sg__httpcomp *comp,
+                                         int level);
+
+SG__EXTERN const char *sg__httpcomp_negotiate(const char *accept);
+
+SG__EXTERN int sg__httpcomp_compress(const struct sg__httpcomp *comp,
+                                     int level, const void *src,
+                                     size_t src_size, void **dest,
+                                     size_t *dest_size);
+
+#endif /* SG_HTTPCOMP_H */
@@ -0,0 +1,500 @@
+/*                         _
+ *   ___  __ _  __ _ _   _(_)
+ *  / __|/ _` |/ _` | | | | |
+ *  \__ \ (_| | (_| | |_| | |
+ *  |___/\__,_|\__, |\__,_|_|
+ *             |___/
+ *
+ * Cross-platform library which helps to develop web servers or frameworks.
+ *
+ * Copyright (C) 2016-2020 Silvio Clecio <silvioprog@gmail.com>
+ *
+ * Sagui library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * Sagui library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Sagui library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include "sg_macros.h"
+#include "microhttpd.h"
+#include "sagui.h"
+#include "sg_httpform.h"
+
+#if defined(__SSE2__) && (defined(__GNUC__) || defined(__clang__))
+#define SG__HTTPFORM_SSE2 1
+#include <emmintrin.h>
+#endif /* __SSE2__ && (__GNUC__ || __clang__) */
+
+/* RFC 2046 limits the boundaries to 70 characters. */
+#define SG__HTTPFORM_BOUNDARY_MAX 70
+
+enum sg__httpform_state {
+  SG__HTTPFORM_PREAMBLE,
+  SG__HTTPFORM_DELIM,
+  SG__HTTPFORM_CLOSE,
+  SG__HTTPFORM_LF,
+  SG__HTTPFORM_HEADERS,
+  SG__HTTPFORM_BODY,
+  SG__HTTPFORM_EPILOGUE,
+  SG__HTTPFORM_KEY,
+  SG__HTTPFORM_VALUE
+};
+
+/* Compares `str` to the lowercase `prefix`, ignoring ASCII case. Returns the
+ * end of the prefix in `str`, or null if it does not match. */
+static const char *sg__httpform_prefix(const char *str, const char *prefix) {
+  for (; *prefix != '\0'; str++, prefix++)
+    if (tolower((unsigned char) *str) != *prefix)
+      return NULL;
+  return str;
+}
+
+enum sg__httpform_kind sg__httpform_kind(const char *type) {
+  if (!type)
+    return SG__HTTPFORM_NONE;
+  if (sg__httpform_prefix(type, MHD_HTTP_POST_ENCODING_FORM_URLENCODED))
+    return SG__HTTPFORM_URLENCODED;
+  if (sg__httpform_prefix(type, MHD_HTTP_POST_ENCODING_MULTIPART_FORMDATA))
+    return SG__HTTPFORM_MULTIPART;
+  return SG__HTTPFORM_NONE;
+}
+
+/* Finds the `boundary` parameter of a multipart content type. */
+static const char *sg__httpform_boundary(const char *type, size_t *len) {
+  const char *val, *end;
+  while ((type = strchr(type, ';'))) {
+    do
+      type++;
+    while ((*type == ' ') || (*type == '\t'));
+    val = sg__httpform_prefix(type, "boundary=");
+    if (!val)
+      continue;
+    if (*val == '"') {
+      val++;
+      end = strchr(val, '"');
+      if (!end)
+        return NULL;
+    } else
+      for (end = val; (*end != '\0') && (*end != ';') && (*end != ' ') &&
+                      (*end != '\t');
+           end++)
+        ;
+    *len = (size_t) (end - val);
+    return val;
+  }
+  return NULL;
+}
+
+struct sg__httpform *sg__httpform_new(const char *type, size_t buf_size,
+                                      MHD_PostDataIterator iter) {
+  struct sg__httpform *form;
+  enum sg__httpform_kind kind = sg__httpform_kind(type);
+  const char *boundary = NULL;
+  size_t len = 0, i;
+  if ((kind == SG__HTTPFORM_NONE) || (buf_size < 256) || !iter) {
+    errno = EINVAL;
+    return NULL;
+  }
+  if (kind == SG__HTTPFORM_MULTIPART) {
+    boundary = sg__httpform_boundary(type, &len);
+    if (!boundary || (len == 0) || (len > SG__HTTPFORM_BOUNDARY_MAX)) {
+      errno = EINVAL;
+      return NULL;
+    }
+    /* the delimiter lookup relies on CR appearing only at its start */
+    for (i = 0; i < len; i++)
+      if ((boundary[i] == '\r') || (boundary[i] == '\n')) {
+        errno = EINVAL;
+        return NULL;
+      }
+  }
+  form = sg_alloc(sizeof(struct sg__httpform) + buf_size + len + 5);
+  if (!form)
+    return NULL;
+  form->iter = iter;
+  form->kind = kind;
+  form->buf = (char *) (form + 1);
+  form->buf_size = buf_size;
+  if (kind == SG__HTTPFORM_MULTIPART) {
+    form->delim = form->buf + buf_size;
+    memcpy(form->delim, "\r\n--", 4);
+    memcpy(form->delim + 4, boundary, len);
+    form->delim_len = len + 4;
+    form->state = SG__HTTPFORM_PREAMBLE;
+    /* the first delimiter may start the body, as if it followed a CRLF */
+    form->match = 2;
+  } else
+    form->state = SG__HTTPFORM_KEY;
+  return form;
+}
+
+void sg__httpform_free(struct sg__httpform *form) {
+  sg_free(form);
+}
+
+const char *sg__httpform_find(const char *data, size_t size, const char *str,
+                              size_t len) {
+  const char *end;
+#ifdef SG__HTTPFORM_SSE2
+  __m128i first, last, eq;
+  unsigned int mask;
+  int bit;
+#endif /* SG__HTTPFORM_SSE2 */
+  if (len == 0)
+    return data;
+  if (size < len)
+    return NULL;
+  /* last position where `str` fits */
+  end = data + (size - len);
+#ifdef SG__HTTPFORM_SSE2
+  /* checks 16 positions at once by their first and last bytes, comparing the
+   * whole string only for the candidates */
+  first = _mm_set1_epi8(str[0]);
+  last = _mm_set1_epi8(str[len - 1]);
+  for (; (size_t) (end - data) >= 16; data += 16) {
+    eq = _mm_and_si128(
+      _mm_cmpeq_epi8(first, _mm_loadu_si128((const __m128i *) data)),
+      _mm_cmpeq_epi8(last,
+                     _mm_loadu_si128((const __m128i *) (data + len - 1))));
+    mask = (unsigned int) _mm_movemask_epi8(eq);
+    while (mask != 0) {
+      bit = __builtin_ctz(mask);
+      if (memcmp(data + bit, str, len) == 0)
+        return data + bit;
+      mask &= mask - 1;
+    }
+  }
+#endif /* SG__HTTPFORM_SSE2 */
+  while (data <= end) {
+    data = memchr(data, str[0], (size_t) (end - data) + 1);
+    if (!data)
+      return NULL;
+    if (memcmp(data, str, len) == 0)
+      return data;
+    data++;
+  }
+  return NULL;
+}
+
+static int sg__httpform_emit(struct sg__httpform *form, void *cls,
+                             const char *data, size_t size) {
+  if ((size == 0) || (form->state == SG__HTTPFORM_PREAMBLE) ||
+      (!form->name && !form->filename))
+    return 0;
+  if (form->iter(cls, MHD_POSTDATA_KIND, form->name, form->filename,
+                 form->mime, form->encoding, data, form->off,
+                 size) != MHD_YES)
+    return ECANCELED;
+  form->off += size;
+  return 0;
+}
+
+/* Reports the data up to the next delimiter, holding back a trailing part of
+ * it which could start the delimiter. As the delimiter has no other CR than
+ * its first byte, the held back bytes are always a prefix of it and there is
+ * no need to copy them. */
+static int sg__httpform_scan(struct sg__httpform *form, void *cls,
+                             const char *data, size_t size, size_t *used,
+                             bool *found) {
+  const char *p;
+  size_t len;
+  int errnum;
+  *found = false;
+  if (form->match > 0) {
+    len = form->delim_len - form->match;
+    if (len > size)
+      len = size;
+    if (memcmp(data, form->delim + form->match, len) == 0) {
+      form->match += len;
+      *used = len;
+      if (form->match == form->delim_len) {
+        form->match = 0;
+        *found = true;
+      }
+      return 0;
+    }
+    /* the held back bytes were data after all */
+    len = form->match;
+    form->match = 0;
+    errnum = sg__httpform_emit(form, cls, form->delim, len);
+    if (errnum != 0)
+      return errnum;
+  }
+  p = sg__httpform_find(data, size, form->delim, form->delim_len);
+  if (p) {
+    *used = (size_t) (p - data) + form->delim_len;
+    *found = true;
+    return sg__httpform_emit(form, cls, data, (size_t) (p - data));
+  }
+  *used = size;
+  len = size < form->delim_len ? size : form->delim_len - 1;
+  for (p = data + size; len > 0; len--)
+    if (*--p == '\r') {
+      len = (size_t) (data + size - p);
+      if (memcmp(p, form->delim, len) == 0)
+        form->match = len;
+      break;
+    }
+  return sg__httpform_emit(form, cls, data, size - form->match);
+}
+
+/* Parses the parameters of a `Content-Disposition` header in place. */
+static void sg__httpform_disposition(struct sg__httpform *form, char *val) {
+  const char **param;
+  char *end;
+  while ((val = strchr(val, ';'))) {
+    do
+      val++;
+    while ((*val == ' ') || (*val == '\t'));
+    if ((end = (char *) sg__httpform_prefix(val, "name=")))
+      param = &form->name;
+    else if ((end = (char *) sg__httpform_prefix(val, "filename=")))
+      param = &form->filename;
+    else
+      continue;
+    val = end;
+    if (*val == '"') {
+      end = strchr(++val, '"');
+      if (!end)
+        return;
+    } else
+      end = val + strcspn(val, "; \t");
+    *param = val;
+    if (*end == '\0')
+      return;
+    *end = '\0';
+    val = end + 1;
+  }
+}
+
+/* Parses the part headers collected in `buf`, terminating their values in
+ * place. */
+static void sg__httpform_part(struct sg__httpform *form) {
+  char *line, *next, *val, *end;
+  form->name = form->filename = form->mime = form->encoding = NULL;
+  form->buf[form->buf_len] = '\0';
+  for (line = form->buf; *line != '\0'; line = next) {
+    next = line + strcspn(line, "\r\n");
+    end = next;
+    while ((*next == '\r') || (*next == '\n'))
+      next++;
+    *end = '\0';
+    val = strchr(line, ':');
+    if (!val)
+      continue;
+    do
+      val++;
+    while ((*val == ' ') || (*val == '\t'));
+    while ((end > val) && ((end[-1] == ' ') || (end[-1] == '\t')))
+      *--end = '\0';
+    if (sg__httpform_prefix(line, "content-disposition:"))
+      sg__httpform_disposition(form, val);
+    else if (sg__httpform_prefix(line, "content-type:"))
+      form->mime = val;
+    else if (sg__httpform_prefix(line, "content-transfer-encoding:"))
+      form->encoding = val;
+  }
+  form->off = 0;
+}
+
+static int sg__httpform_headers(struct sg__httpform *form, const char *data,
+                                size_t size, size_t *used) {
+  const char *lf = memchr(data, '\n', size);
+  size_t len = lf ? (size_t) (lf - data) + 1 : size;
+  if (form->buf_len + len >= form->buf_size)
+    return EINVAL;
+  memcpy(form->buf + form->buf_len, data, len);
+  form->buf_len += len;
+  *used = len;
+  if (!lf)
+    return 0;
+  /* an empty line ends the headers */
+  len = form->buf_len - form->line;
+  if ((len == 1) || ((len == 2) && (form->buf[form->line] == '\r'))) {
+    form->buf_len = form->line;
+    sg__httpform_part(form);
+    form->state = SG__HTTPFORM_BODY;
+  } else
+    form->line = form->buf_len;
+  return 0;
+}
+
+static int sg__httpform_hex(int c) {
+  if ((c >= '0') && (c <= '9'))
+    return c - '0';
+  c = tolower(c);
+  if ((c >= 'a') && (c <= 'f'))
+    return c - 'a' + 10;
+  return -1;
+}
+
+/* Decodes `+` and `%XX` escapes, keeping the invalid ones as they are. An
+ * escape split across the data is kept in `esc`. Returns the decoded size. */
+static size_t sg__httpform_unescape(struct sg__httpform *form, char *dest,
+                                    const char *src, size_t size) {
+  char *p = dest;
+  int hi, lo;
+  for (; size > 0; src++, size--) {
+    if (form->esc_len > 0) {
+      form->esc[form->esc_len++] = *src;
+      if (form->esc_len < 3)
+        continue;
+      hi = sg__httpform_hex((unsigned char) form->esc[1]);
+      lo = sg__httpform_hex((unsigned char) form->esc[2]);
+      if ((hi == -1) || (lo == -1)) {
+        memcpy(p, form->esc, 3);
+        p += 3;
+      } else
+        *p++ = (char) ((hi << 4) | lo);
+      form->esc_len = 0;
+    } else if (*src == '%')
+      form->esc[form->esc_len++] = '%';
+    else
+      *p++ = *src == '+' ? ' ' : *src;
+  }
+  return (size_t) (p - dest);
+}
+
+static int sg__httpform_key(struct sg__httpform *form, const char *data,
+                            size_t size, size_t *used) {
+  size_t len;
+  for (len = 0; (len < size) && (data[len] != '=') && (data[len] != '&');
+       len++)
+    ;
+  /* keeps at least half of the buffer to decode the values */
+  if (form->buf_len + len >= form->buf_size / 2)
+    return EINVAL;
+  memcpy(form->buf + form->buf_len, data, len);
+  form->buf_len += len;
+  if (len == size) {
+    *used = size;
+    return 0;
+  }
+  *used = len + 1;
+  if (data[len] == '&') {
+    /* a name without value */
+    form->buf_len = 0;
+    return 0;
+  }
+  form->esc_len = 0;
+  len = sg__httpform_unescape(form, form->buf, form->buf, form->buf_len);
+  form->buf[len] = '\0';
+  form->buf_len = len + 1;
+  form->name = form->buf;
+  form->off = 0;
+  form->esc_len = 0;
+  form->state = SG__HTTPFORM_VALUE;
+  return 0;
+}
+
+static int sg__httpform_value(struct sg__httpform *form, void *cls,
+                              const char *data, size_t size, size_t *used) {
+  char *dest = form->buf + form->buf_len;
+  const char *amp = memchr(data, '&', size), *end = amp ? amp : data + size;
+  size_t len, max = form->buf_size - form->buf_len;
+  int errnum;
+  *used = amp ? (size_t) (amp - data) + 1 : size;
+  if (form->esc_len == 0) {
+    for (len = 0; (data + len < end) && (data[len] != '%') &&
+                  (data[len] != '+');
+         len++)
+      ;
+    errnum = sg__httpform_emit(form, cls, data, len);
+    if (errnum != 0)
+      return errnum;
+    data += len;
+  }
+  /* decodes the rest in pieces which fit into the buffer, even in the worst
+   * case of an invalid escape growing a piece to three bytes */
+  while (data < end) {
+    len = (size_t) (end - data);
+    if (len > max / 3)
+      len = max / 3;
+    errnum = sg__httpform_emit(form, cls, dest,
+                               sg__httpform_unescape(form, dest, data, len));
+    if (errnum != 0)
+      return errnum;
+    data += len;
+  }
+  if (!amp)
+    return 0;
+  if (form->esc_len > 0) {
+    errnum = sg__httpform_emit(form, cls, form->esc, form->esc_len);
+    if (errnum != 0)
+      return errnum;
+  }
+  form->buf_len = 0;
+  form->state = SG__HTTPFORM_KEY;
+  return 0;
+}
+
+int sg__httpform_parse(struct sg__httpform *form, void *cls, const char *data,
+                       size_t size) {
+  size_t used;
+  bool found;
+  int errnum;
+  while (size > 0) {
+    used = 1;
+    errnum = 0;
+    switch (form->state) {
+      case SG__HTTPFORM_PREAMBLE:
+      case SG__HTTPFORM_BODY:
+        errnum = sg__httpform_scan(form, cls, data, size, &used, &found);
+        if ((errnum == 0) && found)
+          form->state = SG__HTTPFORM_DELIM;
+        break;
+      case SG__HTTPFORM_DELIM:
+        if (*data == '-')
+          form->state = SG__HTTPFORM_CLOSE;
+        else if (*data == '\r')
+          form->state = SG__HTTPFORM_LF;
+        else if ((*data != ' ') && (*data != '\t'))
+          errnum = EINVAL;
+        break;
+      case SG__HTTPFORM_CLOSE:
+        if (*data == '-')
+          form->state = SG__HTTPFORM_EPILOGUE;
+        else
+          errnum = EINVAL;
+        break;
+      case SG__HTTPFORM_LF:
+        if (*data == '\n') {
+          form->buf_len = form->line = 0;
+          form->state = SG__HTTPFORM_HEADERS;
+        } else
+          errnum = EINVAL;
+        break;
+      case SG__HTTPFORM_HEADERS:
+        errnum = sg__httpform_headers(form, data, size, &used);
+        break;
+      case SG__HTTPFORM_EPILOGUE:
+        used = size;
+        break;
+      case SG__HTTPFORM_KEY:
+        errnum = sg__httpform_key(form, data, size, &used);
+        break;
+      case SG__HTTPFORM_VALUE:
+        errnum = sg__httpform_value(form, cls, data, size, &used);
+        break;
+    }
+    if (errnum != 0)
+      return errnum;
+    data += used;
+    size -= used;
+  }
+  return 0;
+}
@@ -0,0 +1,84 @@
+/*                         _
+ *   ___  __ _  __ _ _   _(_)
+ *  / __|/ _` |/ _` | | | | |
+ *  \__ \ (_| | (_| | |_| | |
+ *  |___/\__,_|\__, |\__,_|_|
+ *             |___/
+ *
+ * Cross-platform library which helps to develop web servers or frameworks.
+ *
+ * Copyright (C) 2016-2020 Silvio Clecio <silvioprog@gmail.com>
+ *
+ * Sagui library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * Sagui library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Sagui library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef SG_HTTPFORM_H
+#define SG_HTTPFORM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "sg_macros.h"
+#include "microhttpd.h"
+
+enum sg__httpform_kind {
+  SG__HTTPFORM_NONE,
+  SG__HTTPFORM_URLENCODED,
+  SG__HTTPFORM_MULTIPART
+};
+
+/* Streaming parser for `application/x-www-form-urlencoded` and
+ * `multipart/form-data` bodies, reporting the fields to a
+ * `MHD_PostDataIterator` like MHD's post processor does. Values which need
+ * no decoding (e.g. the file parts) are reported as slices of the parsed
+ * data, without copying them. `buf` (`buf_size` bytes) holds the headers of
+ * the current part, or the name of the current field followed by the
+ * scratch area for its percent-decoded value. `delim` is the multipart
+ * delimiter, `CRLF--boundary`, of which `match` bytes have been seen at the
+ * end of the previous data. */
+struct sg__httpform {
+  MHD_PostDataIterator iter;
+  enum sg__httpform_kind kind;
+  int state;
+  char *buf;
+  size_t buf_size;
+  size_t buf_len;
+  size_t line;
+  char *delim;
+  size_t delim_len;
+  size_t match;
+  const char *name;
+  const char *filename;
+  const char *mime;
+  const char *encoding;
+  uint64_t off;
+  char esc[3];
+  size_t esc_len;
+};
+
+SG__EXTERN enum sg__httpform_kind sg__httpform_kind(const char *type);
+
+SG__EXTERN struct sg__httpform *sg__httpform_new(const char *type,
+                                                 size_t buf_size,
+                                                 MHD_PostDataIterator iter);
+
+SG__EXTERN void sg__httpform_free(struct sg__httpform *form);
+
+SG__EXTERN int sg__httpform_parse(struct sg__httpform *form, void *cls,
+                                  const char *data, size_t size);
+
+SG__EXTERN const char *sg__httpform_find(const char *data, size_t size,
+                                         const char *str, size_t len);
+
+#endif /* SG_HTTPFORM_H */
@@ -24,16 +24,25 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include <string.h>
 #include <errno.h>
 #include <pthread.h>
 #include "sg_macros.h"
 #include "microhttpd.h"
 #include "sagui.h"
 #include "sg_extra.h"
+#include "sg_strmap.h"
+#ifdef SG_HTTP_COMPRESSION
+#include "sg_httpcomp.h"
+#endif /* SG_HTTP_COMPRESSION */
 #include "sg_httpreq.h"
 #include "sg_httpres.h"
 #include "sg_httpauth.h"
 #include "sg_httpsrv.h"
+#include "sg_digest.h"
+#ifdef SG_HTTP_WEBSOCKET
+#include "sg_httpws.h"
+#endif /* SG_HTTP_WEBSOCKET */
 
 static void *sg__httpreq_isolate_cb(void *cls) {
   struct sg__httpreq_isolated *isolated = cls;
@@ -56,6 +65,10 @@ struct sg_httpreq *sg__httpreq_new(struct sg_httpsrv *srv,
   req->res = sg__httpres_new(con);
   if (!req->res)
     goto error;
+  req->res->hdrs = srv->hdrs;
+#ifdef SG_HTTP_COMPRESSION
+  req->res->zpool = srv->zpool;
+#endif /* SG_HTTP_COMPRESSION */
   req->auth = sg__httpauth_new(req->res);
   if (!req->auth)
     goto error;
@@ -84,9 +97,17 @@ void sg__httpreq_free(struct sg_httpreq *req) {
   sg_strmap_cleanup(&req->params);
   sg_strmap_cleanup(&req->fields);
   sg_str_free(req->payload);
-  MHD_destroy_post_processor(req->pp);
+  sg_rope_free(req->chunks);
+  sg_free(req->payld_digest);
+  sg__httpform_free(req->form);
+#ifdef SG_HTTP_COMPRESSION
+  sg__httpuplds_zfree(req->zbody);
+#endif /* SG_HTTP_COMPRESSION */
   sg__httpres_free(req->res);
   sg__httpauth_free(req->auth);
+#ifdef SG_HTTP_WEBSOCKET
+  sg__httpws_free(req->ws);
+#endif /* SG_HTTP_WEBSOCKET */
   sg_free(req);
 }
 
@@ -130,6 +151,91 @@ struct sg_strmap **sg_httpreq_params(struct sg_httpreq *req) {
   return &req->params;
 }
 
+static const char *sg__httpreq_value(struct sg_httpreq *req,
+                                     enum MHD_ValueKind kind,
+                                     const char *name) {
+  if (!req || !name) {
+    errno = EINVAL;
+    return NULL;
+  }
+  return MHD_lookup_connection_value(req->con, kind, name);
+}
+
+const char *sg_httpreq_header(struct sg_httpreq *req, const char *name) {
+  return sg__httpreq_value(req, MHD_HEADER_KIND, name);
+}
+
+static enum MHD_Result sg__httpreq_find_cb(void *cls,
+                                           __SG_UNUSED enum MHD_ValueKind kind,
+                                           const char *key, const char *val) {
+  struct sg__httpreq_find_holder *holder = cls;
+  if (!key || (strlen(key) != holder->len) ||
+      (sg__strmap_keycmp(key, holder->name, holder->len) != 0))
+    return MHD_YES;
+  holder->val = val;
+  return MHD_NO;
+}
+
+/* Scans the values ignoring the case of the name, as the maps do, since MHD
+ * only looks the cookies and the parameters up case-sensitively. */
+static const char *sg__httpreq_find(struct sg_httpreq *req,
+                                    enum MHD_ValueKind kind,
+                                    const char *name) {
+  struct sg__httpreq_find_holder holder;
+  if (!req || !name) {
+    errno = EINVAL;
+    return NULL;
+  }
+  holder.name = name;
+  holder.len = strlen(name);
+  holder.val = NULL;
+  MHD_get_connection_values(req->con, kind, sg__httpreq_find_cb, &holder);
+  return holder.val;
+}
+
+const char *sg_httpreq_cookie(struct sg_httpreq *req, const char *name) {
+  return sg__httpreq_find(req, MHD_COOKIE_KIND, name);
+}
+
+const char *sg_httpreq_param(struct sg_httpreq *req, const char *name) {
+  return sg__httpreq_find(req, MHD_GET_ARGUMENT_KIND, name);
+}
+
+static enum MHD_Result sg__httpreq_iter_cb(void *cls,
+                                           __SG_UNUSED enum MHD_ValueKind kind,
+                                           const char *key, const char *val) {
+  struct sg__httpreq_iter_holder *holder = cls;
+  holder->ret = holder->cb(holder->cls, key, val);
+  return holder->ret == 0 ? MHD_YES : MHD_NO;
+}
+
+static int sg__httpreq_iter(struct sg_httpreq *req, enum MHD_ValueKind kind,
+                            sg_httpreq_iter_cb cb, void *cls) {
+  struct sg__httpreq_iter_holder holder;
+  if (!req || !cb)
+    return EINVAL;
+  holder.cb = cb;
+  holder.cls = cls;
+  holder.ret = 0;
+  MHD_get_connection_values(req->con, kind, sg__httpreq_iter_cb, &holder);
+  return holder.ret;
+}
+
+int sg_httpreq_headers_iter(struct sg_httpreq *req, sg_httpreq_iter_cb cb,
+                            void *cls) {
+  return sg__httpreq_iter(req, MHD_HEADER_KIND, cb, cls);
+}
+
+int sg_httpreq_cookies_iter(struct sg_httpreq *req, sg_httpreq_iter_cb cb,
+                            void *cls) {
+  return sg__httpreq_iter(req, MHD_COOKIE_KIND, cb, cls);
+}
+
+int sg_httpreq_params_iter(struct sg_httpreq *req, sg_httpreq_iter_cb cb,
+                           void *cls) {
+  return sg__httpreq_iter(req, MHD_GET_ARGUMENT_KIND, cb, cls);
+}
+
 struct sg_strmap **sg_httpreq_fields(struct sg_httpreq *req) {
   if (req)
     return &req->fields;
@@ -165,6 +271,29 @@ struct sg_str *sg_httpreq_payload(struct sg_httpreq *req) {
   return NULL;
 }
 
+const char *sg_httpreq_digest(struct sg_httpreq *req, enum sg_digest algo) {
+  unsigned int algos = 0;
+  if (!req || ((algo != SG_DIGEST_CRC32C) && (algo != SG_DIGEST_SHA256))) {
+    errno = EINVAL;
+    return NULL;
+  }
+  if (req->payld_digest)
+    algos = req->payld_digest->algos;
+  else {
+    req->payld_digest = sg_malloc(sizeof(struct sg__digest));
+    if (!req->payld_digest)
+      return NULL;
+  }
+  if (!(algos & (unsigned int) algo)) {
+    /* only the requested algorithms are computed, so asking for another one
+     * hashes the payload again */
+    sg__digest_init(req->payld_digest, algos | (unsigned int) algo);
+    sg__digest_update(req->payld_digest, sg_str_content(req->payload),
+                      sg_str_length(req->payload));
+  }
+  return sg__digest_hex(req->payld_digest, algo);
+}
+
 bool sg_httpreq_is_uploading(struct sg_httpreq *req) {
   if (req)
     return req->is_uploading;
@@ -205,6 +334,18 @@ void *sg_httpreq_tls_session(struct sg_httpreq *req) {
 
 #endif /* SG_HTTPS_SUPPORT */
 
+#ifdef SG_HTTP_COMPRESSION
+
+const char *sg_httpreq_zencoding(struct sg_httpreq *req) {
+  if (req)
+    return sg__httpcomp_negotiate(MHD_lookup_connection_value(
+      req->con, MHD_HEADER_KIND, MHD_HTTP_HEADER_ACCEPT_ENCODING));
+  errno = EINVAL;
+  return NULL;
+}
+
+#endif /* SG_HTTP_COMPRESSION */
+
 int sg_httpreq_isolate(struct sg_httpreq *req, sg_httpreq_cb cb, void *cls) {
   struct sg__httpreq_isolated *isolated;
   int errnum = 0;
@@ -238,6 +379,31 @@ error:
   return errnum;
 }
 
+int sg_httpreq_set_body_cb(struct sg_httpreq *req, sg_httpreq_body_cb cb,
+                           void *cls) {
+  if (!req || !cb)
+    return EINVAL;
+  if (req->is_uploading)
+    return EALREADY;
+  req->body_cb = cb;
+  req->body_cls = cls;
+  return 0;
+}
+
+int sg_httpreq_resume_body(struct sg_httpreq *req) {
+  if (!req)
+    return EINVAL;
+  sg__httpsrv_lock(req->srv);
+  if (req->body_paused) {
+    req->body_paused = false;
+    MHD_resume_connection(req->con);
+  } else if (req->body_sinking)
+    /* the sink has not returned yet, so it must not pause */
+    req->body_resumed = true;
+  sg__httpsrv_unlock(req->srv);
+  return 0;
+}
+
 int sg_httpreq_set_user_data(struct sg_httpreq *req, void *data) {
   if (!req)
     return EINVAL;
@@ -33,13 +33,14 @@
 #include "microhttpd.h"
 #include "sagui.h"
 #include "sg_httpuplds.h"
+#include "sg_httpform.h"
 #include "sg_httpres.h"
 #include "sg_httpsrv.h"
 
 struct sg_httpreq {
   struct sg_httpsrv *srv;
   struct MHD_Connection *con;
-  struct MHD_PostProcessor *pp;
+  struct sg__httpform *form;
   struct sg_httpauth *auth;
   struct sg_httpres *res;
   struct sg_httpupld *uplds;
@@ -50,6 +51,10 @@ struct sg_httpreq {
   struct sg_strmap *params;
   struct sg_strmap *fields;
   struct sg_str *payload;
+  struct sg_rope *chunks;
+  struct sg__digest *payld_digest;
+  sg_httpreq_body_cb body_cb;
+  void *body_cls;
   const char *version;
   const char *method;
   const char *path;
@@ -57,7 +62,33 @@ struct sg_httpreq {
   uint64_t total_uplds_size;
   size_t total_fields_size;
   bool is_uploading;
+  bool sized;
   bool isolated;
+  bool body_paused;
+  bool body_sinking;
+  bool body_resumed;
+#ifdef SG_HTTP_UPLD_URING
+  bool upld_paused;
+#endif /* SG_HTTP_UPLD_URING */
+#ifdef SG_HTTP_COMPRESSION
+  struct sg__httpuplds_zbody *zbody;
+  int zbits;
+#endif /* SG_HTTP_COMPRESSION */
+#ifdef SG_HTTP_WEBSOCKET
+  struct sg_httpws *ws;
+#endif /* SG_HTTP_WEBSOCKET */
+};
+
+struct sg__httpreq_iter_holder {
+  sg_httpreq_iter_cb cb;
+  void *cls;
+  int ret;
+};
+
+struct sg__httpreq_find_holder {
+  const char *name;
+  size_t len;
+  const char *val;
 };
 
 struct sg__httpreq_isolated {
@@ -29,21 +29,28 @@
 #include <stdint.h>
 #include <string.h>
 #include <errno.h>
+#include <time.h>
 #include <fcntl.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
+#include <pthread.h>
 #include "sg_macros.h"
 #ifdef SG_HTTP_COMPRESSION
 #include "zlib.h"
 #endif /* SG_HTTP_COMPRESSION */
 #include "microhttpd.h"
 #include "sagui.h"
+#include "utlist.h"
 #include "sg_utils.h"
 #include "sg_strmap.h"
 #include "sg_extra.h"
 #include "sg_httpres.h"
 
+static pthread_mutex_t sg__httpres_date_mutex = PTHREAD_MUTEX_INITIALIZER;
+static time_t sg__httpres_date_time = (time_t) -1;
+static char sg__httpres_date_str[SG__HTTPRES_DATE_SIZE + 1];
+
 static void sg__httpres_openfile(struct sg_httpres *res, const char *filename,
                                  const char *disposition, uint64_t max_size,
                                  int *fd, struct stat *sbuf, int *errnum) {
@@ -110,170 +117,563 @@ error:
 static ssize_t sg__httpres_zread_cb(void *handle, __SG_UNUSED uint64_t offset,
                                     char *mem, size_t size) {
   struct sg__httpres_zholder *holder = handle;
-  z_size_t have;
-  int flush;
-  if (holder->status == SG__HTTPRES_ZFINISHED)
-    return MHD_CONTENT_READER_END_OF_STREAM;
-  if (holder->status != SG__HTTPRES_ZWRITING) {
-    have =
-      (z_size_t) holder->read_cb(holder->handle, holder->offset_in, mem, size);
-    if (have == (z_size_t) MHD_CONTENT_READER_END_WITH_ERROR)
+  ssize_t have;
+  size_t len;
+  while (holder->offset_out == holder->buf_out.size) {
+    holder->buf_out.size = 0;
+    holder->offset_out = 0;
+    if (holder->status == SG__HTTPRES_ZFINISHED)
+      return MHD_CONTENT_READER_END_OF_STREAM;
+    len = SG__ZLIB_CHUNK;
+    if ((holder->size_in > 0) &&
+        ((holder->size_in - holder->offset_in) < (uint64_t) len))
+      len = (size_t) (holder->size_in - holder->offset_in);
+    have = len > 0 ? holder->read_cb(holder->handle, holder->offset_in,
+                                     holder->buf_in, len) :
+                     MHD_CONTENT_READER_END_OF_STREAM;
+    if (have == MHD_CONTENT_READER_END_WITH_ERROR)
       return MHD_CONTENT_READER_END_WITH_ERROR;
-    if (have == (z_size_t) MHD_CONTENT_READER_END_OF_STREAM) {
+    if (have == MHD_CONTENT_READER_END_OF_STREAM) {
       holder->status = SG__HTTPRES_ZFINISHED;
-      have = 0;
-      flush = Z_FINISH;
-    } else {
-      holder->offset_in += have;
-      if ((holder->size_in > 0) && (holder->offset_in > holder->size_in)) {
-        holder->status = SG__HTTPRES_ZFINISHED;
-        holder->offset_in -= have;
-        have = 0;
-        flush = Z_FINISH;
-      } else
-        flush = Z_NO_FLUSH;
+      if (holder->comp->finish(holder->ctx, &holder->buf_out) != 0)
+        return MHD_CONTENT_READER_END_WITH_ERROR;
+      continue;
     }
-    if (sg__zdeflate(&holder->stream, holder->buf_in, flush, (Bytef *) mem,
-                     (uInt) have, &holder->buf_out, &have) != 0)
-      return MHD_CONTENT_READER_END_WITH_ERROR;
-    if (have > size) {
-      holder->status = SG__HTTPRES_ZWRITING;
-      holder->size_out = have;
-      holder->offset_out = 0;
+    if (have == 0)
       return 0;
-    } else
-      memcpy(mem, holder->buf_out, have);
-  } else {
-    have = size;
-    holder->offset_out += have;
-    if (holder->offset_out >= holder->size_out) {
-      holder->status = SG__HTTPRES_ZPROCESSING;
-      if (holder->offset_out > holder->size_out) {
-        holder->offset_out -= have;
-        have = holder->size_out - holder->offset_out;
-        memcpy(mem, holder->buf_out + holder->offset_out, have);
-        goto done;
-      }
-    }
-    memcpy(mem, holder->buf_out + (holder->offset_out - have), have);
+    holder->offset_in += (uint64_t) have;
+    if (holder->comp->encode(holder->ctx, holder->buf_in, (size_t) have,
+                             &holder->buf_out) != 0)
+      return MHD_CONTENT_READER_END_WITH_ERROR;
   }
-done:
-  if (holder->status != SG__HTTPRES_ZWRITING)
-    sg_free(holder->buf_out);
-  return have;
+  len = holder->buf_out.size - holder->offset_out;
+  if (len > size)
+    len = size;
+  memcpy(mem, holder->buf_out.data + holder->offset_out, len);
+  holder->offset_out += len;
+  return (ssize_t) len;
 }
 
 static void sg__httpres_zfree_cb(void *handle) {
   struct sg__httpres_zholder *holder = handle;
   if (!holder)
     return;
-  deflateEnd(&holder->stream);
+  holder->comp->free(holder->ctx);
+  sg__httpcomp_buf_free(&holder->buf_out);
   sg_free(holder->buf_in);
   if (holder->free_cb)
     holder->free_cb(holder->handle);
   sg_free(holder);
 }
 
-static ssize_t sg__httpres_gzread_cb(void *handle, __SG_UNUSED uint64_t offset,
-                                     char *mem, size_t size) {
-  struct sg__httpres_gzholder *holder = handle;
-  z_size_t have;
-  int flush;
-  if (holder->status == SG__HTTPRES_GZNONE) {
-    holder->status = SG__HTTPRES_GZPROCESSING;
-    mem[0] = (char) 0x1f;
-    mem[1] = (char) 0x8b;
-    mem[2] = (char) 0x08;
-    mem[3] = (char) 0x00;
-    mem[4] = (char) 0x00;
-    mem[5] = (char) 0x00;
-    mem[6] = (char) 0x00;
-    mem[7] = (char) 0x00;
-    mem[8] = (char) 0x00;
-#ifdef _WIN32
-    mem[9] = (char) 0x0b;
-#else /* _WIN32 */
-    mem[9] = (char) 0x03;
-#endif /* _WIN32 */
-    holder->crc = crc32(0L, Z_NULL, 0);
-    return 10;
-  }
-  if (holder->status == SG__HTTPRES_GZFINISHING) {
-    holder->status = SG__HTTPRES_GZFINISHED;
-    mem[0] = (char) (holder->crc & 0xff);
-    mem[1] = (char) ((holder->crc >> 8) & 0xff);
-    mem[2] = (char) ((holder->crc >> 16) & 0xff);
-    mem[3] = (char) ((holder->crc >> 24) & 0xff);
-    mem[4] = (char) ((holder->offset_in) & 0xff);
-    mem[5] = (char) ((holder->offset_in >> 8) & 0xff);
-    mem[6] = (char) ((holder->offset_in >> 16) & 0xff);
-    mem[7] = (char) ((holder->offset_in >> 24) & 0xff);
-    return 8;
-  }
-  if (holder->status == SG__HTTPRES_GZFINISHED)
-    return MHD_CONTENT_READER_END_OF_STREAM;
-  if (holder->status != SG__HTTPRES_GZWRITING) {
-    have = (size_t) read(*holder->handle, mem, size);
-    if ((ssize_t) have < 0)
-      return MHD_CONTENT_READER_END_WITH_ERROR;
+static ssize_t sg__httpres_zfdread_cb(void *handle, __SG_UNUSED uint64_t offset,
+                                      char *buf, size_t size) {
+  const ssize_t have = read(*(int *) handle, buf, size);
+  if (have < 0)
+    return MHD_CONTENT_READER_END_WITH_ERROR;
+  return have > 0 ? have : MHD_CONTENT_READER_END_OF_STREAM;
+}
+
+static void sg__httpres_zfdfree_cb(void *handle) {
+  close(*(int *) handle);
+  sg_free(handle);
+}
+
+static int sg__httpres_zsend(struct sg_httpres *res,
+                             const struct sg__httpcomp *comp, int level,
+                             uint64_t size, sg_read_cb read_cb, void *handle,
+                             sg_free_cb free_cb, unsigned int status) {
+  struct sg__httpres_zholder *holder;
+  int errnum;
+  holder = sg_alloc(sizeof(struct sg__httpres_zholder));
+  if (!holder) {
+    errnum = ENOMEM;
+    goto error;
+  }
+  errnum =
+    comp->init(&holder->ctx, (level == -1) ? comp->def_level : level);
+  if (errnum != 0)
+    goto error_ctx;
+  holder->buf_in = sg_malloc(SG__ZLIB_CHUNK);
+  if (!holder->buf_in) {
+    errnum = ENOMEM;
+    goto error_buf_in;
+  }
+  errnum = sg_strmap_set(&res->headers, MHD_HTTP_HEADER_CONTENT_ENCODING,
+                         comp->token);
+  if (errnum != 0)
+    goto error_res;
+  holder->comp = comp;
+  holder->read_cb = read_cb;
+  holder->free_cb = free_cb;
+  holder->handle = handle;
+  holder->size_in = size;
+  res->handle = MHD_create_response_from_callback(
+    MHD_SIZE_UNKNOWN, SG__BLOCK_SIZE, sg__httpres_zread_cb, holder,
+    sg__httpres_zfree_cb);
+  if (!res->handle) {
+    errnum = ENOMEM;
+    goto error_res;
+  }
+  res->status = status;
+#ifdef SG_TESTING
+  errnum = 0;
+#else /* SG_TESTING */
+  return 0;
+#endif /* SG_TESTING */
+error_res:
+  sg_free(holder->buf_in);
+error_buf_in:
+  comp->free(holder->ctx);
+error_ctx:
+  sg_free(holder);
+error:
+  if (free_cb)
+    free_cb(handle);
+  return errnum;
+}
+
+/* Queues the holder in its pool while it has blocks left and free slots. Must
+ * be called locked. */
+static void sg__httpres_zpqueue(struct sg__httpres_zpholder *holder) {
+  if (holder->queued || (holder->seq_read == holder->blocks) ||
+      ((holder->seq_read - holder->seq_emit) >= holder->slots_count))
+    return;
+  DL_APPEND(holder->pool->queue, holder);
+  holder->queued = true;
+  pthread_cond_signal(&holder->pool->cond);
+}
+
+/* Reads the block `seq` of the file into `slot`, preceded by the tail of the
+ * previous block as dictionary. Positioned reads let the workers of a
+ * response read concurrently. */
+static void sg__httpres_zpread(struct sg__httpres_zpholder *holder,
+                               struct sg__httpres_zpslot *slot, uint64_t seq) {
+  uint64_t offset = seq * SG__HTTPRES_ZPAR_BLOCK_SIZE;
+  Bytef *in;
+  size_t len, size = 0;
+  ssize_t have;
+  slot->dict_size = seq > 0 ? SG__HTTPRES_ZPAR_DICT_SIZE : 0;
+  slot->in_size = SG__HTTPRES_ZPAR_BLOCK_SIZE;
+  if ((holder->size_in - offset) < (uint64_t) slot->in_size)
+    slot->in_size = (size_t) (holder->size_in - offset);
+  slot->last = seq == (holder->blocks - 1);
+  slot->errnum = 0;
+  in = slot->in + SG__HTTPRES_ZPAR_DICT_SIZE - slot->dict_size;
+  len = slot->dict_size + slot->in_size;
+  offset += holder->offset_in - slot->dict_size;
+  while (size < len) {
+    have = sg__pread(holder->fd, in + size, len - size,
+                     (sg__off_t) (offset + size));
+    if (have < 0) {
+      slot->errnum = errno;
+      break;
+    }
     if (have == 0) {
-      holder->status = SG__HTTPRES_GZFINISHING;
-      flush = Z_FINISH;
-    } else {
-      holder->offset_in += have;
-      if ((holder->size_in > 0) && (holder->offset_in > holder->size_in)) {
-        holder->status = SG__HTTPRES_GZFINISHING;
-        holder->offset_in -= have;
-        have = 0;
-        flush = Z_FINISH;
-      } else {
-        holder->crc = crc32(holder->crc, (z_const Bytef *) mem, (uInt) have);
-        flush = Z_NO_FLUSH;
-      }
+      /* the file was truncated while being sent */
+      slot->errnum = EIO;
+      break;
     }
-    if (sg__zdeflate(&holder->stream, holder->buf_in, flush, (Bytef *) mem,
-                     (uInt) have, &holder->buf_out, &have) != 0)
-      return MHD_CONTENT_READER_END_WITH_ERROR;
-    if (have > size) {
-      holder->status = SG__HTTPRES_GZWRITING;
-      holder->size_out = have;
-      holder->offset_out = 0;
-      return 0;
-    } else
-      memcpy(mem, holder->buf_out, have);
+    size += (size_t) have;
+  }
+}
+
+static int sg__httpres_zpdeflate(struct sg__httpres_zpworker *worker,
+                                 int level, struct sg__httpres_zpslot *slot) {
+  z_stream *stream = &worker->stream;
+  uInt have;
+  int errnum;
+  if (worker->ready && (worker->level == level)) {
+    if (deflateReset(stream) != Z_OK)
+      return EIO;
   } else {
-    have = size;
-    holder->offset_out += have;
-    if (holder->offset_out >= holder->size_out) {
-      holder->status = SG__HTTPRES_GZPROCESSING;
-      if (holder->offset_out > holder->size_out) {
-        holder->offset_out -= have;
-        have = holder->size_out - holder->offset_out;
-        memcpy(mem, holder->buf_out + holder->offset_out, have);
-        goto done;
-      }
+    /* the workers serve responses of any level */
+    if (worker->ready)
+      deflateEnd(stream);
+    worker->ready = false;
+    if (deflateInit2(stream, level, Z_DEFLATED, -MAX_WBITS, 8,
+                     Z_DEFAULT_STRATEGY) != Z_OK)
+      return ENOMEM;
+    worker->level = level;
+    worker->ready = true;
+  }
+  if ((slot->dict_size > 0) &&
+      (deflateSetDictionary(stream,
+                            slot->in + SG__HTTPRES_ZPAR_DICT_SIZE -
+                              slot->dict_size,
+                            (uInt) slot->dict_size) != Z_OK))
+    return EIO;
+  slot->out.size = 0;
+  slot->offset_out = 0;
+  if (sg__httpcomp_buf_grow(&slot->out,
+                            deflateBound(stream, (uLong) slot->in_size)) != 0)
+    return ENOMEM;
+  stream->next_in = slot->in + SG__HTTPRES_ZPAR_DICT_SIZE;
+  stream->avail_in = (uInt) slot->in_size;
+  do {
+    if (sg__httpcomp_buf_grow(&slot->out, SG__ZLIB_CHUNK) != 0)
+      return ENOMEM;
+    have = (uInt) (slot->out.cap - slot->out.size);
+    stream->next_out = (Bytef *) slot->out.data + slot->out.size;
+    stream->avail_out = have;
+    /* blocks are byte-aligned by a sync flush, so they can be concatenated */
+    errnum = deflate(stream, slot->last ? Z_FINISH : Z_SYNC_FLUSH);
+    if (errnum == Z_STREAM_ERROR)
+      return EIO;
+    slot->out.size += have - stream->avail_out;
+  } while (stream->avail_out == 0);
+  slot->crc = crc32(crc32(0L, Z_NULL, 0), slot->in + SG__HTTPRES_ZPAR_DICT_SIZE,
+                    (uInt) slot->in_size);
+  return 0;
+}
+
+static void *sg__httpres_zpworker_cb(void *cls) {
+  struct sg__httpres_zpworker *worker = cls;
+  struct sg__httpres_zpool *pool = worker->pool;
+  struct sg__httpres_zpholder *holder;
+  struct sg__httpres_zpslot *slot;
+  uint64_t seq;
+  pthread_mutex_lock(&pool->mutex);
+  for (;;) {
+    while (!pool->stop && !pool->queue)
+      pthread_cond_wait(&pool->cond, &pool->mutex);
+    if (pool->stop)
+      break;
+    holder = pool->queue;
+    seq = holder->seq_read++;
+    slot = &holder->slots[seq % holder->slots_count];
+    slot->state = SG__HTTPRES_ZPBUSY;
+    holder->busy++;
+    /* requeued at the tail, so concurrent responses take turns */
+    DL_DELETE(pool->queue, holder);
+    holder->queued = false;
+    sg__httpres_zpqueue(holder);
+    pthread_mutex_unlock(&pool->mutex);
+    sg__httpres_zpread(holder, slot, seq);
+    if (slot->errnum == 0)
+      slot->errnum = sg__httpres_zpdeflate(worker, holder->level, slot);
+    pthread_mutex_lock(&pool->mutex);
+    slot->state = SG__HTTPRES_ZPDONE;
+    holder->busy--;
+    if (holder->suspended && (seq == holder->seq_emit)) {
+      holder->suspended = false;
+      MHD_resume_connection(holder->con);
     }
-    memcpy(mem, holder->buf_out + (holder->offset_out - have), have);
+    pthread_cond_broadcast(&holder->cond);
   }
-done:
-  if (holder->status != SG__HTTPRES_GZWRITING)
-    sg_free(holder->buf_out);
-  return have;
+  pthread_mutex_unlock(&pool->mutex);
+  return NULL;
 }
 
-static void sg__httpres_gzfree_cb(void *handle) {
-  struct sg__httpres_gzholder *holder = handle;
+static ssize_t sg__httpres_zpread_cb(void *handle, __SG_UNUSED uint64_t offset,
+                                     char *mem, size_t size) {
+  struct sg__httpres_zpholder *holder = handle;
+  struct sg__httpres_zpslot *slot;
+  size_t len;
+  switch (holder->status) {
+    case SG__HTTPRES_ZPHEADER:
+      if (size < 10)
+        return 0;
+      holder->status = SG__HTTPRES_ZPDATA;
+      memset(mem, 0, 10);
+      mem[0] = (char) 0x1f;
+      mem[1] = (char) 0x8b;
+      mem[2] = (char) 0x08;
+#ifdef _WIN32
+      mem[9] = (char) 0x0b;
+#else /* _WIN32 */
+      mem[9] = (char) 0x03;
+#endif /* _WIN32 */
+      return 10;
+    case SG__HTTPRES_ZPTRAILER:
+      if (size < 8)
+        return 0;
+      holder->status = SG__HTTPRES_ZPFINISHED;
+      mem[0] = (char) (holder->crc & 0xff);
+      mem[1] = (char) ((holder->crc >> 8) & 0xff);
+      mem[2] = (char) ((holder->crc >> 16) & 0xff);
+      mem[3] = (char) ((holder->crc >> 24) & 0xff);
+      mem[4] = (char) (holder->total_in & 0xff);
+      mem[5] = (char) ((holder->total_in >> 8) & 0xff);
+      mem[6] = (char) ((holder->total_in >> 16) & 0xff);
+      mem[7] = (char) ((holder->total_in >> 24) & 0xff);
+      return 8;
+    case SG__HTTPRES_ZPFINISHED:
+      return MHD_CONTENT_READER_END_OF_STREAM;
+    default:
+      break;
+  }
+  slot = &holder->slots[holder->seq_emit % holder->slots_count];
+  pthread_mutex_lock(&holder->pool->mutex);
+  if (slot->state != SG__HTTPRES_ZPDONE) {
+    /* parks the connection instead of blocking the MHD thread, until the
+     * worker compressing the block resumes it */
+    holder->suspended = true;
+    MHD_suspend_connection(holder->con);
+    pthread_mutex_unlock(&holder->pool->mutex);
+    return 0;
+  }
+  pthread_mutex_unlock(&holder->pool->mutex);
+  if (slot->errnum != 0)
+    return MHD_CONTENT_READER_END_WITH_ERROR;
+  len = slot->out.size - slot->offset_out;
+  if (len > size)
+    len = size;
+  memcpy(mem, slot->out.data + slot->offset_out, len);
+  slot->offset_out += len;
+  if (slot->offset_out == slot->out.size) {
+    holder->crc =
+      crc32_combine(holder->crc, slot->crc, (z_off_t) slot->in_size);
+    holder->total_in += slot->in_size;
+    if (slot->last)
+      holder->status = SG__HTTPRES_ZPTRAILER;
+    pthread_mutex_lock(&holder->pool->mutex);
+    slot->state = SG__HTTPRES_ZPEMPTY;
+    holder->seq_emit++;
+    sg__httpres_zpqueue(holder);
+    pthread_mutex_unlock(&holder->pool->mutex);
+  }
+  return (ssize_t) len;
+}
+
+static void sg__httpres_zpfree_cb(void *handle) {
+  struct sg__httpres_zpholder *holder = handle;
+  unsigned int i;
   if (!holder)
     return;
-  deflateEnd(&holder->stream);
-  sg_free(holder->buf_in);
-  close(*holder->handle);
-  sg_free(holder->handle);
+  pthread_mutex_lock(&holder->pool->mutex);
+  if (holder->queued)
+    DL_DELETE(holder->pool->queue, holder);
+  holder->queued = false;
+  /* waits for the blocks still being compressed */
+  while (holder->busy > 0)
+    pthread_cond_wait(&holder->cond, &holder->pool->mutex);
+  pthread_mutex_unlock(&holder->pool->mutex);
+  for (i = 0; i < holder->slots_count; i++) {
+    sg_free(holder->slots[i].in);
+    sg__httpcomp_buf_free(&holder->slots[i].out);
+  }
+  sg_free(holder->slots);
+  pthread_cond_destroy(&holder->cond);
+  close(holder->fd);
   sg_free(holder);
 }
 
+/* Creates the parallel gzip holder for `size` bytes of `fd` starting at
+ * `offset`, taking ownership of `fd`, which is closed on failure. */
+static int sg__httpres_zpholder_new(struct sg__httpres_zpholder **holder,
+                                    struct sg__httpres_zpool *pool,
+                                    struct MHD_Connection *con, int fd,
+                                    int level, uint64_t offset,
+                                    uint64_t size) {
+  struct sg__httpres_zpholder *h;
+  uint64_t count;
+  h = sg_alloc(sizeof(struct sg__httpres_zpholder));
+  if (!h) {
+    close(fd);
+    return ENOMEM;
+  }
+  h->pool = pool;
+  h->con = con;
+  h->fd = fd;
+  h->level = level;
+  h->offset_in = offset;
+  h->size_in = size;
+  h->blocks = size > 0 ? ((size - 1) / SG__HTTPRES_ZPAR_BLOCK_SIZE) + 1 : 1;
+  h->crc = crc32(0L, Z_NULL, 0);
+  pthread_cond_init(&h->cond, NULL);
+  /* read-ahead is bounded to two blocks per worker */
+  count = (uint64_t) pool->workers_count * 2;
+  if (count > h->blocks)
+    count = h->blocks;
+  h->slots = sg_alloc(sizeof(struct sg__httpres_zpslot) * (size_t) count);
+  if (!h->slots)
+    goto error;
+  for (h->slots_count = 0; h->slots_count < count; h->slots_count++) {
+    h->slots[h->slots_count].in =
+      sg_malloc(SG__HTTPRES_ZPAR_DICT_SIZE + SG__HTTPRES_ZPAR_BLOCK_SIZE);
+    if (!h->slots[h->slots_count].in)
+      goto error;
+  }
+  pthread_mutex_lock(&pool->mutex);
+  sg__httpres_zpqueue(h);
+  pthread_mutex_unlock(&pool->mutex);
+  *holder = h;
+  return 0;
+error:
+  sg__httpres_zpfree_cb(h);
+  return ENOMEM;
+}
+
+static int sg__httpres_zpsend(struct sg_httpres *res, int fd, int level,
+                              uint64_t offset, uint64_t size,
+                              unsigned int status) {
+  struct sg__httpres_zpholder *holder;
+  int errnum;
+  errnum = sg__httpres_zpholder_new(&holder, res->zpool, res->con, fd, level,
+                                    offset, size);
+  if (errnum != 0)
+    return errnum;
+  errnum =
+    sg_strmap_set(&res->headers, MHD_HTTP_HEADER_CONTENT_ENCODING, "gzip");
+  if (errnum != 0)
+    goto error;
+  res->handle = MHD_create_response_from_callback(
+    MHD_SIZE_UNKNOWN, SG__BLOCK_SIZE, sg__httpres_zpread_cb, holder,
+    sg__httpres_zpfree_cb);
+  if (!res->handle) {
+    errnum = ENOMEM;
+    goto error;
+  }
+  res->status = status;
+#ifdef SG_TESTING
+  errnum = 0;
+#else /* SG_TESTING */
+  return 0;
+#endif /* SG_TESTING */
+error:
+  sg__httpres_zpfree_cb(holder);
+  return errnum;
+}
+
+struct sg__httpres_zpool *sg__httpres_zpool_new(unsigned int size) {
+  struct sg__httpres_zpool *pool;
+  struct sg__httpres_zpworker *worker;
+  int errnum;
+  pool = sg_alloc(sizeof(struct sg__httpres_zpool));
+  if (!pool)
+    return NULL;
+  pool->workers = sg_alloc(sizeof(struct sg__httpres_zpworker) * size);
+  if (!pool->workers) {
+    sg_free(pool);
+    errno = ENOMEM;
+    return NULL;
+  }
+  pthread_mutex_init(&pool->mutex, NULL);
+  pthread_cond_init(&pool->cond, NULL);
+  for (; pool->workers_count < size; pool->workers_count++) {
+    worker = &pool->workers[pool->workers_count];
+    worker->pool = pool;
+    worker->stream.zalloc = sg__zalloc;
+    worker->stream.zfree = sg__zfree;
+    errnum = pthread_create(&worker->thread, NULL, sg__httpres_zpworker_cb,
+                            worker);
+    if (errnum != 0) {
+      sg__httpres_zpool_free(pool);
+      errno = errnum;
+      return NULL;
+    }
+  }
+  return pool;
+}
+
+void sg__httpres_zpool_free(struct sg__httpres_zpool *pool) {
+  unsigned int i;
+  if (!pool)
+    return;
+  pthread_mutex_lock(&pool->mutex);
+  pool->stop = true;
+  pthread_cond_broadcast(&pool->cond);
+  pthread_mutex_unlock(&pool->mutex);
+  for (i = 0; i < pool->workers_count; i++) {
+    pthread_join(pool->workers[i].thread, NULL);
+    if (pool->workers[i].ready)
+      deflateEnd(&pool->workers[i].stream);
+  }
+  sg_free(pool->workers);
+  pthread_cond_destroy(&pool->cond);
+  pthread_mutex_destroy(&pool->mutex);
+  sg_free(pool);
+}
+
 #endif /* SG_HTTP_COMPRESSION */
 
+struct sg__httpres_hdrs *sg__httpres_hdrs_new(struct sg_strmap *map) {
+  struct sg__httpres_hdrs *hdrs;
+  struct sg_strmap *pair, *tmp;
+  size_t size, name_len, val_len;
+  unsigned int i = 0;
+  char *str;
+  size = sizeof(struct sg__httpres_hdrs) +
+         (sg_strmap_count(map) * sizeof(struct sg__httpres_hdr));
+  HASH_ITER(hh, map, pair, tmp) {
+    if (strpbrk(pair->name, "\r\n:") || strpbrk(pair->val, "\r\n")) {
+      errno = EINVAL;
+      return NULL;
+    }
+    size += pair->len + pair->val_len + 2;
+  }
+  hdrs = sg_malloc(size);
+  if (!hdrs)
+    return NULL;
+  str = (char *) &hdrs->items[sg_strmap_count(map)];
+  HASH_ITER(hh, map, pair, tmp) {
+    name_len = pair->len + 1;
+    val_len = pair->val_len + 1;
+    memcpy(str, pair->name, name_len);
+    hdrs->items[i].name = str;
+    str += name_len;
+    memcpy(str, pair->val, val_len);
+    hdrs->items[i].val = str;
+    str += val_len;
+    i++;
+  }
+  hdrs->count = i;
+  return hdrs;
+}
+
+void sg__httpres_date(char *date) {
+  static const char days[7][4] = {"Sun", "Mon", "Tue", "Wed",
+                                  "Thu", "Fri", "Sat"};
+  static const char months[12][4] = {"Jan", "Feb", "Mar", "Apr",
+                                     "May", "Jun", "Jul", "Aug",
+                                     "Sep", "Oct", "Nov", "Dec"};
+  time_t now = time(NULL);
+  struct tm tm;
+  pthread_mutex_lock(&sg__httpres_date_mutex);
+  if (now != sg__httpres_date_time) {
+#ifdef _WIN32
+    gmtime_s(&tm, &now);
+#else /* _WIN32 */
+    gmtime_r(&now, &tm);
+#endif /* _WIN32 */
+    snprintf(sg__httpres_date_str, sizeof(sg__httpres_date_str),
+             "%s, %02d %s %04d %02d:%02d:%02d GMT", days[tm.tm_wday % 7],
+             tm.tm_mday, months[tm.tm_mon % 12], tm.tm_year + 1900, tm.tm_hour,
+             tm.tm_min, tm.tm_sec);
+    sg__httpres_date_time = now;
+  }
+  memcpy(date, sg__httpres_date_str, sizeof(sg__httpres_date_str));
+  pthread_mutex_unlock(&sg__httpres_date_mutex);
+}
+
+void sg__httpres_prepare(struct sg_httpres *res) {
+  char date[SG__HTTPRES_DATE_SIZE + 1];
+  struct sg_strmap *pair, *tmp, *found;
+  unsigned int i;
+  if (!res->handle)
+    return;
+  sg_strmap_iter(res->headers, sg__strmap_iter, res->handle);
+  /* shared headers are added unless overridden, reusing their stored hashes */
+  if (res->base)
+    HASH_ITER(hh, res->base->map, pair, tmp) {
+      found = sg__strmap_find_hashed(res->headers, pair->key, pair->len,
+                                     pair->hh.hashv);
+      if (!found)
+        MHD_add_response_header(res->handle, pair->name, pair->val);
+    }
+  /* the response's own headers take precedence over the server ones */
+  if (res->hdrs)
+    for (i = 0; i < res->hdrs->count; i++)
+      if (!MHD_get_response_header(res->handle, res->hdrs->items[i].name))
+        MHD_add_response_header(res->handle, res->hdrs->items[i].name,
+                                res->hdrs->items[i].val);
+  if (!MHD_get_response_header(res->handle, MHD_HTTP_HEADER_DATE)) {
+    sg__httpres_date(date);
+    MHD_add_response_header(res->handle, MHD_HTTP_HEADER_DATE, date);
+  }
+}
+
 struct sg_httpres *sg__httpres_new(struct MHD_Connection *con) {
   struct sg_httpres *res = sg_alloc(sizeof(struct sg_httpres));
   if (!res)
@@ -287,12 +687,13 @@ void sg__httpres_free(struct sg_httpres *res) {
   if (!res)
     return;
   sg_strmap_cleanup(&res->headers);
+  sg_strmap_snap_unref(res->base);
   MHD_destroy_response(res->handle);
   sg_free(res);
 }
 
 int sg__httpres_dispatch(struct sg_httpres *res) {
-  sg_strmap_iter(res->headers, sg__strmap_iter, res->handle);
+  sg__httpres_prepare(res);
   res->ret = MHD_queue_response(res->con, res->status, res->handle);
   return res->ret;
 }
@@ -304,6 +705,17 @@ struct sg_strmap **sg_httpres_headers(struct sg_httpres *res) {
   return NULL;
 }
 
+int sg_httpres_set_base_headers(struct sg_httpres *res,
+                                struct sg_strmap_snap *snap) {
+  if (!res)
+    return EINVAL;
+  if (snap)
+    sg_strmap_snap_ref(snap);
+  sg_strmap_snap_unref(res->base);
+  res->base = snap;
+  return 0;
+}
+
 int sg_httpres_set_cookie(struct sg_httpres *res, const char *name,
                           const char *val) {
   char *str;
@@ -407,37 +819,115 @@ error:
   return errnum;
 }
 
+static void sg__httpres_iovfree(const struct sg_httpres_iov *iov,
+                                unsigned int count) {
+  unsigned int i;
+  for (i = 0; i < count; i++)
+    if (iov[i].free_cb)
+      iov[i].free_cb((void *) iov[i].buf);
+}
+
+static void sg__httpres_iovfree_cb(void *cls) {
+  struct sg__httpres_iovholder *holder = cls;
+  sg__httpres_iovfree(holder->iov, holder->count);
+  sg_free(holder);
+}
+
+int sg_httpres_sendiov(struct sg_httpres *res, const struct sg_httpres_iov *iov,
+                       unsigned int count, const char *content_type,
+                       unsigned int status) {
+  struct sg__httpres_iovholder *holder;
+  struct MHD_IoVec *vec;
+  size_t total = 0;
+  unsigned int i;
+  int errnum;
+  if (!res || !iov || (count == 0) || (status < 100) || (status > 599)) {
+    errnum = EINVAL;
+    goto error;
+  }
+  for (i = 0; i < count; i++) {
+    if ((!iov[i].buf && (iov[i].size > 0)) ||
+        (iov[i].size > (SIZE_MAX / 2) - total)) {
+      errnum = EINVAL;
+      goto error;
+    }
+    total += iov[i].size;
+  }
+  if (res->handle) {
+    errnum = EALREADY;
+    goto error;
+  }
+  if (content_type) {
+    errnum =
+      sg_strmap_set(&res->headers, MHD_HTTP_HEADER_CONTENT_TYPE, content_type);
+    if (errnum != 0)
+      goto error;
+  }
+  vec = sg_malloc(count * sizeof(struct MHD_IoVec));
+  if (!vec) {
+    errnum = ENOMEM;
+    goto error;
+  }
+  holder = sg_malloc(sizeof(struct sg__httpres_iovholder) +
+                     (count * sizeof(struct sg_httpres_iov)));
+  if (!holder) {
+    sg_free(vec);
+    errnum = ENOMEM;
+    goto error;
+  }
+  holder->iov = (struct sg_httpres_iov *) (holder + 1);
+  holder->count = count;
+  memcpy(holder->iov, iov, count * sizeof(struct sg_httpres_iov));
+  for (i = 0; i < count; i++) {
+    vec[i].iov_base = iov[i].buf;
+    vec[i].iov_len = iov[i].size;
+  }
+  res->handle = MHD_create_response_from_iovec(vec, count,
+                                               sg__httpres_iovfree_cb, holder);
+  sg_free(vec);
+  if (!res->handle) {
+    sg_free(holder);
+    errnum = ENOMEM;
+    goto error;
+  }
+  res->status = status;
+  return 0;
+error:
+  if (iov)
+    sg__httpres_iovfree(iov, count);
+  return errnum;
+}
+
 #ifdef SG_HTTP_COMPRESSION
 
-int sg_httpres_zsendbinary2(struct sg_httpres *res, int level, void *buf,
-                            size_t size, const char *content_type,
-                            unsigned int status) {
+int sg_httpres_zsendbinary3(struct sg_httpres *res, const char *encoding,
+                            int level, void *buf, size_t size,
+                            const char *content_type, unsigned int status) {
+  const struct sg__httpcomp *comp;
   size_t zsize;
-  void *zbuf;
+  void *zbuf = NULL;
   int ret;
-  if (!res || ((level < -1) || (level > 9)) || !buf || ((ssize_t) size < 0) ||
-      (status < 100) || (status > 599))
+  if (!res || !encoding || !buf || ((ssize_t) size < 0) || (status < 100) ||
+      (status > 599))
+    return EINVAL;
+  comp = sg__httpcomp_find(encoding);
+  if (!comp)
+    return ENOTSUP;
+  if (!sg__httpcomp_level_valid(comp, level))
     return EINVAL;
   if (res->handle)
     return EALREADY;
   if (size > 0) {
-    zsize = compressBound(size);
-    zbuf = sg_malloc(zsize);
-    if (!zbuf)
-      return ENOMEM;
-    if ((sg__zcompress(buf, size, zbuf, (uLongf *) &zsize, level) != Z_OK) ||
-        (zsize >= size)) {
-      zsize = size;
-      memcpy(zbuf, buf, zsize);
-    } else {
+    ret = sg__httpcomp_compress(comp, level, buf, size, &zbuf, &zsize);
+    if ((ret == 0) && (zsize < size)) {
       ret = sg_strmap_set(&res->headers, MHD_HTTP_HEADER_CONTENT_ENCODING,
-                          "deflate");
+                          comp->token);
       if (ret != 0)
         goto error;
+    } else {
+      sg_free(zbuf);
+      zbuf = NULL;
     }
-  } else {
-    zbuf = strdup("");
-    zsize = 0;
   }
   if (content_type) {
     ret =
@@ -446,9 +936,12 @@ int sg_httpres_zsendbinary2(struct sg_httpres *res, int level, void *buf,
       goto error;
   }
   res->handle =
-    MHD_create_response_from_buffer(zsize, zbuf, MHD_RESPMEM_MUST_FREE);
-  if (!res->handle)
-    return ENOMEM;
+    zbuf ? MHD_create_response_from_buffer(zsize, zbuf, MHD_RESPMEM_MUST_FREE) :
+           MHD_create_response_from_buffer(size, buf, MHD_RESPMEM_MUST_COPY);
+  if (!res->handle) {
+    ret = ENOMEM;
+    goto error;
+  }
   res->status = status;
   return 0;
 error:
@@ -456,75 +949,58 @@ error:
   return ret;
 }
 
+int sg_httpres_zsendbinary2(struct sg_httpres *res, int level, void *buf,
+                            size_t size, const char *content_type,
+                            unsigned int status) {
+  return sg_httpres_zsendbinary3(res, "deflate", level, buf, size,
+                                 content_type, status);
+}
+
 int sg_httpres_zsendbinary(struct sg_httpres *res, void *buf, size_t size,
                            const char *content_type, unsigned int status) {
   return sg_httpres_zsendbinary2(res, Z_BEST_COMPRESSION, buf, size,
                                  content_type, status);
 }
 
-int sg_httpres_zsendstream2(struct sg_httpres *res, int level, uint64_t size,
-                            sg_read_cb read_cb, void *handle,
-                            sg_free_cb free_cb, unsigned int status) {
-  struct sg__httpres_zholder *holder;
+int sg_httpres_zsendstream3(struct sg_httpres *res, const char *encoding,
+                            int level, uint64_t size, sg_read_cb read_cb,
+                            void *handle, sg_free_cb free_cb,
+                            unsigned int status) {
+  const struct sg__httpcomp *comp;
   int errnum;
-  if (!res || ((level < -1) || (level > 9)) || !read_cb ||
-      ((int64_t) size < 0) || (status < 100) || (status > 599)) {
+  if (!res || !encoding || !read_cb || ((int64_t) size < 0) ||
+      (status < 100) || (status > 599)) {
     errnum = EINVAL;
     goto error;
   }
-  if (res->handle) {
-    errnum = EALREADY;
+  comp = sg__httpcomp_find(encoding);
+  if (!comp) {
+    errnum = ENOTSUP;
     goto error;
   }
-  holder = sg_alloc(sizeof(struct sg__httpres_zholder));
-  if (!holder) {
-    errnum = ENOMEM;
+  if (!sg__httpcomp_level_valid(comp, level)) {
+    errnum = EINVAL;
     goto error;
   }
-  holder->stream.zalloc = sg__zalloc;
-  holder->stream.zfree = sg__zfree;
-  errnum = deflateInit2(&holder->stream, level, Z_DEFLATED, MAX_WBITS,
-                        MAX_MEM_LEVEL, Z_DEFAULT_STRATEGY);
-  if (errnum != Z_OK)
-    goto error_stream;
-  holder->buf_in = sg_malloc(SG__ZLIB_CHUNK);
-  if (!holder->buf_in) {
-    errnum = ENOMEM;
-    goto error_buf_in;
-  }
-  errnum =
-    sg_strmap_set(&res->headers, MHD_HTTP_HEADER_CONTENT_ENCODING, "deflate");
-  if (errnum != 0)
-    goto error_res;
-  holder->read_cb = read_cb;
-  holder->free_cb = free_cb;
-  holder->handle = handle;
-  holder->size_in = size;
-  res->handle = MHD_create_response_from_callback(
-    MHD_SIZE_UNKNOWN, SG__BLOCK_SIZE, sg__httpres_zread_cb, holder,
-    sg__httpres_zfree_cb);
-  if (!res->handle) {
-    errnum = ENOMEM;
-    goto error_res;
+  if (res->handle) {
+    errnum = EALREADY;
+    goto error;
   }
-  res->status = status;
-#ifdef SG_TESTING
-  errnum = 0;
-#else /* SG_TESTING */
-  return 0;
-#endif /* SG_TESTING */
-error_res:
-  sg_free(holder->buf_in);
-error_buf_in:
-  deflateEnd(&holder->stream);
-error_stream:
-  sg_free(holder);
+  return sg__httpres_zsend(res, comp, level, size, read_cb, handle, free_cb,
+                           status);
 error:
   if (free_cb)
     free_cb(handle);
   return errnum;
 }
 
+int sg_httpres_zsendstream2(struct sg_httpres *res, int level, uint64_t size,
+                            sg_read_cb read_cb, void *handle,
+                            sg_free_cb free_cb, unsigned int status) {
+  return sg_httpres_zsendstream3(res, "deflate", level, size, read_cb, handle,
+                                 free_cb, status);
+}
+
 int sg_httpres_zsendstream(struct sg_httpres *res, sg_read_cb read_cb,
                            void *handle, sg_free_cb free_cb,
                            unsigned int status) {
@@ -532,16 +1008,22 @@ int sg_httpres_zsendstream(struct sg_httpres *res, sg_read_cb read_cb,
                                  status);
 }
 
-int sg_httpres_zsendfile2(struct sg_httpres *res, int level, uint64_t size,
-                          uint64_t max_size, uint64_t offset,
-                          const char *filename, const char *disposition,
-                          unsigned int status) {
-  struct sg__httpres_gzholder *holder;
+int sg_httpres_zsendfile3(struct sg_httpres *res, const char *encoding,
+                          int level, uint64_t size, uint64_t max_size,
+                          uint64_t offset, const char *filename,
+                          const char *disposition, unsigned int status) {
+  const struct sg__httpcomp *comp;
   struct stat sbuf;
-  int fd, errnum = 0;
-  if (!res || ((level < -1) || (level > 9)) || ((int64_t) size < 0) ||
-      ((int64_t) max_size < 0) || ((int64_t) offset < 0) || !filename ||
-      (status < 100) || (status > 599))
+  uint64_t total;
+  int *handle;
+  int fd = -1, errnum = 0;
+  if (!res || !encoding || ((int64_t) size < 0) || ((int64_t) max_size < 0) ||
+      ((int64_t) offset < 0) || !filename || (status < 100) || (status > 599))
+    return EINVAL;
+  comp = sg__httpcomp_find(encoding);
+  if (!comp)
+    return ENOTSUP;
+  if (!sg__httpcomp_level_valid(comp, level))
     return EINVAL;
   if (res->handle)
     return EALREADY;
@@ -553,60 +1035,34 @@ int sg_httpres_zsendfile2(struct sg_httpres *res, int level, uint64_t size,
     errnum = errno;
     goto error;
   }
-  holder = sg_alloc(sizeof(struct sg__httpres_gzholder));
-  if (!holder) {
+  total = size;
+  if ((total == 0) && ((uint64_t) sbuf.st_size > offset))
+    total = (uint64_t) sbuf.st_size - offset;
+  if (res->zpool && (strcmp(comp->token, "gzip") == 0) &&
+      (total >= SG__HTTPRES_ZPAR_MIN_SIZE))
+    return sg__httpres_zpsend(res, fd, level, offset, total, status);
+  handle = sg_malloc(sizeof(int));
+  if (!handle) {
     errnum = ENOMEM;
     goto error;
   }
-  holder->stream.zalloc = sg__zalloc;
-  holder->stream.zfree = sg__zfree;
-  errnum = deflateInit2(&holder->stream, level, Z_DEFLATED, -MAX_WBITS, 8,
-                        Z_DEFAULT_STRATEGY);
-  if (errnum != Z_OK)
-    goto error_stream;
-  holder->buf_in = sg_malloc(SG__ZLIB_CHUNK);
-  if (!holder->buf_in) {
-    errnum = ENOMEM;
-    goto error_buf_in;
-  }
-  holder->handle = sg_malloc(sizeof(int));
-  if (!holder->handle) {
-    errnum = ENOMEM;
-    goto error_handle;
-  }
-  errnum =
-    sg_strmap_set(&res->headers, MHD_HTTP_HEADER_CONTENT_ENCODING, "gzip");
-  if (errnum != 0)
-    goto error_res;
-  *holder->handle = fd;
-  holder->size_in = size;
-  res->handle = MHD_create_response_from_callback(
-    MHD_SIZE_UNKNOWN, SG__BLOCK_SIZE, sg__httpres_gzread_cb, holder,
-    sg__httpres_gzfree_cb);
-  if (!res->handle) {
-    errnum = ENOMEM;
-    goto error_res;
-  }
-  res->status = status;
-#ifdef SG_TESTING
-  errnum = 0;
-#else /* SG_TESTING */
-  return 0;
-#endif /* SG_TESTING */
-error_res:
-  sg_free(holder->handle);
-error_handle:
-  sg_free(holder->buf_in);
-error_buf_in:
-  deflateEnd(&holder->stream);
-error_stream:
-  sg_free(holder);
+  *handle = fd;
+  return sg__httpres_zsend(res, comp, level, size, sg__httpres_zfdread_cb,
+                           handle, sg__httpres_zfdfree_cb, status);
 error:
   if (fd != -1)
     close(fd);
   return errnum;
 }
 
+int sg_httpres_zsendfile2(struct sg_httpres *res, int level, uint64_t size,
+                          uint64_t max_size, uint64_t offset,
+                          const char *filename, const char *disposition,
+                          unsigned int status) {
+  return sg_httpres_zsendfile3(res, "gzip", level, size, max_size, offset,
+                               filename, disposition, status);
+}
+
 int sg_httpres_zsendfile(struct sg_httpres *res, uint64_t size,
                          uint64_t max_size, uint64_t offset,
                          const char *filename, bool downloaded,
@@ -629,8 +1085,11 @@ int sg_httpres_reset(struct sg_httpres *res) {
 
 int sg_httpres_clear(struct sg_httpres *res) {
   int ret = sg_httpres_reset(res);
-  if (ret == 0)
+  if (ret == 0) {
     sg_strmap_cleanup(&res->headers);
+    sg_strmap_snap_unref(res->base);
+    res->base = NULL;
+  }
   return ret;
 }
 
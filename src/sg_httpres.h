@@ -30,68 +30,170 @@
 #include "sg_macros.h"
 #ifdef SG_HTTP_COMPRESSION
 #include <stdint.h>
+#include <pthread.h>
 #include "zlib.h"
+#include "sg_httpcomp.h"
 #endif /* SG_HTTP_COMPRESSION */
 #include "microhttpd.h"
 #include "sagui.h"
 
+/* Header added to every response of a server. */
+struct sg__httpres_hdr {
+  const char *name;
+  const char *val;
+};
+
+/* Server default headers, compiled into a single block holding the pairs
+ * followed by their strings and shared read-only by all the responses. */
+struct sg__httpres_hdrs {
+  unsigned int count;
+  struct sg__httpres_hdr items[];
+};
+
+/* Length of an IMF-fixdate, e.g. "Sun, 06 Nov 1994 08:49:37 GMT". */
+#define SG__HTTPRES_DATE_SIZE 29
+
 struct sg_httpres {
   struct MHD_Connection *con;
   struct MHD_Response *handle;
   struct sg_strmap *headers;
+  struct sg_strmap_snap *base;
+  const struct sg__httpres_hdrs *hdrs;
   unsigned int status;
   int ret;
+#ifdef SG_HTTP_COMPRESSION
+  struct sg__httpres_zpool *zpool;
+#endif /* SG_HTTP_COMPRESSION */
+};
+
+/* Keeps the buffers of a scatter-gather response until MHD releases it. */
+struct sg__httpres_iovholder {
+  struct sg_httpres_iov *iov;
+  unsigned int count;
 };
 
 #ifdef SG_HTTP_COMPRESSION
 
 enum sg__httpres_zstatus {
   SG__HTTPRES_ZPROCESSING = 0,
-  SG__HTTPRES_ZWRITING = 1,
-  SG__HTTPRES_ZFINISHED = 2
+  SG__HTTPRES_ZFINISHED = 1
 };
 
 struct sg__httpres_zholder {
-  z_stream stream;
+  const struct sg__httpcomp *comp;
+  void *ctx;
+  struct sg__httpcomp_buf buf_out;
   sg_read_cb read_cb;
   sg_free_cb free_cb;
-  Bytef *buf_in;
-  Bytef *buf_out;
+  char *buf_in;
   uint64_t size_in;
-  uint64_t size_out;
   uint64_t offset_in;
-  uint64_t offset_out;
+  size_t offset_out;
   void *handle;
   enum sg__httpres_zstatus status;
 };
 
-enum sg__httpres_gzstatus {
-  SG__HTTPRES_GZNONE = 0,
-  SG__HTTPRES_GZPROCESSING = 1,
-  SG__HTTPRES_GZWRITING = 2,
-  SG__HTTPRES_GZFINISHING = 3,
-  SG__HTTPRES_GZFINISHED = 4
+/* Parallel gzip: the file is split into blocks compressed concurrently by the
+ * worker pool of the server and emitted in order as a single gzip member. */
+
+#define SG__HTTPRES_ZPAR_BLOCK_SIZE 131072 /* 128 kB */
+#define SG__HTTPRES_ZPAR_DICT_SIZE 32768 /* 32 kB */
+#define SG__HTTPRES_ZPAR_MIN_SIZE 4194304 /* ~4 MB */
+
+enum sg__httpres_zpstatus {
+  SG__HTTPRES_ZPHEADER = 0,
+  SG__HTTPRES_ZPDATA = 1,
+  SG__HTTPRES_ZPTRAILER = 2,
+  SG__HTTPRES_ZPFINISHED = 3
+};
+
+enum sg__httpres_zpstate {
+  SG__HTTPRES_ZPEMPTY = 0,
+  SG__HTTPRES_ZPBUSY = 1,
+  SG__HTTPRES_ZPDONE = 2
+};
+
+struct sg__httpres_zpslot {
+  /* room for the dictionary (tail of the previous block), then the block */
+  Bytef *in;
+  size_t dict_size;
+  size_t in_size;
+  struct sg__httpcomp_buf out;
+  size_t offset_out;
+  uLong crc;
+  int errnum;
+  bool last;
+  enum sg__httpres_zpstate state;
 };
 
-struct sg__httpres_gzholder {
+struct sg__httpres_zpool;
+
+struct sg__httpres_zpworker {
+  struct sg__httpres_zpool *pool;
+  pthread_t thread;
   z_stream stream;
-  Bytef *buf_in;
-  Bytef *buf_out;
-  uint64_t size_in;
-  uint64_t size_out;
+  int level;
+  bool ready;
+};
+
+/* Response compressed by the pool. The slots and the sequence numbers are
+ * protected by the pool mutex, but the blocks are read and deflated outside
+ * it. The holder is queued in the pool while it has blocks to hand out, and
+ * its connection is suspended while the next block to emit is not ready. */
+struct sg__httpres_zpholder {
+  struct sg__httpres_zpool *pool;
+  struct MHD_Connection *con;
+  pthread_cond_t cond;
+  struct sg__httpres_zpslot *slots;
+  unsigned int slots_count;
+  unsigned int busy;
+  uint64_t blocks;
+  uint64_t seq_read;
+  uint64_t seq_emit;
   uint64_t offset_in;
-  uint64_t offset_out;
+  uint64_t size_in;
+  uint64_t total_in;
   uLong crc;
-  int *handle;
-  enum sg__httpres_gzstatus status;
+  int fd;
+  int level;
+  bool queued;
+  bool suspended;
+  enum sg__httpres_zpstatus status;
+  struct sg__httpres_zpholder *prev;
+  struct sg__httpres_zpholder *next;
+};
+
+/* Compression threads of a server, created when it starts listening and
+ * shared by all its responses. */
+struct sg__httpres_zpool {
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  struct sg__httpres_zpworker *workers;
+  struct sg__httpres_zpholder *queue;
+  unsigned int workers_count;
+  bool stop;
 };
 
 #endif /* SG_HTTP_COMPRESSION */
 
+SG__EXTERN struct sg__httpres_hdrs *sg__httpres_hdrs_new(struct sg_strmap *map);
+
+SG__EXTERN void sg__httpres_date(char *date);
+
+SG__EXTERN void sg__httpres_prepare(struct sg_httpres *res);
+
 SG__EXTERN struct sg_httpres *sg__httpres_new(struct MHD_Connection *con);
 
 SG__EXTERN void sg__httpres_free(struct sg_httpres *res);
 
 SG__EXTERN int sg__httpres_dispatch(struct sg_httpres *res);
 
+#ifdef SG_HTTP_COMPRESSION
+
+SG__EXTERN struct sg__httpres_zpool *sg__httpres_zpool_new(unsigned int size);
+
+SG__EXTERN void sg__httpres_zpool_free(struct sg__httpres_zpool *pool);
+
+#endif /* SG_HTTP_COMPRESSION */
+
 #endif /* SG_HTTPRES_H */
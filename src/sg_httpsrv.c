@@ -44,6 +44,13 @@
 #include "sg_httpreq.h"
 #include "sg_httpreq.h"
 #include "sg_httpsrv.h"
+#include "sg_digest.h"
+#ifdef SG_HTTP_WEBSOCKET
+#include "sg_httpws.h"
+#endif /* SG_HTTP_WEBSOCKET */
+#ifdef SG_HTTP_UPLD_URING
+#include "sg_uring.h"
+#endif /* SG_HTTP_UPLD_URING */
 
 static void sg__httpsrv_oel(void *cls, const char *fmt, va_list ap) {
   struct sg_httpsrv *srv = cls;
@@ -79,6 +86,21 @@ static enum MHD_Result sg__httpsrv_ahc(void *cls, struct MHD_Connection *con,
       if (!sg__httpauth_dispatch(req->auth))
         return req->res->ret;
     }
+    if (srv->hdr_cb) {
+      srv->hdr_cb(srv->hdr_cls, req, req->res);
+      if (req->res->handle)
+        return sg__httpres_dispatch(req->res);
+    }
+    if (con &&
+        !sg__httpuplds_begin(
+          srv, req,
+          MHD_lookup_connection_value(con, MHD_HEADER_KIND,
+                                      MHD_HTTP_HEADER_CONTENT_TYPE),
+          MHD_lookup_connection_value(con, MHD_HEADER_KIND,
+                                      MHD_HTTP_HEADER_CONTENT_LENGTH),
+          MHD_lookup_connection_value(con, MHD_HEADER_KIND,
+                                      MHD_HTTP_HEADER_CONTENT_ENCODING)))
+      return sg__httpres_dispatch(req->res);
     return MHD_YES;
   }
   if (!req->auth->canceled) {
@@ -160,6 +182,9 @@ static bool sg__httpsrv_listen2(struct sg_httpsrv *srv, const char *key,
           (threaded ?
              MHD_USE_INTERNAL_POLLING_THREAD | MHD_USE_THREAD_PER_CONNECTION :
              MHD_USE_AUTO_INTERNAL_THREAD);
+#ifdef SG_HTTP_WEBSOCKET
+  flags |= MHD_ALLOW_UPGRADE;
+#endif /* SG_HTTP_WEBSOCKET */
   sg__httpsrv_addopt(ops, &pos, MHD_OPTION_EXTERNAL_LOGGER,
                      (intptr_t) sg__httpsrv_oel, srv);
   if (hostname) {
@@ -222,8 +247,21 @@ static bool sg__httpsrv_listen2(struct sg_httpsrv *srv, const char *key,
     }
   }
   sg__httpsrv_addopt(ops, &pos, MHD_OPTION_END, 0, NULL);
+#ifdef SG_HTTP_COMPRESSION
+  if ((srv->zthr_pool_size > 0) && !srv->zpool) {
+    srv->zpool = sg__httpres_zpool_new(srv->zthr_pool_size);
+    if (!srv->zpool)
+      return false;
+  }
+#endif /* SG_HTTP_COMPRESSION */
   srv->handle = MHD_start_daemon(flags, port, NULL, NULL, sg__httpsrv_ahc, srv,
                                  MHD_OPTION_ARRAY, ops, MHD_OPTION_END);
+#ifdef SG_HTTP_COMPRESSION
+  if (!srv->handle) {
+    sg__httpres_zpool_free(srv->zpool);
+    srv->zpool = NULL;
+  }
+#endif /* SG_HTTP_COMPRESSION */
   return srv->handle != NULL;
 }
 
@@ -294,15 +332,23 @@ struct sg_httpsrv *sg_httpsrv_new2(sg_httpauth_cb auth_cb, sg_httpreq_cb req_cb,
   srv->upld_free_cb = sg__httpupld_free_cb;
   srv->upld_save_cb = sg__httpupld_save_cb;
   srv->upld_save_as_cb = sg__httpupld_save_as_cb;
+#ifdef SG__HTTPUPLD_TMPFILE
+  srv->uplds_dirfd = -1;
+#endif /* SG__HTTPUPLD_TMPFILE */
 #ifdef __arm__
   srv->post_buf_size = 1024; /* ~1 Kb */
   srv->payld_limit = 1048576; /* ~1 MB */
   srv->uplds_limit = 16777216; /* ~16 MB */
+  srv->upld_mem_limit = 4096; /* ~4 kB */
 #else /* __arm__ */
   srv->post_buf_size = 4096; /* ~4 kB */
   srv->payld_limit = 4194304; /* ~4 MB */
   srv->uplds_limit = 67108864; /* ~64 MB */
+  srv->upld_mem_limit = 16384; /* ~16 kB */
 #endif /* __arm__ */
+#ifdef SG_HTTP_WEBSOCKET
+  srv->ws_ping_interval = 30;
+#endif /* SG_HTTP_WEBSOCKET */
   return srv;
 }
 
@@ -339,6 +385,11 @@ void sg_httpsrv_free(struct sg_httpsrv *srv) {
   }
   sg__httpsrv_unlock(srv);
   sg_httpsrv_shutdown(srv);
+#ifdef SG_HTTP_UPLD_URING
+  sg__uring_writer_free(srv->upld_writer);
+#endif /* SG_HTTP_UPLD_URING */
+  sg_free(srv->hdrs);
+  sg__httpuplds_close_dir(srv);
   sg_free(srv->uplds_dir);
   pthread_mutex_destroy(&srv->mutex);
   sg_free(srv);
@@ -404,12 +455,37 @@ bool sg_httpsrv_listen(struct sg_httpsrv *srv, uint16_t port, bool threaded) {
 }
 
 int sg_httpsrv_shutdown(struct sg_httpsrv *srv) {
+#ifdef SG_HTTP_WEBSOCKET
+  struct sg__httpws_loop *loop;
+#endif /* SG_HTTP_WEBSOCKET */
   if (!srv)
     return EINVAL;
   if (!srv->handle)
     return EALREADY;
+#ifdef SG_HTTP_WEBSOCKET
+  /* the upgraded connections are closed while MHD still owns their handles,
+   * and no loop is created until the daemon has stopped */
+  sg__httpsrv_lock(srv);
+  srv->ws_stopping = true;
+  loop = srv->ws_loop;
+  sg__httpsrv_unlock(srv);
+  sg__httpws_loop_stop(loop);
+#endif /* SG_HTTP_WEBSOCKET */
   MHD_stop_daemon(srv->handle);
   srv->handle = NULL;
+#ifdef SG_HTTP_WEBSOCKET
+  sg__httpsrv_lock(srv);
+  loop = srv->ws_loop;
+  srv->ws_loop = NULL;
+  srv->ws_stopping = false;
+  sg__httpsrv_unlock(srv);
+  sg__httpws_loop_free(loop);
+#endif /* SG_HTTP_WEBSOCKET */
+#ifdef SG_HTTP_COMPRESSION
+  /* after MHD, which releases the responses using it */
+  sg__httpres_zpool_free(srv->zpool);
+  srv->zpool = NULL;
+#endif /* SG_HTTP_COMPRESSION */
   return 0;
 }
 
@@ -440,6 +516,15 @@ int sg_httpsrv_set_cli_cb(struct sg_httpsrv *srv, sg_httpsrv_cli_cb cb,
   return 0;
 }
 
+int sg_httpsrv_set_hdr_cb(struct sg_httpsrv *srv, sg_httpreq_cb cb,
+                          void *cls) {
+  if (!srv || !cb)
+    return EINVAL;
+  srv->hdr_cb = cb;
+  srv->hdr_cls = cls;
+  return 0;
+}
+
 int sg_httpsrv_set_upld_cbs(struct sg_httpsrv *srv, sg_httpupld_cb cb,
                             void *cls, sg_write_cb write_cb, sg_free_cb free_cb,
                             sg_save_cb save_cb, sg_save_as_cb save_as_cb) {
@@ -457,6 +542,9 @@ int sg_httpsrv_set_upld_cbs(struct sg_httpsrv *srv, sg_httpupld_cb cb,
 int sg_httpsrv_set_upld_dir(struct sg_httpsrv *srv, const char *dir) {
   if (!srv || !dir)
     return EINVAL;
+  sg__httpsrv_lock(srv);
+  sg__httpuplds_close_dir(srv);
+  sg__httpsrv_unlock(srv);
   sg_free(srv->uplds_dir);
   srv->uplds_dir = strdup(dir);
   return 0;
@@ -469,6 +557,50 @@ const char *sg_httpsrv_upld_dir(struct sg_httpsrv *srv) {
   return NULL;
 }
 
+int sg_httpsrv_set_upld_sync(struct sg_httpsrv *srv,
+                             enum sg_httpupld_sync policy) {
+  if (!srv || ((int) policy < (int) SG_HTTPUPLD_SYNC_NONE) ||
+      ((int) policy > (int) SG_HTTPUPLD_SYNC_FULL))
+    return EINVAL;
+  srv->upld_sync = policy;
+  return 0;
+}
+
+enum sg_httpupld_sync sg_httpsrv_upld_sync(struct sg_httpsrv *srv) {
+  if (srv)
+    return srv->upld_sync;
+  errno = EINVAL;
+  return SG_HTTPUPLD_SYNC_NONE;
+}
+
+int sg_httpsrv_set_upld_mem_limit(struct sg_httpsrv *srv, size_t limit) {
+  if (!srv)
+    return EINVAL;
+  srv->upld_mem_limit = limit;
+  return 0;
+}
+
+size_t sg_httpsrv_upld_mem_limit(struct sg_httpsrv *srv) {
+  if (srv)
+    return srv->upld_mem_limit;
+  errno = EINVAL;
+  return 0;
+}
+
+int sg_httpsrv_set_upld_digests(struct sg_httpsrv *srv, unsigned int algos) {
+  if (!srv || (algos & ~(unsigned int) SG__DIGEST_ALL))
+    return EINVAL;
+  srv->upld_digests = algos;
+  return 0;
+}
+
+unsigned int sg_httpsrv_upld_digests(struct sg_httpsrv *srv) {
+  if (srv)
+    return srv->upld_digests;
+  errno = EINVAL;
+  return 0;
+}
+
 int sg_httpsrv_set_post_buf_size(struct sg_httpsrv *srv, size_t size) {
   if (!srv || (size < 256))
     return EINVAL;
@@ -553,6 +685,59 @@ unsigned int sg_httpsrv_con_limit(struct sg_httpsrv *srv) {
   return 0;
 }
 
+int sg_httpsrv_set_headers(struct sg_httpsrv *srv, struct sg_strmap *headers) {
+  struct sg__httpres_hdrs *hdrs = NULL;
+  if (!srv)
+    return EINVAL;
+  if (srv->handle)
+    return EALREADY;
+  if (headers) {
+    hdrs = sg__httpres_hdrs_new(headers);
+    if (!hdrs)
+      return errno;
+  }
+  sg_free(srv->hdrs);
+  srv->hdrs = hdrs;
+  return 0;
+}
+
+#ifdef SG_HTTP_COMPRESSION
+
+int sg_httpsrv_set_zthr_pool_size(struct sg_httpsrv *srv, unsigned int size) {
+  if (!srv)
+    return EINVAL;
+  srv->zthr_pool_size = size;
+  return 0;
+}
+
+unsigned int sg_httpsrv_zthr_pool_size(struct sg_httpsrv *srv) {
+  if (srv)
+    return srv->zthr_pool_size;
+  errno = EINVAL;
+  return 0;
+}
+
+#endif /* SG_HTTP_COMPRESSION */
+
+#ifdef SG_HTTP_WEBSOCKET
+
+int sg_httpsrv_set_ws_ping_interval(struct sg_httpsrv *srv,
+                                    unsigned int interval) {
+  if (!srv)
+    return EINVAL;
+  srv->ws_ping_interval = interval;
+  return 0;
+}
+
+unsigned int sg_httpsrv_ws_ping_interval(struct sg_httpsrv *srv) {
+  if (srv)
+    return srv->ws_ping_interval;
+  errno = EINVAL;
+  return 0;
+}
+
+#endif /* SG_HTTP_WEBSOCKET */
+
 void *sg_httpsrv_handle(struct sg_httpsrv *srv) {
   if (srv)
     return srv->handle;
@@ -33,6 +33,7 @@
 #include "microhttpd.h"
 #include "sagui.h"
 #include "sg_httpreq.h"
+#include "sg_httpres.h"
 
 struct sg_httpsrv {
   struct MHD_Daemon *handle;
@@ -40,6 +41,7 @@ struct sg_httpsrv {
   pthread_mutex_t mutex;
   sg_httpsrv_cli_cb cli_cb;
   sg_httpauth_cb auth_cb;
+  sg_httpreq_cb hdr_cb;
   sg_httpupld_cb upld_cb;
   sg_write_cb upld_write_cb;
   sg_free_cb upld_free_cb;
@@ -48,15 +50,37 @@ struct sg_httpsrv {
   sg_httpreq_cb req_cb;
   sg_err_cb err_cb;
   void *cli_cls;
+  void *hdr_cls;
   void *upld_cls;
   void *cls;
+  struct sg__httpres_hdrs *hdrs;
   char *uplds_dir;
+#ifdef SG__HTTPUPLD_TMPFILE
+  int uplds_dirfd;
+  bool uplds_tmpfile;
+#endif /* SG__HTTPUPLD_TMPFILE */
+  enum sg_httpupld_sync upld_sync;
+#ifdef SG_HTTP_UPLD_URING
+  struct sg__uring_writer *upld_writer;
+  bool upld_writer_failed;
+#endif /* SG_HTTP_UPLD_URING */
   size_t post_buf_size;
   size_t payld_limit;
+  size_t upld_mem_limit;
+  unsigned int upld_digests;
   uint64_t uplds_limit;
   unsigned int thr_pool_size;
   unsigned int con_timeout;
   unsigned int con_limit;
+#ifdef SG_HTTP_COMPRESSION
+  struct sg__httpres_zpool *zpool;
+  unsigned int zthr_pool_size;
+#endif /* SG_HTTP_COMPRESSION */
+#ifdef SG_HTTP_WEBSOCKET
+  struct sg__httpws_loop *ws_loop;
+  unsigned int ws_ping_interval;
+  bool ws_stopping;
+#endif /* SG_HTTP_WEBSOCKET */
 };
 
 SG__EXTERN void sg__httpsrv_eprintf(struct sg_httpsrv *srv, const char *fmt,
@@ -0,0 +1,279 @@
+/*                         _
+ *   ___  __ _  __ _ _   _(_)
+ *  / __|/ _` |/ _` | | | | |
+ *  \__ \ (_| | (_| | |_| | |
+ *  |___/\__,_|\__, |\__,_|_|
+ *             |___/
+ *
+ * Cross-platform library which helps to develop web servers or frameworks.
+ *
+ * Copyright (C) 2016-2020 Silvio Clecio <silvioprog@gmail.com>
+ *
+ * Sagui library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * Sagui library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Sagui library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include "sg_macros.h"
+#include "utlist.h"
+#include "microhttpd.h"
+#include "sagui.h"
+#include "sg_httpreq.h"
+#include "sg_httpres.h"
+#include "sg_httpsse.h"
+
+static void sg__httpsse_destroy(struct sg_httpsse *sse) {
+  pthread_mutex_destroy(&sse->mutex);
+  sg_free(sse);
+}
+
+static void sg__httpsse_wake(struct sg__httpsse_sub *sub) {
+  if (sub->suspended) {
+    sub->suspended = false;
+    MHD_resume_connection(sub->con);
+  }
+}
+
+static void sg__httpsse_sub_write(struct sg__httpsse_sub *sub,
+                                  const char *buf, size_t size) {
+  const size_t cap = sub->sse->buf_size;
+  size_t tail, len;
+  if (sub->closed)
+    return;
+  if (size > cap - sub->used) {
+    if (sub->sse->policy == SG_HTTPSSE_DISCONNECT) {
+      sub->closed = true;
+      sub->failed = true;
+      sg__httpsse_wake(sub);
+    }
+    return;
+  }
+  tail = (sub->head + sub->used) % cap;
+  len = cap - tail;
+  if (len > size)
+    len = size;
+  memcpy(sub->buf + tail, buf, len);
+  memcpy(sub->buf, buf + len, size - len);
+  sub->used += size;
+  sg__httpsse_wake(sub);
+}
+
+static size_t sg__httpsse_sub_read(struct sg__httpsse_sub *sub, char *buf,
+                                   size_t size) {
+  const size_t cap = sub->sse->buf_size;
+  size_t len;
+  if (size > sub->used)
+    size = sub->used;
+  len = cap - sub->head;
+  if (len > size)
+    len = size;
+  memcpy(buf, sub->buf + sub->head, len);
+  memcpy(buf + len, sub->buf, size - len);
+  sub->head = (sub->head + size) % cap;
+  sub->used -= size;
+  return size;
+}
+
+static ssize_t sg__httpsse_read_cb(void *handle, __SG_UNUSED uint64_t offset,
+                                   char *buf, size_t size) {
+  struct sg__httpsse_sub *sub = handle;
+  ssize_t ret;
+  pthread_mutex_lock(&sub->sse->mutex);
+  if (sub->failed)
+    ret = MHD_CONTENT_READER_END_WITH_ERROR;
+  else if (sub->used > 0)
+    ret = (ssize_t) sg__httpsse_sub_read(sub, buf, size);
+  else if (sub->closed)
+    ret = MHD_CONTENT_READER_END_OF_STREAM;
+  else {
+    /* nothing queued: park the connection until a publisher resumes it */
+    sub->suspended = true;
+    MHD_suspend_connection(sub->con);
+    ret = 0;
+  }
+  pthread_mutex_unlock(&sub->sse->mutex);
+  return ret;
+}
+
+static void sg__httpsse_free_cb(void *handle) {
+  struct sg__httpsse_sub *sub = handle;
+  struct sg_httpsse *sse = sub->sse;
+  bool done;
+  pthread_mutex_lock(&sse->mutex);
+  DL_DELETE(sse->subs, sub);
+  sse->count--;
+  done = sse->closed && !sse->subs;
+  pthread_mutex_unlock(&sse->mutex);
+  sg_free(sub->buf);
+  sg_free(sub);
+  if (done)
+    sg__httpsse_destroy(sse);
+}
+
+static char *sg__httpsse_format(const char *event, const char *data,
+                                size_t *size) {
+  const char *line;
+  char *msg, *p;
+  size_t len, lines = 1;
+  /* CR, LF and CRLF all end a line in the event stream, so each one starts a
+   * new "data:" field, otherwise a lone CR could inject fields */
+  line = data;
+  while (*(line += strcspn(line, "\r\n")) != '\0') {
+    line += ((line[0] == '\r') && (line[1] == '\n')) ? 2 : 1;
+    lines++;
+  }
+  len = strlen(data);
+  *size = (lines * strlen("data: \n")) + len + strlen("\n");
+  if (event)
+    *size += strlen("event: \n") + strlen(event);
+  msg = sg_malloc(*size);
+  if (!msg)
+    return NULL;
+  p = msg;
+  if (event) {
+    len = strlen(event);
+    memcpy(p, "event: ", 7);
+    memcpy(p + 7, event, len);
+    p += 7 + len;
+    *p++ = '\n';
+  }
+  line = data;
+  for (;;) {
+    len = strcspn(line, "\r\n");
+    memcpy(p, "data: ", 6);
+    memcpy(p + 6, line, len);
+    p += 6 + len;
+    *p++ = '\n';
+    line += len;
+    if (*line == '\0')
+      break;
+    line += ((line[0] == '\r') && (line[1] == '\n')) ? 2 : 1;
+  }
+  *p++ = '\n';
+  *size = (size_t) (p - msg);
+  return msg;
+}
+
+struct sg_httpsse *sg_httpsse_new(size_t buf_size,
+                                  enum sg_httpsse_policy policy) {
+  struct sg_httpsse *sse;
+  if ((buf_size == 0) || ((policy != SG_HTTPSSE_DROP) &&
+                          (policy != SG_HTTPSSE_DISCONNECT))) {
+    errno = EINVAL;
+    return NULL;
+  }
+  sse = sg_alloc(sizeof(struct sg_httpsse));
+  if (!sse)
+    return NULL;
+  errno = pthread_mutex_init(&sse->mutex, NULL);
+  if (errno != 0) {
+    sg_free(sse);
+    return NULL;
+  }
+  sse->buf_size = buf_size;
+  sse->policy = policy;
+  return sse;
+}
+
+void sg_httpsse_free(struct sg_httpsse *sse) {
+  struct sg__httpsse_sub *sub;
+  bool done;
+  if (!sse)
+    return;
+  pthread_mutex_lock(&sse->mutex);
+  sse->closed = true;
+  DL_FOREACH(sse->subs, sub) {
+    sub->closed = true;
+    sg__httpsse_wake(sub);
+  }
+  done = !sse->subs;
+  pthread_mutex_unlock(&sse->mutex);
+  if (done)
+    sg__httpsse_destroy(sse);
+}
+
+int sg_httpsse_subscribe(struct sg_httpsse *sse, struct sg_httpreq *req) {
+  struct sg__httpsse_sub *sub;
+  int errnum;
+  if (!sse || !req)
+    return EINVAL;
+  if (req->res->handle)
+    return EALREADY;
+  errnum = sg_strmap_set(&req->res->headers, MHD_HTTP_HEADER_CONTENT_TYPE,
+                         "text/event-stream");
+  if (errnum != 0)
+    return errnum;
+  errnum =
+    sg_strmap_set(&req->res->headers, MHD_HTTP_HEADER_CACHE_CONTROL, "no-cache");
+  if (errnum != 0)
+    return errnum;
+  sub = sg_alloc(sizeof(struct sg__httpsse_sub));
+  if (!sub)
+    return ENOMEM;
+  sub->buf = sg_malloc(sse->buf_size);
+  if (!sub->buf) {
+    sg_free(sub);
+    return ENOMEM;
+  }
+  sub->sse = sse;
+  sub->con = req->con;
+  pthread_mutex_lock(&sse->mutex);
+  DL_APPEND(sse->subs, sub);
+  sse->count++;
+  pthread_mutex_unlock(&sse->mutex);
+  return sg_httpres_sendstream(req->res, 0, sg__httpsse_read_cb, sub,
+                               sg__httpsse_free_cb, 200);
+}
+
+int sg_httpsse_send(struct sg_httpsse *sse, const void *buf, size_t size) {
+  struct sg__httpsse_sub *sub;
+  if (!sse || !buf || (size == 0))
+    return EINVAL;
+  pthread_mutex_lock(&sse->mutex);
+  DL_FOREACH(sse->subs, sub) {
+    sg__httpsse_sub_write(sub, buf, size);
+  }
+  pthread_mutex_unlock(&sse->mutex);
+  return 0;
+}
+
+int sg_httpsse_publish(struct sg_httpsse *sse, const char *event,
+                       const char *data) {
+  char *msg;
+  size_t size;
+  int ret;
+  if (!sse || (event && strpbrk(event, "\r\n")) || !data)
+    return EINVAL;
+  msg = sg__httpsse_format(event, data, &size);
+  if (!msg)
+    return ENOMEM;
+  ret = sg_httpsse_send(sse, msg, size);
+  sg_free(msg);
+  return ret;
+}
+
+unsigned int sg_httpsse_count(struct sg_httpsse *sse) {
+  unsigned int count;
+  if (!sse) {
+    errno = EINVAL;
+    return 0;
+  }
+  pthread_mutex_lock(&sse->mutex);
+  count = sse->count;
+  pthread_mutex_unlock(&sse->mutex);
+  return count;
+}
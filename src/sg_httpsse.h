@@ -0,0 +1,61 @@
+/*                         _
+ *   ___  __ _  __ _ _   _(_)
+ *  / __|/ _` |/ _` | | | | |
+ *  \__ \ (_| | (_| | |_| | |
+ *  |___/\__,_|\__, |\__,_|_|
+ *             |___/
+ *
+ * Cross-platform library which helps to develop web servers or frameworks.
+ *
+ * Copyright (C) 2016-2020 Silvio Clecio <silvioprog@gmail.com>
+ *
+ * Sagui library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * Sagui library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Sagui library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef SG_HTTPSSE_H
+#define SG_HTTPSSE_H
+
+#include <stdbool.h>
+#include <pthread.h>
+#include "sg_macros.h"
+#include "microhttpd.h"
+#include "sagui.h"
+
+/* Subscriber of a channel. Its ring buffer is filled by the publishers and
+ * drained by the response callback, which suspends the connection while the
+ * buffer is empty. All fields are protected by the channel mutex. */
+struct sg__httpsse_sub {
+  struct sg_httpsse *sse;
+  struct MHD_Connection *con;
+  char *buf;
+  size_t head;
+  size_t used;
+  bool suspended;
+  bool closed;
+  bool failed;
+  struct sg__httpsse_sub *prev;
+  struct sg__httpsse_sub *next;
+};
+
+struct sg_httpsse {
+  pthread_mutex_t mutex;
+  struct sg__httpsse_sub *subs;
+  size_t buf_size;
+  unsigned int count;
+  enum sg_httpsse_policy policy;
+  bool closed;
+};
+
+#endif /* SG_HTTPSSE_H */
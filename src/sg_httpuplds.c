@@ -24,15 +24,24 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include <stdlib.h>
 #include <stdbool.h>
+#include <string.h>
+#include <ctype.h>
 #include <errno.h>
+#include <unistd.h>
 #include <sys/stat.h>
+#ifdef _WIN32
+#include <io.h>
+#endif /* _WIN32 */
 #include "sg_macros.h"
-#include "uthash.h"
 #include "sagui.h"
 #include "sg_utils.h"
 #include "sg_str.h"
+#include "sg_rope.h"
 #include "sg_strmap.h"
+#include "sg_extra.h"
+#include "sg_httpform.h"
 #include "sg_httpreq.h"
 #include "sg_httpsrv.h"
 
@@ -57,6 +66,12 @@ static int sg__httpuplds_add(struct sg_httpsrv *srv, struct sg_httpreq *req,
   req->curr_upld->encoding = sg__strdup(transfer_encoding);
   req->curr_upld->save_cb = srv->upld_save_cb;
   req->curr_upld->save_as_cb = srv->upld_save_as_cb;
+  if (srv->upld_digests != 0) {
+    req->curr_upld->digest = sg_malloc(sizeof(struct sg__digest));
+    if (!req->curr_upld->digest)
+      goto error;
+    sg__digest_init(req->curr_upld->digest, srv->upld_digests);
+  }
   return 0;
 error:
   sg__httpuplds_free(NULL, req);
@@ -73,6 +88,7 @@ static void sg__httpuplds_free(struct sg_httpsrv *srv, struct sg_httpreq *req) {
   sg_free(req->curr_upld->name);
   sg_free(req->curr_upld->mime);
   sg_free(req->curr_upld->encoding);
+  sg_free(req->curr_upld->digest);
   sg_free(req->curr_upld);
 }
 
@@ -82,11 +98,12 @@ static enum MHD_Result
                      const char *content_type, const char *transfer_encoding,
                      const char *data, uint64_t off, size_t size) {
   struct sg__httpupld_holder *holder;
-  char *val;
   if (/*kind == MHD_POSTDATA_KIND && */ size > 0) {
     holder = cls;
     if (filename) {
       if (off == 0) {
+        if (holder->req->curr_upld && (holder->srv->upld_cb == sg__httpupld_cb))
+          sg__httpupld_trim(holder->req->curr_upld->handle);
         if ((sg__httpuplds_add(holder->srv, holder->req, key, filename,
                                content_type, transfer_encoding) != 0) ||
             (holder->srv->upld_cb(holder->srv->upld_cls,
@@ -94,11 +111,18 @@ static enum MHD_Result
                                   holder->srv->uplds_dir, key, filename,
                                   content_type, transfer_encoding) != 0))
           return MHD_NO;
+#ifdef SG_HTTP_UPLD_URING
+        if (holder->srv->upld_cb == sg__httpupld_cb)
+          sg__httpupld_attach(holder->req->curr_upld->handle, holder->req);
+#endif /* SG_HTTP_UPLD_URING */
       }
       if (holder->srv->upld_write_cb(holder->req->curr_upld->handle, off, data,
                                      size) == -1)
         return MHD_NO;
       holder->req->curr_upld->size += size;
+      /* hashed while still in cache, instead of reading the file back */
+      if (holder->req->curr_upld->digest)
+        sg__digest_update(holder->req->curr_upld->digest, data, size);
       if (holder->srv->uplds_limit > 0) {
         holder->req->total_uplds_size += size;
         if (holder->req->total_uplds_size > holder->srv->uplds_limit) {
@@ -108,17 +132,17 @@ static enum MHD_Result
       }
     } else {
       if (off == 0) {
-        holder->req->curr_field = sg__strmap_new(key, data);
+        holder->req->curr_field = sg__strmap_new2(key, data, size);
         if (!holder->req->curr_field)
           return MHD_NO;
-        HASH_ADD_STR(holder->req->fields, key, holder->req->curr_field);
-      } else {
-        val = sg_realloc(holder->req->curr_field->val, off + size + 1);
-        if (!val)
+        if (sg__strmap_insert(&holder->req->fields, holder->req->curr_field) !=
+            0) {
+          sg__strmap_free(holder->req->curr_field);
+          holder->req->curr_field = NULL;
           return MHD_NO;
-        holder->req->curr_field->val = val;
-        memcpy(holder->req->curr_field->val + off, data, size + 1);
-      }
+        }
+      } else if (sg__strmap_append(holder->req->curr_field, data, size) != 0)
+        return MHD_NO;
       if (holder->srv->payld_limit > 0) {
         holder->req->total_fields_size += size;
         if (holder->req->total_fields_size > holder->srv->payld_limit) {
@@ -131,34 +155,367 @@ static enum MHD_Result
   return MHD_YES;
 }
 
+#ifdef SG_HTTP_COMPRESSION
+
+/* Returns the window bits to inflate a body sent with the content coding
+ * `enc`, zero if it is not compressed, or -1 if the coding is not
+ * supported. */
+static int sg__httpuplds_zbits(const char *enc) {
+  static const struct {
+    const char *name;
+    int bits;
+  } codings[] = {{"identity", 0},
+                 {"gzip", 15 + 16},
+                 {"x-gzip", 15 + 16},
+                 {"deflate", 15}};
+  size_t i, j, len;
+  if (!enc)
+    return 0;
+  while ((*enc == ' ') || (*enc == '\t'))
+    enc++;
+  for (len = strlen(enc);
+       (len > 0) && ((enc[len - 1] == ' ') || (enc[len - 1] == '\t')); len--)
+    ;
+  if (len == 0)
+    return 0;
+  for (i = 0; i < sizeof(codings) / sizeof(codings[0]); i++) {
+    for (j = 0;
+         (j < len) && (tolower((unsigned char) enc[j]) == codings[i].name[j]);
+         j++)
+      ;
+    if ((j == len) && (codings[i].name[j] == '\0'))
+      return codings[i].bits;
+  }
+  return -1;
+}
+
+#endif /* SG_HTTP_COMPRESSION */
+
+bool sg__httpuplds_begin(struct sg_httpsrv *srv, struct sg_httpreq *req,
+                         const char *content_type, const char *content_length,
+                         const char *content_encoding) {
+  unsigned long long size;
+  char *end;
+  if (req->body_cb)
+    return true;
+#ifdef SG_HTTP_COMPRESSION
+  req->zbits = sg__httpuplds_zbits(content_encoding);
+  if (req->zbits == -1) {
+    sg_httpres_send(req->res, _("Unsupported content encoding."), "text/plain",
+                    415);
+    return false;
+  }
+#else  /* SG_HTTP_COMPRESSION */
+  (void) content_encoding;
+#endif /* SG_HTTP_COMPRESSION */
+  if (!content_length)
+    return true;
+  errno = 0;
+  size = strtoull(content_length, &end, 10);
+  if ((errno != 0) || (end == content_length) || (*end != '\0') ||
+      (*content_length == '-'))
+    return true;
+  /* form bodies are parsed instead of kept as the payload */
+  if (sg__httpform_kind(content_type) != SG__HTTPFORM_NONE)
+    return true;
+  req->sized = true;
+  if ((srv->payld_limit > 0) && (size > srv->payld_limit)) {
+    /* answers before reading the body, which MHD then discards */
+    sg_httpres_send(req->res, _("Payload too large."), "text/plain", 413);
+    return false;
+  }
+  /* a client announcing a large body does not get it allocated up front */
+  if (size > 0)
+    sg_str_reserve(req->payload, size < SG__HTTPUPLDS_RESERVE_MAX
+                                   ? (size_t) size
+                                   : SG__HTTPUPLDS_RESERVE_MAX);
+  return true;
+}
+
+static int sg__httpuplds_append(struct sg_httpreq *req, const char *data,
+                                size_t size, uint64_t *total) {
+  int errnum;
+  if (req->sized) {
+    errnum = sg_str_write(req->payload, data, size);
+    *total = req->payload->i;
+    return errnum;
+  }
+  /* unknown length (e.g. chunked): small bodies are written as they arrive,
+   * larger ones are collected in chunks joined once the body is complete */
+  if (!req->chunks && (size <= SG__HTTPUPLDS_RESERVE_MAX - req->payload->i)) {
+    errnum = sg_str_write(req->payload, data, size);
+    *total = req->payload->i;
+    return errnum;
+  }
+  if (!req->chunks) {
+    req->chunks = sg_rope_new();
+    if (!req->chunks)
+      return ENOMEM;
+  }
+  errnum = sg_rope_write(req->chunks, data, size);
+  *total = req->payload->i + req->chunks->size;
+  return errnum;
+}
+
+static void sg__httpuplds_sink(struct sg_httpreq *req, const char *upld_data,
+                               size_t *upld_data_size, int *ret) {
+  ssize_t size;
+  bool resumed;
+  sg__httpsrv_lock(req->srv);
+  req->body_sinking = true;
+  sg__httpsrv_unlock(req->srv);
+  size = req->body_cb(req->body_cls, req, upld_data, *upld_data_size);
+  sg__httpsrv_lock(req->srv);
+  req->body_sinking = false;
+  resumed = req->body_resumed;
+  req->body_resumed = false;
+  if ((size >= 0) && ((size_t) size < *upld_data_size) && !resumed) {
+    /* keeps the remaining data buffered by MHD and stops reading the socket
+     * until the sink asks for more */
+    req->body_paused = true;
+    MHD_suspend_connection(req->con);
+  }
+  sg__httpsrv_unlock(req->srv);
+  if (size < 0) {
+    *ret = MHD_NO;
+    return;
+  }
+  *ret = MHD_YES;
+  if ((size_t) size >= *upld_data_size)
+    *upld_data_size = 0;
+  else
+    *upld_data_size -= (size_t) size;
+}
+
+#ifdef SG_HTTP_UPLD_URING
+
+static void sg__httpuplds_resume(void *cls) {
+  struct sg_httpreq *req = cls;
+  sg__httpsrv_lock(req->srv);
+  if (req->upld_paused) {
+    req->upld_paused = false;
+    MHD_resume_connection(req->con);
+  }
+  sg__httpsrv_unlock(req->srv);
+}
+
+/* Submits the writes queued while parsing the chunk in a single batch, and
+ * stops reading the socket while the disk is behind. */
+static void sg__httpuplds_flush(struct sg_httpsrv *srv,
+                                struct sg_httpreq *req) {
+  struct sg__httpupld *upld;
+  if (!req->curr_upld || (srv->upld_cb != sg__httpupld_cb))
+    return;
+  upld = req->curr_upld->handle;
+  if (!upld || !upld->uring.writer)
+    return;
+  /* write errors are reported by the next write */
+  sg__uring_flush(&upld->uring, false);
+  sg__httpsrv_lock(srv);
+  if (sg__uring_pause(&upld->uring)) {
+    req->upld_paused = true;
+    MHD_suspend_connection(req->con);
+  }
+  sg__httpsrv_unlock(srv);
+}
+
+#endif /* SG_HTTP_UPLD_URING */
+
+/* Hands a piece of the (decompressed) body to the form parser, or appends it
+ * to the payload. */
+static bool sg__httpuplds_feed(struct sg_httpsrv *srv, struct sg_httpreq *req,
+                               struct MHD_Connection *con, const char *data,
+                               size_t size) {
+  struct sg__httpupld_holder holder = {srv, req};
+  uint64_t total;
+  if (!req->form)
+    req->form = sg__httpform_new(
+      MHD_lookup_connection_value(con, MHD_HEADER_KIND,
+                                  MHD_HTTP_HEADER_CONTENT_TYPE),
+      srv->post_buf_size, sg__httpuplds_iter);
+  if (req->form)
+    return sg__httpform_parse(req->form, &holder, data, size) == 0;
+  if (sg__httpuplds_append(req, data, size, &total) != 0)
+    return false;
+  if ((srv->payld_limit > 0) && (total > srv->payld_limit)) {
+    sg_str_clear(req->payload);
+    sg_rope_clear(req->chunks);
+    srv->err_cb(srv->cls, _("Payload too large.\n"));
+    return false;
+  }
+  return true;
+}
+
+#ifdef SG_HTTP_COMPRESSION
+
+void sg__httpuplds_zfree(struct sg__httpuplds_zbody *zbody) {
+  if (!zbody)
+    return;
+  inflateEnd(&zbody->stream);
+  sg_free(zbody);
+}
+
+static struct sg__httpuplds_zbody *
+sg__httpuplds_znew(struct sg_httpsrv *srv, struct sg_httpreq *req,
+                   struct MHD_Connection *con) {
+  struct sg__httpuplds_zbody *zbody = sg_malloc(sizeof(*zbody));
+  if (!zbody)
+    return NULL;
+  memset(&zbody->stream, 0, sizeof(z_stream));
+  zbody->stream.zalloc = sg__zalloc;
+  zbody->stream.zfree = sg__zfree;
+  if (inflateInit2(&zbody->stream, req->zbits) != Z_OK) {
+    sg_free(zbody);
+    return NULL;
+  }
+  zbody->size = 0;
+  zbody->hdr_len = 0;
+  zbody->raw = false;
+  zbody->ended = false;
+  /* protects against bombs: the fields and the files of a form are already
+   * bounded by their own limits, which are summed up to bound the markup
+   * around them as well */
+  if (!req->form &&
+      (sg__httpform_kind(MHD_lookup_connection_value(
+         con, MHD_HEADER_KIND, MHD_HTTP_HEADER_CONTENT_TYPE)) ==
+       SG__HTTPFORM_NONE))
+    zbody->limit = srv->payld_limit;
+  else if ((srv->payld_limit > 0) && (srv->uplds_limit > 0))
+    zbody->limit = srv->payld_limit + srv->uplds_limit;
+  else
+    zbody->limit = 0;
+  return zbody;
+}
+
+/* Inflates the data through the window, handing each output to
+ * sg__httpuplds_feed(), so neither the compressed nor the decompressed body
+ * is ever held whole. */
+static bool sg__httpuplds_zrun(struct sg_httpsrv *srv, struct sg_httpreq *req,
+                               struct MHD_Connection *con, const Bytef *data,
+                               size_t size) {
+  struct sg__httpuplds_zbody *zbody = req->zbody;
+  size_t len;
+  int ret;
+  /* MHD hands out pieces of its connection buffer, far below 4 GB */
+  zbody->stream.next_in = (z_const Bytef *) data;
+  zbody->stream.avail_in = (uInt) size;
+  do {
+    if (zbody->ended) {
+      /* ignores anything after the end of a deflate stream */
+      if (req->zbits == 15)
+        break;
+      /* gzip allows several members in a row, even across pieces */
+      if (inflateReset(&zbody->stream) != Z_OK)
+        return false;
+      zbody->ended = false;
+    }
+    zbody->stream.next_out = zbody->buf;
+    zbody->stream.avail_out = sizeof(zbody->buf);
+    ret = inflate(&zbody->stream, Z_NO_FLUSH);
+    if ((ret != Z_OK) && (ret != Z_STREAM_END) && (ret != Z_BUF_ERROR)) {
+      srv->err_cb(srv->cls, _("Invalid compressed payload.\n"));
+      return false;
+    }
+    len = sizeof(zbody->buf) - zbody->stream.avail_out;
+    zbody->size += len;
+    if ((zbody->limit > 0) && (zbody->size > zbody->limit)) {
+      srv->err_cb(srv->cls, _("Payload too large.\n"));
+      return false;
+    }
+    if ((len > 0) &&
+        !sg__httpuplds_feed(srv, req, con, (const char *) zbody->buf, len))
+      return false;
+    if (ret == Z_STREAM_END)
+      zbody->ended = true;
+  } while ((zbody->stream.avail_in > 0) ||
+           (!zbody->ended && (zbody->stream.avail_out == 0)));
+  return true;
+}
+
+/* Checks the CMF and FLG bytes of a zlib header (RFC 1950). */
+static bool sg__httpuplds_is_zlib(const Bytef *hdr) {
+  return ((hdr[0] & 0x0f) == Z_DEFLATED) && ((hdr[0] >> 4) <= 7) &&
+         ((((unsigned int) hdr[0] << 8) | hdr[1]) % 31 == 0);
+}
+
+static bool sg__httpuplds_inflate(struct sg_httpsrv *srv,
+                                  struct sg_httpreq *req,
+                                  struct MHD_Connection *con, const char *data,
+                                  size_t size) {
+  if (!req->zbody) {
+    req->zbody = sg__httpuplds_znew(srv, req, con);
+    if (!req->zbody)
+      return false;
+  }
+  if ((req->zbits == 15) && (req->zbody->hdr_len < 2)) {
+    /* `deflate` is sometimes sent as a bare stream, which is told apart by
+     * its first two bytes, whatever pieces they arrive in */
+    while ((req->zbody->hdr_len < 2) && (size > 0)) {
+      req->zbody->hdr[req->zbody->hdr_len++] = (Bytef) *data++;
+      size--;
+    }
+    if (req->zbody->hdr_len < 2)
+      return true;
+    if (!sg__httpuplds_is_zlib(req->zbody->hdr)) {
+      req->zbody->raw = true;
+      if (inflateReset2(&req->zbody->stream, -15) != Z_OK)
+        return false;
+    }
+    if (!sg__httpuplds_zrun(srv, req, con, req->zbody->hdr, 2))
+      return false;
+  }
+  if (size == 0)
+    return true;
+  return sg__httpuplds_zrun(srv, req, con, (const Bytef *) data, size);
+}
+
+#endif /* SG_HTTP_COMPRESSION */
+
 bool sg__httpuplds_process(struct sg_httpsrv *srv, struct sg_httpreq *req,
                            struct MHD_Connection *con, const char *upld_data,
                            size_t *upld_data_size, int *ret) {
-  struct sg__httpupld_holder holder = {srv, req};
+  bool ok;
   if (*upld_data_size > 0) {
     req->is_uploading = true;
-    if (!req->pp)
-      req->pp = MHD_create_post_processor(con, srv->post_buf_size,
-                                          sg__httpuplds_iter, &holder);
-    if (req->pp) {
-      if (MHD_post_process(req->pp, upld_data, *upld_data_size) != MHD_YES) {
-        *ret = MHD_NO;
-        return true;
-      }
-    } else {
-      utstring_bincpy(req->payload->buf, upld_data, *upld_data_size);
-      if ((srv->payld_limit > 0) &&
-          (utstring_len(req->payload->buf) > srv->payld_limit)) {
-        *ret = MHD_NO;
-        utstring_clear(req->payload->buf);
-        srv->err_cb(srv->cls, _("Payload too large.\n"));
-        return true;
-      }
+    if (req->body_cb) {
+      sg__httpuplds_sink(req, upld_data, upld_data_size, ret);
+      return true;
+    }
+#ifdef SG_HTTP_COMPRESSION
+    if (req->zbits != 0)
+      ok = sg__httpuplds_inflate(srv, req, con, upld_data, *upld_data_size);
+    else
+#endif /* SG_HTTP_COMPRESSION */
+      ok = sg__httpuplds_feed(srv, req, con, upld_data, *upld_data_size);
+    if (!ok) {
+      *ret = MHD_NO;
+      return true;
     }
+#ifdef SG_HTTP_UPLD_URING
+    if (req->form)
+      sg__httpuplds_flush(srv, req);
+#endif /* SG_HTTP_UPLD_URING */
     *upld_data_size = 0;
     *ret = MHD_YES;
     return true;
   }
+#ifdef SG_HTTP_COMPRESSION
+  if (req && req->zbody && !req->zbody->ended) {
+    *ret = MHD_NO;
+    srv->err_cb(srv->cls, _("Incomplete compressed payload.\n"));
+    return true;
+  }
+#endif /* SG_HTTP_COMPRESSION */
+  if (req && req->curr_upld && (srv->upld_cb == sg__httpupld_cb))
+    sg__httpupld_trim(req->curr_upld->handle);
+  if (!req || !req->chunks)
+    return false;
+  if (sg__rope_flatten(req->chunks, req->payload) != 0) {
+    *ret = MHD_NO;
+    return true;
+  }
+  sg_rope_free(req->chunks);
+  req->chunks = NULL;
   return false;
 }
 
@@ -170,77 +527,444 @@ void sg__httpuplds_cleanup(struct sg_httpsrv *srv, struct sg_httpreq *req) {
   }
 }
 
+#ifdef SG_HTTP_UPLD_URING
+
+void sg__httpupld_attach(void *handle, struct sg_httpreq *req) {
+  struct sg__httpupld *upld = handle;
+  struct sg_httpsrv *srv = upld->srv;
+  struct sg__uring_writer *writer;
+  sg__httpsrv_lock(srv);
+  if (!srv->upld_writer && !srv->upld_writer_failed) {
+    srv->upld_writer = sg__uring_writer_new(sg__httpuplds_resume);
+    /* e.g. io_uring disabled by the kernel or a seccomp filter: keeps writing
+     * synchronously */
+    srv->upld_writer_failed = !srv->upld_writer;
+  }
+  writer = srv->upld_writer;
+  sg__httpsrv_unlock(srv);
+  if (writer)
+    sg__uring_file_init(&upld->uring, writer, upld->fd, req);
+}
+
+#endif /* SG_HTTP_UPLD_URING */
+
+#ifdef SG__HTTPUPLD_TMPFILE
+
+void sg__httpuplds_close_dir(struct sg_httpsrv *srv) {
+  if (srv->uplds_dirfd != -1)
+    close(srv->uplds_dirfd);
+  srv->uplds_dirfd = -1;
+}
+
+/* Opens the uploads directory once, so the files are created relative to it
+ * without looking it up again. */
+static int sg__httpupld_dirfd(struct sg_httpsrv *srv, const char *dir) {
+  int fd;
+  sg__httpsrv_lock(srv);
+  if (srv->uplds_dirfd == -1) {
+    srv->uplds_dirfd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    /* anonymous files can be linked only through their `/proc` entries */
+    srv->uplds_tmpfile =
+      (srv->uplds_dirfd != -1) && (access("/proc/self/fd", X_OK) == 0);
+  }
+  fd = srv->uplds_dirfd;
+  sg__httpsrv_unlock(srv);
+  return fd;
+}
+
+/* Validates the server uploads directory through its cached descriptor, so it
+ * is looked up only at first use. Other directories are not kept open. */
+static int sg__httpupld_find_dir(struct sg_httpsrv *srv, const char *dir,
+                                 int *dirfd) {
+  char err[SG_ERR_SIZE >> 2];
+  if (!srv->uplds_dir || (strcmp(dir, srv->uplds_dir) != 0))
+    return EOPNOTSUPP;
+  *dirfd = sg__httpupld_dirfd(srv, dir);
+  if (*dirfd != -1)
+    return 0;
+  if (errno == ENOTDIR) {
+    sg__httpsrv_eprintf(srv, _("Cannot access uploads directory \"%s\": %s.\n"),
+                        dir, sg_strerror(ENOTDIR, err, sizeof(err)));
+    return ENOTDIR;
+  }
+  sg__httpsrv_eprintf(srv, _("Cannot find uploads directory \"%s\": %s.\n"),
+                      dir, sg_strerror(errno, err, sizeof(err)));
+  return ENOENT;
+}
+
+static int sg__httpupld_tmpfile(struct sg__httpupld *upld, const char *dir) {
+  char err[SG_ERR_SIZE >> 2];
+  struct sg_httpsrv *srv = upld->srv;
+  int dirfd, errnum;
+  errnum = sg__httpupld_find_dir(srv, dir, &dirfd);
+  if (errnum != 0)
+    return errnum;
+  if (!srv->uplds_tmpfile)
+    return EOPNOTSUPP;
+  upld->fd = openat(dirfd, ".", O_TMPFILE | O_RDWR | O_CLOEXEC, 0600);
+  if (upld->fd != -1)
+    return 0;
+  /* the file system does not support anonymous files */
+  if ((errno == EOPNOTSUPP) || (errno == EISDIR) || (errno == EINVAL)) {
+    srv->uplds_tmpfile = false;
+    return EOPNOTSUPP;
+  }
+  sg__httpsrv_eprintf(srv,
+                      _("Cannot create temporary upload file in \"%s\": %s.\n"),
+                      dir, sg_strerror(errno, err, sizeof(err)));
+  return errno;
+}
+
+static int sg__httpupld_link(struct sg__httpupld *upld, const char *path) {
+  char proc[32];
+  snprintf(proc, sizeof(proc), "/proc/self/fd/%d", upld->fd);
+  return linkat(AT_FDCWD, proc, AT_FDCWD, path, AT_SYMLINK_FOLLOW);
+}
+
+#else /* SG__HTTPUPLD_TMPFILE */
+
+void sg__httpuplds_close_dir(__SG_UNUSED struct sg_httpsrv *srv) {
+}
+
+#endif /* SG__HTTPUPLD_TMPFILE */
+
+static int sg__httpupld_check_dir(struct sg__httpupld *upld,
+                                  const char *dir) {
+  char err[SG_ERR_SIZE >> 2];
+  struct stat sbuf;
+  if (stat(dir, &sbuf)) {
+    sg__httpsrv_eprintf(upld->srv,
+                        _("Cannot find uploads directory \"%s\": %s.\n"), dir,
+                        sg_strerror(errno, err, sizeof(err)));
+    return ENOENT;
+  }
+  if (!S_ISDIR(sbuf.st_mode)) {
+    sg__httpsrv_eprintf(upld->srv,
+                        _("Cannot access uploads directory \"%s\": %s.\n"),
+                        dir, sg_strerror(ENOTDIR, err, sizeof(err)));
+    return ENOTDIR;
+  }
+  return 0;
+}
+
+static int sg__httpupld_mkstemp(struct sg__httpupld *upld, const char *dir) {
+  char err[SG_ERR_SIZE >> 2];
+  int errnum = sg__httpupld_check_dir(upld, dir);
+  if (errnum != 0)
+    return errnum;
+  upld->path = sg__strjoin(PATH_SEP, dir, "sg_upld_tmp_XXXXXX");
+  if (!upld->path)
+    return ENOMEM;
+  upld->fd = mkstemp(upld->path);
+  if (upld->fd == -1) {
+    errnum = errno;
+    sg__httpsrv_eprintf(
+      upld->srv, _("Cannot create temporary upload file in \"%s\": %s.\n"),
+      dir, sg_strerror(errnum, err, sizeof(err)));
+    return errnum;
+  }
+  return 0;
+}
+
+static int sg__httpupld_open(struct sg__httpupld *upld, const char *dir) {
+#ifdef SG__HTTPUPLD_TMPFILE
+  int errnum = sg__httpupld_tmpfile(upld, dir);
+  if (errnum == EOPNOTSUPP)
+    errnum = sg__httpupld_mkstemp(upld, dir);
+  return errnum;
+#else /* SG__HTTPUPLD_TMPFILE */
+  return sg__httpupld_mkstemp(upld, dir);
+#endif /* SG__HTTPUPLD_TMPFILE */
+}
+
+/* Moves an upload kept in memory to its file. */
+static int sg__httpupld_spill(struct sg__httpupld *upld) {
+  size_t off = 0;
+  ssize_t ret;
+  int errnum = sg__httpupld_open(upld, upld->dir);
+  if (errnum != 0)
+    return errnum;
+  upld->in_mem = false;
+#ifdef SG_HTTP_UPLD_URING
+  if (upld->uring.writer) {
+    upld->uring.fd = upld->fd;
+    errnum = sg__uring_write(&upld->uring, upld->mem, (size_t) upld->size);
+    goto done;
+  }
+#endif /* SG_HTTP_UPLD_URING */
+  while (off < upld->size) {
+    ret = write(upld->fd, upld->mem + off, (size_t) upld->size - off);
+    if (ret < 0) {
+      if (errno == EINTR)
+        continue;
+      errnum = errno;
+      goto done;
+    }
+    off += (size_t) ret;
+  }
+done:
+  sg_free(upld->mem);
+  upld->mem = NULL;
+  upld->mem_cap = 0;
+  sg_free(upld->dir);
+  upld->dir = NULL;
+  return errnum;
+}
+
+/* Appends to an upload kept in memory, spilling it when it gets too large. */
+static int sg__httpupld_mem_write(struct sg__httpupld *upld, const char *buf,
+                                  size_t size) {
+  size_t len = (size_t) upld->size, cap;
+  char *mem;
+  if (size > upld->srv->upld_mem_limit - len)
+    return sg__httpupld_spill(upld);
+  if (len + size > upld->mem_cap) {
+    cap = upld->mem_cap > 0 ? upld->mem_cap * 2 : 256;
+    if (cap < len + size)
+      cap = len + size;
+    if (cap > upld->srv->upld_mem_limit)
+      cap = upld->srv->upld_mem_limit;
+    mem = sg_realloc(upld->mem, cap);
+    if (!mem)
+      return ENOMEM;
+    upld->mem = mem;
+    upld->mem_cap = cap;
+  }
+  memcpy(upld->mem + len, buf, size);
+  upld->size += size;
+  return 0;
+}
+
 int sg__httpupld_cb(void *cls, void **handle, const char *dir,
                     __SG_UNUSED const char *field, const char *name,
                     __SG_UNUSED const char *mime,
                     __SG_UNUSED const char *encoding) {
-  char err[SG_ERR_SIZE >> 2];
   struct sg__httpupld *upld;
-  struct stat sbuf;
   int errnum;
+#ifdef SG__HTTPUPLD_TMPFILE
+  int dirfd;
+#endif /* SG__HTTPUPLD_TMPFILE */
   upld = sg_alloc(sizeof(struct sg__httpupld));
   if (!upld)
     return ENOMEM;
   upld->fd = -1;
   upld->srv = cls;
-  if (stat(dir, &sbuf)) {
-    sg__httpsrv_eprintf(cls, _("Cannot find uploads directory \"%s\": %s.\n"),
-                        dir, sg_strerror(errno, err, sizeof(err)));
-    errnum = ENOENT;
-    goto error_dir;
-  }
-  if (!S_ISDIR(sbuf.st_mode)) {
-    sg__httpsrv_eprintf(cls, _("Cannot access uploads directory \"%s\": %s.\n"),
-                        dir, sg_strerror(ENOTDIR, err, sizeof(err)));
-    errnum = ENOTDIR;
-    goto error_dir;
-  }
-  upld->path = sg__strjoin(PATH_SEP, dir, "sg_upld_tmp_XXXXXX");
-  if (!upld->path) {
-    errnum = ENOMEM;
-    goto error_path;
+  if (upld->srv && (upld->srv->upld_mem_limit > 0)) {
+    /* the file is created only if the upload outgrows the memory limit, which
+     * looks the directory up again */
+#ifdef SG__HTTPUPLD_TMPFILE
+    errnum = sg__httpupld_find_dir(upld->srv, dir, &dirfd);
+    if ((errnum != 0) && (errnum != EOPNOTSUPP))
+      goto error;
+#endif /* SG__HTTPUPLD_TMPFILE */
+    upld->dir = sg__strdup(dir);
+    if (!upld->dir) {
+      errnum = ENOMEM;
+      goto error;
+    }
+    upld->in_mem = true;
+  } else {
+    errnum = sg__httpupld_open(upld, dir);
+    if (errnum != 0)
+      goto error;
   }
   upld->dest = sg__strjoin(PATH_SEP, dir, name);
   if (!upld->dest) {
     errnum = ENOMEM;
-    goto error_path;
-  }
-  upld->fd = mkstemp(upld->path);
-  if (upld->fd == -1) {
-    errnum = errno;
-    sg__httpsrv_eprintf(
-      cls, _("Cannot create temporary upload file in \"%s\": %s.\n"), dir,
-      sg_strerror(errnum, err, sizeof(err)));
-    goto error_path;
+    goto error;
   }
   *handle = upld;
   return 0;
-error_path:
-  sg_free(upld->path);
-  sg_free(upld->dest);
-error_dir:
-  sg_free(upld);
+error:
+  sg__httpupld_free_cb(upld);
   return errnum;
 }
 
 ssize_t sg__httpupld_write_cb(void *handle, __SG_UNUSED uint64_t offset,
                               const char *buf, size_t size) {
-  return write(((struct sg__httpupld *) handle)->fd, buf, size);
+  struct sg__httpupld *upld = handle;
+  ssize_t ret;
+  int errnum;
+  if (upld->in_mem) {
+    errnum = sg__httpupld_mem_write(upld, buf, size);
+    if (errnum != 0) {
+      errno = errnum;
+      return -1;
+    }
+    if (upld->in_mem)
+      return (ssize_t) size;
+  }
+  sg__httpupld_reserve(upld, upld->size + size);
+#ifdef SG_HTTP_UPLD_URING
+  if (upld->uring.writer) {
+    errnum = sg__uring_write(&upld->uring, buf, size);
+    if (errnum != 0) {
+      errno = errnum;
+      return -1;
+    }
+    upld->size += size;
+    return (ssize_t) size;
+  }
+#endif /* SG_HTTP_UPLD_URING */
+  ret = write(upld->fd, buf, size);
+  if (ret > 0)
+    upld->size += (uint64_t) ret;
+  return ret;
 }
 
 void sg__httpupld_free_cb(void *handle) {
   struct sg__httpupld *upld = handle;
   if (!upld)
     return;
+#ifdef SG_HTTP_UPLD_URING
+  if (upld->uring.writer)
+    sg__uring_drain(&upld->uring);
+#endif /* SG_HTTP_UPLD_URING */
   if (upld->fd != -1)
     close(upld->fd);
   upld->fd = -1;
-  unlink(upld->path);
+  if (upld->path)
+    unlink(upld->path);
   sg_free(upld->path);
   sg_free(upld->dest);
+  sg_free(upld->dir);
+  sg_free(upld->mem);
   sg_free(upld);
 }
 
+void sg__httpupld_reserve(void *handle, uint64_t size) {
+#ifdef __linux__
+  struct sg__httpupld *upld = handle;
+  uint64_t end;
+  if (upld->in_mem || (size < SG__HTTPUPLD_RESERVE_MIN) ||
+      (size <= upld->reserved))
+    return;
+  /* stays one step ahead of the received data instead of trusting the size
+   * announced by the client */
+  end = size + SG__HTTPUPLD_RESERVE_STEP;
+  if (upld->srv && (upld->srv->uplds_limit > 0) &&
+      (end > upld->srv->uplds_limit))
+    end = upld->srv->uplds_limit;
+  if ((end <= upld->reserved) || (end > INT64_MAX))
+    return;
+  /* best effort: the writes still work if the file system refuses it, and
+   * it is not retried */
+  if (fallocate(upld->fd, 0, (off_t) upld->reserved,
+                (off_t) (end - upld->reserved)) != 0)
+    end = UINT64_MAX;
+  upld->reserved = end;
+#else /* __linux__ */
+  (void) handle;
+  (void) size;
+#endif /* __linux__ */
+}
+
+void sg__httpupld_trim(void *handle) {
+  struct sg__httpupld *upld = handle;
+#ifdef SG_HTTP_UPLD_URING
+  /* the part is complete, so its last buffer goes out now; the writes in
+   * flight are all below the final size */
+  if (upld && upld->uring.writer)
+    sg__uring_flush(&upld->uring, true);
+#endif /* SG_HTTP_UPLD_URING */
+  if (upld && (upld->reserved > upld->size) && (upld->fd != -1) &&
+      (ftruncate(upld->fd, (off_t) upld->size) == 0))
+    upld->reserved = 0;
+}
+
+static int sg__httpupld_sync(struct sg__httpupld *upld, int fd) {
+  if (!upld->srv || (upld->srv->upld_sync == SG_HTTPUPLD_SYNC_NONE))
+    return 0;
+#ifdef _WIN32
+  return _commit(fd) ? errno : 0;
+#else /* _WIN32 */
+#ifdef __linux__
+  if (upld->srv->upld_sync == SG_HTTPUPLD_SYNC_DATA)
+    return fdatasync(fd) ? errno : 0;
+#endif /* __linux__ */
+  return fsync(fd) ? errno : 0;
+#endif /* _WIN32 */
+}
+
+static void sg__httpupld_sync_dir(struct sg__httpupld *upld, const char *path) {
+#ifndef _WIN32
+  const char *sep;
+  char *dir;
+  int fd;
+  if (!upld->srv || (upld->srv->upld_sync != SG_HTTPUPLD_SYNC_FULL))
+    return;
+  sep = strrchr(path, PATH_SEP);
+  if (!sep)
+    dir = sg__strdup(".");
+  else if (sep == path)
+    dir = sg__strdup("/");
+  else {
+    dir = sg_malloc((size_t) (sep - path) + 1);
+    if (dir) {
+      memcpy(dir, path, (size_t) (sep - path));
+      dir[sep - path] = '\0';
+    }
+  }
+  if (!dir)
+    return;
+  fd = open(dir, O_RDONLY);
+  sg_free(dir);
+  if (fd == -1)
+    return;
+  fsync(fd);
+  close(fd);
+#else /* _WIN32 */
+  (void) upld;
+  (void) path;
+#endif /* _WIN32 */
+}
+
+/* Writes an upload kept in memory straight at its destination. */
+static int sg__httpupld_save_mem(struct sg__httpupld *upld, const char *path,
+                                 bool overwritten) {
+  struct stat sbuf;
+  size_t off = 0;
+  ssize_t ret;
+  int fd, flags, errnum = 0;
+#ifdef _WIN32
+  wchar_t *file_name;
+#endif /* _WIN32 */
+  if ((stat(path, &sbuf) >= 0) && S_ISDIR(sbuf.st_mode))
+    return EISDIR;
+  flags = O_WRONLY | O_CREAT | O_TRUNC | (overwritten ? 0 : O_EXCL);
+#ifdef _WIN32
+  file_name = stow(path);
+  fd = SG__OPEN(file_name, flags | O_BINARY, 0600);
+  sg_free(file_name);
+#else /* _WIN32 */
+  fd = SG__OPEN(path, flags | O_CLOEXEC, 0600);
+#endif /* _WIN32 */
+  if (fd == -1)
+    return errno;
+  while (off < upld->size) {
+    ret = write(fd, upld->mem + off, (size_t) upld->size - off);
+    if (ret < 0) {
+      if (errno == EINTR)
+        continue;
+      errnum = errno;
+      break;
+    }
+    off += (size_t) ret;
+  }
+  if (errnum == 0)
+    errnum = sg__httpupld_sync(upld, fd);
+  if (close(fd) && (errnum == 0))
+    errnum = errno;
+  if (errnum != 0) {
+    unlink(path);
+    return errnum;
+  }
+  /* saved only once, as the uploads kept in files; the data stays readable */
+  upld->in_mem = false;
+  sg__httpupld_sync_dir(upld, path);
+  return 0;
+}
+
 int sg__httpupld_save_cb(void *handle, bool overwritten) {
   struct sg__httpupld *upld = handle;
   return upld ? sg__httpupld_save_as_cb(upld, upld->dest, overwritten) : EINVAL;
@@ -249,11 +973,48 @@ int sg__httpupld_save_cb(void *handle, bool overwritten) {
 int sg__httpupld_save_as_cb(void *handle, const char *path, bool overwritten) {
   struct sg__httpupld *upld = handle;
   struct stat sbuf;
-  if (!handle || !path || (upld->fd < 0))
+  int errnum;
+  if (!handle || !path)
     return EINVAL;
+  if (upld->in_mem)
+    return sg__httpupld_save_mem(upld, path, overwritten);
+  if (upld->fd < 0)
+    return EINVAL;
+#ifdef SG_HTTP_UPLD_URING
+  errnum = upld->uring.writer ? sg__uring_drain(&upld->uring) : 0;
+  sg__httpupld_trim(upld);
+  if (errnum == 0)
+    errnum = sg__httpupld_sync(upld, upld->fd);
+#else /* SG_HTTP_UPLD_URING */
+  sg__httpupld_trim(upld);
+  errnum = sg__httpupld_sync(upld, upld->fd);
+#endif /* SG_HTTP_UPLD_URING */
+#ifdef SG__HTTPUPLD_TMPFILE
+  if (!upld->path) {
+    /* anonymous files are published straight at their destination */
+    if ((errnum == 0) && sg__httpupld_link(upld, path)) {
+      errnum = errno;
+      if (errnum == EEXIST) {
+        if ((stat(path, &sbuf) >= 0) && S_ISDIR(sbuf.st_mode))
+          errnum = EISDIR;
+        else if (overwritten) {
+          unlink(path);
+          errnum = sg__httpupld_link(upld, path) ? errno : 0;
+        }
+      }
+    }
+    close(upld->fd);
+    upld->fd = -1;
+    if (errnum == 0)
+      sg__httpupld_sync_dir(upld, path);
+    return errnum;
+  }
+#endif /* SG__HTTPUPLD_TMPFILE */
   if (close(upld->fd))
     return errno;
   upld->fd = -1;
+  if (errnum != 0)
+    return errnum;
   if ((stat(path, &sbuf) >= 0) && S_ISDIR(sbuf.st_mode))
     return EISDIR;
   if (!access(path, F_OK)) {
@@ -264,9 +1025,61 @@ int sg__httpupld_save_as_cb(void *handle, const char *path, bool overwritten) {
   }
   if (sg__rename(upld->path, path))
     return errno;
+  sg__httpupld_sync_dir(upld, path);
   return 0;
 }
 
+const void *sg__httpupld_data(void *handle) {
+  struct sg__httpupld *upld = handle;
+  size_t off = 0;
+  ssize_t ret;
+  int errnum;
+  if (upld->in_mem || upld->mem)
+    return upld->mem ? upld->mem : "";
+  /* a saved file no longer belongs to the upload */
+  if (upld->fd < 0) {
+    errno = EBADF;
+    return NULL;
+  }
+  if (upld->size >= SIZE_MAX) {
+    errno = ENOMEM;
+    return NULL;
+  }
+#ifdef SG_HTTP_UPLD_URING
+  if (upld->uring.writer) {
+    errnum = sg__uring_drain(&upld->uring);
+    if (errnum != 0) {
+      errno = errnum;
+      return NULL;
+    }
+  }
+#endif /* SG_HTTP_UPLD_URING */
+  upld->mem = sg_malloc((size_t) upld->size + 1);
+  if (!upld->mem)
+    return NULL;
+  if (sg__lseek(upld->fd, 0, SEEK_SET) != 0)
+    goto error;
+  while (off < upld->size) {
+    ret = read(upld->fd, upld->mem + off, (size_t) upld->size - off);
+    if (ret <= 0) {
+      if ((ret < 0) && (errno == EINTR))
+        continue;
+      if (ret == 0)
+        errno = EIO;
+      goto error;
+    }
+    off += (size_t) ret;
+  }
+  sg__lseek(upld->fd, 0, SEEK_END);
+  return upld->mem;
+error:
+  errnum = errno;
+  sg_free(upld->mem);
+  upld->mem = NULL;
+  errno = errnum;
+  return NULL;
+}
+
 int sg_httpuplds_iter(struct sg_httpupld *uplds, sg_httpuplds_iter_cb cb,
                       void *cls) {
   struct sg_httpupld *tmp;
@@ -347,6 +1160,32 @@ uint64_t sg_httpupld_size(struct sg_httpupld *upld) {
   return 0;
 }
 
+const void *sg_httpupld_data(struct sg_httpupld *upld) {
+  if (!upld) {
+    errno = EINVAL;
+    return NULL;
+  }
+  if (upld->save_as_cb != sg__httpupld_save_as_cb) {
+    errno = ENOTSUP;
+    return NULL;
+  }
+  return sg__httpupld_data(upld->handle);
+}
+
+const char *sg_httpupld_digest(struct sg_httpupld *upld, enum sg_digest algo) {
+  if (!upld) {
+    errno = EINVAL;
+    return NULL;
+  }
+  if (!upld->digest) {
+    errno = ((algo == SG_DIGEST_CRC32C) || (algo == SG_DIGEST_SHA256))
+              ? ENOTSUP
+              : EINVAL;
+    return NULL;
+  }
+  return sg__digest_hex(upld->digest, algo);
+}
+
 int sg_httpupld_save(struct sg_httpupld *upld, bool overwritten) {
   if (upld)
     return upld->save_cb(upld->handle, overwritten);
@@ -30,9 +30,16 @@
 #include <stdint.h>
 #include "sg_macros.h"
 #include "utlist.h"
+#ifdef SG_HTTP_COMPRESSION
+#include "zlib.h"
+#endif /* SG_HTTP_COMPRESSION */
 #include "microhttpd.h"
 #include "sg_httpreq.h"
 #include "sg_httpsrv.h"
+#include "sg_digest.h"
+#ifdef SG_HTTP_UPLD_URING
+#include "sg_uring.h"
+#endif /* SG_HTTP_UPLD_URING */
 
 struct sg_httpupld {
   struct sg_httpupld *next;
@@ -44,21 +51,79 @@ struct sg_httpupld {
   char *name;
   char *mime;
   char *encoding;
+  struct sg__digest *digest;
   uint64_t size;
 };
 
+/* `path` is null when the file is anonymous (`O_TMPFILE`), in which case it
+ * gets a name only when it is saved. With io_uring, the writes are
+ * asynchronous when `uring.writer` is set.
+ * While `in_mem` is set, the upload has no file yet: its data is kept in
+ * `mem` until it outgrows the server memory limit and is spilled into a file
+ * created in `dir`. Otherwise `mem` caches the file loaded by
+ * sg__httpupld_data(). The file is preallocated up to `reserved` while it
+ * is written, and trimmed to `size` when the part ends. */
 struct sg__httpupld {
   struct sg_httpsrv *srv;
   int fd;
   char *path;
   char *dest;
+  char *dir;
+  char *mem;
+  size_t mem_cap;
+  uint64_t size;
+  uint64_t reserved;
+  bool in_mem;
+#ifdef SG_HTTP_UPLD_URING
+  struct sg__uring_file uring;
+#endif /* SG_HTTP_UPLD_URING */
 };
 
+/* Largest part of the payload reserved from `Content-Length`, and largest
+ * payload of unknown length kept out of chunks. The rest grows as the body
+ * arrives. */
+#define SG__HTTPUPLDS_RESERVE_MAX (4 * SG__BLOCK_SIZE)
+
+/* Smallest upload worth preallocating a file for. */
+#define SG__HTTPUPLD_RESERVE_MIN 65536
+
+/* How far ahead of the received data an upload file is preallocated. */
+#define SG__HTTPUPLD_RESERVE_STEP 1048576
+
+#ifdef SG_HTTP_COMPRESSION
+
+/* Size of the window request bodies are inflated through. */
+#define SG__HTTPUPLDS_ZBUF_SIZE 16384
+
+/* Inflates a compressed request body as it arrives. `size` counts the
+ * decompressed bytes, bounded by `limit` unless it is zero. A `deflate` body
+ * keeps its first two bytes in `hdr` until it is known whether it has the
+ * zlib header, and `raw` is set if it does not. `ended` is set at the end of
+ * each stream (or gzip member). */
+struct sg__httpuplds_zbody {
+  z_stream stream;
+  uint64_t size;
+  uint64_t limit;
+  Bytef hdr[2];
+  size_t hdr_len;
+  bool raw;
+  bool ended;
+  Bytef buf[SG__HTTPUPLDS_ZBUF_SIZE];
+};
+
+#endif /* SG_HTTP_COMPRESSION */
+
 struct sg__httpupld_holder {
   struct sg_httpsrv *srv;
   struct sg_httpreq *req;
 };
 
+SG__EXTERN bool sg__httpuplds_begin(struct sg_httpsrv *srv,
+                                    struct sg_httpreq *req,
+                                    const char *content_type,
+                                    const char *content_length,
+                                    const char *content_encoding);
+
 SG__EXTERN bool sg__httpuplds_process(struct sg_httpsrv *srv,
                                       struct sg_httpreq *req,
                                       struct MHD_Connection *con,
@@ -68,6 +133,26 @@ SG__EXTERN bool sg__httpuplds_process(struct sg_httpsrv *srv,
 SG__EXTERN void sg__httpuplds_cleanup(struct sg_httpsrv *srv,
                                       struct sg_httpreq *req);
 
+SG__EXTERN void sg__httpuplds_close_dir(struct sg_httpsrv *srv);
+
+#ifdef SG_HTTP_COMPRESSION
+
+SG__EXTERN void sg__httpuplds_zfree(struct sg__httpuplds_zbody *zbody);
+
+#endif /* SG_HTTP_COMPRESSION */
+
+SG__EXTERN void sg__httpupld_reserve(void *handle, uint64_t size);
+
+SG__EXTERN void sg__httpupld_trim(void *handle);
+
+SG__EXTERN const void *sg__httpupld_data(void *handle);
+
+#ifdef SG_HTTP_UPLD_URING
+
+SG__EXTERN void sg__httpupld_attach(void *handle, struct sg_httpreq *req);
+
+#endif /* SG_HTTP_UPLD_URING */
+
 SG__EXTERN int sg__httpupld_cb(void *cls, void **handle, const char *dir,
                                const char *field, const char *name,
                                const char *mime, const char *encoding);
@@ -0,0 +1,243 @@
+/*                         _
+ *   ___  __ _  __ _ _   _(_)
+ *  / __|/ _` |/ _` | | | | |
+ *  \__ \ (_| | (_| | |_| | |
+ *  |___/\__,_|\__, |\__,_|_|
+ *             |___/
+ *
+ * Cross-platform library which helps to develop web servers or frameworks.
+ *
+ * Copyright (C) 2016-2020 Silvio Clecio <silvioprog@gmail.com>
+ *
+ * Sagui library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * Sagui library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Sagui library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include "sg_macros.h"
+#include "microhttpd.h"
+#include "sagui.h"
+#include "sg_httpres.h"
+#include "sg_httpwrt.h"
+
+static void sg__httpwrt_destroy(struct sg_httpwrt *wrt) {
+  pthread_mutex_destroy(&wrt->mutex);
+  sg_free(wrt->buf);
+  sg_free(wrt);
+}
+
+static void sg__httpwrt_wake(struct sg_httpwrt *wrt) {
+  if (wrt->suspended) {
+    wrt->suspended = false;
+    MHD_resume_connection(wrt->con);
+  }
+}
+
+static int sg__httpwrt_append(struct sg_httpwrt *wrt, const void *buf,
+                              size_t size) {
+  size_t used = wrt->size - wrt->head, cap;
+  char *data;
+  if (size > wrt->cap - wrt->size) {
+    if (wrt->head > 0) {
+      memmove(wrt->buf, wrt->buf + wrt->head, used);
+      wrt->head = 0;
+      wrt->size = used;
+    }
+    if (size > wrt->cap - wrt->size) {
+      cap = wrt->cap > 0 ? wrt->cap : SG__BLOCK_SIZE;
+      while (cap < used + size)
+        cap *= 2;
+      data = sg_realloc(wrt->buf, cap);
+      if (!data)
+        return ENOMEM;
+      wrt->buf = data;
+      wrt->cap = cap;
+    }
+  }
+  memcpy(wrt->buf + wrt->size, buf, size);
+  wrt->size += size;
+  return 0;
+}
+
+static ssize_t sg__httpwrt_read_cb(void *handle, __SG_UNUSED uint64_t offset,
+                                   char *buf, size_t size) {
+  struct sg_httpwrt *wrt = handle;
+  sg_httpwrt_drain_cb drain_cb = NULL;
+  void *cls = NULL;
+  size_t used;
+  ssize_t ret;
+  pthread_mutex_lock(&wrt->mutex);
+  used = wrt->size - wrt->head;
+  if (used > 0) {
+    if (size > used)
+      size = used;
+    memcpy(buf, wrt->buf + wrt->head, size);
+    wrt->head += size;
+    if (wrt->head == wrt->size)
+      wrt->head = wrt->size = 0;
+    if (wrt->blocked && (used - size < wrt->high_water)) {
+      wrt->blocked = false;
+      if (!wrt->closed) {
+        drain_cb = wrt->drain_cb;
+        cls = wrt->cls;
+      }
+    }
+    ret = (ssize_t) size;
+  } else if (wrt->closed)
+    ret = MHD_CONTENT_READER_END_OF_STREAM;
+  else {
+    /* nothing queued: park the connection until the producer resumes it */
+    wrt->suspended = true;
+    MHD_suspend_connection(wrt->con);
+    ret = 0;
+  }
+  pthread_mutex_unlock(&wrt->mutex);
+  if (drain_cb)
+    drain_cb(cls, wrt);
+  return ret;
+}
+
+static void sg__httpwrt_free_cb(void *handle) {
+  struct sg_httpwrt *wrt = handle;
+  sg_httpwrt_drain_cb drain_cb = NULL;
+  void *cls = NULL;
+  bool done;
+  pthread_mutex_lock(&wrt->mutex);
+  wrt->gone = true;
+  wrt->suspended = false;
+  done = --wrt->refs == 0;
+  if (!done && wrt->blocked) {
+    /* lets a producer waiting for room find out the client is gone */
+    wrt->blocked = false;
+    drain_cb = wrt->drain_cb;
+    cls = wrt->cls;
+  }
+  pthread_mutex_unlock(&wrt->mutex);
+  if (done)
+    sg__httpwrt_destroy(wrt);
+  else if (drain_cb)
+    drain_cb(cls, wrt);
+}
+
+struct sg_httpwrt *sg_httpwrt_new(struct sg_httpres *res, size_t high_water,
+                                  sg_httpwrt_drain_cb drain_cb, void *cls,
+                                  unsigned int status) {
+  struct sg_httpwrt *wrt;
+  if (!res || (high_water == 0) || (status < 100) || (status > 599)) {
+    errno = EINVAL;
+    return NULL;
+  }
+  if (res->handle) {
+    errno = EALREADY;
+    return NULL;
+  }
+  wrt = sg_alloc(sizeof(struct sg_httpwrt));
+  if (!wrt)
+    return NULL;
+  errno = pthread_mutex_init(&wrt->mutex, NULL);
+  if (errno != 0) {
+    sg_free(wrt);
+    return NULL;
+  }
+  wrt->con = res->con;
+  wrt->drain_cb = drain_cb;
+  wrt->cls = cls;
+  wrt->high_water = high_water;
+  wrt->refs = 2;
+  res->handle =
+    MHD_create_response_from_callback(MHD_SIZE_UNKNOWN, SG__BLOCK_SIZE,
+                                      sg__httpwrt_read_cb, wrt,
+                                      sg__httpwrt_free_cb);
+  if (!res->handle) {
+    sg__httpwrt_destroy(wrt);
+    errno = ENOMEM;
+    return NULL;
+  }
+  res->status = status;
+  return wrt;
+}
+
+int sg_httpwrt_write(struct sg_httpwrt *wrt, const void *buf, size_t size) {
+  int errnum;
+  if (!wrt || !buf || (size == 0))
+    return EINVAL;
+  pthread_mutex_lock(&wrt->mutex);
+  if (wrt->closed)
+    errnum = EINVAL;
+  else if (wrt->gone)
+    errnum = EPIPE;
+  else if (wrt->size - wrt->head >= wrt->high_water) {
+    wrt->blocked = true;
+    errnum = EAGAIN;
+    /* the queued data must reach the client, or drain_cb would never fire */
+    sg__httpwrt_wake(wrt);
+  } else {
+    errnum = sg__httpwrt_append(wrt, buf, size);
+    /* small writes are coalesced until a block or the high-water mark is
+     * reached, or until they are flushed */
+    if ((errnum == 0) && ((wrt->size - wrt->head >= SG__BLOCK_SIZE) ||
+                          (wrt->size - wrt->head >= wrt->high_water)))
+      sg__httpwrt_wake(wrt);
+  }
+  pthread_mutex_unlock(&wrt->mutex);
+  return errnum;
+}
+
+int sg_httpwrt_flush(struct sg_httpwrt *wrt) {
+  int errnum = 0;
+  if (!wrt)
+    return EINVAL;
+  pthread_mutex_lock(&wrt->mutex);
+  if (wrt->closed)
+    errnum = EINVAL;
+  else if (wrt->gone)
+    errnum = EPIPE;
+  else
+    sg__httpwrt_wake(wrt);
+  pthread_mutex_unlock(&wrt->mutex);
+  return errnum;
+}
+
+int sg_httpwrt_close(struct sg_httpwrt *wrt) {
+  bool done;
+  if (!wrt)
+    return EINVAL;
+  pthread_mutex_lock(&wrt->mutex);
+  if (wrt->closed) {
+    pthread_mutex_unlock(&wrt->mutex);
+    return EINVAL;
+  }
+  wrt->closed = true;
+  sg__httpwrt_wake(wrt);
+  done = --wrt->refs == 0;
+  pthread_mutex_unlock(&wrt->mutex);
+  if (done)
+    sg__httpwrt_destroy(wrt);
+  return 0;
+}
+
+size_t sg_httpwrt_buffered(struct sg_httpwrt *wrt) {
+  size_t used;
+  if (!wrt) {
+    errno = EINVAL;
+    return 0;
+  }
+  pthread_mutex_lock(&wrt->mutex);
+  used = wrt->size - wrt->head;
+  pthread_mutex_unlock(&wrt->mutex);
+  return used;
+}
@@ -0,0 +1,58 @@
+/*                         _
+ *   ___  __ _  __ _ _   _(_)
+ *  / __|/ _` |/ _` | | | | |
+ *  \__ \ (_| | (_| | |_| | |
+ *  |___/\__,_|\__, |\__,_|_|
+ *             |___/
+ *
+ * Cross-platform library which helps to develop web servers or frameworks.
+ *
+ * Copyright (C) 2016-2020 Silvio Clecio <silvioprog@gmail.com>
+ *
+ * Sagui library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * Sagui library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Sagui library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef SG_HTTPWRT_H
+#define SG_HTTPWRT_H
+
+#include <stdbool.h>
+#include <pthread.h>
+#include "sg_macros.h"
+#include "microhttpd.h"
+#include "sagui.h"
+
+/* Push-style response writer. The producer appends to `buf` and the response
+ * callback drains it, suspending the connection while it is empty. The
+ * writer is released when both the producer (`sg_httpwrt_close()`) and MHD
+ * (response free callback) have dropped their references. All fields are
+ * protected by `mutex`. */
+struct sg_httpwrt {
+  pthread_mutex_t mutex;
+  struct MHD_Connection *con;
+  sg_httpwrt_drain_cb drain_cb;
+  void *cls;
+  char *buf;
+  size_t head;
+  size_t size;
+  size_t cap;
+  size_t high_water;
+  unsigned int refs;
+  bool suspended;
+  bool blocked;
+  bool closed;
+  bool gone;
+};
+
+#endif /* SG_HTTPWRT_H */
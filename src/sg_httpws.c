@@ -0,0 +1,900 @@
+/*                         _
+ *   ___  __ _  __ _ _   _(_)
+ *  / __|/ _` |/ _` | | | | |
+ *  \__ \ (_| | (_| | |_| | |
+ *  |___/\__,_|\__, |\__,_|_|
+ *             |___/
+ *
+ * Cross-platform library which helps to develop web servers or frameworks.
+ *
+ * Copyright (C) 2016-2020 Silvio Clecio <silvioprog@gmail.com>
+ *
+ * Sagui library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * Sagui library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Sagui library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <pthread.h>
+#include "sg_macros.h"
+#include "utlist.h"
+#include "microhttpd.h"
+#include "sagui.h"
+#include "sg_strmap.h"
+#include "sg_httpreq.h"
+#include "sg_httpres.h"
+#include "sg_httpsrv.h"
+#include "sg_httpws.h"
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif /* MSG_NOSIGNAL */
+
+#define SG__HTTPWS_ROL(val, bits) (((val) << (bits)) | ((val) >> (32 - (bits))))
+
+static void sg__httpws_sha1_block(uint32_t state[5], const unsigned char *blk) {
+  uint32_t w[80], a, b, c, d, e, f, k, tmp;
+  unsigned char i;
+  for (i = 0; i < 16; i++)
+    w[i] = ((uint32_t) blk[i * 4] << 24) | ((uint32_t) blk[i * 4 + 1] << 16) |
+           ((uint32_t) blk[i * 4 + 2] << 8) | (uint32_t) blk[i * 4 + 3];
+  for (i = 16; i < 80; i++)
+    w[i] = SG__HTTPWS_ROL(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+  a = state[0];
+  b = state[1];
+  c = state[2];
+  d = state[3];
+  e = state[4];
+  for (i = 0; i < 80; i++) {
+    if (i < 20) {
+      f = (b & c) | (~b & d);
+      k = 0x5A827999;
+    } else if (i < 40) {
+      f = b ^ c ^ d;
+      k = 0x6ED9EBA1;
+    } else if (i < 60) {
+      f = (b & c) | (b & d) | (c & d);
+      k = 0x8F1BBCDC;
+    } else {
+      f = b ^ c ^ d;
+      k = 0xCA62C1D6;
+    }
+    tmp = SG__HTTPWS_ROL(a, 5) + f + e + k + w[i];
+    e = d;
+    d = c;
+    c = SG__HTTPWS_ROL(b, 30);
+    b = a;
+    a = tmp;
+  }
+  state[0] += a;
+  state[1] += b;
+  state[2] += c;
+  state[3] += d;
+  state[4] += e;
+}
+
+void sg__httpws_sha1(const void *data, size_t size, unsigned char digest[20]) {
+  uint32_t state[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476,
+                       0xC3D2E1F0};
+  const unsigned char *p = data;
+  unsigned char blk[64];
+  const uint64_t bits = (uint64_t) size * 8;
+  size_t rem;
+  unsigned char i;
+  for (; size >= 64; size -= 64, p += 64)
+    sg__httpws_sha1_block(state, p);
+  rem = size;
+  memset(blk, 0, sizeof(blk));
+  memcpy(blk, p, rem);
+  blk[rem] = 0x80;
+  if (rem >= 56) {
+    sg__httpws_sha1_block(state, blk);
+    memset(blk, 0, sizeof(blk));
+  }
+  for (i = 0; i < 8; i++)
+    blk[63 - i] = (unsigned char) (bits >> (i * 8));
+  sg__httpws_sha1_block(state, blk);
+  for (i = 0; i < 20; i++)
+    digest[i] = (unsigned char) (state[i / 4] >> (24 - (i % 4) * 8));
+}
+
+bool sg__httpws_accept(const char *key, char accept[29]) {
+  static const char b64[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  char buf[64 + sizeof(SG__HTTPWS_GUID)];
+  unsigned char digest[21];
+  size_t len;
+  unsigned char i, j;
+  len = key ? strlen(key) : 0;
+  if ((len == 0) || (len > 64))
+    return false;
+  memcpy(buf, key, len);
+  memcpy(buf + len, SG__HTTPWS_GUID, sizeof(SG__HTTPWS_GUID) - 1);
+  sg__httpws_sha1(buf, len + sizeof(SG__HTTPWS_GUID) - 1, digest);
+  digest[20] = 0;
+  for (i = 0, j = 0; i < 21; i += 3, j += 4) {
+    accept[j] = b64[digest[i] >> 2];
+    accept[j + 1] = b64[((digest[i] & 0x03) << 4) | (digest[i + 1] >> 4)];
+    accept[j + 2] = b64[((digest[i + 1] & 0x0F) << 2) | (digest[i + 2] >> 6)];
+    accept[j + 3] = b64[digest[i + 2] & 0x3F];
+  }
+  accept[27] = '=';
+  accept[28] = '\0';
+  return true;
+}
+
+void sg__httpws_mask(void *buf, size_t size, const unsigned char mask[4]) {
+  unsigned char *p = buf;
+  unsigned char key[8];
+  uint64_t key64, word;
+  size_t i;
+  /* XOR eight bytes at a time, which compilers turn into vector code */
+  for (i = 0; i < 8; i++)
+    key[i] = mask[i % 4];
+  memcpy(&key64, key, sizeof(key64));
+  for (i = 0; i + 8 <= size; i += 8) {
+    memcpy(&word, p + i, sizeof(word));
+    word ^= key64;
+    memcpy(p + i, &word, sizeof(word));
+  }
+  for (; i < size; i++)
+    p[i] ^= mask[i % 4];
+}
+
+bool sg__httpws_is_utf8(const void *buf, size_t size) {
+  const unsigned char *p = buf;
+  uint64_t word;
+  unsigned char c;
+  size_t i = 0, n;
+  while (i < size) {
+    /* skip ASCII eight bytes at a time */
+    if (i + 8 <= size) {
+      memcpy(&word, p + i, sizeof(word));
+      if ((word & UINT64_C(0x8080808080808080)) == 0) {
+        i += 8;
+        continue;
+      }
+    }
+    c = p[i];
+    if (c < 0x80) {
+      i++;
+      continue;
+    }
+    if ((c >= 0xC2) && (c <= 0xDF))
+      n = 1;
+    else if ((c >= 0xE0) && (c <= 0xEF))
+      n = 2;
+    else if ((c >= 0xF0) && (c <= 0xF4))
+      n = 3;
+    else
+      return false;
+    if (n > size - i - 1)
+      return false;
+    /* reject overlong forms, surrogates and code points above U+10FFFF */
+    if (((c == 0xE0) && (p[i + 1] < 0xA0)) ||
+        ((c == 0xED) && (p[i + 1] > 0x9F)) ||
+        ((c == 0xF0) && (p[i + 1] < 0x90)) ||
+        ((c == 0xF4) && (p[i + 1] > 0x8F)))
+      return false;
+    for (i++; n > 0; n--, i++)
+      if ((p[i] & 0xC0) != 0x80)
+        return false;
+  }
+  return true;
+}
+
+static bool sg__httpws_is_close_code(unsigned int code) {
+  if ((code >= 3000) && (code <= 4999))
+    return true;
+  return (code >= 1000) && (code <= 1014) && (code != 1004) &&
+         (code != SG__HTTPWS_NO_STATUS) && (code != SG__HTTPWS_ABNORMAL);
+}
+
+int sg__httpws_parse(const void *buf, size_t size,
+                     struct sg__httpws_frame *frame) {
+  const unsigned char *p = buf;
+  size_t len;
+  unsigned char i;
+  if (size < 2)
+    return 0;
+  frame->fin = (p[0] & 0x80) != 0;
+  frame->opcode = p[0] & 0x0F;
+  /* reserved bits, unknown opcodes and unmasked client frames */
+  if ((p[0] & 0x70) || ((frame->opcode > SG__HTTPWS_BINARY) &&
+                        (frame->opcode < SG__HTTPWS_CLOSE)) ||
+      (frame->opcode > SG__HTTPWS_PONG) || !(p[1] & 0x80))
+    return -1;
+  len = p[1] & 0x7F;
+  if ((frame->opcode >= SG__HTTPWS_CLOSE) && (!frame->fin || (len > 125)))
+    return -1;
+  frame->header_size = 6;
+  if (len == 126) {
+    frame->header_size += 2;
+    if (size < frame->header_size)
+      return 0;
+    frame->size = ((uint64_t) p[2] << 8) | p[3];
+  } else if (len == 127) {
+    frame->header_size += 8;
+    if (size < frame->header_size)
+      return 0;
+    if (p[2] & 0x80)
+      return -1;
+    frame->size = 0;
+    for (i = 2; i < 10; i++)
+      frame->size = (frame->size << 8) | p[i];
+  } else {
+    if (size < frame->header_size)
+      return 0;
+    frame->size = len;
+  }
+  memcpy(frame->mask, p + frame->header_size - 4, 4);
+  return (int) frame->header_size;
+}
+
+size_t sg__httpws_header(unsigned char *buf, unsigned char opcode, bool fin,
+                         uint64_t size) {
+  unsigned char i;
+  buf[0] = (unsigned char) ((fin ? 0x80 : 0) | opcode);
+  if (size < 126) {
+    buf[1] = (unsigned char) size;
+    return 2;
+  }
+  if (size <= 0xFFFF) {
+    buf[1] = 126;
+    buf[2] = (unsigned char) (size >> 8);
+    buf[3] = (unsigned char) size;
+    return 4;
+  }
+  buf[1] = 127;
+  for (i = 0; i < 8; i++)
+    buf[9 - i] = (unsigned char) (size >> (i * 8));
+  return 10;
+}
+
+static int sg__httpws_buf_grow(struct sg__httpws_buf *buf, size_t size) {
+  size_t cap;
+  char *data;
+  if (size <= buf->cap - buf->size)
+    return 0;
+  cap = buf->cap > 0 ? buf->cap : 256;
+  while (cap - buf->size < size)
+    cap *= 2;
+  data = sg_realloc(buf->data, cap);
+  if (!data)
+    return ENOMEM;
+  buf->data = data;
+  buf->cap = cap;
+  return 0;
+}
+
+static int sg__httpws_buf_write(struct sg__httpws_buf *buf, const void *data,
+                                size_t size) {
+  int errnum = sg__httpws_buf_grow(buf, size);
+  if (errnum != 0)
+    return errnum;
+  if (size > 0)
+    memcpy(buf->data + buf->size, data, size);
+  buf->size += size;
+  return 0;
+}
+
+static void sg__httpws_wake(struct sg__httpws_loop *loop) {
+  ssize_t ret;
+  if (loop) {
+    ret = write(loop->wake[1], "", 1);
+    (void) ret;
+  }
+}
+
+static int sg__httpws_enqueue(struct sg_httpws *ws, unsigned char opcode,
+                              const void *data, size_t size) {
+  unsigned char hdr[SG__HTTPWS_MAX_HEADER_SIZE];
+  struct sg__httpws_loop *loop;
+  size_t len;
+  int errnum;
+  len = sg__httpws_header(hdr, opcode, true, size);
+  pthread_mutex_lock(&ws->mutex);
+  if (ws->close_sent || ws->closed) {
+    errnum = ENOTCONN;
+    goto done;
+  }
+  /* a client which does not read must not make the queue grow unbounded */
+  if ((opcode != SG__HTTPWS_CLOSE) && (ws->out.size >= SG__HTTPWS_OUT_LIMIT)) {
+    errnum = EAGAIN;
+    goto done;
+  }
+  errnum = sg__httpws_buf_grow(&ws->out, len + size);
+  if (errnum != 0)
+    goto done;
+  sg__httpws_buf_write(&ws->out, hdr, len);
+  sg__httpws_buf_write(&ws->out, data, size);
+  if (opcode == SG__HTTPWS_CLOSE)
+    ws->close_sent = true;
+done:
+  loop = ws->loop;
+  pthread_mutex_unlock(&ws->mutex);
+  if (errnum == 0)
+    sg__httpws_wake(loop);
+  return errnum;
+}
+
+static void sg__httpws_fail(struct sg_httpws *ws, unsigned int code) {
+  unsigned char payload[2];
+  payload[0] = (unsigned char) (code >> 8);
+  payload[1] = (unsigned char) code;
+  if (ws->close_code == 0)
+    ws->close_code = code;
+  sg__httpws_enqueue(ws, SG__HTTPWS_CLOSE, payload, sizeof(payload));
+}
+
+static bool sg__httpws_frame_cb(struct sg_httpws *ws,
+                                const struct sg__httpws_frame *frame,
+                                const char *payload) {
+  const size_t size = (size_t) frame->size;
+  unsigned int code;
+  switch (frame->opcode) {
+    case SG__HTTPWS_CONTINUATION:
+      if (ws->msg_opcode == 0)
+        goto protocol_error;
+      if (size > ws->max_size - ws->msg.size) {
+        sg__httpws_fail(ws, SG__HTTPWS_TOO_BIG);
+        return false;
+      }
+      if (sg__httpws_buf_write(&ws->msg, payload, size) != 0) {
+        sg__httpws_fail(ws, SG__HTTPWS_INTERNAL_ERROR);
+        return false;
+      }
+      if (frame->fin) {
+        if ((ws->msg_opcode == SG__HTTPWS_TEXT) &&
+            !sg__httpws_is_utf8(ws->msg.data, ws->msg.size))
+          goto invalid_data;
+        ws->msg_cb(ws->cls, ws, ws->msg_opcode == SG__HTTPWS_BINARY,
+                   ws->msg.data, ws->msg.size);
+        ws->msg.size = 0;
+        ws->msg_opcode = 0;
+      }
+      break;
+    case SG__HTTPWS_TEXT:
+    case SG__HTTPWS_BINARY:
+      if (ws->msg_opcode != 0)
+        goto protocol_error;
+      if (frame->fin) {
+        /* unfragmented message: delivered straight from the input buffer */
+        if ((frame->opcode == SG__HTTPWS_TEXT) &&
+            !sg__httpws_is_utf8(payload, size))
+          goto invalid_data;
+        ws->msg_cb(ws->cls, ws, frame->opcode == SG__HTTPWS_BINARY, payload,
+                   size);
+        break;
+      }
+      ws->msg_opcode = frame->opcode;
+      if (sg__httpws_buf_write(&ws->msg, payload, size) != 0) {
+        sg__httpws_fail(ws, SG__HTTPWS_INTERNAL_ERROR);
+        return false;
+      }
+      break;
+    case SG__HTTPWS_CLOSE:
+      if (size == 1)
+        goto protocol_error;
+      if (size >= 2) {
+        code = ((unsigned int) (unsigned char) payload[0] << 8) |
+               (unsigned char) payload[1];
+        if (!sg__httpws_is_close_code(code))
+          goto protocol_error;
+        if (!sg__httpws_is_utf8(payload + 2, size - 2))
+          goto invalid_data;
+        if (ws->close_code == 0)
+          ws->close_code = code;
+        sg__httpws_enqueue(ws, SG__HTTPWS_CLOSE, payload, 2);
+      } else {
+        if (ws->close_code == 0)
+          ws->close_code = SG__HTTPWS_NO_STATUS;
+        sg__httpws_enqueue(ws, SG__HTTPWS_CLOSE, NULL, 0);
+      }
+      return false;
+    case SG__HTTPWS_PING:
+      if (sg__httpws_enqueue(ws, SG__HTTPWS_PONG, payload, size) == EAGAIN) {
+        /* pings flooded by a client which does not read the pongs */
+        sg__httpws_fail(ws, SG__HTTPWS_POLICY_VIOLATION);
+        return false;
+      }
+      break;
+    case SG__HTTPWS_PONG:
+      ws->alive = true;
+      break;
+    default:
+      goto protocol_error;
+  }
+  return true;
+protocol_error:
+  sg__httpws_fail(ws, SG__HTTPWS_PROTOCOL_ERROR);
+  return false;
+invalid_data:
+  sg__httpws_fail(ws, SG__HTTPWS_INVALID_DATA);
+  return false;
+}
+
+static void sg__httpws_process(struct sg_httpws *ws) {
+  struct sg__httpws_frame frame;
+  size_t offset = 0, avail;
+  char *payload;
+  bool closing;
+  int ret;
+  pthread_mutex_lock(&ws->mutex);
+  closing = ws->close_sent;
+  pthread_mutex_unlock(&ws->mutex);
+  if (closing) {
+    /* anything after our closing frame is discarded */
+    ws->in.size = 0;
+    return;
+  }
+  for (;;) {
+    avail = ws->in.size - offset;
+    ret = sg__httpws_parse(ws->in.data + offset, avail, &frame);
+    if (ret == 0)
+      break;
+    if (ret < 0) {
+      sg__httpws_fail(ws, SG__HTTPWS_PROTOCOL_ERROR);
+      break;
+    }
+    if (frame.size > ws->max_size) {
+      sg__httpws_fail(ws, SG__HTTPWS_TOO_BIG);
+      break;
+    }
+    if (frame.size > avail - frame.header_size)
+      break;
+    payload = ws->in.data + offset + frame.header_size;
+    sg__httpws_mask(payload, (size_t) frame.size, frame.mask);
+    offset += frame.header_size + (size_t) frame.size;
+    if (!sg__httpws_frame_cb(ws, &frame, payload))
+      break;
+  }
+  if (offset > 0) {
+    ws->in.size -= offset;
+    memmove(ws->in.data, ws->in.data + offset, ws->in.size);
+  }
+}
+
+static void sg__httpws_recv(struct sg_httpws *ws) {
+  ssize_t ret;
+  if (sg__httpws_buf_grow(&ws->in, SG__HTTPWS_READ_SIZE) != 0) {
+    sg__httpws_fail(ws, SG__HTTPWS_INTERNAL_ERROR);
+    return;
+  }
+  ret = recv(ws->sock, ws->in.data + ws->in.size, ws->in.cap - ws->in.size, 0);
+  if (ret > 0) {
+    ws->in.size += (size_t) ret;
+    sg__httpws_process(ws);
+    return;
+  }
+  if ((ret < 0) &&
+      ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR)))
+    return;
+  pthread_mutex_lock(&ws->mutex);
+  ws->closed = true;
+  pthread_mutex_unlock(&ws->mutex);
+  if (ws->close_code == 0)
+    ws->close_code = SG__HTTPWS_ABNORMAL;
+}
+
+static void sg__httpws_flush(struct sg_httpws *ws) {
+  ssize_t ret;
+  pthread_mutex_lock(&ws->mutex);
+  while (ws->out_offset < ws->out.size) {
+    ret = send(ws->sock, ws->out.data + ws->out_offset,
+               ws->out.size - ws->out_offset, MSG_NOSIGNAL);
+    if (ret > 0) {
+      ws->out_offset += (size_t) ret;
+      continue;
+    }
+    if ((ret < 0) && (errno == EINTR))
+      continue;
+    if ((ret < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK)))
+      break;
+    ws->closed = true;
+    if (ws->close_code == 0)
+      ws->close_code = SG__HTTPWS_ABNORMAL;
+    break;
+  }
+  if (ws->out_offset == ws->out.size)
+    ws->out.size = ws->out_offset = 0;
+  pthread_mutex_unlock(&ws->mutex);
+}
+
+static void sg__httpws_ping(struct sg__httpws_loop *loop) {
+  struct sg_httpws *ws;
+  pthread_mutex_lock(&loop->mutex);
+  DL_FOREACH(loop->conns, ws) {
+    if (!ws->alive) {
+      pthread_mutex_lock(&ws->mutex);
+      ws->closed = true;
+      pthread_mutex_unlock(&ws->mutex);
+      if (ws->close_code == 0)
+        ws->close_code = SG__HTTPWS_ABNORMAL;
+      continue;
+    }
+    ws->alive = false;
+    sg__httpws_enqueue(ws, SG__HTTPWS_PING, NULL, 0);
+  }
+  pthread_mutex_unlock(&loop->mutex);
+}
+
+static void sg__httpws_close(struct sg_httpws *ws) {
+  if (ws->close_cb)
+    ws->close_cb(ws->cls, ws,
+                 ws->close_code != 0 ? ws->close_code : SG__HTTPWS_NORMAL);
+  MHD_upgrade_action(ws->urh, MHD_UPGRADE_ACTION_CLOSE);
+  sg__httpws_free(ws);
+}
+
+/* Removes and closes the connections which failed or have flushed their
+ * closing frame. */
+static void sg__httpws_reap(struct sg__httpws_loop *loop, bool all) {
+  struct sg_httpws *ws, *tmp, *dead = NULL;
+  bool done;
+  pthread_mutex_lock(&loop->mutex);
+  DL_FOREACH_SAFE(loop->conns, ws, tmp) {
+    pthread_mutex_lock(&ws->mutex);
+    done = all || ws->closed || (ws->close_sent && (ws->out.size == 0));
+    pthread_mutex_unlock(&ws->mutex);
+    if (done) {
+      DL_DELETE(loop->conns, ws);
+      DL_APPEND(dead, ws);
+    }
+  }
+  pthread_mutex_unlock(&loop->mutex);
+  DL_FOREACH_SAFE(dead, ws, tmp) {
+    DL_DELETE(dead, ws);
+    sg__httpws_close(ws);
+  }
+}
+
+static void *sg__httpws_loop_cb(void *cls) {
+  struct sg__httpws_loop *loop = cls;
+  struct sg_httpws **conns = NULL, **conns_tmp, *ws;
+  struct pollfd *fds = NULL, *fds_tmp;
+  char drain[64];
+  time_t ping_time = time(NULL), now;
+  size_t count, cap = 0, i;
+  for (;;) {
+    pthread_mutex_lock(&loop->mutex);
+    if (loop->stop) {
+      pthread_mutex_unlock(&loop->mutex);
+      break;
+    }
+    count = 0;
+    DL_COUNT(loop->conns, ws, count);
+    if (count + 1 > cap) {
+      cap = (count + 1) * 2;
+      fds_tmp = sg_realloc(fds, cap * sizeof(struct pollfd));
+      if (fds_tmp)
+        fds = fds_tmp;
+      conns_tmp = sg_realloc(conns, cap * sizeof(struct sg_httpws *));
+      if (conns_tmp)
+        conns = conns_tmp;
+      if (!fds_tmp || !conns_tmp) {
+        cap = 0;
+        pthread_mutex_unlock(&loop->mutex);
+        continue;
+      }
+    }
+    fds[0].fd = loop->wake[0];
+    fds[0].events = POLLIN;
+    fds[0].revents = 0;
+    i = 0;
+    DL_FOREACH(loop->conns, ws) {
+      conns[i] = ws;
+      i++;
+      fds[i].fd = ws->sock;
+      fds[i].events = POLLIN;
+      fds[i].revents = 0;
+      pthread_mutex_lock(&ws->mutex);
+      if (ws->out.size > 0)
+        fds[i].events |= POLLOUT;
+      pthread_mutex_unlock(&ws->mutex);
+    }
+    pthread_mutex_unlock(&loop->mutex);
+    if (poll(fds, (nfds_t) (count + 1), (loop->ping_interval > 0) ? 1000 : -1) <
+        0) {
+      if (errno != EINTR)
+        break;
+      continue;
+    }
+    if (fds[0].revents & POLLIN)
+      while (read(loop->wake[0], drain, sizeof(drain)) > 0)
+        ;
+    for (i = 0; i < count; i++) {
+      ws = conns[i];
+      if (fds[i + 1].revents & (POLLIN | POLLHUP | POLLERR))
+        sg__httpws_recv(ws);
+      sg__httpws_flush(ws);
+    }
+    if (loop->ping_interval > 0) {
+      now = time(NULL);
+      if (now - ping_time >= (time_t) loop->ping_interval) {
+        ping_time = now;
+        sg__httpws_ping(loop);
+      }
+    }
+    sg__httpws_reap(loop, false);
+  }
+  sg_free(fds);
+  sg_free(conns);
+  return NULL;
+}
+
+static struct sg__httpws_loop *sg__httpws_loop_new(unsigned int ping_interval) {
+  struct sg__httpws_loop *loop;
+  unsigned char i;
+  loop = sg_alloc(sizeof(struct sg__httpws_loop));
+  if (!loop)
+    return NULL;
+  if (pipe(loop->wake) != 0)
+    goto error_pipe;
+  for (i = 0; i < 2; i++) {
+    fcntl(loop->wake[i], F_SETFL, fcntl(loop->wake[i], F_GETFL) | O_NONBLOCK);
+    fcntl(loop->wake[i], F_SETFD, FD_CLOEXEC);
+  }
+  loop->ping_interval = ping_interval;
+  errno = pthread_mutex_init(&loop->mutex, NULL);
+  if (errno != 0)
+    goto error_mutex;
+  errno = pthread_create(&loop->thread, NULL, sg__httpws_loop_cb, loop);
+  if (errno != 0)
+    goto error_thread;
+  return loop;
+error_thread:
+  pthread_mutex_destroy(&loop->mutex);
+error_mutex:
+  close(loop->wake[0]);
+  close(loop->wake[1]);
+error_pipe:
+  sg_free(loop);
+  return NULL;
+}
+
+/* Stops the loop thread and closes its connections, which must happen while
+ * MHD still owns their upgrade handles. No connection is added afterwards. */
+void sg__httpws_loop_stop(struct sg__httpws_loop *loop) {
+  struct sg_httpws *ws;
+  if (!loop)
+    return;
+  pthread_mutex_lock(&loop->mutex);
+  if (loop->stop) {
+    pthread_mutex_unlock(&loop->mutex);
+    return;
+  }
+  loop->stop = true;
+  pthread_mutex_unlock(&loop->mutex);
+  sg__httpws_wake(loop);
+  pthread_join(loop->thread, NULL);
+  DL_FOREACH(loop->conns, ws) {
+    if (ws->close_code == 0)
+      ws->close_code = SG__HTTPWS_GOING_AWAY;
+    sg__httpws_fail(ws, SG__HTTPWS_GOING_AWAY);
+    sg__httpws_flush(ws);
+  }
+  sg__httpws_reap(loop, true);
+}
+
+void sg__httpws_loop_free(struct sg__httpws_loop *loop) {
+  if (!loop)
+    return;
+  sg__httpws_loop_stop(loop);
+  pthread_mutex_destroy(&loop->mutex);
+  close(loop->wake[0]);
+  close(loop->wake[1]);
+  sg_free(loop);
+}
+
+static struct sg__httpws_loop *sg__httpws_loop_get(struct sg_httpsrv *srv) {
+  struct sg__httpws_loop *loop;
+  sg__httpsrv_lock(srv);
+  if (srv->ws_stopping)
+    loop = NULL;
+  else {
+    if (!srv->ws_loop)
+      srv->ws_loop = sg__httpws_loop_new(srv->ws_ping_interval);
+    loop = srv->ws_loop;
+  }
+  sg__httpsrv_unlock(srv);
+  return loop;
+}
+
+static void sg__httpws_upgrade_cb(void *cls,
+                                  __SG_UNUSED struct MHD_Connection *con,
+                                  void *req_cls, const char *extra_in,
+                                  size_t extra_in_size, MHD_socket sock,
+                                  struct MHD_UpgradeResponseHandle *urh) {
+  struct sg_httpws *ws = cls;
+  struct sg_httpreq *req = req_cls;
+  struct sg__httpws_loop *loop;
+  /* from now on the connection belongs to the event loop */
+  req->ws = NULL;
+  ws->sock = sock;
+  ws->urh = urh;
+  fcntl(sock, F_SETFL, fcntl(sock, F_GETFL) | O_NONBLOCK);
+#ifdef SO_NOSIGPIPE
+  setsockopt(sock, SOL_SOCKET, SO_NOSIGPIPE, &(int){1}, sizeof(int));
+#endif /* SO_NOSIGPIPE */
+  loop = sg__httpws_loop_get(req->srv);
+  if (!loop ||
+      (sg__httpws_buf_write(&ws->in, extra_in, extra_in_size) != 0)) {
+    ws->close_code = SG__HTTPWS_INTERNAL_ERROR;
+    sg__httpws_close(ws);
+    return;
+  }
+  /* frames that arrived with the handshake are handled before the loop thread
+   * can see the connection, since the input buffers are not locked */
+  sg__httpws_process(ws);
+  pthread_mutex_lock(&loop->mutex);
+  if (loop->stop) {
+    /* the server is shutting down */
+    pthread_mutex_unlock(&loop->mutex);
+    ws->close_code = SG__HTTPWS_GOING_AWAY;
+    sg__httpws_close(ws);
+    return;
+  }
+  DL_APPEND(loop->conns, ws);
+  pthread_mutex_lock(&ws->mutex);
+  ws->loop = loop;
+  pthread_mutex_unlock(&ws->mutex);
+  pthread_mutex_unlock(&loop->mutex);
+  sg__httpws_wake(loop);
+}
+
+static struct sg_httpws *sg__httpws_new(sg_httpws_msg_cb msg_cb,
+                                        sg_httpws_close_cb close_cb, void *cls,
+                                        size_t max_size) {
+  struct sg_httpws *ws = sg_alloc(sizeof(struct sg_httpws));
+  if (!ws)
+    return NULL;
+  errno = pthread_mutex_init(&ws->mutex, NULL);
+  if (errno != 0) {
+    sg_free(ws);
+    return NULL;
+  }
+  ws->sock = MHD_INVALID_SOCKET;
+  ws->msg_cb = msg_cb;
+  ws->close_cb = close_cb;
+  ws->cls = cls;
+  ws->max_size = max_size;
+  ws->alive = true;
+  return ws;
+}
+
+void sg__httpws_free(struct sg_httpws *ws) {
+  if (!ws)
+    return;
+  sg_free(ws->in.data);
+  sg_free(ws->msg.data);
+  sg_free(ws->out.data);
+  pthread_mutex_destroy(&ws->mutex);
+  sg_free(ws);
+}
+
+/* Checks if a comma-separated header value contains `token`. */
+static bool sg__httpws_has_token(const char *val, const char *token) {
+  const size_t len = strlen(token);
+  const char *end;
+  while (val && *val) {
+    while ((*val == ' ') || (*val == '\t') || (*val == ','))
+      val++;
+    end = val;
+    while (*end && (*end != ',') && (*end != ' ') && (*end != '\t'))
+      end++;
+    if (((size_t) (end - val) == len) && (strncasecmp(val, token, len) == 0))
+      return true;
+    val = end;
+  }
+  return false;
+}
+
+int sg_httpws_upgrade(struct sg_httpreq *req, sg_httpws_msg_cb msg_cb,
+                      sg_httpws_close_cb close_cb, void *cls) {
+  char accept[29];
+  const char *val;
+  struct sg_httpws *ws;
+  int errnum;
+  if (!req || !msg_cb)
+    return EINVAL;
+  if (req->res->handle || req->ws)
+    return EALREADY;
+  val = MHD_lookup_connection_value(req->con, MHD_HEADER_KIND,
+                                    MHD_HTTP_HEADER_SEC_WEBSOCKET_VERSION);
+  if (!req->method || (strcmp(req->method, MHD_HTTP_METHOD_GET) != 0) ||
+      !val || (strcmp(val, "13") != 0) ||
+      !sg__httpws_has_token(
+        MHD_lookup_connection_value(req->con, MHD_HEADER_KIND,
+                                    MHD_HTTP_HEADER_UPGRADE),
+        "websocket") ||
+      !sg__httpws_has_token(
+        MHD_lookup_connection_value(req->con, MHD_HEADER_KIND,
+                                    MHD_HTTP_HEADER_CONNECTION),
+        "upgrade") ||
+      !sg__httpws_accept(
+        MHD_lookup_connection_value(req->con, MHD_HEADER_KIND,
+                                    MHD_HTTP_HEADER_SEC_WEBSOCKET_KEY),
+        accept))
+    return EPROTO;
+  errnum =
+    sg_strmap_set(&req->res->headers, MHD_HTTP_HEADER_UPGRADE, "websocket");
+  if (errnum != 0)
+    return errnum;
+  errnum = sg_strmap_set(&req->res->headers,
+                         MHD_HTTP_HEADER_SEC_WEBSOCKET_ACCEPT, accept);
+  if (errnum != 0)
+    return errnum;
+  ws = sg__httpws_new(msg_cb, close_cb, cls, req->srv->payld_limit);
+  if (!ws)
+    return ENOMEM;
+  req->res->handle = MHD_create_response_for_upgrade(sg__httpws_upgrade_cb, ws);
+  if (!req->res->handle) {
+    sg__httpws_free(ws);
+    return ENOMEM;
+  }
+  req->res->status = MHD_HTTP_SWITCHING_PROTOCOLS;
+  req->ws = ws;
+  return 0;
+}
+
+int sg_httpws_send(struct sg_httpws *ws, bool binary, const void *buf,
+                   size_t size) {
+  if (!ws || (!buf && (size > 0)))
+    return EINVAL;
+  return sg__httpws_enqueue(
+    ws, binary ? SG__HTTPWS_BINARY : SG__HTTPWS_TEXT, buf, size);
+}
+
+int sg_httpws_close(struct sg_httpws *ws, unsigned int code) {
+  unsigned char payload[2];
+  int errnum;
+  if (!ws || (code < 1000) || (code > 4999) ||
+      (code == SG__HTTPWS_NO_STATUS) || (code == SG__HTTPWS_ABNORMAL) ||
+      (code == 1015))
+    return EINVAL;
+  payload[0] = (unsigned char) (code >> 8);
+  payload[1] = (unsigned char) code;
+  errnum = sg__httpws_enqueue(ws, SG__HTTPWS_CLOSE, payload, sizeof(payload));
+  if (errnum == 0) {
+    pthread_mutex_lock(&ws->mutex);
+    if (ws->close_code == 0)
+      ws->close_code = code;
+    pthread_mutex_unlock(&ws->mutex);
+  }
+  return errnum;
+}
+
+int sg_httpws_set_user_data(struct sg_httpws *ws, void *data) {
+  if (!ws)
+    return EINVAL;
+  ws->user_data = data;
+  return 0;
+}
+
+void *sg_httpws_user_data(struct sg_httpws *ws) {
+  if (ws)
+    return ws->user_data;
+  errno = EINVAL;
+  return NULL;
+}
@@ -0,0 +1,139 @@
+/*                         _
+ *   ___  __ _  __ _ _   _(_)
+ *  / __|/ _` |/ _` | | | | |
+ *  \__ \ (_| | (_| | |_| | |
+ *  |___/\__,_|\__, |\__,_|_|
+ *             |___/
+ *
+ * Cross-platform library which helps to develop web servers or frameworks.
+ *
+ * Copyright (C) 2016-2020 Silvio Clecio <silvioprog@gmail.com>
+ *
+ * Sagui library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * Sagui library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Sagui library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef SG_HTTPWS_H
+#define SG_HTTPWS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "sg_macros.h"
+#include "microhttpd.h"
+#include "sagui.h"
+
+#define SG__HTTPWS_GUID "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+
+#define SG__HTTPWS_READ_SIZE 16384
+
+#define SG__HTTPWS_MAX_HEADER_SIZE 14
+
+/* High-water mark of the outgoing queue, past which only closing frames are
+ * queued. */
+#define SG__HTTPWS_OUT_LIMIT 4194304 /* ~4 MB */
+
+enum sg__httpws_opcode {
+  SG__HTTPWS_CONTINUATION = 0x0,
+  SG__HTTPWS_TEXT = 0x1,
+  SG__HTTPWS_BINARY = 0x2,
+  SG__HTTPWS_CLOSE = 0x8,
+  SG__HTTPWS_PING = 0x9,
+  SG__HTTPWS_PONG = 0xA
+};
+
+/* Close status codes (RFC 6455, section 7.4.1). */
+#define SG__HTTPWS_NORMAL 1000
+#define SG__HTTPWS_GOING_AWAY 1001
+#define SG__HTTPWS_PROTOCOL_ERROR 1002
+#define SG__HTTPWS_NO_STATUS 1005
+#define SG__HTTPWS_ABNORMAL 1006
+#define SG__HTTPWS_INVALID_DATA 1007
+#define SG__HTTPWS_POLICY_VIOLATION 1008
+#define SG__HTTPWS_TOO_BIG 1009
+#define SG__HTTPWS_INTERNAL_ERROR 1011
+
+struct sg__httpws_frame {
+  uint64_t size;
+  size_t header_size;
+  unsigned char mask[4];
+  unsigned char opcode;
+  bool fin;
+};
+
+struct sg__httpws_buf {
+  char *data;
+  size_t size;
+  size_t cap;
+};
+
+/* Event loop shared by all the upgraded connections of a server. */
+struct sg__httpws_loop {
+  pthread_t thread;
+  pthread_mutex_t mutex;
+  struct sg_httpws *conns;
+  unsigned int ping_interval;
+  int wake[2];
+  bool stop;
+};
+
+/* Upgraded connection. The input buffers are only touched by the loop thread,
+ * while the output queue and the closing state are protected by `mutex`, since
+ * messages can be sent from any thread. */
+struct sg_httpws {
+  pthread_mutex_t mutex;
+  struct sg__httpws_loop *loop;
+  struct MHD_UpgradeResponseHandle *urh;
+  MHD_socket sock;
+  struct sg__httpws_buf in;
+  struct sg__httpws_buf msg;
+  struct sg__httpws_buf out;
+  size_t out_offset;
+  size_t max_size;
+  sg_httpws_msg_cb msg_cb;
+  sg_httpws_close_cb close_cb;
+  void *cls;
+  void *user_data;
+  unsigned int close_code;
+  unsigned char msg_opcode;
+  bool alive;
+  bool close_sent;
+  bool closed;
+  struct sg_httpws *prev;
+  struct sg_httpws *next;
+};
+
+SG__EXTERN void sg__httpws_sha1(const void *data, size_t size,
+                                unsigned char digest[20]);
+
+SG__EXTERN bool sg__httpws_accept(const char *key, char accept[29]);
+
+SG__EXTERN void sg__httpws_mask(void *buf, size_t size,
+                                const unsigned char mask[4]);
+
+SG__EXTERN bool sg__httpws_is_utf8(const void *buf, size_t size);
+
+SG__EXTERN int sg__httpws_parse(const void *buf, size_t size,
+                                struct sg__httpws_frame *frame);
+
+SG__EXTERN size_t sg__httpws_header(unsigned char *buf, unsigned char opcode,
+                                    bool fin, uint64_t size);
+
+SG__EXTERN void sg__httpws_free(struct sg_httpws *ws);
+
+SG__EXTERN void sg__httpws_loop_stop(struct sg__httpws_loop *loop);
+
+SG__EXTERN void sg__httpws_loop_free(struct sg__httpws_loop *loop);
+
+#endif /* SG_HTTPWS_H */
@@ -0,0 +1,661 @@
+/*                         _
+ *   ___  __ _  __ _ _   _(_)
+ *  / __|/ _` |/ _` | | | | |
+ *  \__ \ (_| | (_| | |_| | |
+ *  |___/\__,_|\__, |\__,_|_|
+ *             |___/
+ *
+ * Cross-platform library which helps to develop web servers or frameworks.
+ *
+ * Copyright (C) 2016-2020 Silvio Clecio <silvioprog@gmail.com>
+ *
+ * Sagui library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * Sagui library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Sagui library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include "sg_macros.h"
+#include "sagui.h"
+#include "sg_str.h"
+#include "sg_json.h"
+
+static const char sg__json_digits[] = "00010203040506070809"
+                                      "10111213141516171819"
+                                      "20212223242526272829"
+                                      "30313233343536373839"
+                                      "40414243444546474849"
+                                      "50515253545556575859"
+                                      "60616263646566676869"
+                                      "70717273747576777879"
+                                      "80818283848586878889"
+                                      "90919293949596979899";
+
+/* Buffer. */
+
+static int sg__json_reserve(struct sg_json *json, size_t size) {
+  if (SG__STR_ROOM(json->buf, size))
+    return 0;
+  return sg__str_grow(json->buf, size);
+}
+
+static void sg__json_put(struct sg_json *json, const char *val, size_t len) {
+  memcpy(json->buf->d + json->buf->i, val, len);
+  json->buf->i += len;
+}
+
+static void sg__json_putc(struct sg_json *json, char c) {
+  json->buf->d[json->buf->i++] = c;
+}
+
+static int sg__json_end(struct sg_json *json) {
+  int errnum;
+  json->buf->d[json->buf->i] = '\0';
+  if (json->wrt && (json->buf->i >= SG__BLOCK_SIZE)) {
+    errnum = sg_json_flush(json);
+    if (errnum != 0)
+      return errnum;
+  }
+  return 0;
+}
+
+/* Strings. */
+
+#define SG__JSON_ONES UINT64_C(0x0101010101010101)
+#define SG__JSON_HIGHS UINT64_C(0x8080808080808080)
+#define SG__JSON_HASZERO(v) (((v) - SG__JSON_ONES) & ~(v) & SG__JSON_HIGHS)
+#define SG__JSON_HASBYTE(v, b) SG__JSON_HASZERO((v) ^ (SG__JSON_ONES * (b)))
+#define SG__JSON_HASLESS(v, n)                                                 \
+  (((v) - (SG__JSON_ONES * (n))) & ~(v) & SG__JSON_HIGHS)
+
+/* Returns the length of the prefix of `str` which needs no escaping. It
+ * checks eight bytes at a time (SWAR) for quotes, backslashes and control
+ * characters before falling back to a per-byte loop. */
+size_t sg__json_safelen(const char *str, size_t len) {
+  const unsigned char *p = (const unsigned char *) str;
+  size_t i = 0;
+  uint64_t v;
+  for (; i + 8 <= len; i += 8) {
+    memcpy(&v, p + i, 8);
+    if (SG__JSON_HASLESS(v, 0x20) | SG__JSON_HASBYTE(v, '"') |
+        SG__JSON_HASBYTE(v, '\\'))
+      break;
+  }
+  for (; i < len; i++)
+    if ((p[i] < 0x20) || (p[i] == '"') || (p[i] == '\\'))
+      break;
+  return i;
+}
+
+static int sg__json_str(struct sg_json *json, const char *str) {
+  static const char hex[] = "0123456789abcdef";
+  size_t len = strlen(str), safe;
+  unsigned char c;
+  int errnum;
+  /* worst case: every byte escaped as \u00XX, plus quotes and a separator */
+  errnum = sg__json_reserve(json, (len * 6) + 3);
+  if (errnum != 0)
+    return errnum;
+  sg__json_putc(json, '"');
+  while (len > 0) {
+    safe = sg__json_safelen(str, len);
+    sg__json_put(json, str, safe);
+    str += safe;
+    len -= safe;
+    if (len == 0)
+      break;
+    c = (unsigned char) *str++;
+    len--;
+    sg__json_putc(json, '\\');
+    switch (c) {
+      case '"':
+      case '\\':
+        sg__json_putc(json, (char) c);
+        break;
+      case '\b':
+        sg__json_putc(json, 'b');
+        break;
+      case '\f':
+        sg__json_putc(json, 'f');
+        break;
+      case '\n':
+        sg__json_putc(json, 'n');
+        break;
+      case '\r':
+        sg__json_putc(json, 'r');
+        break;
+      case '\t':
+        sg__json_putc(json, 't');
+        break;
+      default:
+        sg__json_put(json, "u00", 3);
+        sg__json_putc(json, hex[c >> 4]);
+        sg__json_putc(json, hex[c & 0xf]);
+    }
+  }
+  sg__json_putc(json, '"');
+  return 0;
+}
+
+/* Integers. */
+
+/* Writes the digits of `val` ending at `buf` (exclusive), two at a time, and
+ * returns a pointer to the first one. */
+char *sg__json_utoa(uint64_t val, char *buf) {
+  unsigned int i;
+  while (val >= 100) {
+    i = (unsigned int) (val % 100) * 2;
+    val /= 100;
+    *--buf = sg__json_digits[i + 1];
+    *--buf = sg__json_digits[i];
+  }
+  if (val >= 10) {
+    i = (unsigned int) val * 2;
+    *--buf = sg__json_digits[i + 1];
+    *--buf = sg__json_digits[i];
+  } else
+    *--buf = (char) ('0' + val);
+  return buf;
+}
+
+/* Doubles: Grisu2 (F. Loitsch, "Printing Floating-Point Numbers Quickly and
+ * Accurately with Integers"), which always produces a representation that
+ * round-trips and is the shortest one in the vast majority of cases. */
+
+struct sg__json_fp {
+  uint64_t f;
+  int e;
+};
+
+static const uint64_t sg__json_pow_f[] = {
+  0xfa8fd5a0081c0288ULL, 0xbaaee17fa23ebf76ULL, 0x8b16fb203055ac76ULL,
+  0xcf42894a5dce35eaULL, 0x9a6bb0aa55653b2dULL, 0xe61acf033d1a45dfULL,
+  0xab70fe17c79ac6caULL, 0xff77b1fcbebcdc4fULL, 0xbe5691ef416bd60cULL,
+  0x8dd01fad907ffc3cULL, 0xd3515c2831559a83ULL, 0x9d71ac8fada6c9b5ULL,
+  0xea9c227723ee8bcbULL, 0xaecc49914078536dULL, 0x823c12795db6ce57ULL,
+  0xc21094364dfb5637ULL, 0x9096ea6f3848984fULL, 0xd77485cb25823ac7ULL,
+  0xa086cfcd97bf97f4ULL, 0xef340a98172aace5ULL, 0xb23867fb2a35b28eULL,
+  0x84c8d4dfd2c63f3bULL, 0xc5dd44271ad3cdbaULL, 0x936b9fcebb25c996ULL,
+  0xdbac6c247d62a584ULL, 0xa3ab66580d5fdaf6ULL, 0xf3e2f893dec3f126ULL,
+  0xb5b5ada8aaff80b8ULL, 0x87625f056c7c4a8bULL, 0xc9bcff6034c13053ULL,
+  0x964e858c91ba2655ULL, 0xdff9772470297ebdULL, 0xa6dfbd9fb8e5b88fULL,
+  0xf8a95fcf88747d94ULL, 0xb94470938fa89bcfULL, 0x8a08f0f8bf0f156bULL,
+  0xcdb02555653131b6ULL, 0x993fe2c6d07b7facULL, 0xe45c10c42a2b3b06ULL,
+  0xaa242499697392d3ULL, 0xfd87b5f28300ca0eULL, 0xbce5086492111aebULL,
+  0x8cbccc096f5088ccULL, 0xd1b71758e219652cULL, 0x9c40000000000000ULL,
+  0xe8d4a51000000000ULL, 0xad78ebc5ac620000ULL, 0x813f3978f8940984ULL,
+  0xc097ce7bc90715b3ULL, 0x8f7e32ce7bea5c70ULL, 0xd5d238a4abe98068ULL,
+  0x9f4f2726179a2245ULL, 0xed63a231d4c4fb27ULL, 0xb0de65388cc8ada8ULL,
+  0x83c7088e1aab65dbULL, 0xc45d1df942711d9aULL, 0x924d692ca61be758ULL,
+  0xda01ee641a708deaULL, 0xa26da3999aef774aULL, 0xf209787bb47d6b85ULL,
+  0xb454e4a179dd1877ULL, 0x865b86925b9bc5c2ULL, 0xc83553c5c8965d3dULL,
+  0x952ab45cfa97a0b3ULL, 0xde469fbd99a05fe3ULL, 0xa59bc234db398c25ULL,
+  0xf6c69a72a3989f5cULL, 0xb7dcbf5354e9beceULL, 0x88fcf317f22241e2ULL,
+  0xcc20ce9bd35c78a5ULL, 0x98165af37b2153dfULL, 0xe2a0b5dc971f303aULL,
+  0xa8d9d1535ce3b396ULL, 0xfb9b7cd9a4a7443cULL, 0xbb764c4ca7a44410ULL,
+  0x8bab8eefb6409c1aULL, 0xd01fef10a657842cULL, 0x9b10a4e5e9913129ULL,
+  0xe7109bfba19c0c9dULL, 0xac2820d9623bf429ULL, 0x80444b5e7aa7cf85ULL,
+  0xbf21e44003acdd2dULL, 0x8e679c2f5e44ff8fULL, 0xd433179d9c8cb841ULL,
+  0x9e19db92b4e31ba9ULL, 0xeb96bf6ebadf77d9ULL, 0xaf87023b9bf0ee6bULL
+};
+
+static const short sg__json_pow_e[] = {
+  -1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980, -954,
+  -927, -901, -874, -847, -821, -794, -768, -741, -715, -688, -661, -635,
+  -608, -582, -555, -529, -502, -475, -449, -422, -396, -369, -343, -316,
+  -289, -263, -236, -210, -183, -157, -130, -103, -77, -50, -24, 3, 30, 56,
+  83, 109, 136, 162, 189, 216, 242, 269, 295, 322, 348, 375, 402, 428, 455,
+  481, 508, 534, 561, 588, 614, 641, 667, 694, 720, 747, 774, 800, 827, 853,
+  880, 907, 933, 960, 986, 1013, 1039, 1066
+};
+
+static const uint64_t sg__json_pow10[] = {UINT64_C(1),
+                                           UINT64_C(10),
+                                           UINT64_C(100),
+                                           UINT64_C(1000),
+                                           UINT64_C(10000),
+                                           UINT64_C(100000),
+                                           UINT64_C(1000000),
+                                           UINT64_C(10000000),
+                                           UINT64_C(100000000),
+                                           UINT64_C(1000000000),
+                                           UINT64_C(10000000000),
+                                           UINT64_C(100000000000),
+                                           UINT64_C(1000000000000),
+                                           UINT64_C(10000000000000),
+                                           UINT64_C(100000000000000),
+                                           UINT64_C(1000000000000000),
+                                           UINT64_C(10000000000000000),
+                                           UINT64_C(100000000000000000),
+                                           UINT64_C(1000000000000000000),
+                                           UINT64_C(10000000000000000000)};
+
+static struct sg__json_fp sg__json_fp_mul(struct sg__json_fp x,
+                                          struct sg__json_fp y) {
+  const uint64_t m32 = 0xffffffff;
+  uint64_t a = x.f >> 32, b = x.f & m32, c = y.f >> 32, d = y.f & m32;
+  uint64_t ac = a * c, bc = b * c, ad = a * d, bd = b * d, tmp;
+  struct sg__json_fp r;
+  tmp = (bd >> 32) + (ad & m32) + (bc & m32);
+  tmp += UINT64_C(1) << 31; /* rounds */
+  r.f = ac + (ad >> 32) + (bc >> 32) + (tmp >> 32);
+  r.e = x.e + y.e + 64;
+  return r;
+}
+
+static struct sg__json_fp sg__json_fp_norm(struct sg__json_fp x) {
+  while (!(x.f & (UINT64_C(1) << 63))) {
+    x.f <<= 1;
+    x.e--;
+  }
+  return x;
+}
+
+static void sg__json_round(char *buf, int len, uint64_t delta, uint64_t rest,
+                           uint64_t ten_kappa, uint64_t wp_w) {
+  while ((rest < wp_w) && (delta - rest >= ten_kappa) &&
+         ((rest + ten_kappa < wp_w) ||
+          (wp_w - rest > rest + ten_kappa - wp_w))) {
+    buf[len - 1]--;
+    rest += ten_kappa;
+  }
+}
+
+static int sg__json_digitcount(uint32_t n) {
+  int count = 1;
+  while ((count < 10) && (n >= sg__json_pow10[count]))
+    count++;
+  return count;
+}
+
+static void sg__json_digitgen(struct sg__json_fp w, struct sg__json_fp mp,
+                              uint64_t delta, char *buf, int *len, int *k) {
+  struct sg__json_fp one, wp_w;
+  uint32_t p1, d;
+  uint64_t p2, tmp;
+  int kappa;
+  one.f = UINT64_C(1) << -mp.e;
+  one.e = mp.e;
+  wp_w.f = mp.f - w.f;
+  wp_w.e = mp.e;
+  p1 = (uint32_t) (mp.f >> -one.e);
+  p2 = mp.f & (one.f - 1);
+  kappa = sg__json_digitcount(p1);
+  *len = 0;
+  while (kappa > 0) {
+    d = p1 / (uint32_t) sg__json_pow10[kappa - 1];
+    p1 %= (uint32_t) sg__json_pow10[kappa - 1];
+    if (d || *len)
+      buf[(*len)++] = (char) ('0' + d);
+    kappa--;
+    tmp = ((uint64_t) p1 << -one.e) + p2;
+    if (tmp <= delta) {
+      *k += kappa;
+      sg__json_round(buf, *len, delta, tmp,
+                     sg__json_pow10[kappa] << -one.e, wp_w.f);
+      return;
+    }
+  }
+  for (;;) {
+    p2 *= 10;
+    delta *= 10;
+    d = (uint32_t) (p2 >> -one.e);
+    if (d || *len)
+      buf[(*len)++] = (char) ('0' + d);
+    p2 &= one.f - 1;
+    kappa--;
+    if (p2 < delta) {
+      *k += kappa;
+      sg__json_round(buf, *len, delta, p2, one.f,
+                     wp_w.f * (-kappa < 20 ? sg__json_pow10[-kappa] : 0));
+      return;
+    }
+  }
+}
+
+static void sg__json_grisu2(double val, char *buf, int *len, int *k) {
+  struct sg__json_fp v, w, mi, pl, c;
+  uint64_t bits;
+  double dk;
+  int biased_e, ck;
+  unsigned int index;
+  memcpy(&bits, &val, sizeof(bits));
+  biased_e = (int) ((bits >> 52) & 0x7ff);
+  v.f = bits & ((UINT64_C(1) << 52) - 1);
+  if (biased_e != 0) {
+    v.f += UINT64_C(1) << 52;
+    v.e = biased_e - 1075;
+  } else
+    v.e = -1074;
+  /* boundaries m- and m+, normalized to the exponent of m+ */
+  pl.f = (v.f << 1) + 1;
+  pl.e = v.e - 1;
+  while (!(pl.f & (UINT64_C(1) << 53))) {
+    pl.f <<= 1;
+    pl.e--;
+  }
+  pl.f <<= 10;
+  pl.e -= 10;
+  if (v.f == (UINT64_C(1) << 52)) {
+    mi.f = (v.f << 2) - 1;
+    mi.e = v.e - 2;
+  } else {
+    mi.f = (v.f << 1) - 1;
+    mi.e = v.e - 1;
+  }
+  mi.f <<= mi.e - pl.e;
+  mi.e = pl.e;
+  /* cached power c = 10^-k which brings m+ into the [-60, -32] range */
+  dk = (-61 - pl.e) * 0.30102999566398114 + 347;
+  ck = (int) dk;
+  if (dk - ck > 0.0)
+    ck++;
+  index = (unsigned int) ((ck >> 3) + 1);
+  *k = -(-348 + (int) (index << 3));
+  c.f = sg__json_pow_f[index];
+  c.e = sg__json_pow_e[index];
+  w = sg__json_fp_mul(sg__json_fp_norm(v), c);
+  pl = sg__json_fp_mul(pl, c);
+  mi = sg__json_fp_mul(mi, c);
+  mi.f++;
+  pl.f--;
+  sg__json_digitgen(w, pl, pl.f - mi.f, buf, len, k);
+}
+
+static char *sg__json_exp(int k, char *buf) {
+  if (k < 0) {
+    *buf++ = '-';
+    k = -k;
+  }
+  if (k >= 100) {
+    *buf++ = (char) ('0' + k / 100);
+    k %= 100;
+    *buf++ = sg__json_digits[k * 2];
+    *buf++ = sg__json_digits[k * 2 + 1];
+  } else if (k >= 10) {
+    *buf++ = sg__json_digits[k * 2];
+    *buf++ = sg__json_digits[k * 2 + 1];
+  } else
+    *buf++ = (char) ('0' + k);
+  return buf;
+}
+
+static char *sg__json_prettify(char *buf, int len, int k) {
+  const int kk = len + k; /* 10^(kk - 1) <= v < 10^kk */
+  int i, offset;
+  if ((k >= 0) && (kk <= 21)) {
+    /* 1234e7 -> 12340000000.0 */
+    for (i = len; i < kk; i++)
+      buf[i] = '0';
+    buf[kk] = '.';
+    buf[kk + 1] = '0';
+    return &buf[kk + 2];
+  }
+  if ((kk > 0) && (kk <= 21)) {
+    /* 1234e-2 -> 12.34 */
+    memmove(&buf[kk + 1], &buf[kk], (size_t) (len - kk));
+    buf[kk] = '.';
+    return &buf[len + 1];
+  }
+  if ((kk > -6) && (kk <= 0)) {
+    /* 1234e-6 -> 0.001234 */
+    offset = 2 - kk;
+    memmove(&buf[offset], &buf[0], (size_t) len);
+    buf[0] = '0';
+    buf[1] = '.';
+    for (i = 2; i < offset; i++)
+      buf[i] = '0';
+    return &buf[len + offset];
+  }
+  if (len == 1) {
+    /* 1e30 */
+    buf[1] = 'e';
+    return sg__json_exp(kk - 1, &buf[2]);
+  }
+  /* 1234e30 -> 1.234e33 */
+  memmove(&buf[2], &buf[1], (size_t) (len - 1));
+  buf[1] = '.';
+  buf[len + 1] = 'e';
+  return sg__json_exp(kk - 1, &buf[len + 2]);
+}
+
+/* Writes the shortest representation of a finite `val` which reads back to
+ * the same double, returning a pointer past the last character. */
+char *sg__json_dtoa(double val, char *buf) {
+  int len, k;
+  if (val == 0) {
+    if (signbit(val))
+      *buf++ = '-';
+    memcpy(buf, "0.0", 3);
+    return buf + 3;
+  }
+  if (val < 0) {
+    *buf++ = '-';
+    val = -val;
+  }
+  sg__json_grisu2(val, buf, &len, &k);
+  return sg__json_prettify(buf, len, k);
+}
+
+/* Structure. */
+
+static int sg__json_value(struct sg_json *json, size_t size) {
+  unsigned char *top;
+  int errnum;
+  if (json->depth == 0) {
+    if (json->done)
+      return EINVAL;
+  } else {
+    top = &json->stack[json->depth - 1];
+    if (*top & SG__JSON_OBJECT) {
+      if (!json->key)
+        return EINVAL;
+      json->key = false;
+    } else if (!(*top & SG__JSON_FIRST))
+      size++;
+  }
+  errnum = sg__json_reserve(json, size);
+  if (errnum != 0)
+    return errnum;
+  if (json->depth > 0) {
+    top = &json->stack[json->depth - 1];
+    if (!(*top & SG__JSON_OBJECT) && !(*top & SG__JSON_FIRST))
+      sg__json_putc(json, ',');
+    *top &= (unsigned char) ~SG__JSON_FIRST;
+  }
+  return 0;
+}
+
+static int sg__json_literal(struct sg_json *json, const char *val,
+                            size_t len) {
+  int errnum;
+  if (!json)
+    return EINVAL;
+  errnum = sg__json_value(json, len);
+  if (errnum != 0)
+    return errnum;
+  sg__json_put(json, val, len);
+  if (json->depth == 0)
+    json->done = true;
+  return sg__json_end(json);
+}
+
+static int sg__json_begin(struct sg_json *json, unsigned char type, char c) {
+  int errnum;
+  if (!json)
+    return EINVAL;
+  if (json->depth == SG__JSON_MAX_DEPTH)
+    return EOVERFLOW;
+  errnum = sg__json_value(json, 1);
+  if (errnum != 0)
+    return errnum;
+  sg__json_putc(json, c);
+  json->stack[json->depth++] = type | SG__JSON_FIRST;
+  return sg__json_end(json);
+}
+
+static int sg__json_close(struct sg_json *json, unsigned char type, char c) {
+  int errnum;
+  if (!json || (json->depth == 0) ||
+      ((json->stack[json->depth - 1] & SG__JSON_OBJECT) != type) || json->key)
+    return EINVAL;
+  errnum = sg__json_reserve(json, 1);
+  if (errnum != 0)
+    return errnum;
+  sg__json_putc(json, c);
+  if (--json->depth == 0)
+    json->done = true;
+  return sg__json_end(json);
+}
+
+static struct sg_json *sg__json_new(struct sg_str *buf,
+                                    struct sg_httpwrt *wrt) {
+  struct sg_json *json = sg_alloc(sizeof(struct sg_json));
+  if (!json)
+    return NULL;
+  if (!buf) {
+    buf = sg_str_new();
+    if (!buf) {
+      sg_free(json);
+      return NULL;
+    }
+  }
+  json->buf = buf;
+  json->wrt = wrt;
+  return json;
+}
+
+struct sg_json *sg_json_new(struct sg_str *str) {
+  if (!str) {
+    errno = EINVAL;
+    return NULL;
+  }
+  return sg__json_new(str, NULL);
+}
+
+struct sg_json *sg_json_new2(struct sg_httpwrt *wrt) {
+  if (!wrt) {
+    errno = EINVAL;
+    return NULL;
+  }
+  return sg__json_new(NULL, wrt);
+}
+
+void sg_json_free(struct sg_json *json) {
+  if (!json)
+    return;
+  if (json->wrt)
+    sg_str_free(json->buf);
+  sg_free(json);
+}
+
+int sg_json_flush(struct sg_json *json) {
+  int errnum;
+  if (!json)
+    return EINVAL;
+  if (!json->wrt || (json->buf->i == 0))
+    return 0;
+  errnum = sg_httpwrt_write(json->wrt, json->buf->d, json->buf->i);
+  if (errnum != 0)
+    return errnum;
+  sg_str_clear(json->buf);
+  return 0;
+}
+
+int sg_json_begin_object(struct sg_json *json) {
+  return sg__json_begin(json, SG__JSON_OBJECT, '{');
+}
+
+int sg_json_end_object(struct sg_json *json) {
+  return sg__json_close(json, SG__JSON_OBJECT, '}');
+}
+
+int sg_json_begin_array(struct sg_json *json) {
+  return sg__json_begin(json, 0, '[');
+}
+
+int sg_json_end_array(struct sg_json *json) {
+  return sg__json_close(json, 0, ']');
+}
+
+int sg_json_key(struct sg_json *json, const char *key) {
+  unsigned char *top;
+  int errnum;
+  if (!json || !key || (json->depth == 0))
+    return EINVAL;
+  top = &json->stack[json->depth - 1];
+  if (!(*top & SG__JSON_OBJECT) || json->key)
+    return EINVAL;
+  errnum = sg__json_reserve(json, 2);
+  if (errnum != 0)
+    return errnum;
+  if (!(*top & SG__JSON_FIRST))
+    sg__json_putc(json, ',');
+  errnum = sg__json_str(json, key);
+  if (errnum != 0)
+    return errnum;
+  sg__json_putc(json, ':');
+  *top &= (unsigned char) ~SG__JSON_FIRST;
+  json->key = true;
+  return 0;
+}
+
+int sg_json_string(struct sg_json *json, const char *val) {
+  int errnum;
+  if (!json || !val)
+    return EINVAL;
+  errnum = sg__json_value(json, 0);
+  if (errnum != 0)
+    return errnum;
+  errnum = sg__json_str(json, val);
+  if (errnum != 0)
+    return errnum;
+  if (json->depth == 0)
+    json->done = true;
+  return sg__json_end(json);
+}
+
+int sg_json_int(struct sg_json *json, int64_t val) {
+  char buf[21], *p = buf + sizeof(buf);
+  p = sg__json_utoa(val < 0 ? (uint64_t) 0 - (uint64_t) val : (uint64_t) val,
+                    p);
+  if (val < 0)
+    *--p = '-';
+  return sg__json_literal(json, p, (size_t) (buf + sizeof(buf) - p));
+}
+
+int sg_json_uint(struct sg_json *json, uint64_t val) {
+  char buf[20], *p = buf + sizeof(buf);
+  p = sg__json_utoa(val, p);
+  return sg__json_literal(json, p, (size_t) (buf + sizeof(buf) - p));
+}
+
+int sg_json_double(struct sg_json *json, double val) {
+  char buf[SG__JSON_DTOA_SIZE + 1];
+  if (!isfinite(val))
+    return EINVAL;
+  return sg__json_literal(json, buf, (size_t) (sg__json_dtoa(val, buf) - buf));
+}
+
+int sg_json_bool(struct sg_json *json, bool val) {
+  return val ? sg__json_literal(json, "true", 4) :
+               sg__json_literal(json, "false", 5);
+}
+
+int sg_json_null(struct sg_json *json) {
+  return sg__json_literal(json, "null", 4);
+}
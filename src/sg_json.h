@@ -0,0 +1,60 @@
+/*                         _
+ *   ___  __ _  __ _ _   _(_)
+ *  / __|/ _` |/ _` | | | | |
+ *  \__ \ (_| | (_| | |_| | |
+ *  |___/\__,_|\__, |\__,_|_|
+ *             |___/
+ *
+ * Cross-platform library which helps to develop web servers or frameworks.
+ *
+ * Copyright (C) 2016-2020 Silvio Clecio <silvioprog@gmail.com>
+ *
+ * Sagui library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * Sagui library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Sagui library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef SG_JSON_H
+#define SG_JSON_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "sg_macros.h"
+#include "sagui.h"
+#include "sg_str.h"
+
+#define SG__JSON_MAX_DEPTH 64
+
+/* Longest output of `sg__json_dtoa()`, e.g. "-1.2345678901234567e-308". */
+#define SG__JSON_DTOA_SIZE 25
+
+/* Bits of each nesting level. */
+#define SG__JSON_OBJECT 0x01
+#define SG__JSON_FIRST 0x02
+
+struct sg_json {
+  struct sg_str *buf;
+  struct sg_httpwrt *wrt;
+  unsigned char stack[SG__JSON_MAX_DEPTH];
+  unsigned int depth;
+  bool key;
+  bool done;
+};
+
+SG__EXTERN size_t sg__json_safelen(const char *str, size_t len);
+
+SG__EXTERN char *sg__json_utoa(uint64_t val, char *buf);
+
+SG__EXTERN char *sg__json_dtoa(double val, char *buf);
+
+#endif /* SG_JSON_H */
@@ -60,6 +60,11 @@
 
 #endif /* _WIN32 */
 
+/* anonymous upload files, published only when they are saved */
+#if defined(__linux__) && defined(O_TMPFILE)
+#define SG__HTTPUPLD_TMPFILE 1
+#endif /* __linux__ && O_TMPFILE */
+
 /* used by utstring library */
 #ifndef utstring_oom
 #define utstring_oom() ((void) 0)
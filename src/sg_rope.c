@@ -0,0 +1,300 @@
+/*                         _
+ *   ___  __ _  __ _ _   _(_)
+ *  / __|/ _` |/ _` | | | | |
+ *  \__ \ (_| | (_| | |_| | |
+ *  |___/\__,_|\__, |\__,_|_|
+ *             |___/
+ *
+ * Cross-platform library which helps to develop web servers or frameworks.
+ *
+ * Copyright (C) 2016-2020 Silvio Clecio <silvioprog@gmail.com>
+ *
+ * Sagui library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * Sagui library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Sagui library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <microhttpd.h>
+#include "sg_macros.h"
+#include "sagui.h"
+#include "sg_strmap.h"
+#include "sg_httpres.h"
+#include "sg_rope.h"
+
+/* Free chunks shared by all ropes, so large responses built repeatedly do not
+ * go back to the allocator for every chunk. */
+static pthread_mutex_t sg__rope_pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct sg__rope_chunk *sg__rope_pool;
+static unsigned int sg__rope_pool_len;
+
+struct sg__rope_chunk *sg__rope_chunk_get(void) {
+  struct sg__rope_chunk *chunk;
+  pthread_mutex_lock(&sg__rope_pool_mutex);
+  chunk = sg__rope_pool;
+  if (chunk) {
+    sg__rope_pool = chunk->next;
+    sg__rope_pool_len--;
+  }
+  pthread_mutex_unlock(&sg__rope_pool_mutex);
+  if (!chunk) {
+    chunk = sg_malloc(sizeof(struct sg__rope_chunk));
+    if (!chunk)
+      return NULL;
+  }
+  chunk->next = NULL;
+  chunk->size = 0;
+  return chunk;
+}
+
+void sg__rope_chunk_put(struct sg__rope_chunk *chunk) {
+  pthread_mutex_lock(&sg__rope_pool_mutex);
+  if (sg__rope_pool_len < SG__ROPE_POOL_SIZE) {
+    chunk->next = sg__rope_pool;
+    sg__rope_pool = chunk;
+    sg__rope_pool_len++;
+    chunk = NULL;
+  }
+  pthread_mutex_unlock(&sg__rope_pool_mutex);
+  sg_free(chunk);
+}
+
+unsigned int sg__rope_pool_count(void) {
+  unsigned int count;
+  pthread_mutex_lock(&sg__rope_pool_mutex);
+  count = sg__rope_pool_len;
+  pthread_mutex_unlock(&sg__rope_pool_mutex);
+  return count;
+}
+
+/* Appends the whole content to `str` with a single exact reservation. */
+int sg__rope_flatten(struct sg_rope *rope, struct sg_str *str) {
+  struct sg__rope_chunk *chunk;
+  if (rope->size > (SIZE_MAX - str->i - 1))
+    return ENOMEM;
+  if (sg_str_reserve(str, str->i + (size_t) rope->size) != 0)
+    return ENOMEM;
+  for (chunk = rope->head; chunk; chunk = chunk->next) {
+    memcpy(str->d + str->i, chunk->data, chunk->size);
+    str->i += chunk->size;
+  }
+  str->d[str->i] = '\0';
+  return 0;
+}
+
+static void sg__rope_link(struct sg_rope *rope, struct sg__rope_chunk *chunk) {
+  if (rope->tail)
+    rope->tail->next = chunk;
+  else
+    rope->head = chunk;
+  rope->tail = chunk;
+  rope->count++;
+}
+
+static void sg__rope_release(struct sg_rope *rope) {
+  struct sg__rope_chunk *chunk, *next;
+  for (chunk = rope->head; chunk; chunk = next) {
+    next = chunk->next;
+    sg__rope_chunk_put(chunk);
+  }
+  rope->head = rope->tail = NULL;
+  rope->size = 0;
+  rope->count = 0;
+}
+
+struct sg_rope *sg_rope_new(void) {
+  return sg_alloc(sizeof(struct sg_rope));
+}
+
+void sg_rope_free(struct sg_rope *rope) {
+  if (!rope)
+    return;
+  sg__rope_release(rope);
+  sg_free(rope);
+}
+
+int sg_rope_write(struct sg_rope *rope, const char *val, size_t len) {
+  struct sg__rope_chunk *chunk;
+  size_t size;
+  if (!rope || !val || (len < 1))
+    return EINVAL;
+  rope->size += len;
+  chunk = rope->tail;
+  if (chunk && ((SG__ROPE_CHUNK_SIZE - chunk->size) >= len)) {
+    memcpy(chunk->data + chunk->size, val, len);
+    chunk->size += len;
+    return 0;
+  }
+  for (;;) {
+    chunk = rope->tail;
+    if (!chunk || (chunk->size == SG__ROPE_CHUNK_SIZE)) {
+      chunk = sg__rope_chunk_get();
+      if (!chunk) {
+        rope->size -= len;
+        return ENOMEM;
+      }
+      sg__rope_link(rope, chunk);
+    }
+    size = SG__ROPE_CHUNK_SIZE - chunk->size;
+    if (size > len)
+      size = len;
+    memcpy(chunk->data + chunk->size, val, size);
+    chunk->size += size;
+    len -= size;
+    if (len == 0)
+      return 0;
+    val += size;
+  }
+}
+
+int sg_rope_printf_va(struct sg_rope *rope, const char *fmt, va_list ap) {
+  struct sg__rope_chunk *chunk;
+  va_list cp;
+  char *buf;
+  size_t avail;
+  int len, errnum;
+  if (!rope || !fmt)
+    return EINVAL;
+#if !defined(__arm__) && !defined(__aarch64__)
+  if (!ap)
+    return EINVAL;
+#endif /* !__arm__ && !__aarch64__ */
+  chunk = rope->tail;
+  avail = chunk ? SG__ROPE_CHUNK_SIZE - chunk->size : 0;
+  va_copy(cp, ap);
+  len = vsnprintf(avail > 0 ? chunk->data + chunk->size : NULL, avail, fmt,
+                  cp);
+  va_end(cp);
+  if (len <= 0)
+    return len < 0 ? EINVAL : 0;
+  if ((size_t) len < avail) {
+    chunk->size += (size_t) len;
+    rope->size += (size_t) len;
+    return 0;
+  }
+  if ((size_t) len < SG__ROPE_CHUNK_SIZE) {
+    /* formats into a fresh chunk, then tops up the current one with the
+     * leading bytes, so only the last chunk is ever partially filled */
+    chunk = sg__rope_chunk_get();
+    if (!chunk)
+      return ENOMEM;
+    vsnprintf(chunk->data, SG__ROPE_CHUNK_SIZE, fmt, ap);
+    if (avail > 0) {
+      memcpy(rope->tail->data + rope->tail->size, chunk->data, avail);
+      rope->tail->size += avail;
+      memmove(chunk->data, chunk->data + avail, (size_t) len - avail);
+    }
+    chunk->size = (size_t) len - avail;
+    rope->size += (size_t) len;
+    if (chunk->size > 0)
+      sg__rope_link(rope, chunk);
+    else
+      sg__rope_chunk_put(chunk);
+    return 0;
+  }
+  buf = sg_malloc((size_t) len + 1);
+  if (!buf)
+    return ENOMEM;
+  vsnprintf(buf, (size_t) len + 1, fmt, ap);
+  errnum = sg_rope_write(rope, buf, (size_t) len);
+  sg_free(buf);
+  return errnum;
+}
+
+int sg_rope_printf(struct sg_rope *rope, const char *fmt, ...) {
+  va_list ap;
+  int ret;
+  if (!rope || !fmt)
+    return EINVAL;
+  va_start(ap, fmt);
+  ret = sg_rope_printf_va(rope, fmt, ap);
+  va_end(ap);
+  return ret;
+}
+
+uint64_t sg_rope_length(struct sg_rope *rope) {
+  if (!rope) {
+    errno = EINVAL;
+    return 0;
+  }
+  return rope->size;
+}
+
+int sg_rope_clear(struct sg_rope *rope) {
+  if (!rope)
+    return EINVAL;
+  sg__rope_release(rope);
+  return 0;
+}
+
+static void sg__rope_free_cb(void *cls) {
+  sg_rope_free(cls);
+}
+
+int sg_httpres_sendrope(struct sg_httpres *res, struct sg_rope *rope,
+                        const char *content_type, unsigned int status) {
+  struct sg__rope_chunk *chunk;
+  struct MHD_IoVec *vec;
+  unsigned int i;
+  int errnum;
+  if (!res || !rope || (status < 100) || (status > 599)) {
+    errnum = EINVAL;
+    goto error;
+  }
+  if (rope->size > (SIZE_MAX / 2)) {
+    errnum = EOVERFLOW;
+    goto error;
+  }
+  if (res->handle) {
+    errnum = EALREADY;
+    goto error;
+  }
+  if (content_type) {
+    errnum =
+      sg_strmap_set(&res->headers, MHD_HTTP_HEADER_CONTENT_TYPE, content_type);
+    if (errnum != 0)
+      goto error;
+  }
+  if (rope->count == 0) {
+    res->handle =
+      MHD_create_response_from_buffer(0, NULL, MHD_RESPMEM_PERSISTENT);
+    if (res->handle)
+      sg_rope_free(rope);
+  } else {
+    vec = sg_malloc(rope->count * sizeof(struct MHD_IoVec));
+    if (!vec) {
+      errnum = ENOMEM;
+      goto error;
+    }
+    for (chunk = rope->head, i = 0; chunk; chunk = chunk->next, i++) {
+      vec[i].iov_base = chunk->data;
+      vec[i].iov_len = chunk->size;
+    }
+    res->handle = MHD_create_response_from_iovec(vec, rope->count,
+                                                 sg__rope_free_cb, rope);
+    sg_free(vec);
+  }
+  if (!res->handle) {
+    errnum = ENOMEM;
+    goto error;
+  }
+  res->status = status;
+  return 0;
+error:
+  sg_rope_free(rope);
+  return errnum;
+}
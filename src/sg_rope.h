@@ -0,0 +1,63 @@
+/*                         _
+ *   ___  __ _  __ _ _   _(_)
+ *  / __|/ _` |/ _` | | | | |
+ *  \__ \ (_| | (_| | |_| | |
+ *  |___/\__,_|\__, |\__,_|_|
+ *             |___/
+ *
+ * Cross-platform library which helps to develop web servers or frameworks.
+ *
+ * Copyright (C) 2016-2020 Silvio Clecio <silvioprog@gmail.com>
+ *
+ * Sagui library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * Sagui library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Sagui library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+
+#ifndef SG_ROPE_H
+#define SG_ROPE_H
+
+#include <stdint.h>
+#include "sg_macros.h"
+#include "sagui.h"
+#include "sg_str.h"
+
+/* Data size of each chunk. */
+#define SG__ROPE_CHUNK_SIZE 65536
+
+/* Maximum number of free chunks kept by the pool. */
+#define SG__ROPE_POOL_SIZE 64
+
+struct sg__rope_chunk {
+  struct sg__rope_chunk *next;
+  size_t size;
+  char data[SG__ROPE_CHUNK_SIZE];
+};
+
+struct sg_rope {
+  struct sg__rope_chunk *head;
+  struct sg__rope_chunk *tail;
+  uint64_t size;
+  unsigned int count;
+};
+
+SG__EXTERN struct sg__rope_chunk *sg__rope_chunk_get(void);
+
+SG__EXTERN void sg__rope_chunk_put(struct sg__rope_chunk *chunk);
+
+SG__EXTERN unsigned int sg__rope_pool_count(void);
+
+SG__EXTERN int sg__rope_flatten(struct sg_rope *rope, struct sg_str *str);
+
+#endif /* SG_ROPE_H */
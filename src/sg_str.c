@@ -24,36 +24,101 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
 #include <errno.h>
 #include "sg_str.h"
+#include "sg_json.h"
 #include "sagui.h"
 
-struct sg_str *sg_str_new(void) {
-  struct sg_str *str = sg_alloc(sizeof(struct sg_str));
-  if (str) {
-    utstring_new(str->buf);
-    if (!str->buf) {
-      sg_free(str);
-      return NULL;
-    }
+static void sg__str_init(struct sg_str *str) {
+  str->d = str->sbo;
+  str->n = sizeof(str->sbo);
+  str->i = 0;
+  str->d[0] = '\0';
+}
+
+static int sg__str_realloc(struct sg_str *str, size_t size) {
+  char *d;
+  if (str->d == str->sbo) {
+    d = sg_malloc(size);
+    if (!d)
+      return ENOMEM;
+    memcpy(d, str->d, str->i + 1);
+  } else {
+    d = sg_realloc(str->d, size);
+    if (!d)
+      return ENOMEM;
   }
+  str->d = d;
+  str->n = size;
+  return 0;
+}
+
+/* Grows geometrically, so a sequence of appends costs amortized O(1). */
+int sg__str_grow(struct sg_str *str, size_t len) {
+  size_t size;
+  if (SG__STR_ROOM(str, len))
+    return 0;
+  if (len >= SIZE_MAX - str->i)
+    return ENOMEM;
+  size = str->n * 2;
+  if (size < str->i + len + 1)
+    size = str->i + len + 1;
+  return sg__str_realloc(str, size);
+}
+
+struct sg_str *sg_str_new(void) {
+  struct sg_str *str = sg_malloc(sizeof(struct sg_str));
+  if (str)
+    sg__str_init(str);
   return str;
 }
 
 void sg_str_free(struct sg_str *str) {
   if (!str)
     return;
-  utstring_free(str->buf);
+  if (str->d != str->sbo)
+    sg_free(str->d);
   sg_free(str);
 }
 
 int sg_str_write(struct sg_str *str, const char *val, size_t len) {
   if (!str || !val || (len < 1))
     return EINVAL;
-  utstring_bincpy(str->buf, val, len);
+  if (!SG__STR_ROOM(str, len) && (sg__str_grow(str, len) != 0))
+    return ENOMEM;
+  memcpy(str->d + str->i, val, len);
+  str->i += len;
+  str->d[str->i] = '\0';
   return 0;
 }
 
+static int sg__str_printf_va(struct sg_str *str, const char *fmt,
+                             va_list ap) {
+  va_list cp;
+  int len;
+  for (;;) {
+    va_copy(cp, ap);
+    len = vsnprintf(str->d + str->i, str->n - str->i, fmt, cp);
+    va_end(cp);
+    if (len < 0) {
+      str->d[str->i] = '\0';
+      return EINVAL;
+    }
+    if (SG__STR_ROOM(str, (size_t) len)) {
+      str->i += (size_t) len;
+      return 0;
+    }
+    if (sg__str_grow(str, (size_t) len) != 0) {
+      str->d[str->i] = '\0';
+      return ENOMEM;
+    }
+  }
+}
+
 int sg_str_printf_va(struct sg_str *str, const char *fmt, va_list ap) {
   if (!str || !fmt)
     return EINVAL;
@@ -61,17 +126,69 @@ int sg_str_printf_va(struct sg_str *str, const char *fmt, va_list ap) {
   if (!ap)
     return EINVAL;
 #endif /* !__arm__ && !__aarch64__ */
-  utstring_printf_va(str->buf, fmt, ap);
-  return 0;
+  return sg__str_printf_va(str, fmt, ap);
 }
 
 int sg_str_printf(struct sg_str *str, const char *fmt, ...) {
   va_list ap;
+  int ret;
   if (!str || !fmt)
     return EINVAL;
   va_start(ap, fmt);
-  utstring_printf_va(str->buf, fmt, ap);
+  ret = sg__str_printf_va(str, fmt, ap);
   va_end(ap);
+  return ret;
+}
+
+int sg_str_append_char(struct sg_str *str, char c) {
+  if (!str)
+    return EINVAL;
+  if (!SG__STR_ROOM(str, 1) && (sg__str_grow(str, 1) != 0))
+    return ENOMEM;
+  str->d[str->i++] = c;
+  str->d[str->i] = '\0';
+  return 0;
+}
+
+static int sg__str_append_uint(struct sg_str *str, uint64_t val, bool neg) {
+  char buf[21], *end = buf + sizeof(buf), *p;
+  size_t len;
+  p = sg__json_utoa(val, end);
+  if (neg)
+    *--p = '-';
+  len = (size_t) (end - p);
+  if (!SG__STR_ROOM(str, len) && (sg__str_grow(str, len) != 0))
+    return ENOMEM;
+  memcpy(str->d + str->i, p, len);
+  str->i += len;
+  str->d[str->i] = '\0';
+  return 0;
+}
+
+int sg_str_append_int(struct sg_str *str, int64_t val) {
+  if (!str)
+    return EINVAL;
+  if (val < 0)
+    return sg__str_append_uint(str, (uint64_t) 0 - (uint64_t) val, true);
+  return sg__str_append_uint(str, (uint64_t) val, false);
+}
+
+int sg_str_append_uint(struct sg_str *str, uint64_t val) {
+  if (!str)
+    return EINVAL;
+  return sg__str_append_uint(str, val, false);
+}
+
+int sg_str_append_double(struct sg_str *str, double val) {
+  char *end;
+  if (!str || !isfinite(val))
+    return EINVAL;
+  if (!SG__STR_ROOM(str, SG__JSON_DTOA_SIZE) &&
+      (sg__str_grow(str, SG__JSON_DTOA_SIZE) != 0))
+    return ENOMEM;
+  end = sg__json_dtoa(val, str->d + str->i);
+  *end = '\0';
+  str->i = (size_t) (end - str->d);
   return 0;
 }
 
@@ -80,7 +197,7 @@ const char *sg_str_content(struct sg_str *str) {
     errno = EINVAL;
     return NULL;
   }
-  return utstring_body(str->buf);
+  return str->d;
 }
 
 size_t sg_str_length(struct sg_str *str) {
@@ -88,12 +205,61 @@ size_t sg_str_length(struct sg_str *str) {
     errno = EINVAL;
     return 0;
   }
-  return utstring_len(str->buf);
+  return str->i;
+}
+
+int sg_str_reserve(struct sg_str *str, size_t size) {
+  if (!str)
+    return EINVAL;
+  if (size < str->n)
+    return 0;
+  if (size == SIZE_MAX)
+    return ENOMEM;
+  return sg__str_realloc(str, size + 1);
+}
+
+int sg_str_shrink(struct sg_str *str) {
+  if (!str)
+    return EINVAL;
+  if (str->d == str->sbo)
+    return 0;
+  if (str->i < sizeof(str->sbo)) {
+    memcpy(str->sbo, str->d, str->i + 1);
+    sg_free(str->d);
+    str->d = str->sbo;
+    str->n = sizeof(str->sbo);
+    return 0;
+  }
+  if (str->i + 1 == str->n)
+    return 0;
+  return sg__str_realloc(str, str->i + 1);
+}
+
+char *sg_str_detach(struct sg_str *str, size_t *len) {
+  char *d;
+  if (!str) {
+    errno = EINVAL;
+    return NULL;
+  }
+  if (str->d == str->sbo) {
+    d = sg_malloc(str->i + 1);
+    if (!d) {
+      errno = ENOMEM;
+      return NULL;
+    }
+    memcpy(d, str->sbo, str->i + 1);
+  } else
+    d = str->d;
+  if (len)
+    *len = str->i;
+  sg__str_init(str);
+  return d;
 }
 
 int sg_str_clear(struct sg_str *str) {
   if (!str)
     return EINVAL;
-  utstring_clear(str->buf);
+  str->i = 0;
+  str->d[0] = '\0';
   return 0;
 }
@@ -27,11 +27,22 @@
 #ifndef SG_STR_H
 #define SG_STR_H
 
+#include <stddef.h>
 #include "sg_macros.h"
-#include "utstring.h"
+
+/* Size of the inline buffer used while the content fits in it. */
+#define SG__STR_SBO_SIZE 40
 
 struct sg_str {
-  UT_string *buf;
+  char *d; /* content, points to `sbo` or to the heap */
+  size_t n; /* allocated size */
+  size_t i; /* content length */
+  char sbo[SG__STR_SBO_SIZE];
 };
 
+/* Ensures room for `len` more bytes plus the null terminator. */
+#define SG__STR_ROOM(str, len) (((str)->n - (str)->i) > (len))
+
+SG__EXTERN int sg__str_grow(struct sg_str *str, size_t len);
+
 #endif /* SG_STR_H */
@@ -24,41 +24,267 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
 #include <errno.h>
+#include <pthread.h>
 #include "sg_macros.h"
 #include "sagui.h"
 #include "sg_utils.h"
 #include "sg_strmap.h"
 
-struct sg_strmap *sg__strmap_new(const char *name, const char *val) {
-  struct sg_strmap *pair = sg_alloc(sizeof(struct sg_strmap));
+#define SG__STRMAP_ONES UINT64_C(0x0101010101010101)
+#define SG__STRMAP_HIGH (SG__STRMAP_ONES * 0x80)
+#define SG__STRMAP_MUL UINT64_C(0x9e3779b97f4a7c15)
+
+#define SG__STRMAP_INLINE_VAL(pair) ((pair)->buf + (((pair)->len + 1) * 2))
+
+static uint64_t sg__strmap_seed;
+static pthread_once_t sg__strmap_seed_once = PTHREAD_ONCE_INIT;
+
+static uint64_t sg__strmap_mix(uint64_t h) {
+  h ^= h >> 33;
+  h *= UINT64_C(0xff51afd7ed558ccd);
+  h ^= h >> 33;
+  h *= UINT64_C(0xc4ceb9fe1a85ec53);
+  h ^= h >> 33;
+  return h;
+}
+
+static void sg__strmap_seed_init(void) {
+  uint64_t seed = (uint64_t) time(NULL);
+  /* the addresses vary per process when ASLR is enabled */
+  seed ^= (uint64_t) (uintptr_t) &seed;
+  seed ^= (uint64_t) (uintptr_t) &sg__strmap_seed << 16;
+  seed ^= (uint64_t) clock() << 40;
+  sg__strmap_seed = sg__strmap_mix(seed);
+}
+
+/* Lowercases the ASCII letters of eight bytes at once. */
+static uint64_t sg__strmap_fold(uint64_t w) {
+  const uint64_t heptets = w & ~SG__STRMAP_HIGH;
+  const uint64_t ge_a = heptets + (SG__STRMAP_ONES * (0x80 - 'A'));
+  const uint64_t gt_z = heptets + (SG__STRMAP_ONES * (0x80 - 'Z' - 1));
+  return w | (((ge_a & ~gt_z & ~w) & SG__STRMAP_HIGH) >> 2);
+}
+
+/* Seeded per process against hash flooding. It is not a cryptographic hash;
+ * it only has to make bucket collisions unpredictable from the outside. */
+unsigned sg__strmap_hash(const void *key, size_t len) {
+  const unsigned char *p = key;
+  uint64_t h, w;
+  pthread_once(&sg__strmap_seed_once, sg__strmap_seed_init);
+  h = sg__strmap_seed ^ (len * SG__STRMAP_MUL);
+  for (; len >= sizeof(w); p += sizeof(w), len -= sizeof(w)) {
+    memcpy(&w, p, sizeof(w));
+    h = (h ^ sg__strmap_fold(w)) * SG__STRMAP_MUL;
+    h ^= h >> 29;
+  }
+  if (len > 0) {
+    w = 0;
+    memcpy(&w, p, len);
+    h = (h ^ sg__strmap_fold(w)) * SG__STRMAP_MUL;
+  }
+  return (unsigned) sg__strmap_mix(h);
+}
+
+int sg__strmap_keycmp(const void *a, const void *b, size_t len) {
+  const unsigned char *pa = a, *pb = b;
+  uint64_t wa, wb;
+  for (; len >= sizeof(wa);
+       pa += sizeof(wa), pb += sizeof(wb), len -= sizeof(wa)) {
+    memcpy(&wa, pa, sizeof(wa));
+    memcpy(&wb, pb, sizeof(wb));
+    if ((wa != wb) && (sg__strmap_fold(wa) != sg__strmap_fold(wb)))
+      return 1;
+  }
+  if (len > 0) {
+    wa = wb = 0;
+    memcpy(&wa, pa, len);
+    memcpy(&wb, pb, len);
+    if ((wa != wb) && (sg__strmap_fold(wa) != sg__strmap_fold(wb)))
+      return 1;
+  }
+  return 0;
+}
+
+struct sg_strmap *sg__strmap_new2(const char *name, const char *val,
+                                  size_t val_len) {
+  struct sg_strmap *pair;
+  size_t len = strlen(name), size;
+  size = offsetof(struct sg_strmap, buf) + ((len + 1) * 2) + val_len + 1;
+  /* the allocator rounds up anyway, so give the slack to the value */
+  size = (size + 15) & ~((size_t) 15);
+  pair = sg_malloc(size);
   if (!pair)
     return NULL;
-  pair->key = strdup(name);
-  if (!pair->key)
-    goto error;
-  pair->name = strdup(name);
-  if (!pair->name)
-    goto error;
-  pair->val = strdup(val);
-  if (!pair->val)
-    goto error;
+  memset(pair, 0, offsetof(struct sg_strmap, buf));
+  pair->len = len;
+  pair->key = pair->buf;
+  memcpy(pair->key, name, len + 1);
   sg__toasciilower(pair->key);
+  pair->name = pair->key + len + 1;
+  memcpy(pair->name, name, len + 1);
+  pair->val = SG__STRMAP_INLINE_VAL(pair);
+  pair->val_len = val_len;
+  pair->val_size = size - offsetof(struct sg_strmap, buf) - ((len + 1) * 2);
+  memcpy(pair->val, val, val_len);
+  pair->val[val_len] = '\0';
   return pair;
-error:
-  sg__strmap_free(pair);
-  return NULL;
+}
+
+struct sg_strmap *sg__strmap_new(const char *name, const char *val) {
+  return sg__strmap_new2(name, val, strlen(val));
 }
 
 void sg__strmap_free(struct sg_strmap *pair) {
   if (!pair)
     return;
-  sg_free(pair->key);
-  sg_free(pair->name);
-  sg_free(pair->val);
+  if (pair->val != SG__STRMAP_INLINE_VAL(pair))
+    sg_free(pair->val);
   sg_free(pair);
 }
 
+int sg__strmap_append(struct sg_strmap *pair, const char *val, size_t len) {
+  size_t size;
+  char *buf;
+  if (pair->val_len + len >= pair->val_size) {
+    size = pair->val_size * 2;
+    if (size <= pair->val_len + len)
+      size = pair->val_len + len + 1;
+    if (pair->val == SG__STRMAP_INLINE_VAL(pair)) {
+      buf = sg_malloc(size);
+      if (buf)
+        memcpy(buf, pair->val, pair->val_len);
+    } else
+      buf = sg_realloc(pair->val, size);
+    if (!buf)
+      return ENOMEM;
+    pair->val = buf;
+    pair->val_size = size;
+  }
+  memcpy(pair->val + pair->val_len, val, len);
+  pair->val_len += len;
+  pair->val[pair->val_len] = '\0';
+  return 0;
+}
+
+static void sg__strmap_promote(struct sg_strmap *map) {
+  UT_hash_table *tbl = map->hh.tbl;
+  struct sg_strmap *pair;
+  unsigned bkt;
+  int oomed = 0;
+  tbl->buckets = sg_alloc(HASH_INITIAL_NUM_BUCKETS * sizeof(UT_hash_bucket));
+  if (!tbl->buckets)
+    return;
+  tbl->num_buckets = HASH_INITIAL_NUM_BUCKETS;
+  tbl->log2_num_buckets = HASH_INITIAL_NUM_BUCKETS_LOG2;
+  /* expanding while the buckets are half built would lose pairs */
+  tbl->noexpand = 1;
+  for (pair = map; pair; pair = pair->hh.next) {
+    HASH_TO_BKT(pair->hh.hashv, tbl->num_buckets, bkt);
+    HASH_ADD_TO_BKT(tbl->buckets[bkt], hh, &pair->hh, oomed);
+  }
+  tbl->noexpand = 0;
+  (void) oomed;
+}
+
+int sg__strmap_insert(struct sg_strmap **map, struct sg_strmap *pair) {
+  UT_hash_table *tbl;
+  pair->hh.key = pair->key;
+  pair->hh.keylen = (unsigned) pair->len;
+  pair->hh.hashv = sg__strmap_hash(pair->key, pair->len);
+  pair->hh.next = NULL;
+  pair->hh.hh_prev = pair->hh.hh_next = NULL;
+  if (!*map) {
+    tbl = sg_alloc(sizeof(UT_hash_table));
+    if (!tbl)
+      return ENOMEM;
+    tbl->tail = &pair->hh;
+    tbl->hho = offsetof(struct sg_strmap, hh);
+    tbl->num_items = 1;
+    tbl->signature = HASH_SIGNATURE;
+    pair->hh.tbl = tbl;
+    pair->hh.prev = NULL;
+    *map = pair;
+    return 0;
+  }
+  if (!SG__STRMAP_IS_SMALL(*map)) {
+    HASH_ADD_KEYPTR_BYHASHVALUE(hh, *map, pair->key, pair->hh.keylen,
+                                pair->hh.hashv, pair);
+    return pair->hh.tbl ? 0 : ENOMEM;
+  }
+  tbl = (*map)->hh.tbl;
+  pair->hh.tbl = tbl;
+  HASH_APPEND_LIST(hh, *map, pair);
+  if (++tbl->num_items > SG__STRMAP_SMALL_MAX)
+    sg__strmap_promote(*map);
+  return 0;
+}
+
+static void sg__strmap_remove(struct sg_strmap **map, struct sg_strmap *pair) {
+  UT_hash_table *tbl = (*map)->hh.tbl;
+  if (!SG__STRMAP_IS_SMALL(*map)) {
+    HASH_DELETE_HH(hh, *map, &pair->hh);
+    return;
+  }
+  if (!pair->hh.prev && !pair->hh.next) {
+    sg_free(tbl);
+    *map = NULL;
+    return;
+  }
+  if (&pair->hh == tbl->tail)
+    tbl->tail = HH_FROM_ELMT(tbl, pair->hh.prev);
+  if (pair->hh.prev)
+    HH_FROM_ELMT(tbl, pair->hh.prev)->next = pair->hh.next;
+  else
+    *map = pair->hh.next;
+  if (pair->hh.next)
+    HH_FROM_ELMT(tbl, pair->hh.next)->prev = pair->hh.prev;
+  tbl->num_items--;
+}
+
+/* Small maps compare the lengths first and then the keys a word at a time. */
+static struct sg_strmap *sg__strmap_scan(struct sg_strmap *map,
+                                         const char *key, unsigned len) {
+  for (; map; map = map->hh.next)
+    if ((map->hh.keylen == len) &&
+        (sg__strmap_keycmp(map->hh.key, key, len) == 0))
+      return map;
+  return NULL;
+}
+
+struct sg_strmap *sg__strmap_find_hashed(struct sg_strmap *map,
+                                         const char *key, size_t len,
+                                         unsigned hashv) {
+  struct sg_strmap *pair;
+  if (!map)
+    return NULL;
+  if (SG__STRMAP_IS_SMALL(map)) {
+    for (pair = map; pair; pair = pair->hh.next)
+      if ((pair->hh.hashv == hashv) && (pair->hh.keylen == len) &&
+          (sg__strmap_keycmp(pair->hh.key, key, len) == 0))
+        return pair;
+    return NULL;
+  }
+  HASH_FIND_BYHASHVALUE(hh, map, key, (unsigned) len, hashv, pair);
+  return pair;
+}
+
+static int sg__strmap_lookup(struct sg_strmap *map, const char *name,
+                             struct sg_strmap **pair) {
+  const unsigned len = (unsigned) strlen(name);
+  if (!map)
+    *pair = NULL;
+  else if (SG__STRMAP_IS_SMALL(map))
+    *pair = sg__strmap_scan(map, name, len);
+  else
+    HASH_FIND(hh, map, name, len, *pair);
+  return *pair ? 0 : ENOENT;
+}
+
 const char *sg_strmap_name(struct sg_strmap *pair) {
   if (!pair) {
     errno = EINVAL;
@@ -82,38 +308,46 @@ int sg_strmap_add(struct sg_strmap **map, const char *name, const char *val) {
   pair = sg__strmap_new(name, val);
   if (!pair)
     return ENOMEM;
-  HASH_ADD_STR(*map, key, pair);
+  if (sg__strmap_insert(map, pair) != 0) {
+    sg__strmap_free(pair);
+    return ENOMEM;
+  }
   return 0;
 }
 
 int sg_strmap_set(struct sg_strmap **map, const char *name, const char *val) {
-  struct sg_strmap *pair, *tmp;
+  struct sg_strmap *pair, *old;
+  size_t val_len;
   if (!map || !name || !val)
     return EINVAL;
+  val_len = strlen(val);
+  sg__strmap_lookup(*map, name, &old);
+  /* reuses the pair when the new value fits, keeping its position */
+  if (old && (val_len < old->val_size)) {
+    memcpy(old->name, name, old->len);
+    memcpy(old->val, val, val_len + 1);
+    old->val_len = val_len;
+    return 0;
+  }
   pair = sg__strmap_new(name, val);
   if (!pair)
     return ENOMEM;
-  HASH_REPLACE_STR(*map, key, pair, tmp);
-  sg__strmap_free(tmp);
+  if (sg__strmap_insert(map, pair) != 0) {
+    sg__strmap_free(pair);
+    return ENOMEM;
+  }
+  if (old) {
+    sg__strmap_remove(map, old);
+    sg__strmap_free(old);
+  }
   return 0;
 }
 
 int sg_strmap_find(struct sg_strmap *map, const char *name,
                    struct sg_strmap **pair) {
-  char *key;
   if (!map || !pair || !name)
     return EINVAL;
-  key = strdup(name);
-  if (!key)
-    return ENOMEM;
-  sg__toasciilower(key);
-  HASH_FIND_STR(map, key, *pair);
-  if (!*pair) {
-    sg_free(key);
-    return ENOENT;
-  }
-  sg_free(key);
-  return 0;
+  return sg__strmap_lookup(map, name, pair);
 }
 
 const char *sg_strmap_get(struct sg_strmap *map, const char *name) {
@@ -125,20 +359,13 @@ const char *sg_strmap_get(struct sg_strmap *map, const char *name) {
 
 int sg_strmap_rm(struct sg_strmap **map, const char *name) {
   struct sg_strmap *pair;
-  char *key;
+  int ret;
   if (!map || !name)
     return EINVAL;
-  key = strdup(name);
-  if (!key)
-    return ENOMEM;
-  sg__toasciilower(key);
-  HASH_FIND_STR(*map, key, pair);
-  if (!pair) {
-    sg_free(key);
-    return ENOENT;
-  }
-  sg_free(key);
-  HASH_DELETE_HH(hh, *map, &pair->hh);
+  ret = sg__strmap_lookup(*map, name, &pair);
+  if (ret != 0)
+    return ret;
+  sg__strmap_remove(map, pair);
   sg__strmap_free(pair);
   return 0;
 }
@@ -177,11 +404,73 @@ int sg_strmap_next(struct sg_strmap **next) {
 
 void sg_strmap_cleanup(struct sg_strmap **map) {
   struct sg_strmap *pair, *tmp;
+  UT_hash_table *tbl;
   if (map && *map) {
+    tbl = (*map)->hh.tbl;
     HASH_ITER(hh, *map, pair, tmp) {
-      HASH_DEL(*map, pair);
       sg__strmap_free(pair);
     }
+    sg_free(tbl->buckets);
+    sg_free(tbl);
     *map = NULL;
   }
 }
+
+struct sg_strmap_snap *sg_strmap_snap_new(struct sg_strmap *map) {
+  struct sg_strmap_snap *snap;
+  struct sg_strmap *pair, *tmp, *copy;
+  snap = sg_alloc(sizeof(struct sg_strmap_snap));
+  if (!snap)
+    return NULL;
+  errno = pthread_mutex_init(&snap->mutex, NULL);
+  if (errno != 0) {
+    sg_free(snap);
+    return NULL;
+  }
+  HASH_ITER(hh, map, pair, tmp) {
+    copy = sg__strmap_new(pair->name, pair->val);
+    if (!copy || (sg__strmap_insert(&snap->map, copy) != 0)) {
+      sg__strmap_free(copy);
+      sg_strmap_cleanup(&snap->map);
+      pthread_mutex_destroy(&snap->mutex);
+      sg_free(snap);
+      errno = ENOMEM;
+      return NULL;
+    }
+  }
+  snap->refs = 1;
+  return snap;
+}
+
+struct sg_strmap_snap *sg_strmap_snap_ref(struct sg_strmap_snap *snap) {
+  if (!snap) {
+    errno = EINVAL;
+    return NULL;
+  }
+  pthread_mutex_lock(&snap->mutex);
+  snap->refs++;
+  pthread_mutex_unlock(&snap->mutex);
+  return snap;
+}
+
+void sg_strmap_snap_unref(struct sg_strmap_snap *snap) {
+  unsigned int refs;
+  if (!snap)
+    return;
+  pthread_mutex_lock(&snap->mutex);
+  refs = --snap->refs;
+  pthread_mutex_unlock(&snap->mutex);
+  if (refs > 0)
+    return;
+  sg_strmap_cleanup(&snap->map);
+  pthread_mutex_destroy(&snap->mutex);
+  sg_free(snap);
+}
+
+struct sg_strmap *sg_strmap_snap_map(struct sg_strmap_snap *snap) {
+  if (!snap) {
+    errno = EINVAL;
+    return NULL;
+  }
+  return snap->map;
+}
@@ -27,16 +27,66 @@
 #ifndef SG_STRMAP_H
 #define SG_STRMAP_H
 
+#include <stddef.h>
+#include <pthread.h>
 #include "sg_macros.h"
+
+SG__EXTERN unsigned sg__strmap_hash(const void *key, size_t len);
+
+SG__EXTERN int sg__strmap_keycmp(const void *a, const void *b, size_t len);
+
+/* Keys are hashed and compared ignoring ASCII case, so lookups can use the
+ * caller's string as is. This header must be included before any other
+ * inclusion of uthash.h. */
+#define HASH_FUNCTION(keyptr, keylen, hashv)                                   \
+  ((hashv) = sg__strmap_hash((keyptr), (keylen)))
+#define HASH_KEYCMP(a, b, n) sg__strmap_keycmp((a), (b), (n))
+
 #include "uthash.h"
 
+/* Maps up to this size keep no buckets: their table only tracks the list,
+ * which is scanned linearly. Past it, the buckets are built once and the map
+ * behaves as a regular uthash table. */
+#define SG__STRMAP_SMALL_MAX 16
+
+#define SG__STRMAP_IS_SMALL(map) (!(map)->hh.tbl->buckets)
+
+/* Each pair is a single allocation: `buf` holds the lowercased key, the
+ * original name and the value, all null-terminated. `val` points into `buf`
+ * until a value outgrows `val_size`, in which case it moves to the heap. */
 struct sg_strmap {
   char *key, *name, *val;
+  size_t len;
+  size_t val_len;
+  size_t val_size;
   UT_hash_handle hh;
+  char buf[];
+};
+
+/* Immutable copy of a map shared by reference. Only `refs` changes after
+ * creation, so `map` can be read concurrently without locking. */
+struct sg_strmap_snap {
+  pthread_mutex_t mutex;
+  struct sg_strmap *map;
+  unsigned int refs;
 };
 
 SG__EXTERN struct sg_strmap *sg__strmap_new(const char *name, const char *val);
 
+/* Same as sg__strmap_new(), for a value which is not null-terminated. */
+SG__EXTERN struct sg_strmap *sg__strmap_new2(const char *name, const char *val,
+                                             size_t val_len);
+
 SG__EXTERN void sg__strmap_free(struct sg_strmap *pair);
 
+SG__EXTERN int sg__strmap_append(struct sg_strmap *pair, const char *val,
+                                 size_t len);
+
+SG__EXTERN int sg__strmap_insert(struct sg_strmap **map,
+                                 struct sg_strmap *pair);
+
+SG__EXTERN struct sg_strmap *sg__strmap_find_hashed(struct sg_strmap *map,
+                                                    const char *key, size_t len,
+                                                    unsigned hashv);
+
 #endif /* SG_STRMAP_H */
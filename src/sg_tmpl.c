@@ -0,0 +1,435 @@
+/*                         _
+ *   ___  __ _  __ _ _   _(_)
+ *  / __|/ _` |/ _` | | | | |
+ *  \__ \ (_| | (_| | |_| | |
+ *  |___/\__,_|\__, |\__,_|_|
+ *             |___/
+ *
+ * Cross-platform library which helps to develop web servers or frameworks.
+ *
+ * Copyright (C) 2016-2020 Silvio Clecio <silvioprog@gmail.com>
+ *
+ * Sagui library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * Sagui library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Sagui library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "sg_macros.h"
+#include "microhttpd.h"
+#include "sagui.h"
+#include "sg_utils.h"
+#include "sg_strmap.h"
+#include "sg_httpres.h"
+#include "sg_tmpl.h"
+
+static void sg__tmpl_prog_unref(struct sg__tmpl_prog *prog) {
+  if (!prog || (--prog->refs > 0))
+    return;
+  sg_free(prog->ins);
+  sg_free(prog->src);
+  sg_free(prog);
+}
+
+/* Compiles `src`, taking ownership of it. Text is kept in place, and each
+ * `{{name}}` (HTML-escaped) or `{{{name}}}` (raw) becomes a variable slot. */
+struct sg__tmpl_prog *sg__tmpl_compile(char *src, size_t size) {
+  struct sg__tmpl_prog *prog;
+  struct sg__tmpl_ins *ins;
+  char *p = src, *end = src + size, *tag, *name, *close;
+  unsigned int cap = 8;
+  bool raw;
+  prog = sg_alloc(sizeof(struct sg__tmpl_prog));
+  if (!prog)
+    goto error;
+  prog->src = src;
+  prog->refs = 1;
+  prog->ins = sg_malloc(cap * sizeof(struct sg__tmpl_ins));
+  if (!prog->ins)
+    goto error;
+  while (p < end) {
+    if (prog->count + 2 > cap) {
+      cap *= 2;
+      ins = sg_realloc(prog->ins, cap * sizeof(struct sg__tmpl_ins));
+      if (!ins)
+        goto error;
+      prog->ins = ins;
+    }
+    for (tag = p; tag + 1 < end; tag++)
+      if ((tag[0] == '{') && (tag[1] == '{'))
+        break;
+    if (tag + 1 >= end)
+      tag = end;
+    if (tag > p) {
+      ins = &prog->ins[prog->count++];
+      ins->op = SG__TMPL_TEXT;
+      ins->str = p;
+      ins->len = (size_t) (tag - p);
+      ins->hashv = 0;
+      prog->text_size += ins->len;
+    }
+    if (tag == end)
+      break;
+    raw = (tag + 2 < end) && (tag[2] == '{');
+    name = tag + (raw ? 3 : 2);
+    for (close = name; close + 1 < end; close++)
+      if ((close[0] == '}') && (close[1] == '}'))
+        break;
+    if ((close + 1 >= end) ||
+        (raw && ((close + 2 >= end) || (close[2] != '}')))) {
+      errno = EINVAL;
+      goto error;
+    }
+    p = close + (raw ? 3 : 2);
+    while ((name < close) && ((*name == ' ') || (*name == '\t')))
+      name++;
+    while ((close > name) && ((close[-1] == ' ') || (close[-1] == '\t')))
+      close--;
+    if (close == name) {
+      errno = EINVAL;
+      goto error;
+    }
+    *close = '\0';
+    sg__toasciilower(name);
+    ins = &prog->ins[prog->count++];
+    ins->op = raw ? SG__TMPL_RAW : SG__TMPL_VAR;
+    ins->str = name;
+    ins->len = (size_t) (close - name);
+    HASH_VALUE(name, ins->len, ins->hashv);
+  }
+  return prog;
+error:
+  if (prog)
+    sg__tmpl_prog_unref(prog);
+  else
+    sg_free(src);
+  return NULL;
+}
+
+size_t sg__tmpl_escsize(const char *str) {
+  size_t size = 0;
+  for (; *str; str++)
+    switch (*str) {
+      case '&':
+        size += 5;
+        break;
+      case '<':
+      case '>':
+        size += 4;
+        break;
+      case '"':
+      case '\'':
+        size += 5;
+        break;
+      default:
+        size++;
+    }
+  return size;
+}
+
+char *sg__tmpl_esccpy(char *dest, const char *str) {
+#define SG__TMPL_PUT(s)                                                        \
+  do {                                                                         \
+    memcpy(dest, (s), sizeof(s) - 1);                                          \
+    dest += sizeof(s) - 1;                                                     \
+  } while (0)
+  for (; *str; str++)
+    switch (*str) {
+      case '&':
+        SG__TMPL_PUT("&amp;");
+        break;
+      case '<':
+        SG__TMPL_PUT("&lt;");
+        break;
+      case '>':
+        SG__TMPL_PUT("&gt;");
+        break;
+      case '"':
+        SG__TMPL_PUT("&#34;");
+        break;
+      case '\'':
+        SG__TMPL_PUT("&#39;");
+        break;
+      default:
+        *dest++ = *str;
+    }
+#undef SG__TMPL_PUT
+  return dest;
+}
+
+static int sg__tmpl_read(const char *filename, char **src, size_t *size,
+                         struct stat *sbuf) {
+  char *buf = NULL;
+  ssize_t rd;
+  size_t pos = 0;
+  int fd, errnum = 0;
+#ifdef _WIN32
+  wchar_t *file_name = stow(filename);
+  fd = SG__OPEN(file_name, O_RDONLY | O_BINARY);
+  sg_free(file_name);
+#else /* _WIN32 */
+  fd = SG__OPEN(filename, O_RDONLY);
+#endif /* _WIN32 */
+  if (fd == -1)
+    return errno;
+  if (fstat(fd, sbuf)) {
+    errnum = errno;
+    goto done;
+  }
+  if (!S_ISREG(sbuf->st_mode)) {
+    errnum = EBADF;
+    goto done;
+  }
+  buf = sg_malloc((size_t) sbuf->st_size + 1);
+  if (!buf) {
+    errnum = ENOMEM;
+    goto done;
+  }
+  while (pos < (size_t) sbuf->st_size) {
+    rd = read(fd, buf + pos, (size_t) sbuf->st_size - pos);
+    if (rd == 0)
+      break;
+    if (rd < 0) {
+      errnum = errno;
+      goto done;
+    }
+    pos += (size_t) rd;
+  }
+  buf[pos] = '\0';
+  *src = buf;
+  *size = pos;
+  buf = NULL;
+done:
+  sg_free(buf);
+  close(fd);
+  return errnum;
+}
+
+static int sg__tmpl_reload(struct sg_tmpl *tmpl) {
+  struct sg__tmpl_prog *prog;
+  struct stat sbuf;
+  char *src;
+  size_t size;
+  int errnum;
+  errnum = sg__tmpl_read(tmpl->filename, &src, &size, &sbuf);
+  if (errnum != 0)
+    return errnum;
+  prog = sg__tmpl_compile(src, size);
+  if (!prog)
+    return errno;
+  sg__tmpl_prog_unref(tmpl->prog);
+  tmpl->prog = prog;
+  tmpl->mtime = sbuf.st_mtime;
+  tmpl->size = (uint64_t) sbuf.st_size;
+  return 0;
+}
+
+/* Returns a reference to the current program, recompiling it first if the
+ * file has changed. The file is checked at most once per second. */
+static struct sg__tmpl_prog *sg__tmpl_acquire(struct sg_tmpl *tmpl) {
+  struct sg__tmpl_prog *prog;
+  struct stat sbuf;
+  time_t now;
+  pthread_mutex_lock(&tmpl->mutex);
+  if (tmpl->filename) {
+    now = time(NULL);
+    if (now != tmpl->checked) {
+      tmpl->checked = now;
+#ifdef _WIN32
+      {
+        wchar_t *file_name = stow(tmpl->filename);
+        if ((SG__STAT(file_name, &sbuf) == 0) &&
+            ((sbuf.st_mtime != tmpl->mtime) ||
+             ((uint64_t) sbuf.st_size != tmpl->size)))
+          sg__tmpl_reload(tmpl);
+        sg_free(file_name);
+      }
+#else /* _WIN32 */
+      if ((SG__STAT(tmpl->filename, &sbuf) == 0) &&
+          ((sbuf.st_mtime != tmpl->mtime) ||
+           ((uint64_t) sbuf.st_size != tmpl->size)))
+        sg__tmpl_reload(tmpl);
+#endif /* _WIN32 */
+    }
+  }
+  prog = tmpl->prog;
+  prog->refs++;
+  pthread_mutex_unlock(&tmpl->mutex);
+  return prog;
+}
+
+static void sg__tmpl_release(struct sg_tmpl *tmpl, struct sg__tmpl_prog *prog) {
+  pthread_mutex_lock(&tmpl->mutex);
+  sg__tmpl_prog_unref(prog);
+  pthread_mutex_unlock(&tmpl->mutex);
+}
+
+static struct sg_tmpl *sg__tmpl_new(struct sg__tmpl_prog *prog) {
+  struct sg_tmpl *tmpl = sg_alloc(sizeof(struct sg_tmpl));
+  if (!tmpl)
+    return NULL;
+  errno = pthread_mutex_init(&tmpl->mutex, NULL);
+  if (errno != 0) {
+    sg_free(tmpl);
+    return NULL;
+  }
+  tmpl->prog = prog;
+  return tmpl;
+}
+
+struct sg_tmpl *sg_tmpl_new(const char *src, size_t size) {
+  struct sg__tmpl_prog *prog;
+  struct sg_tmpl *tmpl;
+  char *buf;
+  if (!src) {
+    errno = EINVAL;
+    return NULL;
+  }
+  buf = sg_malloc(size + 1);
+  if (!buf)
+    return NULL;
+  memcpy(buf, src, size);
+  buf[size] = '\0';
+  prog = sg__tmpl_compile(buf, size);
+  if (!prog)
+    return NULL;
+  tmpl = sg__tmpl_new(prog);
+  if (!tmpl)
+    sg__tmpl_prog_unref(prog);
+  return tmpl;
+}
+
+struct sg_tmpl *sg_tmpl_load(const char *filename) {
+  struct sg_tmpl *tmpl;
+  int errnum;
+  if (!filename) {
+    errno = EINVAL;
+    return NULL;
+  }
+  tmpl = sg__tmpl_new(NULL);
+  if (!tmpl)
+    return NULL;
+  tmpl->filename = strdup(filename);
+  if (!tmpl->filename) {
+    errnum = ENOMEM;
+    goto error;
+  }
+  errnum = sg__tmpl_reload(tmpl);
+  if (errnum != 0)
+    goto error;
+  tmpl->checked = time(NULL);
+  return tmpl;
+error:
+  sg_tmpl_free(tmpl);
+  errno = errnum;
+  return NULL;
+}
+
+void sg_tmpl_free(struct sg_tmpl *tmpl) {
+  if (!tmpl)
+    return;
+  sg__tmpl_prog_unref(tmpl->prog);
+  sg_free(tmpl->filename);
+  pthread_mutex_destroy(&tmpl->mutex);
+  sg_free(tmpl);
+}
+
+int sg_tmpl_render(struct sg_tmpl *tmpl, struct sg_strmap *vars, char **buf,
+                   size_t *size) {
+  struct sg__tmpl_prog *prog;
+  struct sg__tmpl_ins *ins;
+  struct sg_strmap *pair;
+  char *p;
+  unsigned int i;
+  if (!tmpl || !buf || !size)
+    return EINVAL;
+  prog = sg__tmpl_acquire(tmpl);
+  /* first pass: exact output size, so the buffer is allocated only once */
+  *size = prog->text_size;
+  for (i = 0; i < prog->count; i++) {
+    ins = &prog->ins[i];
+    if (ins->op == SG__TMPL_TEXT)
+      continue;
+    pair = sg__strmap_find_hashed(vars, ins->str, ins->len, ins->hashv);
+    if (pair)
+      *size += ins->op == SG__TMPL_VAR ? sg__tmpl_escsize(pair->val) :
+                                         strlen(pair->val);
+  }
+  *buf = sg_malloc(*size + 1);
+  if (!*buf) {
+    sg__tmpl_release(tmpl, prog);
+    return ENOMEM;
+  }
+  p = *buf;
+  for (i = 0; i < prog->count; i++) {
+    ins = &prog->ins[i];
+    if (ins->op == SG__TMPL_TEXT) {
+      memcpy(p, ins->str, ins->len);
+      p += ins->len;
+      continue;
+    }
+    pair = sg__strmap_find_hashed(vars, ins->str, ins->len, ins->hashv);
+    if (!pair)
+      continue;
+    if (ins->op == SG__TMPL_VAR)
+      p = sg__tmpl_esccpy(p, pair->val);
+    else {
+      memcpy(p, pair->val, strlen(pair->val));
+      p += strlen(pair->val);
+    }
+  }
+  *p = '\0';
+  sg__tmpl_release(tmpl, prog);
+  return 0;
+}
+
+int sg_httpres_sendtmpl(struct sg_httpres *res, struct sg_tmpl *tmpl,
+                        struct sg_strmap *vars, const char *content_type,
+                        unsigned int status) {
+  char *buf;
+  size_t size;
+  int errnum;
+  if (!res || !tmpl || (status < 100) || (status > 599))
+    return EINVAL;
+  if (res->handle)
+    return EALREADY;
+  errnum = sg_tmpl_render(tmpl, vars, &buf, &size);
+  if (errnum != 0)
+    return errnum;
+  if (content_type) {
+    errnum =
+      sg_strmap_set(&res->headers, MHD_HTTP_HEADER_CONTENT_TYPE, content_type);
+    if (errnum != 0) {
+      sg_free(buf);
+      return errnum;
+    }
+  }
+  /* the rendered buffer is handed over to the response without copying */
+  res->handle =
+    MHD_create_response_from_buffer_with_free_callback(size, buf, sg_free);
+  if (!res->handle) {
+    sg_free(buf);
+    return ENOMEM;
+  }
+  res->status = status;
+  return 0;
+}
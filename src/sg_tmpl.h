@@ -0,0 +1,76 @@
+/*                         _
+ *   ___  __ _  __ _ _   _(_)
+ *  / __|/ _` |/ _` | | | | |
+ *  \__ \ (_| | (_| | |_| | |
+ *  |___/\__,_|\__, |\__,_|_|
+ *             |___/
+ *
+ * Cross-platform library which helps to develop web servers or frameworks.
+ *
+ * Copyright (C) 2016-2020 Silvio Clecio <silvioprog@gmail.com>
+ *
+ * Sagui library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * Sagui library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Sagui library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef SG_TMPL_H
+#define SG_TMPL_H
+
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+#include "sg_macros.h"
+#include "sagui.h"
+
+enum sg__tmpl_op {
+  SG__TMPL_TEXT = 0,
+  SG__TMPL_VAR = 1,
+  SG__TMPL_RAW = 2
+};
+
+/* Instruction of a compiled template: a literal span of the source, or a
+ * variable slot holding its lower-cased name and precomputed map hash. */
+struct sg__tmpl_ins {
+  const char *str;
+  size_t len;
+  unsigned int hashv;
+  enum sg__tmpl_op op;
+};
+
+/* Compiled template. It is reference-counted so a reload can replace it
+ * while other threads are still rendering the previous version. */
+struct sg__tmpl_prog {
+  char *src;
+  struct sg__tmpl_ins *ins;
+  unsigned int count;
+  unsigned int refs;
+  size_t text_size;
+};
+
+struct sg_tmpl {
+  pthread_mutex_t mutex;
+  struct sg__tmpl_prog *prog;
+  char *filename;
+  time_t mtime;
+  uint64_t size;
+  time_t checked;
+};
+
+SG__EXTERN struct sg__tmpl_prog *sg__tmpl_compile(char *src, size_t size);
+
+SG__EXTERN size_t sg__tmpl_escsize(const char *str);
+
+SG__EXTERN char *sg__tmpl_esccpy(char *dest, const char *str);
+
+#endif /* SG_TMPL_H */
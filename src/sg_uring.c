@@ -0,0 +1,495 @@
+/*                         _
+ *   ___  __ _  __ _ _   _(_)
+ *  / __|/ _` |/ _` | | | | |
+ *  \__ \ (_| | (_| | |_| | |
+ *  |___/\__,_|\__, |\__,_|_|
+ *             |___/
+ *
+ * Cross-platform library which helps to develop web servers or frameworks.
+ *
+ * Copyright (C) 2016-2020 Silvio Clecio <silvioprog@gmail.com>
+ *
+ * Sagui library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * Sagui library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Sagui library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include "sg_macros.h"
+#include "sagui.h"
+#include "sg_uring.h"
+
+#ifndef __NR_io_uring_setup
+#define __NR_io_uring_setup 425
+#endif /* __NR_io_uring_setup */
+#ifndef __NR_io_uring_enter
+#define __NR_io_uring_enter 426
+#endif /* __NR_io_uring_enter */
+#ifndef __NR_io_uring_register
+#define __NR_io_uring_register 427
+#endif /* __NR_io_uring_register */
+
+/* Ring */
+
+static int sg__uring_enter(struct sg__uring *ring, unsigned to_submit,
+                           unsigned min_complete, unsigned flags) {
+  return (int) syscall(__NR_io_uring_enter, ring->fd, to_submit, min_complete,
+                       flags, NULL, 0);
+}
+
+int sg__uring_init(struct sg__uring *ring, unsigned entries) {
+  struct io_uring_params params;
+  int errnum;
+  memset(ring, 0, sizeof(struct sg__uring));
+  memset(&params, 0, sizeof(struct io_uring_params));
+  ring->fd = (int) syscall(__NR_io_uring_setup, entries, &params);
+  if (ring->fd < 0)
+    return errno;
+  ring->sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  ring->cq_size =
+    params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  if (params.features & IORING_FEAT_SINGLE_MMAP) {
+    if (ring->cq_size > ring->sq_size)
+      ring->sq_size = ring->cq_size;
+    ring->cq_size = ring->sq_size;
+  }
+  ring->sq_ptr = mmap(NULL, ring->sq_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+  if (ring->sq_ptr == MAP_FAILED)
+    goto error_sq;
+  if (params.features & IORING_FEAT_SINGLE_MMAP)
+    ring->cq_ptr = ring->sq_ptr;
+  else {
+    ring->cq_ptr =
+      mmap(NULL, ring->cq_size, PROT_READ | PROT_WRITE,
+           MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+    if (ring->cq_ptr == MAP_FAILED)
+      goto error_cq;
+  }
+  ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+  ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+  if (ring->sqes == MAP_FAILED)
+    goto error_sqes;
+  ring->sq_head = (unsigned *) ((char *) ring->sq_ptr + params.sq_off.head);
+  ring->sq_tail = (unsigned *) ((char *) ring->sq_ptr + params.sq_off.tail);
+  ring->sq_array = (unsigned *) ((char *) ring->sq_ptr + params.sq_off.array);
+  ring->sq_mask =
+    *(unsigned *) ((char *) ring->sq_ptr + params.sq_off.ring_mask);
+  ring->sq_entries = params.sq_entries;
+  ring->cq_head = (unsigned *) ((char *) ring->cq_ptr + params.cq_off.head);
+  ring->cq_tail = (unsigned *) ((char *) ring->cq_ptr + params.cq_off.tail);
+  ring->cq_mask =
+    *(unsigned *) ((char *) ring->cq_ptr + params.cq_off.ring_mask);
+  ring->cqes =
+    (struct io_uring_cqe *) ((char *) ring->cq_ptr + params.cq_off.cqes);
+  return 0;
+error_sqes:
+  errnum = errno;
+  if (ring->cq_ptr != ring->sq_ptr)
+    munmap(ring->cq_ptr, ring->cq_size);
+  goto error;
+error_cq:
+  errnum = errno;
+error:
+  munmap(ring->sq_ptr, ring->sq_size);
+  close(ring->fd);
+  return errnum;
+error_sq:
+  errnum = errno;
+  close(ring->fd);
+  return errnum;
+}
+
+void sg__uring_free(struct sg__uring *ring) {
+  munmap(ring->sqes, ring->sqes_size);
+  if (ring->cq_ptr != ring->sq_ptr)
+    munmap(ring->cq_ptr, ring->cq_size);
+  munmap(ring->sq_ptr, ring->sq_size);
+  close(ring->fd);
+}
+
+struct io_uring_sqe *sg__uring_sqe(struct sg__uring *ring) {
+  struct io_uring_sqe *sqe;
+  unsigned head, tail, index;
+  head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+  tail = *ring->sq_tail + ring->sq_pending;
+  if (tail - head >= ring->sq_entries)
+    return NULL;
+  index = tail & ring->sq_mask;
+  ring->sq_array[index] = index;
+  ring->sq_pending++;
+  sqe = &ring->sqes[index];
+  memset(sqe, 0, sizeof(struct io_uring_sqe));
+  return sqe;
+}
+
+/* Entries published to the kernel but not consumed yet, e.g. after an
+ * interrupted submission. */
+static unsigned sg__uring_unsubmitted(struct sg__uring *ring) {
+  return __atomic_load_n(ring->sq_tail, __ATOMIC_ACQUIRE) -
+         __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+}
+
+int sg__uring_submit(struct sg__uring *ring) {
+  unsigned count;
+  /* publishes all queued entries at once, so a single system call submits
+   * the whole batch */
+  if (ring->sq_pending > 0) {
+    __atomic_store_n(ring->sq_tail, *ring->sq_tail + ring->sq_pending,
+                     __ATOMIC_RELEASE);
+    ring->sq_pending = 0;
+  }
+  count = sg__uring_unsubmitted(ring);
+  while (count > 0) {
+    if (sg__uring_enter(ring, count, 0, 0) < 0) {
+      if (errno == EINTR)
+        continue;
+      return errno;
+    }
+    count = sg__uring_unsubmitted(ring);
+  }
+  return 0;
+}
+
+int sg__uring_wait(struct sg__uring *ring) {
+  /* also retries entries left behind by a failed submission */
+  if (sg__uring_enter(ring, sg__uring_unsubmitted(ring), 1,
+                      IORING_ENTER_GETEVENTS) < 0)
+    return errno;
+  return 0;
+}
+
+struct io_uring_cqe *sg__uring_cqe(struct sg__uring *ring) {
+  unsigned head = *ring->cq_head;
+  if (head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE))
+    return NULL;
+  return &ring->cqes[head & ring->cq_mask];
+}
+
+void sg__uring_cqe_seen(struct sg__uring *ring) {
+  __atomic_store_n(ring->cq_head, *ring->cq_head + 1, __ATOMIC_RELEASE);
+}
+
+/* Writer */
+
+static char *sg__uring_writer_buf(struct sg__uring_writer *writer,
+                                  unsigned index) {
+  return writer->bufs + (size_t) index * SG__URING_SLOT_SIZE;
+}
+
+/* Must be called with the writer mutex held. */
+static int sg__uring_writer_prep(struct sg__uring_writer *writer,
+                                 unsigned index) {
+  struct sg__uring_slot *slot = &writer->slots[index];
+  struct io_uring_sqe *sqe = sg__uring_sqe(&writer->ring);
+  if (!sqe)
+    return EAGAIN;
+  sqe->fd = slot->file->fd;
+  sqe->off = slot->off + slot->done;
+  sqe->user_data = (uint64_t) index + 1;
+  if (writer->fixed) {
+    sqe->opcode = IORING_OP_WRITE_FIXED;
+    sqe->addr = (uint64_t) (uintptr_t) (sg__uring_writer_buf(writer, index) +
+                                        slot->done);
+    sqe->len = slot->len - slot->done;
+    sqe->buf_index = (uint16_t) index;
+  } else {
+    slot->iov.iov_base = sg__uring_writer_buf(writer, index) + slot->done;
+    slot->iov.iov_len = slot->len - slot->done;
+    sqe->opcode = IORING_OP_WRITEV;
+    sqe->addr = (uint64_t) (uintptr_t) &slot->iov;
+    sqe->len = 1;
+  }
+  return 0;
+}
+
+static void sg__uring_writer_done(struct sg__uring_writer *writer,
+                                  unsigned index, int res) {
+  struct sg__uring_slot *slot = &writer->slots[index];
+  struct sg__uring_file *file = slot->file;
+  bool resume = false;
+  pthread_mutex_lock(&writer->mutex);
+  if (res > 0) {
+    slot->done += (unsigned) res;
+    if (slot->done < slot->len) {
+      /* short write: queues the remaining bytes again */
+      if ((sg__uring_writer_prep(writer, index) == 0) &&
+          (sg__uring_submit(&writer->ring) == 0)) {
+        pthread_mutex_unlock(&writer->mutex);
+        return;
+      }
+      res = -EIO;
+    }
+  } else if (res == 0)
+    res = -EIO;
+  if ((res < 0) && (file->err == 0))
+    file->err = -res;
+  writer->free_slots[writer->free_count++] = index;
+  if (file->paused && (file->inflight - 1 <= SG__URING_LOW_WATER)) {
+    file->paused = false;
+    resume = (writer->resume_cb != NULL);
+  }
+  if (resume) {
+    /* keeps the file in flight while resuming, so it cannot be drained and
+     * freed in the meantime */
+    pthread_mutex_unlock(&writer->mutex);
+    writer->resume_cb(file->cls);
+    pthread_mutex_lock(&writer->mutex);
+  }
+  file->inflight--;
+  pthread_cond_broadcast(&writer->cond);
+  pthread_mutex_unlock(&writer->mutex);
+}
+
+static void *sg__uring_writer_cb(void *cls) {
+  struct sg__uring_writer *writer = cls;
+  struct io_uring_cqe *cqe;
+  uint64_t user_data;
+  int res;
+  bool stop = false;
+  while (!stop) {
+    if ((sg__uring_wait(&writer->ring) != 0) && (errno != EINTR))
+      break;
+    while ((cqe = sg__uring_cqe(&writer->ring))) {
+      user_data = cqe->user_data;
+      res = cqe->res;
+      sg__uring_cqe_seen(&writer->ring);
+      if (user_data == 0)
+        stop = true;
+      else
+        sg__uring_writer_done(writer, (unsigned) (user_data - 1), res);
+    }
+  }
+  return NULL;
+}
+
+struct sg__uring_writer *sg__uring_writer_new(void (*resume_cb)(void *cls)) {
+  struct iovec iov[SG__URING_SLOTS];
+  struct sg__uring_writer *writer;
+  unsigned i;
+  int errnum;
+  writer = sg_alloc(sizeof(struct sg__uring_writer));
+  if (!writer)
+    return NULL;
+  /* twice the slots, so the stop request always finds a free entry */
+  errnum = sg__uring_init(&writer->ring, SG__URING_SLOTS * 2);
+  if (errnum != 0)
+    goto error_ring;
+  writer->bufs = sg_malloc((size_t) SG__URING_SLOTS * SG__URING_SLOT_SIZE);
+  if (!writer->bufs) {
+    errnum = ENOMEM;
+    goto error_bufs;
+  }
+  for (i = 0; i < SG__URING_SLOTS; i++) {
+    iov[i].iov_base = sg__uring_writer_buf(writer, i);
+    iov[i].iov_len = SG__URING_SLOT_SIZE;
+    writer->free_slots[i] = SG__URING_SLOTS - 1 - i;
+  }
+  writer->free_count = SG__URING_SLOTS;
+  /* registration may fail on a low memlock limit, then plain writes are
+   * submitted from the same buffers */
+  writer->fixed = syscall(__NR_io_uring_register, writer->ring.fd,
+                          IORING_REGISTER_BUFFERS, iov, SG__URING_SLOTS) == 0;
+  writer->resume_cb = resume_cb;
+  errnum = pthread_mutex_init(&writer->mutex, NULL);
+  if (errnum != 0)
+    goto error_mutex;
+  errnum = pthread_cond_init(&writer->cond, NULL);
+  if (errnum != 0)
+    goto error_cond;
+  errnum = pthread_create(&writer->thread, NULL, sg__uring_writer_cb, writer);
+  if (errnum != 0)
+    goto error_thread;
+  return writer;
+error_thread:
+  pthread_cond_destroy(&writer->cond);
+error_cond:
+  pthread_mutex_destroy(&writer->mutex);
+error_mutex:
+  sg_free(writer->bufs);
+error_bufs:
+  sg__uring_free(&writer->ring);
+error_ring:
+  sg_free(writer);
+  errno = errnum;
+  return NULL;
+}
+
+void sg__uring_writer_free(struct sg__uring_writer *writer) {
+  struct io_uring_sqe *sqe;
+  if (!writer)
+    return;
+  pthread_mutex_lock(&writer->mutex);
+  sqe = sg__uring_sqe(&writer->ring);
+  sqe->opcode = IORING_OP_NOP;
+  sqe->user_data = 0;
+  sg__uring_submit(&writer->ring);
+  pthread_mutex_unlock(&writer->mutex);
+  pthread_join(writer->thread, NULL);
+  pthread_cond_destroy(&writer->cond);
+  pthread_mutex_destroy(&writer->mutex);
+  sg__uring_free(&writer->ring);
+  sg_free(writer->bufs);
+  sg_free(writer);
+}
+
+void sg__uring_file_init(struct sg__uring_file *file,
+                         struct sg__uring_writer *writer, int fd, void *cls) {
+  memset(file, 0, sizeof(struct sg__uring_file));
+  file->writer = writer;
+  file->cls = cls;
+  file->fd = fd;
+  file->slot = -1;
+}
+
+/* Must be called with the writer mutex held. */
+static int sg__uring_file_queue(struct sg__uring_file *file) {
+  struct sg__uring_writer *writer = file->writer;
+  unsigned index = (unsigned) file->slot;
+  int errnum;
+  file->slot = -1;
+  if (writer->slots[index].len == 0) {
+    writer->free_slots[writer->free_count++] = index;
+    return 0;
+  }
+  errnum = sg__uring_writer_prep(writer, index);
+  if (errnum == EAGAIN) {
+    errnum = sg__uring_submit(&writer->ring);
+    if (errnum == 0)
+      errnum = sg__uring_writer_prep(writer, index);
+  }
+  if (errnum != 0) {
+    writer->free_slots[writer->free_count++] = index;
+    if (file->err == 0)
+      file->err = errnum;
+    return errnum;
+  }
+  file->inflight++;
+  return 0;
+}
+
+/* Writes synchronously when the pool is exhausted. The offsets are explicit,
+ * so ordering against the buffers still in flight does not matter. */
+static int sg__uring_file_pwrite(struct sg__uring_file *file, const char *buf,
+                                 size_t size) {
+  ssize_t written;
+  while (size > 0) {
+    written = pwrite(file->fd, buf, size, (off_t) file->off);
+    if (written < 0) {
+      if (errno == EINTR)
+        continue;
+      return errno;
+    }
+    if (written == 0)
+      return EIO;
+    buf += written;
+    size -= (size_t) written;
+    file->off += (uint64_t) written;
+  }
+  return 0;
+}
+
+int sg__uring_write(struct sg__uring_file *file, const char *buf,
+                    size_t size) {
+  struct sg__uring_writer *writer = file->writer;
+  struct sg__uring_slot *slot;
+  size_t room;
+  int errnum = 0;
+  pthread_mutex_lock(&writer->mutex);
+  while (size > 0) {
+    if (file->err != 0) {
+      errnum = file->err;
+      break;
+    }
+    if (file->slot < 0) {
+      if (writer->free_count == 0) {
+        pthread_mutex_unlock(&writer->mutex);
+        return sg__uring_file_pwrite(file, buf, size);
+      }
+      file->slot = (int) writer->free_slots[--writer->free_count];
+      slot = &writer->slots[file->slot];
+      slot->file = file;
+      slot->off = file->off;
+      slot->len = 0;
+      slot->done = 0;
+    }
+    slot = &writer->slots[file->slot];
+    room = SG__URING_SLOT_SIZE - slot->len;
+    if (room > size)
+      room = size;
+    memcpy(sg__uring_writer_buf(writer, (unsigned) file->slot) + slot->len,
+           buf, room);
+    slot->len += (unsigned) room;
+    file->off += room;
+    buf += room;
+    size -= room;
+    if (slot->len == SG__URING_SLOT_SIZE) {
+      errnum = sg__uring_file_queue(file);
+      if (errnum != 0)
+        break;
+    }
+  }
+  pthread_mutex_unlock(&writer->mutex);
+  return errnum;
+}
+
+/* Submits the queued buffers of all files. A partially filled buffer is kept
+ * to coalesce the next writes, unless `partial` is set. */
+int sg__uring_flush(struct sg__uring_file *file, bool partial) {
+  struct sg__uring_writer *writer = file->writer;
+  int errnum = 0;
+  pthread_mutex_lock(&writer->mutex);
+  if (partial && (file->slot >= 0))
+    errnum = sg__uring_file_queue(file);
+  if (errnum == 0)
+    errnum = sg__uring_submit(&writer->ring);
+  if (errnum == 0)
+    errnum = file->err;
+  pthread_mutex_unlock(&writer->mutex);
+  return errnum;
+}
+
+bool sg__uring_pause(struct sg__uring_file *file) {
+  struct sg__uring_writer *writer = file->writer;
+  bool paused;
+  pthread_mutex_lock(&writer->mutex);
+  if (file->inflight >= SG__URING_HIGH_WATER)
+    file->paused = true;
+  paused = file->paused;
+  pthread_mutex_unlock(&writer->mutex);
+  return paused;
+}
+
+int sg__uring_drain(struct sg__uring_file *file) {
+  struct sg__uring_writer *writer = file->writer;
+  int errnum = 0;
+  pthread_mutex_lock(&writer->mutex);
+  if (file->slot >= 0)
+    sg__uring_file_queue(file);
+  /* waits even if the submission fails, since the buffers in flight still
+   * point to the file */
+  errnum = sg__uring_submit(&writer->ring);
+  while (file->inflight > 0)
+    pthread_cond_wait(&writer->cond, &writer->mutex);
+  if (file->err != 0)
+    errnum = file->err;
+  pthread_mutex_unlock(&writer->mutex);
+  return errnum;
+}
@@ -0,0 +1,141 @@
+/*                         _
+ *   ___  __ _  __ _ _   _(_)
+ *  / __|/ _` |/ _` | | | | |
+ *  \__ \ (_| | (_| | |_| | |
+ *  |___/\__,_|\__, |\__,_|_|
+ *             |___/
+ *
+ * Cross-platform library which helps to develop web servers or frameworks.
+ *
+ * Copyright (C) 2016-2020 Silvio Clecio <silvioprog@gmail.com>
+ *
+ * Sagui library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * Sagui library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Sagui library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef SG_URING_H
+#define SG_URING_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+#include "sg_macros.h"
+
+/* Number of pooled buffers per writer. */
+#define SG__URING_SLOTS 32
+
+/* Size of each pooled buffer, also the largest single write. */
+#define SG__URING_SLOT_SIZE 65536
+
+/* A file with this many buffers in flight asks its connection to pause ... */
+#define SG__URING_HIGH_WATER 8
+
+/* ... until they drop to this. */
+#define SG__URING_LOW_WATER 2
+
+/* Minimal io_uring instance driven through the raw system calls. */
+struct sg__uring {
+  int fd;
+  void *sq_ptr;
+  size_t sq_size;
+  void *cq_ptr;
+  size_t cq_size;
+  struct io_uring_sqe *sqes;
+  size_t sqes_size;
+  unsigned *sq_head;
+  unsigned *sq_tail;
+  unsigned *sq_array;
+  unsigned sq_mask;
+  unsigned sq_entries;
+  unsigned *cq_head;
+  unsigned *cq_tail;
+  unsigned cq_mask;
+  struct io_uring_cqe *cqes;
+  unsigned sq_pending;
+};
+
+struct sg__uring_writer;
+
+/* File written through a writer. `inflight` and `paused` are guarded by the
+ * writer mutex. */
+struct sg__uring_file {
+  struct sg__uring_writer *writer;
+  void *cls;
+  uint64_t off;
+  int fd;
+  int slot;
+  unsigned inflight;
+  int err;
+  bool paused;
+};
+
+struct sg__uring_slot {
+  struct sg__uring_file *file;
+  struct iovec iov;
+  uint64_t off;
+  unsigned len;
+  unsigned done;
+};
+
+/* Asynchronous writer: data is copied into pooled (and, when possible,
+ * registered) buffers, submitted in batches and completed by a thread, which
+ * calls `resume_cb` for paused files once they drain. */
+struct sg__uring_writer {
+  struct sg__uring ring;
+  pthread_t thread;
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  void (*resume_cb)(void *cls);
+  char *bufs;
+  struct sg__uring_slot slots[SG__URING_SLOTS];
+  unsigned free_slots[SG__URING_SLOTS];
+  unsigned free_count;
+  bool fixed;
+};
+
+SG__EXTERN int sg__uring_init(struct sg__uring *ring, unsigned entries);
+
+SG__EXTERN void sg__uring_free(struct sg__uring *ring);
+
+SG__EXTERN struct io_uring_sqe *sg__uring_sqe(struct sg__uring *ring);
+
+SG__EXTERN int sg__uring_submit(struct sg__uring *ring);
+
+SG__EXTERN int sg__uring_wait(struct sg__uring *ring);
+
+SG__EXTERN struct io_uring_cqe *sg__uring_cqe(struct sg__uring *ring);
+
+SG__EXTERN void sg__uring_cqe_seen(struct sg__uring *ring);
+
+SG__EXTERN struct sg__uring_writer *
+sg__uring_writer_new(void (*resume_cb)(void *cls));
+
+SG__EXTERN void sg__uring_writer_free(struct sg__uring_writer *writer);
+
+SG__EXTERN void sg__uring_file_init(struct sg__uring_file *file,
+                                    struct sg__uring_writer *writer, int fd,
+                                    void *cls);
+
+SG__EXTERN int sg__uring_write(struct sg__uring_file *file, const char *buf,
+                               size_t size);
+
+SG__EXTERN int sg__uring_flush(struct sg__uring_file *file, bool partial);
+
+SG__EXTERN bool sg__uring_pause(struct sg__uring_file *file);
+
+SG__EXTERN int sg__uring_drain(struct sg__uring_file *file);
+
+#endif /* SG_URING_H */
@@ -36,6 +36,7 @@
 #include <ws2tcpip.h>
 #include <windows.h>
 #include <wchar.h>
+#include <io.h>
 #else /* _WIN32 */
 #include <arpa/inet.h>
 #endif /* _WIN32 */
@@ -124,6 +125,21 @@ int sg__rename(const char *old, const char *new) {
   return ret;
 }
 
+ssize_t sg__pread(int fd, void *buf, size_t size, sg__off_t offset) {
+  OVERLAPPED ov;
+  DWORD have;
+  memset(&ov, 0, sizeof(OVERLAPPED));
+  ov.Offset = (DWORD) ((uint64_t) offset & 0xffffffff);
+  ov.OffsetHigh = (DWORD) ((uint64_t) offset >> 32);
+  if (!ReadFile((HANDLE) _get_osfhandle(fd), buf, (DWORD) size, &have, &ov)) {
+    if (GetLastError() == ERROR_HANDLE_EOF)
+      return 0;
+    errno = EIO;
+    return -1;
+  }
+  return (ssize_t) have;
+}
+
 #endif /* _WIN32 */
 
 #if defined(_WIN32) || defined(__ANDROID__) ||                                 \
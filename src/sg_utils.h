@@ -61,8 +61,12 @@ SG__EXTERN char *wtos(const wchar_t *str);
 
 SG__EXTERN int sg__rename(const char *old, const char *new);
 
+SG__EXTERN ssize_t sg__pread(int fd, void *buf, size_t size,
+                             sg__off_t offset);
+
 #else /* _WIN32 */
 #define sg__rename rename
+#define sg__pread pread
 #endif /* _WIN32 */
 
 #if defined(_WIN32) || defined(__ANDROID__) ||                                 \
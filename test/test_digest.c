@@ -0,0 +1,145 @@
+/*                         _
+ *   ___  __ _  __ _ _   _(_)
+ *  / __|/ _` |/ _` | | | | |
+ *  \__ \ (_| | (_| | |_| | |
+ *  |___/\__,_|\__, |\__,_|_|
+ *             |___/
+ *
+ * Cross-platform library which helps to develop web servers or frameworks.
+ *
+ * Copyright (C) 2016-2020 Silvio Clecio <silvioprog@gmail.com>
+ *
+ * Sagui library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * Sagui library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Sagui library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#define SG_EXTERN
+
+#include "sg_assert.h"
+
+#include <string.h>
+#include "sg_digest.c"
+#include <sagui.h>
+
+static const char *digest_of(unsigned int algos, enum sg_digest algo,
+                             const void *data, size_t size, size_t chunk) {
+  static struct sg__digest digest;
+  const char *p = data;
+  size_t len;
+  sg__digest_init(&digest, algos);
+  while (size > 0) {
+    len = size < chunk ? size : chunk;
+    sg__digest_update(&digest, p, len);
+    p += len;
+    size -= len;
+  }
+  return sg__digest_hex(&digest, algo);
+}
+
+static void test__crc32c(void) {
+  unsigned char buf[300 + 8];
+  uint32_t crc;
+  size_t i, off;
+  ASSERT(sg__crc32c(0, "", 0) == 0);
+  ASSERT(sg__crc32c(0, "123456789", 9) == 0xe3069283);
+  memset(buf, 0, 32);
+  ASSERT(sg__crc32c(0, buf, 32) == 0x8a9136aa);
+  memset(buf, 0xff, 32);
+  ASSERT(sg__crc32c(0, buf, 32) == 0x62a8ab43);
+  /* chained */
+  crc = sg__crc32c(0, "1234", 4);
+  ASSERT(sg__crc32c(crc, "56789", 5) == 0xe3069283);
+  /* the accelerated path matches the tables at any alignment */
+  for (i = 0; i < sizeof(buf); i++)
+    buf[i] = (unsigned char) (i * 7 + 3);
+  for (off = 0; off < 8; off++)
+    for (i = 0; i <= 300; i += 13)
+      ASSERT(sg__crc32c(0, buf + off, i) == sg__crc32c_sw(0, buf + off, i));
+}
+
+static void test__sha256_blocks(void) {
+  unsigned char buf[64 * 5];
+  uint32_t state1[8], state2[8];
+  size_t i;
+  for (i = 0; i < sizeof(buf); i++)
+    buf[i] = (unsigned char) (i * 31 + 11);
+  for (i = 0; i < 8; i++)
+    state1[i] = state2[i] = (uint32_t) (i * 0x9e3779b9);
+  sg__sha256_blocks(state1, buf, 5);
+  sg__sha256_blocks_sw(state2, buf, 5);
+  ASSERT(memcmp(state1, state2, sizeof(state1)) == 0);
+}
+
+static void test__digest_sha256(void) {
+  static const char *msg =
+    "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+  char *buf;
+  size_t chunk;
+  ASSERT(strcmp(digest_of(SG_DIGEST_SHA256, SG_DIGEST_SHA256, "", 0, 1),
+                "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855") ==
+         0);
+  ASSERT(strcmp(digest_of(SG_DIGEST_SHA256, SG_DIGEST_SHA256, "abc", 3, 3),
+                "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad") ==
+         0);
+  /* padding spilling into a second block, fed in uneven chunks */
+  for (chunk = 1; chunk <= 64; chunk += 7)
+    ASSERT(strcmp(digest_of(SG__DIGEST_ALL, SG_DIGEST_SHA256, msg,
+                            strlen(msg), chunk),
+                  "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419d"
+                  "b06c1") == 0);
+  buf = sg_malloc(1000000);
+  ASSERT(buf);
+  memset(buf, 'a', 1000000);
+  ASSERT(strcmp(digest_of(SG_DIGEST_SHA256, SG_DIGEST_SHA256, buf, 1000000,
+                          4093),
+                "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0") ==
+         0);
+  sg_free(buf);
+}
+
+static void test__digest_crc32c(void) {
+  ASSERT(strcmp(digest_of(SG_DIGEST_CRC32C, SG_DIGEST_CRC32C, "", 0, 1),
+                "00000000") == 0);
+  ASSERT(strcmp(digest_of(SG_DIGEST_CRC32C, SG_DIGEST_CRC32C, "123456789", 9,
+                          2),
+                "e3069283") == 0);
+}
+
+static void test__digest_hex(void) {
+  struct sg__digest digest;
+  const char *hex;
+  sg__digest_init(&digest, SG_DIGEST_CRC32C);
+  sg__digest_update(&digest, "123456789", 9);
+  errno = 0;
+  ASSERT(!sg__digest_hex(&digest, (enum sg_digest) 3));
+  ASSERT(errno == EINVAL);
+  errno = 0;
+  ASSERT(!sg__digest_hex(&digest, SG_DIGEST_SHA256));
+  ASSERT(errno == ENOTSUP);
+  hex = sg__digest_hex(&digest, SG_DIGEST_CRC32C);
+  ASSERT(strcmp(hex, "e3069283") == 0);
+  /* final once returned */
+  sg__digest_update(&digest, "abc", 3);
+  ASSERT(sg__digest_hex(&digest, SG_DIGEST_CRC32C) == hex);
+  ASSERT(strcmp(hex, "e3069283") == 0);
+}
+
+int main(void) {
+  test__crc32c();
+  test__sha256_blocks();
+  test__digest_sha256();
+  test__digest_crc32c();
+  test__digest_hex();
+  return EXIT_SUCCESS;
+}
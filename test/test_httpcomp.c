@@ -0,0 +1,202 @@
+/*                         _
+ *   ___  __ _  __ _ _   _(_)
+ *  / __|/ _` |/ _` | | | | |
+ *  \__ \ (_| | (_| | |_| | |
+ *  |___/\__,_|\__, |\__,_|_|
+ *             |___/
+ *
+ * Cross-platform library which helps to develop web servers or frameworks.
+ *
+ * Copyright (C) 2016-2020 Silvio Clecio <silvioprog@gmail.com>
+ *
+ * Sagui library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * Sagui library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Sagui library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "sg_assert.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include "zlib.h"
+#include "sg_macros.h"
+#include "sg_httpcomp.h"
+#include <sagui.h>
+
+#define TEXT                                                                   \
+  "Lorem ipsum dolor sit amet, consectetur adipiscing elit. Lorem ipsum "      \
+  "dolor sit amet, consectetur adipiscing elit. Lorem ipsum dolor sit amet."
+
+static void check_inflate(const void *src, size_t src_size, int wbits) {
+  z_stream stream;
+  char dest[256];
+  memset(&stream, 0, sizeof(z_stream));
+  ASSERT(inflateInit2(&stream, wbits) == Z_OK);
+  stream.next_in = (Bytef *) src;
+  stream.avail_in = (uInt) src_size;
+  stream.next_out = (Bytef *) dest;
+  stream.avail_out = sizeof(dest);
+  ASSERT(inflate(&stream, Z_FINISH) == Z_STREAM_END);
+  ASSERT(stream.total_out == strlen(TEXT));
+  ASSERT(memcmp(dest, TEXT, strlen(TEXT)) == 0);
+  ASSERT(inflateEnd(&stream) == Z_OK);
+}
+
+static void test__httpcomp_buf_grow(void) {
+  struct sg__httpcomp_buf buf;
+  memset(&buf, 0, sizeof(struct sg__httpcomp_buf));
+  ASSERT(sg__httpcomp_buf_grow(&buf, 10) == 0);
+  ASSERT(buf.data);
+  ASSERT(buf.size == 0);
+  ASSERT(buf.cap >= 10);
+  buf.size = buf.cap;
+  ASSERT(sg__httpcomp_buf_grow(&buf, 1) == 0);
+  ASSERT(buf.cap > buf.size);
+  sg__httpcomp_buf_free(&buf);
+  ASSERT(!buf.data);
+  ASSERT(buf.size == 0);
+  ASSERT(buf.cap == 0);
+}
+
+static void test__httpcomp_find(void) {
+  ASSERT(!sg__httpcomp_find(NULL));
+  ASSERT(!sg__httpcomp_find(""));
+  ASSERT(!sg__httpcomp_find("foo"));
+  ASSERT(!sg__httpcomp_find("gzipx"));
+  ASSERT(strcmp(sg__httpcomp_find("deflate")->token, "deflate") == 0);
+  ASSERT(strcmp(sg__httpcomp_find("GZip")->token, "gzip") == 0);
+#ifdef SG_HTTP_COMPRESSION_BROTLI
+  ASSERT(strcmp(sg__httpcomp_find("br")->token, "br") == 0);
+#else /* SG_HTTP_COMPRESSION_BROTLI */
+  ASSERT(!sg__httpcomp_find("br"));
+#endif /* SG_HTTP_COMPRESSION_BROTLI */
+#ifdef SG_HTTP_COMPRESSION_ZSTD
+  ASSERT(strcmp(sg__httpcomp_find("zstd")->token, "zstd") == 0);
+#else /* SG_HTTP_COMPRESSION_ZSTD */
+  ASSERT(!sg__httpcomp_find("zstd"));
+#endif /* SG_HTTP_COMPRESSION_ZSTD */
+}
+
+static void test__httpcomp_level_valid(void) {
+  const struct sg__httpcomp *comp = sg__httpcomp_find("deflate");
+  ASSERT(sg__httpcomp_level_valid(comp, -1));
+  ASSERT(sg__httpcomp_level_valid(comp, 0));
+  ASSERT(sg__httpcomp_level_valid(comp, 9));
+  ASSERT(!sg__httpcomp_level_valid(comp, -2));
+  ASSERT(!sg__httpcomp_level_valid(comp, 10));
+#ifdef SG_HTTP_COMPRESSION_BROTLI
+  comp = sg__httpcomp_find("br");
+  ASSERT(sg__httpcomp_level_valid(comp, 11));
+  ASSERT(!sg__httpcomp_level_valid(comp, 12));
+#endif /* SG_HTTP_COMPRESSION_BROTLI */
+#ifdef SG_HTTP_COMPRESSION_ZSTD
+  comp = sg__httpcomp_find("zstd");
+  ASSERT(!sg__httpcomp_level_valid(comp, 0));
+  ASSERT(sg__httpcomp_level_valid(comp, 22));
+#endif /* SG_HTTP_COMPRESSION_ZSTD */
+}
+
+static void test__httpcomp_negotiate(void) {
+  ASSERT(!sg__httpcomp_negotiate(NULL));
+  ASSERT(!sg__httpcomp_negotiate(""));
+  ASSERT(!sg__httpcomp_negotiate("identity"));
+  ASSERT(!sg__httpcomp_negotiate("gzip;q=0, deflate;q=0.000"));
+  ASSERT(strcmp(sg__httpcomp_negotiate("gzip"), "gzip") == 0);
+  ASSERT(strcmp(sg__httpcomp_negotiate("deflate, gzip"), "gzip") == 0);
+  ASSERT(strcmp(sg__httpcomp_negotiate("deflate, gzip;q=0.5"), "deflate") ==
+         0);
+  ASSERT(strcmp(sg__httpcomp_negotiate("GZIP ; Q=0.8 , deflate;q=0.9"),
+                "deflate") == 0);
+  ASSERT(strcmp(sg__httpcomp_negotiate("*;q=0.1, gzip;q=0"), "gzip") != 0);
+  ASSERT(strcmp(sg__httpcomp_negotiate("*;q=0.5, deflate"), "deflate") == 0);
+#if !defined(SG_HTTP_COMPRESSION_BROTLI) && !defined(SG_HTTP_COMPRESSION_ZSTD)
+  ASSERT(strcmp(sg__httpcomp_negotiate("*"), "gzip") == 0);
+  ASSERT(strcmp(sg__httpcomp_negotiate("br, zstd, deflate"), "deflate") == 0);
+#endif /* !SG_HTTP_COMPRESSION_BROTLI && !SG_HTTP_COMPRESSION_ZSTD */
+#ifdef SG_HTTP_COMPRESSION_BROTLI
+  ASSERT(strcmp(sg__httpcomp_negotiate("gzip, deflate, br"), "br") == 0);
+#endif /* SG_HTTP_COMPRESSION_BROTLI */
+#ifdef SG_HTTP_COMPRESSION_ZSTD
+  ASSERT(strcmp(sg__httpcomp_negotiate("gzip, br, zstd"), "zstd") == 0);
+#endif /* SG_HTTP_COMPRESSION_ZSTD */
+}
+
+static void test__httpcomp_stream(const char *token, int wbits) {
+  const struct sg__httpcomp *comp = sg__httpcomp_find(token);
+  struct sg__httpcomp_buf buf;
+  void *ctx = NULL;
+  size_t len = strlen(TEXT);
+  memset(&buf, 0, sizeof(struct sg__httpcomp_buf));
+  ASSERT(comp->init(&ctx, comp->def_level) == 0);
+  ASSERT(ctx);
+  ASSERT(comp->encode(ctx, TEXT, len / 2, &buf) == 0);
+  ASSERT(comp->flush(ctx, &buf) == 0);
+  ASSERT(buf.size > 0);
+  ASSERT(comp->encode(ctx, TEXT + len / 2, len - len / 2, &buf) == 0);
+  ASSERT(comp->finish(ctx, &buf) == 0);
+  comp->free(ctx);
+  if (wbits != 0)
+    check_inflate(buf.data, buf.size, wbits);
+  else
+    ASSERT(buf.size > 0);
+  sg__httpcomp_buf_free(&buf);
+}
+
+static void test__httpcomp_compress(void) {
+  void *dest;
+  size_t dest_size;
+  ASSERT(sg__httpcomp_compress(sg__httpcomp_find("deflate"), -1, TEXT,
+                               strlen(TEXT), &dest, &dest_size) == 0);
+  ASSERT(dest_size < strlen(TEXT));
+  check_inflate(dest, dest_size, -MAX_WBITS);
+  sg_free(dest);
+  ASSERT(sg__httpcomp_compress(sg__httpcomp_find("gzip"), 9, TEXT,
+                               strlen(TEXT), &dest, &dest_size) == 0);
+  ASSERT(dest_size < strlen(TEXT));
+  ASSERT(((unsigned char *) dest)[0] == 0x1f);
+  ASSERT(((unsigned char *) dest)[1] == 0x8b);
+  check_inflate(dest, dest_size, MAX_WBITS + 16);
+  sg_free(dest);
+#ifdef SG_HTTP_COMPRESSION_BROTLI
+  ASSERT(sg__httpcomp_compress(sg__httpcomp_find("br"), -1, TEXT,
+                               strlen(TEXT), &dest, &dest_size) == 0);
+  ASSERT(dest_size > 0);
+  ASSERT(dest_size < strlen(TEXT));
+  sg_free(dest);
+#endif /* SG_HTTP_COMPRESSION_BROTLI */
+#ifdef SG_HTTP_COMPRESSION_ZSTD
+  ASSERT(sg__httpcomp_compress(sg__httpcomp_find("zstd"), -1, TEXT,
+                               strlen(TEXT), &dest, &dest_size) == 0);
+  ASSERT(dest_size < strlen(TEXT));
+  ASSERT(((unsigned char *) dest)[0] == 0x28);
+  ASSERT(((unsigned char *) dest)[3] == 0xfd);
+  sg_free(dest);
+#endif /* SG_HTTP_COMPRESSION_ZSTD */
+}
+
+int main(void) {
+  test__httpcomp_buf_grow();
+  test__httpcomp_find();
+  test__httpcomp_level_valid();
+  test__httpcomp_negotiate();
+  test__httpcomp_stream("deflate", MAX_WBITS);
+  test__httpcomp_stream("gzip", MAX_WBITS + 16);
+#ifdef SG_HTTP_COMPRESSION_BROTLI
+  test__httpcomp_stream("br", 0);
+#endif /* SG_HTTP_COMPRESSION_BROTLI */
+#ifdef SG_HTTP_COMPRESSION_ZSTD
+  test__httpcomp_stream("zstd", 0);
+#endif /* SG_HTTP_COMPRESSION_ZSTD */
+  test__httpcomp_compress();
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,329 @@
+/*                         _
+ *   ___  __ _  __ _ _   _(_)
+ *  / __|/ _` |/ _` | | | | |
+ *  \__ \ (_| | (_| | |_| | |
+ *  |___/\__,_|\__, |\__,_|_|
+ *             |___/
+ *
+ * Cross-platform library which helps to develop web servers or frameworks.
+ *
+ * Copyright (C) 2016-2020 Silvio Clecio <silvioprog@gmail.com>
+ *
+ * Sagui library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * Sagui library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Sagui library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#define SG_EXTERN
+
+#include "sg_assert.h"
+
+#include <string.h>
+#include "sg_httpform.c"
+#include <sagui.h>
+
+static const char *multipart =
+  "preamble\r\n"
+  "--XyZ\r\n"
+  "Content-Disposition: form-data; name=\"a\"\r\n"
+  "\r\n"
+  "foo\r\n"
+  "--XyZ\r\n"
+  "content-disposition: form-data; name=\"file\"; filename=\"b.txt\"\r\n"
+  "Content-Type: text/plain\r\n"
+  "Content-Transfer-Encoding: binary \r\n"
+  "\r\n"
+  "line1\r\n--Xy\r\n--X\rline2\r\r\n"
+  "--XyZ  \r\n"
+  "Content-Disposition: form-data; name=\"empty\"\r\n"
+  "\r\n"
+  "\r\n"
+  "--XyZ\r\n"
+  "\r\n"
+  "unnamed\r\n"
+  "--XyZ--\r\n"
+  "epilogue";
+
+static const char *multipart_fields =
+  "\na;;;:foo\nfile;b.txt;text/plain;binary:line1\r\n--Xy\r\n--X\rline2\r";
+
+static const char *urlencoded = "a=1&b+c=x%20y+z&d&e=%41%4&f=%zz&g=&%68=i";
+
+static const char *urlencoded_fields =
+  "\na;;;:1\nb c;;;:x y z\ne;;;:A%4\nf;;;:%zz\nh;;;:i";
+
+static enum MHD_Result form_iter(void *cls, enum MHD_ValueKind kind,
+                                 const char *key, const char *filename,
+                                 const char *content_type,
+                                 const char *transfer_encoding,
+                                 const char *data, uint64_t off, size_t size) {
+  struct sg_str *str = cls;
+  ASSERT(kind == MHD_POSTDATA_KIND);
+  ASSERT(size > 0);
+  if (off == 0)
+    sg_str_printf(str, "\n%s;%s;%s;%s:", key ? key : "",
+                  filename ? filename : "", content_type ? content_type : "",
+                  transfer_encoding ? transfer_encoding : "");
+  sg_str_write(str, data, size);
+  return MHD_YES;
+}
+
+static enum MHD_Result form_iter_stop(void *cls, enum MHD_ValueKind kind,
+                                      const char *key, const char *filename,
+                                      const char *content_type,
+                                      const char *transfer_encoding,
+                                      const char *data, uint64_t off,
+                                      size_t size) {
+  (void) cls;
+  (void) kind;
+  (void) key;
+  (void) filename;
+  (void) content_type;
+  (void) transfer_encoding;
+  (void) data;
+  (void) off;
+  (void) size;
+  return MHD_NO;
+}
+
+/* Parses a copy of each piece, so reading past it is caught. */
+static int form_parse(struct sg__httpform *form, struct sg_str *str,
+                      const char *data, size_t size) {
+  char *buf = sg_malloc(size > 0 ? size : 1);
+  int errnum;
+  ASSERT(buf);
+  memcpy(buf, data, size);
+  errnum = sg__httpform_parse(form, str, buf, size);
+  sg_free(buf);
+  return errnum;
+}
+
+static void form_check(const char *type, const char *body,
+                       const char *fields) {
+  struct sg__httpform *form;
+  struct sg_str *str = sg_str_new();
+  size_t i, j, len = strlen(body);
+  /* every split into two pieces */
+  for (i = 0; i <= len; i++) {
+    form = sg__httpform_new(type, 256, form_iter);
+    ASSERT(form);
+    sg_str_clear(str);
+    ASSERT(form_parse(form, str, body, i) == 0);
+    ASSERT(form_parse(form, str, body + i, len - i) == 0);
+    ASSERT(strcmp(sg_str_content(str), fields) == 0);
+    sg__httpform_free(form);
+  }
+  /* byte per byte */
+  form = sg__httpform_new(type, 256, form_iter);
+  ASSERT(form);
+  sg_str_clear(str);
+  for (j = 0; j < len; j++)
+    ASSERT(form_parse(form, str, body + j, 1) == 0);
+  ASSERT(strcmp(sg_str_content(str), fields) == 0);
+  sg__httpform_free(form);
+  sg_str_free(str);
+}
+
+static void test__httpform_kind(void) {
+  ASSERT(sg__httpform_kind(NULL) == SG__HTTPFORM_NONE);
+  ASSERT(sg__httpform_kind("") == SG__HTTPFORM_NONE);
+  ASSERT(sg__httpform_kind("text/plain") == SG__HTTPFORM_NONE);
+  ASSERT(sg__httpform_kind("multipart/mixed; boundary=a") ==
+         SG__HTTPFORM_NONE);
+  ASSERT(sg__httpform_kind("Application/X-WWW-Form-Urlencoded") ==
+         SG__HTTPFORM_URLENCODED);
+  ASSERT(sg__httpform_kind("application/x-www-form-urlencoded; charset=utf-8") ==
+         SG__HTTPFORM_URLENCODED);
+  ASSERT(sg__httpform_kind("Multipart/Form-Data; boundary=abc") ==
+         SG__HTTPFORM_MULTIPART);
+}
+
+static void test__httpform_new(void) {
+  struct sg__httpform *form;
+  char type[128];
+  errno = 0;
+  ASSERT(!sg__httpform_new(NULL, 256, form_iter));
+  ASSERT(errno == EINVAL);
+  errno = 0;
+  ASSERT(!sg__httpform_new("text/plain", 256, form_iter));
+  ASSERT(errno == EINVAL);
+  errno = 0;
+  ASSERT(!sg__httpform_new("application/x-www-form-urlencoded", 255,
+                           form_iter));
+  ASSERT(errno == EINVAL);
+  errno = 0;
+  ASSERT(!sg__httpform_new("application/x-www-form-urlencoded", 256, NULL));
+  ASSERT(errno == EINVAL);
+  errno = 0;
+  ASSERT(!sg__httpform_new("multipart/form-data", 256, form_iter));
+  ASSERT(errno == EINVAL);
+  errno = 0;
+  ASSERT(!sg__httpform_new("multipart/form-data; boundary=", 256, form_iter));
+  ASSERT(errno == EINVAL);
+  errno = 0;
+  ASSERT(!sg__httpform_new("multipart/form-data; boundary=\"abc", 256,
+                           form_iter));
+  ASSERT(errno == EINVAL);
+  memset(type, 0, sizeof(type));
+  strcpy(type, "multipart/form-data; boundary=");
+  memset(type + strlen(type), 'a', SG__HTTPFORM_BOUNDARY_MAX + 1);
+  errno = 0;
+  ASSERT(!sg__httpform_new(type, 256, form_iter));
+  ASSERT(errno == EINVAL);
+  type[strlen(type) - 1] = '\0';
+  form = sg__httpform_new(type, 256, form_iter);
+  ASSERT(form);
+  ASSERT(form->delim_len == SG__HTTPFORM_BOUNDARY_MAX + 4);
+  sg__httpform_free(form);
+
+  form = sg__httpform_new("multipart/form-data; charset=utf-8; "
+                          "boundary=\"a b\"; foo=bar",
+                          256, form_iter);
+  ASSERT(form);
+  ASSERT(form->kind == SG__HTTPFORM_MULTIPART);
+  ASSERT(form->delim_len == 7);
+  ASSERT(memcmp(form->delim, "\r\n--a b", 7) == 0);
+  sg__httpform_free(form);
+  form = sg__httpform_new("multipart/form-data;boundary=abc;x=y", 256,
+                          form_iter);
+  ASSERT(form);
+  ASSERT(memcmp(form->delim, "\r\n--abc", 7) == 0);
+  sg__httpform_free(form);
+  form = sg__httpform_new("application/x-www-form-urlencoded", 256,
+                          form_iter);
+  ASSERT(form);
+  ASSERT(form->kind == SG__HTTPFORM_URLENCODED);
+  ASSERT(!form->delim);
+  sg__httpform_free(form);
+  sg__httpform_free(NULL);
+}
+
+static void test__httpform_find(void) {
+  char hay[200], str[40];
+  const char *p, *q;
+  size_t size, len, pos, i;
+  for (i = 0; i < sizeof(hay); i++)
+    hay[i] = (char) ('a' + (i * 7) % 5);
+  ASSERT(sg__httpform_find(hay, 0, "", 0) == hay);
+  ASSERT(!sg__httpform_find(hay, 0, "a", 1));
+  ASSERT(!sg__httpform_find(hay, sizeof(hay), "x", 1));
+  for (len = 1; len < sizeof(str); len += 3) {
+    for (i = 0; i < len; i++)
+      str[i] = (char) ('A' + i % 26);
+    for (size = len; size <= sizeof(hay); size += 17)
+      for (pos = 0; pos + len <= size; pos += 5) {
+        memcpy(hay + pos, str, len);
+        p = sg__httpform_find(hay, size, str, len);
+        for (q = hay; memcmp(q, str, len) != 0; q++)
+          ;
+        ASSERT(p == q);
+        ASSERT(!sg__httpform_find(hay, pos + len - 1, str, len) ||
+               (len == 1 && memchr(hay, str[0], pos)));
+        for (i = 0; i < len; i++)
+          hay[pos + i] = (char) ('a' + ((pos + i) * 7) % 5);
+      }
+  }
+}
+
+static void test__httpform_multipart(void) {
+  static const char *nopreamble = "--XyZ\r\n"
+                                  "Content-Disposition: form-data; name=a\r\n"
+                                  "\r\n"
+                                  "\r\r\n\r\n--X\r\n"
+                                  "--XyZ--";
+  form_check("multipart/form-data; boundary=XyZ", multipart,
+             multipart_fields);
+  form_check("multipart/form-data; boundary=XyZ", nopreamble,
+             "\na;;;:\r\r\n\r\n--X");
+}
+
+static void test__httpform_urlencoded(void) {
+  form_check("application/x-www-form-urlencoded", urlencoded,
+             urlencoded_fields);
+  form_check("application/x-www-form-urlencoded", "a=%2", "");
+}
+
+static void test__httpform_parse(void) {
+  const char *type = "multipart/form-data; boundary=XyZ";
+  struct sg__httpform *form;
+  struct sg_str *str = sg_str_new();
+  char body[512];
+  size_t i;
+
+  form = sg__httpform_new(type, 256, form_iter);
+  ASSERT(sg__httpform_parse(form, str, "--XyZx", 6) == EINVAL);
+  sg__httpform_free(form);
+  form = sg__httpform_new(type, 256, form_iter);
+  ASSERT(sg__httpform_parse(form, str, "--XyZ-x", 7) == EINVAL);
+  sg__httpform_free(form);
+  form = sg__httpform_new(type, 256, form_iter);
+  ASSERT(sg__httpform_parse(form, str, "--XyZ\rx", 7) == EINVAL);
+  sg__httpform_free(form);
+
+  /* part headers larger than the buffer */
+  strcpy(body, "--XyZ\r\nContent-Disposition: form-data; name=\"");
+  for (i = strlen(body); i < 300; i++)
+    body[i] = 'a';
+  strcpy(body + i, "\"\r\n\r\n");
+  form = sg__httpform_new(type, 256, form_iter);
+  ASSERT(sg__httpform_parse(form, str, body, strlen(body)) == EINVAL);
+  sg__httpform_free(form);
+  form = sg__httpform_new(type, 512, form_iter);
+  ASSERT(sg__httpform_parse(form, str, body, strlen(body)) == 0);
+  sg__httpform_free(form);
+
+  /* names larger than half of the buffer */
+  for (i = 0; i < 128; i++)
+    body[i] = 'a';
+  body[i] = '=';
+  form =
+    sg__httpform_new("application/x-www-form-urlencoded", 256, form_iter);
+  ASSERT(sg__httpform_parse(form, str, body, 128) == EINVAL);
+  sg__httpform_free(form);
+  form =
+    sg__httpform_new("application/x-www-form-urlencoded", 256, form_iter);
+  ASSERT(sg__httpform_parse(form, str, body + 1, 128) == 0);
+  sg__httpform_free(form);
+
+  /* decoded in pieces larger than the scratch area */
+  sg_str_clear(str);
+  strcpy(body, "a=");
+  for (i = 2; i < 500; i++)
+    body[i] = (char) (i % 2 ? '+' : 'b');
+  form =
+    sg__httpform_new("application/x-www-form-urlencoded", 256, form_iter);
+  ASSERT(sg__httpform_parse(form, str, body, 500) == 0);
+  ASSERT(sg_str_length(str) == strlen("\na;;;:") + 498);
+  ASSERT(strncmp(sg_str_content(str), "\na;;;:b b b", 11) == 0);
+  sg__httpform_free(form);
+
+  form = sg__httpform_new(type, 256, form_iter_stop);
+  ASSERT(sg__httpform_parse(form, str, multipart, strlen(multipart)) ==
+         ECANCELED);
+  sg__httpform_free(form);
+  form = sg__httpform_new("application/x-www-form-urlencoded", 256,
+                          form_iter_stop);
+  ASSERT(sg__httpform_parse(form, str, "a=1", 3) == ECANCELED);
+  sg__httpform_free(form);
+  sg_str_free(str);
+}
+
+int main(void) {
+  test__httpform_kind();
+  test__httpform_new();
+  test__httpform_find();
+  test__httpform_multipart();
+  test__httpform_urlencoded();
+  test__httpform_parse();
+  return EXIT_SUCCESS;
+}
@@ -28,6 +28,7 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include "sg_digest.h"
 #include "sg_httpreq.h"
 #include <sagui.h>
 
@@ -133,6 +134,55 @@ static void test_httpreq_params(struct sg_httpreq *req) {
   ASSERT(strcmp(sg_strmap_get(*params, "abc"), "123") == 0);
 }
 
+static int dummy_httpreq_iter_cb(void *cls, const char *name,
+                                 const char *val) {
+  (void) name;
+  (void) val;
+  return *((int *) cls);
+}
+
+static void test_httpreq_lookup(struct sg_httpreq *req) {
+  errno = 0;
+  ASSERT(!sg_httpreq_header(NULL, "foo"));
+  ASSERT(errno == EINVAL);
+  errno = 0;
+  ASSERT(!sg_httpreq_header(req, NULL));
+  ASSERT(errno == EINVAL);
+  errno = 0;
+  ASSERT(!sg_httpreq_cookie(NULL, "foo"));
+  ASSERT(errno == EINVAL);
+  errno = 0;
+  ASSERT(!sg_httpreq_cookie(req, NULL));
+  ASSERT(errno == EINVAL);
+  errno = 0;
+  ASSERT(!sg_httpreq_param(NULL, "foo"));
+  ASSERT(errno == EINVAL);
+  errno = 0;
+  ASSERT(!sg_httpreq_param(req, NULL));
+  ASSERT(errno == EINVAL);
+
+  errno = 0;
+  ASSERT(!sg_httpreq_header(req, "foo"));
+  ASSERT(!sg_httpreq_cookie(req, "foo"));
+  ASSERT(!sg_httpreq_param(req, "foo"));
+  ASSERT(errno == 0);
+}
+
+static void test_httpreq_iter(struct sg_httpreq *req) {
+  int ret = 0;
+  ASSERT(sg_httpreq_headers_iter(NULL, dummy_httpreq_iter_cb, &ret) == EINVAL);
+  ASSERT(sg_httpreq_headers_iter(req, NULL, &ret) == EINVAL);
+  ASSERT(sg_httpreq_cookies_iter(NULL, dummy_httpreq_iter_cb, &ret) == EINVAL);
+  ASSERT(sg_httpreq_cookies_iter(req, NULL, &ret) == EINVAL);
+  ASSERT(sg_httpreq_params_iter(NULL, dummy_httpreq_iter_cb, &ret) == EINVAL);
+  ASSERT(sg_httpreq_params_iter(req, NULL, &ret) == EINVAL);
+
+  ret = 123;
+  ASSERT(sg_httpreq_headers_iter(req, dummy_httpreq_iter_cb, &ret) == 0);
+  ASSERT(sg_httpreq_cookies_iter(req, dummy_httpreq_iter_cb, &ret) == 0);
+  ASSERT(sg_httpreq_params_iter(req, dummy_httpreq_iter_cb, &ret) == 0);
+}
+
 static void test_httpreq_fields(struct sg_httpreq *req) {
   struct sg_strmap **fields;
   errno = 0;
@@ -217,6 +267,26 @@ static void test_httpreq_payload(struct sg_httpreq *req) {
   ASSERT(strcmp(sg_str_content(sg_httpreq_payload(req)), "abc123") == 0);
 }
 
+static void test_httpreq_digest(struct sg_httpreq *req) {
+  errno = 0;
+  ASSERT(!sg_httpreq_digest(NULL, SG_DIGEST_SHA256));
+  ASSERT(errno == EINVAL);
+  errno = 0;
+  ASSERT(!sg_httpreq_digest(req, (enum sg_digest) 0));
+  ASSERT(errno == EINVAL);
+
+  ASSERT(strcmp(sg_str_content(sg_httpreq_payload(req)), "abc123") == 0);
+  ASSERT(strcmp(sg_httpreq_digest(req, SG_DIGEST_SHA256),
+                "6ca13d52ca70c883e0f0bb101e425a89e8624de51db2d2392593af6a84118090") ==
+         0);
+  ASSERT(req->payld_digest->algos == SG_DIGEST_SHA256);
+  ASSERT(strcmp(sg_httpreq_digest(req, SG_DIGEST_CRC32C), "018f14c9") == 0);
+  ASSERT(req->payld_digest->algos == (SG_DIGEST_CRC32C | SG_DIGEST_SHA256));
+  ASSERT(strcmp(sg_httpreq_digest(req, SG_DIGEST_SHA256),
+                "6ca13d52ca70c883e0f0bb101e425a89e8624de51db2d2392593af6a84118090") ==
+         0);
+}
+
 static void test_httpreq_is_uploading(struct sg_httpreq *req) {
   errno = 0;
   ASSERT(!sg_httpreq_is_uploading(NULL));
@@ -279,6 +349,48 @@ static void test_httpreq_isolate(struct sg_httpreq *req) {
   /* more tests in `test_httpsrv_curl.c`. */
 }
 
+static ssize_t dummy_httpreq_body_cb(void *cls, struct sg_httpreq *req,
+                                     const char *buf, size_t size) {
+  (void) cls;
+  (void) req;
+  (void) buf;
+  return (ssize_t) size;
+}
+
+static void test_httpreq_set_body_cb(struct sg_httpreq *req) {
+  int dummy = 123;
+  ASSERT(sg_httpreq_set_body_cb(NULL, dummy_httpreq_body_cb, &dummy) ==
+         EINVAL);
+  ASSERT(sg_httpreq_set_body_cb(req, NULL, &dummy) == EINVAL);
+
+  req->is_uploading = false;
+  ASSERT(sg_httpreq_set_body_cb(req, dummy_httpreq_body_cb, &dummy) == 0);
+  ASSERT(req->body_cb == dummy_httpreq_body_cb);
+  ASSERT(*((int *) req->body_cls) == 123);
+  req->is_uploading = true;
+  ASSERT(sg_httpreq_set_body_cb(req, dummy_httpreq_body_cb, NULL) ==
+         EALREADY);
+  req->is_uploading = false;
+}
+
+static void test_httpreq_resume_body(struct sg_httpreq *req,
+                                     struct sg_httpsrv *srv) {
+  ASSERT(sg_httpreq_resume_body(NULL) == EINVAL);
+
+  req->srv = srv;
+  req->body_paused = false;
+  req->body_resumed = false;
+  ASSERT(sg_httpreq_resume_body(req) == 0);
+  ASSERT(!req->body_resumed);
+  ASSERT(!req->body_paused);
+  req->body_sinking = true;
+  ASSERT(sg_httpreq_resume_body(req) == 0);
+  ASSERT(req->body_resumed);
+  ASSERT(!req->body_paused);
+  req->body_sinking = false;
+  req->body_resumed = false;
+}
+
 static void test_httpreq_set_user_data(struct sg_httpreq *req) {
   const char *dummy = "foo";
   ASSERT(sg_httpreq_set_user_data(NULL, (void *) dummy) == EINVAL);
@@ -315,11 +427,14 @@ int main(void) {
   test_httpreq_headers(req);
   test_httpreq_cookies(req);
   test_httpreq_params(req);
+  test_httpreq_lookup(req);
+  test_httpreq_iter(req);
   test_httpreq_fields(req);
   test_httpreq_version(req);
   test_httpreq_method(req);
   test_httpreq_path(req);
   test_httpreq_payload(req);
+  test_httpreq_digest(req);
   test_httpreq_is_uploading(req);
   test_httpreq_uploads(req);
   test_httpreq_client();
@@ -327,6 +442,8 @@ int main(void) {
   test_httpreq_tls_session();
 #endif /* SG_HTTPS_SUPPORT */
   test_httpreq_isolate(req);
+  test_httpreq_set_body_cb(req);
+  test_httpreq_resume_body(req, srv);
   test_httpreq_set_user_data(req);
   test_httpreq_user_data(req);
   sg__httpreq_free(req);
@@ -72,6 +72,67 @@ static void test__httpres_dispatch(struct sg_httpres *res) {
   ASSERT(sg__httpres_dispatch(res) == 0);
 }
 
+static void test__httpres_hdrs_new(void) {
+  struct sg__httpres_hdrs *hdrs;
+  struct sg_strmap *map = NULL;
+  hdrs = sg__httpres_hdrs_new(NULL);
+  ASSERT(hdrs);
+  ASSERT(hdrs->count == 0);
+  sg_free(hdrs);
+  sg_strmap_add(&map, "Server", "Sagui");
+  sg_strmap_add(&map, "X-Frame-Options", "DENY");
+  hdrs = sg__httpres_hdrs_new(map);
+  ASSERT(hdrs);
+  ASSERT(hdrs->count == 2);
+  ASSERT(strcmp(hdrs->items[0].name, "Server") == 0);
+  ASSERT(strcmp(hdrs->items[0].val, "Sagui") == 0);
+  ASSERT(strcmp(hdrs->items[1].name, "X-Frame-Options") == 0);
+  ASSERT(strcmp(hdrs->items[1].val, "DENY") == 0);
+  sg_free(hdrs);
+  sg_strmap_add(&map, "foo", "bar\r\nbaz");
+  errno = 0;
+  ASSERT(!sg__httpres_hdrs_new(map));
+  ASSERT(errno == EINVAL);
+  sg_strmap_cleanup(&map);
+}
+
+static void test__httpres_date(void) {
+  char date[SG__HTTPRES_DATE_SIZE + 1], date2[SG__HTTPRES_DATE_SIZE + 1];
+  memset(date, 'x', sizeof(date));
+  sg__httpres_date(date);
+  ASSERT(strlen(date) == SG__HTTPRES_DATE_SIZE);
+  ASSERT(date[3] == ',');
+  ASSERT(strcmp(date + SG__HTTPRES_DATE_SIZE - 4, " GMT") == 0);
+  sg__httpres_date(date2);
+  ASSERT(strlen(date2) == SG__HTTPRES_DATE_SIZE);
+  sg__httpres_date_str[0] = '?';
+  sg__httpres_date_time = 0;
+  sg__httpres_date(date);
+  ASSERT(date[0] != '?');
+  ASSERT(strlen(date) == SG__HTTPRES_DATE_SIZE);
+}
+
+static void test__httpres_prepare(void) {
+  struct sg_httpres *res = sg__httpres_new(NULL);
+  struct sg__httpres_hdrs *hdrs;
+  struct sg_strmap *map = NULL;
+  sg__httpres_prepare(res);
+  sg_strmap_add(&map, "Server", "Sagui");
+  sg_strmap_add(&map, "X-Foo", "bar");
+  hdrs = sg__httpres_hdrs_new(map);
+  sg_strmap_cleanup(&map);
+  res->hdrs = hdrs;
+  ASSERT(sg_httpres_send(res, "foo", "text/plain", 200) == 0);
+  sg_strmap_set(&res->headers, "X-Foo", "baz");
+  sg__httpres_prepare(res);
+  ASSERT(strcmp(MHD_get_response_header(res->handle, "Server"), "Sagui") == 0);
+  ASSERT(strcmp(MHD_get_response_header(res->handle, "X-Foo"), "baz") == 0);
+  ASSERT(strlen(MHD_get_response_header(res->handle, MHD_HTTP_HEADER_DATE)) ==
+         SG__HTTPRES_DATE_SIZE);
+  sg__httpres_free(res);
+  sg_free(hdrs);
+}
+
 static void test_httpres_headers(struct sg_httpres *res) {
   struct sg_strmap **headers;
   errno = 0;
@@ -92,6 +153,38 @@ static void test_httpres_headers(struct sg_httpres *res) {
   ASSERT(strcmp(sg_strmap_get(*headers, "abc"), "123") == 0);
 }
 
+static void test_httpres_set_base_headers(void) {
+  struct sg_httpres *res = sg__httpres_new(NULL);
+  struct sg_strmap_snap *snap;
+  struct sg_strmap *map = NULL;
+  sg_strmap_add(&map, "Server", "Sagui");
+  sg_strmap_add(&map, "X-Foo", "bar");
+  snap = sg_strmap_snap_new(map);
+  sg_strmap_cleanup(&map);
+  ASSERT(sg_httpres_set_base_headers(NULL, snap) == EINVAL);
+
+  ASSERT(sg_httpres_set_base_headers(res, snap) == 0);
+  ASSERT(res->base == snap);
+  ASSERT(snap->refs == 2);
+  ASSERT(sg_httpres_set_base_headers(res, snap) == 0);
+  ASSERT(snap->refs == 2);
+  ASSERT(sg_httpres_send(res, "foo", "text/plain", 200) == 0);
+  sg_strmap_set(&res->headers, "x-foo", "baz");
+  sg__httpres_prepare(res);
+  ASSERT(strcmp(MHD_get_response_header(res->handle, "Server"), "Sagui") == 0);
+  ASSERT(strcmp(MHD_get_response_header(res->handle, "X-Foo"), "baz") == 0);
+  ASSERT(sg_httpres_clear(res) == 0);
+  ASSERT(!res->base);
+  ASSERT(snap->refs == 1);
+  ASSERT(sg_httpres_set_base_headers(res, snap) == 0);
+  ASSERT(sg_httpres_set_base_headers(res, NULL) == 0);
+  ASSERT(!res->base);
+  ASSERT(sg_httpres_set_base_headers(res, snap) == 0);
+  sg__httpres_free(res);
+  ASSERT(snap->refs == 1);
+  sg_strmap_snap_unref(snap);
+}
+
 static void test_httpres_set_cookie(struct sg_httpres *res) {
   struct sg_strmap **fields;
   ASSERT(sg_httpres_set_cookie(NULL, "foo", "bar") == EINVAL);
@@ -435,6 +528,56 @@ static void test_httpres_sendstream(struct sg_httpres *res) {
   sg_free(str);
 }
 
+static void test_httpres_sendiov(struct sg_httpres *res) {
+  struct sg_httpres_iov iov[3];
+  int a = 1, b = 1;
+  memset(iov, 0, sizeof(iov));
+  iov[0].buf = &a;
+  iov[0].size = sizeof(int);
+  iov[0].free_cb = dummy_free_cb;
+  iov[1].buf = "foo";
+  iov[1].size = 3;
+  iov[2].buf = &b;
+  iov[2].size = sizeof(int);
+  iov[2].free_cb = dummy_free_cb;
+  ASSERT(sg_httpres_sendiov(NULL, iov, 3, "text/plain", 200) == EINVAL);
+  ASSERT(a == 0 && b == 0);
+  a = b = 1;
+  ASSERT(sg_httpres_sendiov(res, NULL, 3, "text/plain", 200) == EINVAL);
+  ASSERT(a == 1 && b == 1);
+  ASSERT(sg_httpres_sendiov(res, iov, 0, "text/plain", 200) == EINVAL);
+  ASSERT(a == 1 && b == 1);
+  ASSERT(sg_httpres_sendiov(res, iov, 3, "text/plain", 99) == EINVAL);
+  ASSERT(a == 0 && b == 0);
+  a = b = 1;
+  ASSERT(sg_httpres_sendiov(res, iov, 3, "text/plain", 600) == EINVAL);
+  ASSERT(a == 0 && b == 0);
+  a = b = 1;
+  iov[1].buf = NULL;
+  ASSERT(sg_httpres_sendiov(res, iov, 3, "text/plain", 200) == EINVAL);
+  ASSERT(a == 0 && b == 0);
+  a = b = 1;
+  iov[1].size = 0;
+  ASSERT(sg_httpres_sendiov(res, iov, 3, "text/plain", 200) == 0);
+  MHD_destroy_response(res->handle);
+  res->handle = NULL;
+  ASSERT(a == 0 && b == 0);
+  a = b = 1;
+
+  iov[1].buf = "foo";
+  iov[1].size = 3;
+  sg_strmap_cleanup(&res->headers);
+  ASSERT(sg_httpres_sendiov(res, iov, 3, "text/plain", 201) == 0);
+  ASSERT(strcmp(sg_strmap_get(res->headers, MHD_HTTP_HEADER_CONTENT_TYPE),
+                "text/plain") == 0);
+  ASSERT(res->status == 201);
+  ASSERT(a == 1 && b == 1);
+  ASSERT(sg_httpres_sendiov(res, iov, 3, "text/plain", 200) == EALREADY);
+  ASSERT(a == 0 && b == 0);
+  MHD_destroy_response(res->handle);
+  res->handle = NULL;
+}
+
 #ifdef SG_HTTP_COMPRESSION
 
 static void test_httpres_zsend(struct sg_httpres *res) {
@@ -874,6 +1017,139 @@ static void test_httpres_zsendfile2(struct sg_httpres *res) {
   res->handle = NULL;
 }
 
+static struct sg__httpres_zpholder *
+test__httpres_zpholder(struct sg__httpres_zpool *pool, int level,
+                       uint64_t offset, uint64_t size) {
+#define FILENAME "foo.bin"
+#define PATH TEST_HTTPRES_BASE_PATH FILENAME
+  struct sg__httpres_zpholder *holder;
+  int fd = SG__OPEN(PATH, O_RDONLY);
+  ASSERT(fd != -1);
+  ASSERT(sg__httpres_zpholder_new(&holder, pool, NULL, fd, level, offset,
+                                  size) == 0);
+  return holder;
+#undef PATH
+#undef FILENAME
+}
+
+/* Pulls up to `max` bytes of the response and inflates them into `stream`. */
+static bool test__httpres_zpull(struct sg__httpres_zpholder *holder,
+                                z_stream *stream, size_t max) {
+  char mem[SG__BLOCK_SIZE];
+  ssize_t have;
+  while ((have = sg__httpres_zpread_cb(holder, 0, mem, max)) == 0) {
+    /* suspended until the worker compressing the block resumes it */
+    ASSERT(holder->suspended);
+    pthread_mutex_lock(&holder->pool->mutex);
+    while (holder->suspended)
+      pthread_cond_wait(&holder->cond, &holder->pool->mutex);
+    pthread_mutex_unlock(&holder->pool->mutex);
+  }
+  if (have == MHD_CONTENT_READER_END_OF_STREAM)
+    return false;
+  ASSERT(have > 0);
+  stream->next_in = (Bytef *) mem;
+  stream->avail_in = (uInt) have;
+  ASSERT(inflate(stream, Z_NO_FLUSH) >= Z_OK);
+  return true;
+}
+
+static void test__httpres_zpsend_check(struct sg__httpres_zpool *pool,
+                                       const char *data, uint64_t offset,
+                                       uint64_t size) {
+  struct sg__httpres_zpholder *holder;
+  z_stream stream;
+  char *dest;
+  dest = sg_malloc(size);
+  ASSERT(dest);
+  holder = test__httpres_zpholder(pool, -1, offset, size);
+  memset(&stream, 0, sizeof(z_stream));
+  ASSERT(inflateInit2(&stream, MAX_WBITS + 16) == Z_OK);
+  stream.next_out = (Bytef *) dest;
+  stream.avail_out = (uInt) size;
+  while (test__httpres_zpull(holder, &stream, SG__BLOCK_SIZE))
+    ;
+  ASSERT(inflate(&stream, Z_FINISH) == Z_STREAM_END);
+  ASSERT(stream.total_out == size);
+  ASSERT(memcmp(dest, data + offset, size) == 0);
+  ASSERT(inflateEnd(&stream) == Z_OK);
+  sg__httpres_zpfree_cb(holder);
+  sg_free(dest);
+}
+
+/* Responses of different levels interleaved on the same pool. */
+static void test__httpres_zpsend_shared(struct sg__httpres_zpool *pool,
+                                        const char *data, uint64_t size) {
+  struct sg__httpres_zpholder *holders[3];
+  z_stream streams[3];
+  char *dests[3];
+  bool more = true;
+  unsigned int i;
+  for (i = 0; i < 3; i++) {
+    dests[i] = sg_malloc(size);
+    ASSERT(dests[i]);
+    holders[i] = test__httpres_zpholder(pool, (int) i * 4 + 1, 0, size);
+    memset(&streams[i], 0, sizeof(z_stream));
+    ASSERT(inflateInit2(&streams[i], MAX_WBITS + 16) == Z_OK);
+    streams[i].next_out = (Bytef *) dests[i];
+    streams[i].avail_out = (uInt) size;
+  }
+  while (more) {
+    more = false;
+    for (i = 0; i < 3; i++)
+      if (test__httpres_zpull(holders[i], &streams[i], 1000))
+        more = true;
+  }
+  for (i = 0; i < 3; i++) {
+    ASSERT(inflate(&streams[i], Z_FINISH) == Z_STREAM_END);
+    ASSERT(streams[i].total_out == size);
+    ASSERT(memcmp(dests[i], data, size) == 0);
+    ASSERT(inflateEnd(&streams[i]) == Z_OK);
+    sg__httpres_zpfree_cb(holders[i]);
+    sg_free(dests[i]);
+  }
+}
+
+static void test__httpres_zpsend(void) {
+#define FILENAME "foo.bin"
+#define PATH TEST_HTTPRES_BASE_PATH FILENAME
+  const size_t len = (SG__HTTPRES_ZPAR_BLOCK_SIZE * 6) + 123;
+  struct sg__httpres_zpool *pool;
+  char *data;
+  FILE *file;
+  size_t i;
+  data = sg_malloc(len);
+  ASSERT(data);
+  for (i = 0; i < len; i++)
+    data[i] = "lorem ipsum dolor sit amet"[(i * 7 + i / 13) % 26];
+  unlink(PATH);
+  file = fopen(PATH, "wb");
+  ASSERT(file);
+  ASSERT(fwrite(data, 1, len, file) == len);
+  ASSERT(fclose(file) == 0);
+  pool = sg__httpres_zpool_new(1);
+  ASSERT(pool);
+  test__httpres_zpsend_check(pool, data, 0, len);
+  sg__httpres_zpool_free(pool);
+  pool = sg__httpres_zpool_new(4);
+  ASSERT(pool);
+  ASSERT(pool->workers_count == 4);
+  test__httpres_zpsend_check(pool, data, 0, len);
+  test__httpres_zpsend_check(pool, data, 0, SG__HTTPRES_ZPAR_BLOCK_SIZE * 2);
+  test__httpres_zpsend_check(pool, data, 0, 10);
+  test__httpres_zpsend_check(pool, data, 1000, len - 1000);
+  test__httpres_zpsend_check(pool, data, SG__HTTPRES_ZPAR_BLOCK_SIZE + 7,
+                             SG__HTTPRES_ZPAR_BLOCK_SIZE * 3);
+  test__httpres_zpsend_shared(pool, data, len);
+  /* released while the workers are still compressing */
+  sg__httpres_zpfree_cb(test__httpres_zpholder(pool, -1, 0, len));
+  sg__httpres_zpool_free(pool);
+  sg_free(data);
+  unlink(PATH);
+#undef PATH
+#undef FILENAME
+}
+
 static void test_httpres_zsendfile(struct sg_httpres *res) {
 #define FILENAME "foo.txt"
 #define PATH TEST_HTTPRES_BASE_PATH FILENAME
@@ -1010,7 +1286,11 @@ int main(void) {
   test__httpres_new();
   test__httpres_free();
   test__httpres_dispatch(res);
+  test__httpres_hdrs_new();
+  test__httpres_date();
+  test__httpres_prepare();
   test_httpres_headers(res);
+  test_httpres_set_base_headers();
   test_httpres_set_cookie(res);
   test_httpres_send(res);
   test_httpres_sendbinary(res);
@@ -1019,6 +1299,7 @@ int main(void) {
   test_httpres_sendfile2(res);
   test_httpres_sendfile(res);
   test_httpres_sendstream(res);
+  test_httpres_sendiov(res);
 #ifdef SG_HTTP_COMPRESSION
   test_httpres_zsend(res);
   test_httpres_zsendbinary2(res);
@@ -1029,6 +1310,7 @@ int main(void) {
   test_httpres_zrender(res);
   test_httpres_zsendfile2(res);
   test_httpres_zsendfile(res);
+  test__httpres_zpsend();
 #endif /* SG_HTTP_COMPRESSION */
   test_httpres_reset(res);
   test_httpres_clear(res);
@@ -297,11 +297,14 @@ static void test_httpsrv_new2(void) {
   ASSERT(srv->post_buf_size == 1024);
   ASSERT(srv->payld_limit == 1048576);
   ASSERT(srv->uplds_limit == 16777216);
+  ASSERT(srv->upld_mem_limit == 4096);
 #else /* __arm__ */
   ASSERT(srv->post_buf_size == 4096);
   ASSERT(srv->payld_limit == 4194304);
   ASSERT(srv->uplds_limit == 67108864);
+  ASSERT(srv->upld_mem_limit == 16384);
 #endif /* __arm__ */
+  ASSERT(srv->upld_digests == 0);
   sg_httpsrv_free(srv);
 }
 
@@ -663,6 +666,16 @@ static void test__httpsrv_set_cli_cb(struct sg_httpsrv *srv) {
   ASSERT(*((int *) srv->cli_cls) == 123);
 }
 
+static void test__httpsrv_set_hdr_cb(struct sg_httpsrv *srv) {
+  int dummy = 123;
+  ASSERT(sg_httpsrv_set_hdr_cb(NULL, dummy_httpreq_cb, &dummy) == EINVAL);
+  ASSERT(sg_httpsrv_set_hdr_cb(srv, NULL, &dummy) == EINVAL);
+
+  ASSERT(sg_httpsrv_set_hdr_cb(srv, dummy_httpreq_cb, &dummy) == 0);
+  ASSERT(srv->hdr_cb == dummy_httpreq_cb);
+  ASSERT(*((int *) srv->hdr_cls) == 123);
+}
+
 static void test__httpsrv_set_upld_cbs(struct sg_httpsrv *srv) {
   int dummy = 123;
 
@@ -714,6 +727,67 @@ static void test_httpsrv_upld_dir(struct sg_httpsrv *srv) {
   ASSERT(errno == 0);
 }
 
+static void test_httpsrv_set_upld_sync(struct sg_httpsrv *srv) {
+  ASSERT(sg_httpsrv_set_upld_sync(NULL, SG_HTTPUPLD_SYNC_DATA) == EINVAL);
+  ASSERT(sg_httpsrv_set_upld_sync(srv, (enum sg_httpupld_sync) 3) == EINVAL);
+
+  ASSERT(sg_httpsrv_set_upld_sync(srv, SG_HTTPUPLD_SYNC_DATA) == 0);
+}
+
+static void test_httpsrv_upld_sync(struct sg_httpsrv *srv) {
+  errno = 0;
+  ASSERT(sg_httpsrv_upld_sync(NULL) == SG_HTTPUPLD_SYNC_NONE);
+  ASSERT(errno == EINVAL);
+
+  ASSERT(sg_httpsrv_set_upld_sync(srv, SG_HTTPUPLD_SYNC_NONE) == 0);
+  errno = 0;
+  ASSERT(sg_httpsrv_upld_sync(srv) == SG_HTTPUPLD_SYNC_NONE);
+  ASSERT(errno == 0);
+  ASSERT(sg_httpsrv_set_upld_sync(srv, SG_HTTPUPLD_SYNC_FULL) == 0);
+  ASSERT(sg_httpsrv_upld_sync(srv) == SG_HTTPUPLD_SYNC_FULL);
+}
+
+static void test_httpsrv_set_upld_mem_limit(struct sg_httpsrv *srv) {
+  ASSERT(sg_httpsrv_set_upld_mem_limit(NULL, 123) == EINVAL);
+
+  ASSERT(sg_httpsrv_set_upld_mem_limit(srv, 123) == 0);
+  ASSERT(srv->upld_mem_limit == 123);
+}
+
+static void test_httpsrv_upld_mem_limit(struct sg_httpsrv *srv) {
+  errno = 0;
+  ASSERT(sg_httpsrv_upld_mem_limit(NULL) == 0);
+  ASSERT(errno == EINVAL);
+
+  ASSERT(sg_httpsrv_set_upld_mem_limit(srv, 0) == 0);
+  errno = 0;
+  ASSERT(sg_httpsrv_upld_mem_limit(srv) == 0);
+  ASSERT(errno == 0);
+  ASSERT(sg_httpsrv_set_upld_mem_limit(srv, 456) == 0);
+  ASSERT(sg_httpsrv_upld_mem_limit(srv) == 456);
+}
+
+static void test_httpsrv_set_upld_digests(struct sg_httpsrv *srv) {
+  ASSERT(sg_httpsrv_set_upld_digests(NULL, SG_DIGEST_SHA256) == EINVAL);
+  ASSERT(sg_httpsrv_set_upld_digests(srv, 4) == EINVAL);
+
+  ASSERT(sg_httpsrv_set_upld_digests(srv, SG_DIGEST_SHA256) == 0);
+  ASSERT(srv->upld_digests == SG_DIGEST_SHA256);
+  ASSERT(sg_httpsrv_set_upld_digests(srv, 0) == 0);
+  ASSERT(srv->upld_digests == 0);
+}
+
+static void test_httpsrv_upld_digests(struct sg_httpsrv *srv) {
+  errno = 0;
+  ASSERT(sg_httpsrv_upld_digests(NULL) == 0);
+  ASSERT(errno == EINVAL);
+
+  ASSERT(sg_httpsrv_set_upld_digests(srv,
+                                     SG_DIGEST_CRC32C | SG_DIGEST_SHA256) == 0);
+  ASSERT(sg_httpsrv_upld_digests(srv) == (SG_DIGEST_CRC32C | SG_DIGEST_SHA256));
+  ASSERT(sg_httpsrv_set_upld_digests(srv, 0) == 0);
+}
+
 static void test_httpsrv_set_post_buf_size(struct sg_httpsrv *srv) {
   ASSERT(sg_httpsrv_set_post_buf_size(NULL, 256) == EINVAL);
   ASSERT(sg_httpsrv_set_post_buf_size(srv, 255) == EINVAL);
@@ -822,6 +896,68 @@ static void test_httpsrv_con_limit(struct sg_httpsrv *srv) {
   ASSERT(errno == 0);
 }
 
+static void test_httpsrv_set_headers(struct sg_httpsrv *srv) {
+  struct sg_strmap *headers = NULL;
+  ASSERT(sg_httpsrv_set_headers(NULL, NULL) == EINVAL);
+
+  sg_strmap_add(&headers, "Server", "Sagui");
+  ASSERT(sg_httpsrv_set_headers(srv, headers) == 0);
+  ASSERT(srv->hdrs);
+  ASSERT(srv->hdrs->count == 1);
+  ASSERT(strcmp(srv->hdrs->items[0].name, "Server") == 0);
+  ASSERT(strcmp(srv->hdrs->items[0].val, "Sagui") == 0);
+  sg_strmap_add(&headers, "X-Foo", "a\nb");
+  ASSERT(sg_httpsrv_set_headers(srv, headers) == EINVAL);
+  ASSERT(srv->hdrs->count == 1);
+  sg_strmap_cleanup(&headers);
+  ASSERT(sg_httpsrv_set_headers(srv, NULL) == 0);
+  ASSERT(!srv->hdrs);
+}
+
+#ifdef SG_HTTP_COMPRESSION
+
+static void test_httpsrv_set_zthr_pool_size(struct sg_httpsrv *srv) {
+  ASSERT(sg_httpsrv_set_zthr_pool_size(NULL, 123) == EINVAL);
+
+  ASSERT(sg_httpsrv_set_zthr_pool_size(srv, 0) == 0);
+  ASSERT(sg_httpsrv_set_zthr_pool_size(srv, 123) == 0);
+}
+
+static void test_httpsrv_zthr_pool_size(struct sg_httpsrv *srv) {
+  errno = 0;
+  ASSERT(sg_httpsrv_zthr_pool_size(NULL) == 0);
+  ASSERT(errno == EINVAL);
+
+  ASSERT(sg_httpsrv_set_zthr_pool_size(srv, 123) == 0);
+  errno = 0;
+  ASSERT(sg_httpsrv_zthr_pool_size(srv) == 123);
+  ASSERT(errno == 0);
+}
+
+#endif /* SG_HTTP_COMPRESSION */
+
+#ifdef SG_HTTP_WEBSOCKET
+
+static void test_httpsrv_set_ws_ping_interval(struct sg_httpsrv *srv) {
+  ASSERT(sg_httpsrv_set_ws_ping_interval(NULL, 123) == EINVAL);
+
+  ASSERT(sg_httpsrv_set_ws_ping_interval(srv, 0) == 0);
+  ASSERT(sg_httpsrv_set_ws_ping_interval(srv, 123) == 0);
+}
+
+static void test_httpsrv_ws_ping_interval(struct sg_httpsrv *srv) {
+  errno = 0;
+  ASSERT(sg_httpsrv_ws_ping_interval(NULL) == 0);
+  ASSERT(errno == EINVAL);
+
+  ASSERT(sg_httpsrv_set_ws_ping_interval(srv, 123) == 0);
+  errno = 0;
+  ASSERT(sg_httpsrv_ws_ping_interval(srv) == 123);
+  ASSERT(errno == 0);
+}
+
+#endif /* SG_HTTP_WEBSOCKET */
+
 static void test_httpsrv_handle(struct sg_httpsrv *srv) {
   void *fake_handle = (void *) 123;
   void *old_handle;
@@ -862,9 +998,16 @@ int main(void) {
   test_httpsrv_port(srv);
   test_httpsrv_is_threaded(srv);
   test__httpsrv_set_cli_cb(srv);
+  test__httpsrv_set_hdr_cb(srv);
   test__httpsrv_set_upld_cbs(srv);
   test_httpsrv_set_upld_dir(srv);
   test_httpsrv_upld_dir(srv);
+  test_httpsrv_set_upld_sync(srv);
+  test_httpsrv_upld_sync(srv);
+  test_httpsrv_set_upld_mem_limit(srv);
+  test_httpsrv_upld_mem_limit(srv);
+  test_httpsrv_set_upld_digests(srv);
+  test_httpsrv_upld_digests(srv);
   test_httpsrv_set_post_buf_size(srv);
   test_httpsrv_post_buf_size(srv);
   test_httpsrv_set_payld_limit(srv);
@@ -877,6 +1020,15 @@ int main(void) {
   test_httpsrv_con_timeout(srv);
   test_httpsrv_set_con_limit(srv);
   test_httpsrv_con_limit(srv);
+  test_httpsrv_set_headers(srv);
+#ifdef SG_HTTP_COMPRESSION
+  test_httpsrv_set_zthr_pool_size(srv);
+  test_httpsrv_zthr_pool_size(srv);
+#endif /* SG_HTTP_COMPRESSION */
+#ifdef SG_HTTP_WEBSOCKET
+  test_httpsrv_set_ws_ping_interval(srv);
+  test_httpsrv_ws_ping_interval(srv);
+#endif /* SG_HTTP_WEBSOCKET */
   test_httpsrv_handle(srv);
   sg_httpsrv_free(srv);
   return EXIT_SUCCESS;
@@ -0,0 +1,202 @@
+/*                         _
+ *   ___  __ _  __ _ _   _(_)
+ *  / __|/ _` |/ _` | | | | |
+ *  \__ \ (_| | (_| | |_| | |
+ *  |___/\__,_|\__, |\__,_|_|
+ *             |___/
+ *
+ * Cross-platform library which helps to develop web servers or frameworks.
+ *
+ * Copyright (C) 2016-2020 Silvio Clecio <silvioprog@gmail.com>
+ *
+ * Sagui library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * Sagui library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Sagui library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#define SG_EXTERN
+
+#include "sg_assert.h"
+
+#include <string.h>
+#include "sg_httpsse.c"
+#include <sagui.h>
+
+static void dummy_httpreq_cb(void *cls, struct sg_httpreq *req,
+                             struct sg_httpres *res) {
+  (void) cls;
+  (void) req;
+  (void) res;
+}
+
+static void test__httpsse_format(void) {
+  char *msg;
+  size_t size;
+  msg = sg__httpsse_format(NULL, "foo", &size);
+  ASSERT(size == strlen("data: foo\n\n"));
+  ASSERT(memcmp(msg, "data: foo\n\n", size) == 0);
+  sg_free(msg);
+  msg = sg__httpsse_format("bar", "foo\nbar\n", &size);
+  ASSERT(size == strlen("event: bar\ndata: foo\ndata: bar\ndata: \n\n"));
+  ASSERT(memcmp(msg, "event: bar\ndata: foo\ndata: bar\ndata: \n\n", size) ==
+         0);
+  sg_free(msg);
+  msg = sg__httpsse_format(NULL, "foo\rid: 1\r\nbar\n\rbaz\r", &size);
+  ASSERT(size == strlen("data: foo\ndata: id: 1\ndata: bar\ndata: \n"
+                        "data: baz\ndata: \n\n"));
+  ASSERT(memcmp(msg,
+                "data: foo\ndata: id: 1\ndata: bar\ndata: \ndata: baz\n"
+                "data: \n\n",
+                size) == 0);
+  sg_free(msg);
+  msg = sg__httpsse_format(NULL, "", &size);
+  ASSERT(size == strlen("data: \n\n"));
+  ASSERT(memcmp(msg, "data: \n\n", size) == 0);
+  sg_free(msg);
+}
+
+static void test_httpsse_new(void) {
+  struct sg_httpsse *sse;
+  errno = 0;
+  ASSERT(!sg_httpsse_new(0, SG_HTTPSSE_DROP));
+  ASSERT(errno == EINVAL);
+  errno = 0;
+  ASSERT(!sg_httpsse_new(10, (enum sg_httpsse_policy) 10));
+  ASSERT(errno == EINVAL);
+  sse = sg_httpsse_new(10, SG_HTTPSSE_DISCONNECT);
+  ASSERT(sse);
+  ASSERT(sse->buf_size == 10);
+  ASSERT(sse->policy == SG_HTTPSSE_DISCONNECT);
+  ASSERT(!sse->subs);
+  sg_httpsse_free(sse);
+}
+
+static void test_httpsse_free(void) {
+  sg_httpsse_free(NULL);
+}
+
+static void test_httpsse_subscribe(struct sg_httpreq *req) {
+  struct sg_httpsse *sse = sg_httpsse_new(16, SG_HTTPSSE_DROP);
+  ASSERT(sg_httpsse_subscribe(NULL, req) == EINVAL);
+  ASSERT(sg_httpsse_subscribe(sse, NULL) == EINVAL);
+  ASSERT(sg_httpsse_count(sse) == 0);
+
+  ASSERT(sg_httpsse_subscribe(sse, req) == 0);
+  ASSERT(sg_httpsse_count(sse) == 1);
+  ASSERT(strcmp(sg_strmap_get(req->res->headers, MHD_HTTP_HEADER_CONTENT_TYPE),
+                "text/event-stream") == 0);
+  ASSERT(strcmp(sg_strmap_get(req->res->headers,
+                              MHD_HTTP_HEADER_CACHE_CONTROL),
+                "no-cache") == 0);
+  ASSERT(req->res->status == 200);
+  ASSERT(sse->subs->con == req->con);
+  ASSERT(sg_httpsse_subscribe(sse, req) == EALREADY);
+  ASSERT(sg_httpsse_count(sse) == 1);
+  MHD_destroy_response(req->res->handle);
+  req->res->handle = NULL;
+  ASSERT(sg_httpsse_count(sse) == 0);
+  ASSERT(!sse->subs);
+  sg_httpsse_free(sse);
+}
+
+static void test_httpsse_publish(struct sg_httpreq *req) {
+  struct sg_httpsse *sse = sg_httpsse_new(16, SG_HTTPSSE_DROP);
+  struct sg__httpsse_sub *sub;
+  char buf[16];
+  ASSERT(sg_httpsse_publish(NULL, NULL, "foo") == EINVAL);
+  ASSERT(sg_httpsse_publish(sse, "a\nb", "foo") == EINVAL);
+  ASSERT(sg_httpsse_publish(sse, NULL, NULL) == EINVAL);
+  ASSERT(sg_httpsse_publish(sse, NULL, "foo") == 0);
+
+  ASSERT(sg_httpsse_subscribe(sse, req) == 0);
+  sub = sse->subs;
+  ASSERT(sg_httpsse_publish(sse, NULL, "foo") == 0);
+  ASSERT(sub->used == strlen("data: foo\n\n"));
+  ASSERT(sg_httpsse_publish(sse, NULL, "bar") == 0);
+  ASSERT(sub->used == strlen("data: foo\n\n"));
+  ASSERT(sg__httpsse_read_cb(sub, 0, buf, 6) == 6);
+  ASSERT(memcmp(buf, "data: ", 6) == 0);
+  ASSERT(sg_httpsse_publish(sse, NULL, "bar") == 0);
+  ASSERT(sub->used == 16);
+  ASSERT(sub->head == 6);
+  ASSERT(sg__httpsse_read_cb(sub, 0, buf, sizeof(buf)) == 16);
+  ASSERT(memcmp(buf, "foo\n\ndata: bar\n\n", 16) == 0);
+  ASSERT(sub->used == 0);
+  ASSERT(sg_httpsse_count(sse) == 1);
+  MHD_destroy_response(req->res->handle);
+  req->res->handle = NULL;
+  sg_httpsse_free(sse);
+
+  sse = sg_httpsse_new(16, SG_HTTPSSE_DISCONNECT);
+  ASSERT(sg_httpsse_subscribe(sse, req) == 0);
+  sub = sse->subs;
+  ASSERT(sg_httpsse_publish(sse, NULL, "foo") == 0);
+  ASSERT(!sub->closed);
+  ASSERT(sg_httpsse_publish(sse, NULL, "bar") == 0);
+  ASSERT(sub->closed);
+  ASSERT(sg__httpsse_read_cb(sub, 0, buf, sizeof(buf)) ==
+         MHD_CONTENT_READER_END_WITH_ERROR);
+  MHD_destroy_response(req->res->handle);
+  req->res->handle = NULL;
+  sg_httpsse_free(sse);
+}
+
+static void test_httpsse_send(struct sg_httpreq *req) {
+  struct sg_httpsse *sse = sg_httpsse_new(16, SG_HTTPSSE_DROP);
+  struct sg__httpsse_sub *sub;
+  char buf[16];
+  ASSERT(sg_httpsse_send(NULL, "foo", 3) == EINVAL);
+  ASSERT(sg_httpsse_send(sse, NULL, 3) == EINVAL);
+  ASSERT(sg_httpsse_send(sse, "foo", 0) == EINVAL);
+
+  ASSERT(sg_httpsse_subscribe(sse, req) == 0);
+  sub = sse->subs;
+  ASSERT(sg_httpsse_send(sse, "retry: 1000\n\n", 13) == 0);
+  ASSERT(sg_httpsse_send(sse, "foo", 3) == 0);
+  ASSERT(sg_httpsse_send(sse, "bar", 3) == 0);
+  ASSERT(sub->used == 16);
+  ASSERT(sg__httpsse_read_cb(sub, 0, buf, sizeof(buf)) == 16);
+  ASSERT(memcmp(buf, "retry: 1000\n\nfoo", 16) == 0);
+
+  ASSERT(sg_httpsse_send(sse, "foo", 3) == 0);
+  sg_httpsse_free(sse);
+  ASSERT(sub->closed);
+  ASSERT(sg__httpsse_read_cb(sub, 0, buf, sizeof(buf)) == 3);
+  ASSERT(sg__httpsse_read_cb(sub, 0, buf, sizeof(buf)) ==
+         MHD_CONTENT_READER_END_OF_STREAM);
+  MHD_destroy_response(req->res->handle);
+  req->res->handle = NULL;
+}
+
+static void test_httpsse_count(void) {
+  errno = 0;
+  ASSERT(sg_httpsse_count(NULL) == 0);
+  ASSERT(errno == EINVAL);
+}
+
+int main(void) {
+  struct sg_httpsrv *srv = sg_httpsrv_new(dummy_httpreq_cb, NULL);
+  struct MHD_Connection *con = sg_alloc(256);
+  struct sg_httpreq *req = sg__httpreq_new(srv, con, NULL, NULL, NULL);
+  test__httpsse_format();
+  test_httpsse_new();
+  test_httpsse_free();
+  test_httpsse_subscribe(req);
+  test_httpsse_publish(req);
+  test_httpsse_send(req);
+  test_httpsse_count();
+  sg__httpreq_free(req);
+  sg_httpsrv_free(srv);
+  sg_free(con);
+  return EXIT_SUCCESS;
+}
@@ -200,9 +200,148 @@ static void test__httpuplds_iter(struct MHD_Connection *con) {
   sg_httpsrv_free(srv);
 }
 
+static void test__httpuplds_digest(struct MHD_Connection *con) {
+  char err[256];
+  struct sg_httpsrv *srv =
+    sg_httpsrv_new2(NULL, dummy_httpreq_cb, dummy_err_cb, err);
+  struct sg_httpreq *req = sg__httpreq_new(srv, con, "", "", "");
+  struct sg__httpupld_holder holder = {srv, req};
+
+  ASSERT(sg__httpuplds_iter(&holder, MHD_POSTDATA_KIND, "foo", "foo.txt", NULL,
+                            NULL, "abc", 0, 3) == MHD_YES);
+  ASSERT(!req->curr_upld->digest);
+  errno = 0;
+  ASSERT(!sg_httpupld_digest(req->curr_upld, SG_DIGEST_SHA256));
+  ASSERT(errno == ENOTSUP);
+
+  ASSERT(sg_httpsrv_set_upld_digests(srv, SG_DIGEST_SHA256) == 0);
+  ASSERT(sg__httpuplds_iter(&holder, MHD_POSTDATA_KIND, "bar", "bar.txt", NULL,
+                            NULL, "a", 0, 1) == MHD_YES);
+  ASSERT(sg__httpuplds_iter(&holder, MHD_POSTDATA_KIND, "bar", "bar.txt", NULL,
+                            NULL, "bc", 1, 2) == MHD_YES);
+  ASSERT(strcmp(sg_httpupld_digest(req->curr_upld, SG_DIGEST_SHA256),
+                "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad") ==
+         0);
+  errno = 0;
+  ASSERT(!sg_httpupld_digest(req->curr_upld, SG_DIGEST_CRC32C));
+  ASSERT(errno == ENOTSUP);
+
+  sg__httpuplds_cleanup(srv, req);
+  sg__httpreq_free(req);
+  sg_httpsrv_free(srv);
+}
+
+static void test__httpuplds_form(struct MHD_Connection *con) {
+  static const char *body = "--XyZ\r\n"
+                            "Content-Disposition: form-data; name=\"a\"\r\n"
+                            "\r\n"
+                            "foo\r\n"
+                            "--XyZ\r\n"
+                            "Content-Disposition: form-data; name=\"f\"; "
+                            "filename=\"f.txt\"\r\n"
+                            "Content-Type: text/plain\r\n"
+                            "\r\n"
+                            "bar\r\n--X\r\n"
+                            "--XyZ--\r\n";
+  char err[256];
+  struct sg_httpsrv *srv =
+    sg_httpsrv_new2(NULL, dummy_httpreq_cb, dummy_err_cb, err);
+  struct sg_httpreq *req = sg__httpreq_new(srv, con, "", "", "");
+  struct sg__httpupld_holder holder = {srv, req};
+  struct sg_strmap **fields = sg_httpreq_fields(req);
+  size_t i, len = strlen(body);
+
+  req->form = sg__httpform_new("multipart/form-data; boundary=XyZ",
+                               srv->post_buf_size, sg__httpuplds_iter);
+  ASSERT(req->form);
+  for (i = 0; i < len; i += 7)
+    ASSERT(sg__httpform_parse(req->form, &holder, body + i,
+                              len - i < 7 ? len - i : 7) == 0);
+  ASSERT(strcmp(sg_strmap_get(*fields, "a"), "foo") == 0);
+  ASSERT(sg_httpuplds_count(req->uplds) == 1);
+  ASSERT(strcmp(sg_httpupld_field(req->curr_upld), "f") == 0);
+  ASSERT(strcmp(sg_httpupld_name(req->curr_upld), "f.txt") == 0);
+  ASSERT(strcmp(sg_httpupld_mime(req->curr_upld), "text/plain") == 0);
+  ASSERT(sg_httpupld_size(req->curr_upld) == 8);
+  ASSERT(memcmp(sg_httpupld_data(req->curr_upld), "bar\r\n--X", 8) == 0);
+  sg__httpform_free(req->form);
+
+  req->form = sg__httpform_new("application/x-www-form-urlencoded",
+                               srv->post_buf_size, sg__httpuplds_iter);
+  ASSERT(req->form);
+  ASSERT(sg__httpform_parse(req->form, &holder, "b=1+2&c=%41", 11) == 0);
+  ASSERT(strcmp(sg_strmap_get(*fields, "b"), "1 2") == 0);
+  ASSERT(strcmp(sg_strmap_get(*fields, "c"), "A") == 0);
+
+  sg__httpuplds_cleanup(srv, req);
+  sg__httpreq_free(req);
+  sg_httpsrv_free(srv);
+}
+
+static ssize_t dummy_httpreq_body_cb(void *cls, struct sg_httpreq *req,
+                                     const char *buf, size_t size) {
+  struct sg_str *str = cls;
+  (void) req;
+  if (strncmp(buf, "err", size) == 0)
+    return -1;
+  /* consumes at most two bytes per call */
+  if (size > 2)
+    size = 2;
+  sg_str_write(str, buf, size);
+  return (ssize_t) size;
+}
+
+static void test__httpuplds_sink(struct MHD_Connection *con) {
+  struct sg_httpsrv *srv = sg_httpsrv_new(dummy_httpreq_cb, NULL);
+  struct sg_httpreq *req = sg__httpreq_new(srv, con, "", "", "");
+  struct sg_str *str = sg_str_new();
+  int ret = MHD_NO;
+  size_t size;
+
+  ASSERT(sg_httpsrv_set_payld_limit(srv, 1) == 0);
+  ASSERT(sg_httpreq_set_body_cb(req, dummy_httpreq_body_cb, str) == 0);
+  size = 2;
+  ASSERT(sg__httpuplds_process(srv, req, con, "ab", &size, &ret));
+  ASSERT(ret == MHD_YES);
+  ASSERT(size == 0);
+  ASSERT(!req->body_paused);
+  ASSERT(sg_str_length(req->payload) == 0);
+
+  req->body_resumed = true;
+  size = 3;
+  ret = MHD_NO;
+  ASSERT(sg__httpuplds_process(srv, req, con, "cde", &size, &ret));
+  ASSERT(ret == MHD_YES);
+  ASSERT(size == 1);
+  ASSERT(!req->body_paused);
+  ASSERT(!req->body_resumed);
+  ASSERT(strcmp(sg_str_content(str), "abcd") == 0);
+
+  /* a resume while the body is neither paused nor being sunk is ignored */
+  ASSERT(sg_httpreq_resume_body(req) == 0);
+  ASSERT(!req->body_resumed);
+  size = 3;
+  ASSERT(sg__httpuplds_process(srv, req, con, "fgh", &size, &ret));
+  ASSERT(ret == MHD_YES);
+  ASSERT(size == 1);
+  ASSERT(req->body_paused);
+  ASSERT(sg_httpreq_resume_body(req) == 0);
+  ASSERT(!req->body_paused);
+  ASSERT(!req->body_resumed);
+  ASSERT(strcmp(sg_str_content(str), "abcdfg") == 0);
+
+  size = 3;
+  ASSERT(sg__httpuplds_process(srv, req, con, "err", &size, &ret));
+  ASSERT(ret == MHD_NO);
+
+  sg_str_free(str);
+  sg__httpreq_free(req);
+  sg_httpsrv_free(srv);
+}
+
 static void test__httpuplds_process(struct MHD_Connection *con) {
   const size_t len = 3;
-  char err[256], str[256];
+  char err[256], str[256], *big;
   struct sg_httpsrv *srv =
     sg_httpsrv_new2(NULL, dummy_httpreq_cb, dummy_err_cb, err);
   struct sg_httpreq *req = sg__httpreq_new(srv, con, "", "", "");
@@ -221,16 +360,296 @@ static void test__httpuplds_process(struct MHD_Connection *con) {
   snprintf(str, sizeof(str), _("Payload too large.\n"));
   ASSERT(strcmp(err, str) == 0);
 
-  ASSERT(sg_httpsrv_set_payld_limit(srv, len) == 0);
+  ASSERT(sg_httpsrv_set_payld_limit(srv, len * 2) == 0);
   ret = MHD_NO;
   ASSERT(sg__httpuplds_process(srv, req, con, "foo", &size, &ret));
   ASSERT(ret == MHD_YES);
+  ASSERT(size == 0);
+  size = len;
+  ASSERT(sg__httpuplds_process(srv, req, con, "bar", &size, &ret));
+  ASSERT(ret == MHD_YES);
+  ASSERT(!req->chunks);
+  ASSERT(!sg__httpuplds_process(srv, req, con, NULL, &size, &ret));
+  ASSERT(strcmp(sg_str_content(req->payload), "foobar") == 0);
+
+  ASSERT(sg_httpsrv_set_payld_limit(srv, 0) == 0);
+  big = sg_malloc(SG__HTTPUPLDS_RESERVE_MAX);
+  ASSERT(big);
+  memset(big, 'a', SG__HTTPUPLDS_RESERVE_MAX);
+  sg_str_clear(req->payload);
+  size = SG__HTTPUPLDS_RESERVE_MAX;
+  ASSERT(sg__httpuplds_process(srv, req, con, big, &size, &ret));
+  ASSERT(ret == MHD_YES);
+  ASSERT(!req->chunks);
+  size = len;
+  ASSERT(sg__httpuplds_process(srv, req, con, "bar", &size, &ret));
+  ASSERT(ret == MHD_YES);
+  ASSERT(sg_str_length(req->payload) == SG__HTTPUPLDS_RESERVE_MAX);
+  ASSERT(sg_rope_length(req->chunks) == len);
+  ASSERT(!sg__httpuplds_process(srv, req, con, NULL, &size, &ret));
+  ASSERT(!req->chunks);
+  ASSERT(sg_str_length(req->payload) == SG__HTTPUPLDS_RESERVE_MAX + len);
+  ASSERT(memcmp(sg_str_content(req->payload), big,
+                SG__HTTPUPLDS_RESERVE_MAX) == 0);
+  ASSERT(strcmp(sg_str_content(req->payload) + SG__HTTPUPLDS_RESERVE_MAX,
+                "bar") == 0);
+  sg_free(big);
+
+  sg_str_clear(req->payload);
+  req->sized = true;
+  size = len;
+  ASSERT(sg__httpuplds_process(srv, req, con, "foo", &size, &ret));
+  ASSERT(ret == MHD_YES);
+  ASSERT(!req->chunks);
+  ASSERT(strcmp(sg_str_content(req->payload), "foo") == 0);
+  ASSERT(!sg__httpuplds_process(srv, req, con, NULL, &size, &ret));
   ASSERT(strcmp(sg_str_content(req->payload), "foo") == 0);
 
   sg__httpreq_free(req);
   sg_httpsrv_free(srv);
 }
 
+static void test__httpuplds_begin(struct MHD_Connection *con) {
+  struct sg_httpsrv *srv = sg_httpsrv_new(dummy_httpreq_cb, NULL);
+  struct sg_httpreq *req = sg__httpreq_new(srv, con, "", "", "");
+
+  ASSERT(sg_httpsrv_set_payld_limit(srv, 1000) == 0);
+  ASSERT(sg__httpuplds_begin(srv, req, NULL, NULL, NULL));
+  ASSERT(!req->sized);
+  ASSERT(sg__httpuplds_begin(srv, req, "text/plain", "abc", NULL));
+  ASSERT(!req->sized);
+  ASSERT(sg__httpuplds_begin(srv, req, "text/plain", "10abc", NULL));
+  ASSERT(!req->sized);
+  ASSERT(sg__httpuplds_begin(srv, req, "text/plain", "-1", NULL));
+  ASSERT(!req->sized);
+  ASSERT(sg__httpuplds_begin(srv, req, "Multipart/Form-Data; boundary=abc",
+                             "2000", NULL));
+  ASSERT(!req->sized);
+  ASSERT(sg__httpuplds_begin(srv, req, "application/x-www-form-urlencoded",
+                             "2000", NULL));
+  ASSERT(!req->sized);
+  ASSERT(!req->res->handle);
+
+  ASSERT(sg__httpuplds_begin(srv, req, "application/json", "100", NULL));
+  ASSERT(req->sized);
+  ASSERT(req->payload->n == 101);
+  ASSERT(sg_str_length(req->payload) == 0);
+
+  req->sized = false;
+  ASSERT(sg__httpuplds_begin(srv, req, NULL, "0", NULL));
+  ASSERT(req->sized);
+
+  req->sized = false;
+  ASSERT(!sg__httpuplds_begin(srv, req, "application/json", "1001", NULL));
+  ASSERT(req->sized);
+  ASSERT(req->res->handle);
+  ASSERT(req->res->status == 413);
+  MHD_destroy_response(req->res->handle);
+  req->res->handle = NULL;
+
+  ASSERT(sg_httpsrv_set_payld_limit(srv, 0) == 0);
+  ASSERT(sg__httpuplds_begin(srv, req, "application/json", "100000000", NULL));
+  ASSERT(req->payload->n == SG__HTTPUPLDS_RESERVE_MAX + 1);
+  sg__httpreq_free(req);
+
+  req = sg__httpreq_new(srv, con, "", "", "");
+  ASSERT(sg_httpsrv_set_payld_limit(srv, 10) == 0);
+  req->body_cb = dummy_httpreq_body_cb;
+  ASSERT(sg__httpuplds_begin(srv, req, "application/json", "1000", NULL));
+  ASSERT(!req->sized);
+  ASSERT(!req->res->handle);
+
+  sg__httpreq_free(req);
+  sg_httpsrv_free(srv);
+}
+
+#ifdef SG_HTTP_COMPRESSION
+
+static size_t zpack(int bits, const void *src, size_t size, void *dest,
+                    size_t dest_size) {
+  z_stream stream;
+  size_t len;
+  memset(&stream, 0, sizeof(z_stream));
+  ASSERT(deflateInit2(&stream, 9, Z_DEFLATED, bits, 8, Z_DEFAULT_STRATEGY) ==
+         Z_OK);
+  stream.next_in = (z_const Bytef *) src;
+  stream.avail_in = (uInt) size;
+  stream.next_out = dest;
+  stream.avail_out = (uInt) dest_size;
+  ASSERT(deflate(&stream, Z_FINISH) == Z_STREAM_END);
+  len = stream.total_out;
+  deflateEnd(&stream);
+  return len;
+}
+
+/* Feeds `size` bytes of body in pieces of `chunk` bytes. */
+static int zprocess(struct sg_httpsrv *srv, struct sg_httpreq *req,
+                    struct MHD_Connection *con, const Bytef *data, size_t size,
+                    size_t chunk) {
+  size_t len;
+  int ret = MHD_YES;
+  while ((size > 0) && (ret == MHD_YES)) {
+    len = size < chunk ? size : chunk;
+    ASSERT(sg__httpuplds_process(srv, req, con, (const char *) data, &len,
+                                 &ret));
+    data += chunk;
+    size -= size < chunk ? size : chunk;
+  }
+  return ret;
+}
+
+static void test__httpuplds_inflate(struct MHD_Connection *con) {
+  const char *text = "Hello, compressed world! Hello, compressed world!";
+  char err[256], str[256];
+  struct sg_httpsrv *srv =
+    sg_httpsrv_new2(NULL, dummy_httpreq_cb, dummy_err_cb, err);
+  struct sg_httpreq *req;
+  struct sg_strmap **fields;
+  Bytef zbuf[4096];
+  char *zeros;
+  size_t len, size;
+  int ret;
+
+  req = sg__httpreq_new(srv, con, "", "", "");
+  ASSERT(sg__httpuplds_begin(srv, req, NULL, NULL, NULL));
+  ASSERT(req->zbits == 0);
+  ASSERT(sg__httpuplds_begin(srv, req, NULL, NULL, " identity "));
+  ASSERT(req->zbits == 0);
+  ASSERT(sg__httpuplds_begin(srv, req, NULL, NULL, "gzip"));
+  ASSERT(req->zbits == 15 + 16);
+  ASSERT(sg__httpuplds_begin(srv, req, NULL, NULL, " X-Gzip "));
+  ASSERT(req->zbits == 15 + 16);
+  ASSERT(sg__httpuplds_begin(srv, req, NULL, NULL, "Deflate"));
+  ASSERT(req->zbits == 15);
+  ASSERT(!req->res->handle);
+  ASSERT(!sg__httpuplds_begin(srv, req, NULL, NULL, "gzip, br"));
+  ASSERT(req->res->status == 415);
+  MHD_destroy_response(req->res->handle);
+  req->res->handle = NULL;
+  ASSERT(!sg__httpuplds_begin(srv, req, NULL, NULL, "gzi"));
+  ASSERT(req->res->status == 415);
+  sg__httpreq_free(req);
+
+  /* gzip, zlib and bare deflate streams, in small pieces */
+  req = sg__httpreq_new(srv, con, "", "", "");
+  ASSERT(sg__httpuplds_begin(srv, req, NULL, NULL, "gzip"));
+  len = zpack(15 + 16, text, strlen(text), zbuf, sizeof(zbuf));
+  ASSERT(zprocess(srv, req, con, zbuf, len, 5) == MHD_YES);
+  size = 0;
+  ASSERT(!sg__httpuplds_process(srv, req, con, NULL, &size, &ret));
+  ASSERT(strcmp(sg_str_content(req->payload), text) == 0);
+  sg__httpreq_free(req);
+  req = sg__httpreq_new(srv, con, "", "", "");
+  ASSERT(sg__httpuplds_begin(srv, req, NULL, NULL, "deflate"));
+  len = zpack(15, text, strlen(text), zbuf, sizeof(zbuf));
+  ASSERT(zprocess(srv, req, con, zbuf, len, 1) == MHD_YES);
+  ASSERT(!sg__httpuplds_process(srv, req, con, NULL, &size, &ret));
+  ASSERT(strcmp(sg_str_content(req->payload), text) == 0);
+  sg__httpreq_free(req);
+  req = sg__httpreq_new(srv, con, "", "", "");
+  ASSERT(sg__httpuplds_begin(srv, req, NULL, NULL, "deflate"));
+  len = zpack(-15, text, strlen(text), zbuf, sizeof(zbuf));
+  ASSERT(zprocess(srv, req, con, zbuf, len, len) == MHD_YES);
+  ASSERT(!sg__httpuplds_process(srv, req, con, NULL, &size, &ret));
+  ASSERT(strcmp(sg_str_content(req->payload), text) == 0);
+  ASSERT(req->zbody->raw);
+  sg__httpreq_free(req);
+  req = sg__httpreq_new(srv, con, "", "", "");
+  ASSERT(sg__httpuplds_begin(srv, req, NULL, NULL, "deflate"));
+  ASSERT(zprocess(srv, req, con, zbuf, len, 1) == MHD_YES);
+  ASSERT(!sg__httpuplds_process(srv, req, con, NULL, &size, &ret));
+  ASSERT(strcmp(sg_str_content(req->payload), text) == 0);
+  ASSERT(req->zbody->raw);
+  sg__httpreq_free(req);
+
+  /* gzip members in a row */
+  req = sg__httpreq_new(srv, con, "", "", "");
+  ASSERT(sg__httpuplds_begin(srv, req, NULL, NULL, "gzip"));
+  len = zpack(15 + 16, "foo", 3, zbuf, sizeof(zbuf));
+  len += zpack(15 + 16, "bar", 3, zbuf + len, sizeof(zbuf) - len);
+  ASSERT(zprocess(srv, req, con, zbuf, len, len) == MHD_YES);
+  ASSERT(!sg__httpuplds_process(srv, req, con, NULL, &size, &ret));
+  ASSERT(strcmp(sg_str_content(req->payload), "foobar") == 0);
+  sg__httpreq_free(req);
+  /* split at the end of the first member */
+  req = sg__httpreq_new(srv, con, "", "", "");
+  ASSERT(sg__httpuplds_begin(srv, req, NULL, NULL, "gzip"));
+  size = zpack(15 + 16, "foo", 3, zbuf, sizeof(zbuf));
+  ASSERT(zprocess(srv, req, con, zbuf, len, size) == MHD_YES);
+  size = 0;
+  ASSERT(!sg__httpuplds_process(srv, req, con, NULL, &size, &ret));
+  ASSERT(strcmp(sg_str_content(req->payload), "foobar") == 0);
+  sg__httpreq_free(req);
+  /* truncated second member */
+  req = sg__httpreq_new(srv, con, "", "", "");
+  ASSERT(sg__httpuplds_begin(srv, req, NULL, NULL, "gzip"));
+  ASSERT(zprocess(srv, req, con, zbuf, len - 2, len) == MHD_YES);
+  ret = MHD_YES;
+  ASSERT(sg__httpuplds_process(srv, req, con, NULL, &size, &ret));
+  ASSERT(ret == MHD_NO);
+  sg__httpreq_free(req);
+
+  /* bomb */
+  zeros = sg_alloc(1048576);
+  ASSERT(zeros);
+  len = zpack(15 + 16, zeros, 1048576, zbuf, sizeof(zbuf));
+  sg_free(zeros);
+  ASSERT(len < 2048);
+  ASSERT(sg_httpsrv_set_payld_limit(srv, 100000) == 0);
+  req = sg__httpreq_new(srv, con, "", "", "");
+  ASSERT(sg__httpuplds_begin(srv, req, NULL, NULL, "gzip"));
+  memset(err, 0, sizeof(err));
+  ASSERT(zprocess(srv, req, con, zbuf, len, len) == MHD_NO);
+  ASSERT(req->zbody->size <= 100000 + SG__HTTPUPLDS_ZBUF_SIZE);
+  memset(str, 0, sizeof(str));
+  snprintf(str, sizeof(str), _("Payload too large.\n"));
+  ASSERT(strcmp(err, str) == 0);
+  sg__httpreq_free(req);
+
+  /* corrupted */
+  req = sg__httpreq_new(srv, con, "", "", "");
+  ASSERT(sg__httpuplds_begin(srv, req, NULL, NULL, "gzip"));
+  len = zpack(15 + 16, text, strlen(text), zbuf, sizeof(zbuf));
+  memset(zbuf + 10, 0xff, 8);
+  memset(err, 0, sizeof(err));
+  ASSERT(zprocess(srv, req, con, zbuf, len, len) == MHD_NO);
+  memset(str, 0, sizeof(str));
+  snprintf(str, sizeof(str), _("Invalid compressed payload.\n"));
+  ASSERT(strcmp(err, str) == 0);
+  sg__httpreq_free(req);
+
+  /* truncated */
+  req = sg__httpreq_new(srv, con, "", "", "");
+  ASSERT(sg__httpuplds_begin(srv, req, NULL, NULL, "gzip"));
+  len = zpack(15 + 16, text, strlen(text), zbuf, sizeof(zbuf));
+  ASSERT(zprocess(srv, req, con, zbuf, len - 4, 7) == MHD_YES);
+  memset(err, 0, sizeof(err));
+  ret = MHD_YES;
+  ASSERT(sg__httpuplds_process(srv, req, con, NULL, &size, &ret));
+  ASSERT(ret == MHD_NO);
+  memset(str, 0, sizeof(str));
+  snprintf(str, sizeof(str), _("Incomplete compressed payload.\n"));
+  ASSERT(strcmp(err, str) == 0);
+  sg__httpreq_free(req);
+
+  /* form */
+  req = sg__httpreq_new(srv, con, "", "", "");
+  ASSERT(sg__httpuplds_begin(srv, req, NULL, NULL, "gzip"));
+  req->form = sg__httpform_new("application/x-www-form-urlencoded",
+                               srv->post_buf_size, sg__httpuplds_iter);
+  len = zpack(15 + 16, "a=1&b=x+y", 9, zbuf, sizeof(zbuf));
+  ASSERT(zprocess(srv, req, con, zbuf, len, 3) == MHD_YES);
+  fields = sg_httpreq_fields(req);
+  ASSERT(strcmp(sg_strmap_get(*fields, "a"), "1") == 0);
+  ASSERT(strcmp(sg_strmap_get(*fields, "b"), "x y") == 0);
+  sg__httpuplds_cleanup(srv, req);
+  sg__httpreq_free(req);
+
+  sg_httpsrv_free(srv);
+}
+
+#endif /* SG_HTTP_COMPRESSION */
+
 static void test__httpuplds_cleanup(struct MHD_Connection *con) {
   struct sg_httpsrv *srv = sg_httpsrv_new(dummy_httpreq_cb, NULL);
   struct sg_httpreq *req = sg__httpreq_new(srv, con, "", "", "");
@@ -271,6 +690,7 @@ static void test__httpupld_cb(void) {
   int fd;
   memset(err, 0, sizeof(err));
   srv = sg_httpsrv_new2(NULL, dummy_httpreq_cb, dummy_err_cb, err);
+  ASSERT(sg_httpsrv_set_upld_mem_limit(srv, 0) == 0);
 
   ASSERT(sg__httpupld_cb(srv, &handle, "", "", "", "", "") == ENOENT);
   ASSERT(!handle);
@@ -311,8 +731,14 @@ static void test__httpupld_cb(void) {
   ASSERT(sg__httpupld_cb(srv, &handle, dir, "foo", "foo.txt", "", "") == 0);
   sg_free(dir);
   h = handle;
-  ASSERT(access(h->path, F_OK) == 0);
+#ifdef SG__HTTPUPLD_TMPFILE
+  if (srv->uplds_tmpfile)
+    ASSERT(!h->path);
+  else
+#endif /* SG__HTTPUPLD_TMPFILE */
+    ASSERT(access(h->path, F_OK) == 0);
   ASSERT(sg__httpupld_write_cb(handle, 0, "foo", len) == len);
+  ASSERT(h->size == (uint64_t) len);
   ASSERT(sg__httpupld_save_cb(handle, true) == 0);
   sg__httpupld_free_cb(handle);
   ASSERT(access(dest_path, F_OK) == 0);
@@ -327,6 +753,170 @@ static void test__httpupld_cb(void) {
   sg_httpsrv_free(srv);
 }
 
+static void test__httpupld_reserve(void) {
+  const ssize_t len = 3;
+  char err[256], *dir, *dest_path;
+  struct sg_httpsrv *srv;
+  struct sg__httpupld *h;
+  struct stat sbuf;
+  void *handle = NULL;
+  memset(err, 0, sizeof(err));
+  srv = sg_httpsrv_new2(NULL, dummy_httpreq_cb, dummy_err_cb, err);
+  ASSERT(sg_httpsrv_set_upld_mem_limit(srv, 0) == 0);
+  ASSERT(sg_httpsrv_set_upld_sync(srv, SG_HTTPUPLD_SYNC_FULL) == 0);
+  dir = sg_tmpdir();
+  dest_path = sg__strjoin(PATH_SEP, dir, "bar.txt");
+  unlink(dest_path);
+  ASSERT(sg__httpupld_cb(srv, &handle, dir, "bar", "bar.txt", "", "") == 0);
+  h = handle;
+  sg__httpupld_reserve(handle, SG__HTTPUPLD_RESERVE_MIN - 1);
+  ASSERT(h->reserved == 0);
+  sg__httpupld_reserve(handle, SG__HTTPUPLD_RESERVE_MIN);
+#ifdef __linux__
+  if (h->reserved != UINT64_MAX) {
+    ASSERT(h->reserved ==
+           SG__HTTPUPLD_RESERVE_MIN + SG__HTTPUPLD_RESERVE_STEP);
+    ASSERT(fstat(h->fd, &sbuf) == 0);
+    ASSERT(sbuf.st_size ==
+           SG__HTTPUPLD_RESERVE_MIN + SG__HTTPUPLD_RESERVE_STEP);
+    sg__httpupld_reserve(handle, SG__HTTPUPLD_RESERVE_STEP);
+    ASSERT(h->reserved ==
+           SG__HTTPUPLD_RESERVE_MIN + SG__HTTPUPLD_RESERVE_STEP);
+    sg__httpupld_reserve(handle, SG__HTTPUPLD_RESERVE_STEP * 2);
+    ASSERT(h->reserved == SG__HTTPUPLD_RESERVE_STEP * 3);
+  }
+  ASSERT(sg_httpsrv_set_uplds_limit(srv, SG__HTTPUPLD_RESERVE_STEP * 4) ==
+         0);
+  sg__httpupld_reserve(handle, SG__HTTPUPLD_RESERVE_STEP * 3 + 1);
+  if (h->reserved != UINT64_MAX)
+    ASSERT(h->reserved == SG__HTTPUPLD_RESERVE_STEP * 4);
+#endif /* __linux__ */
+  ASSERT(sg__httpupld_write_cb(handle, 0, "bar", len) == len);
+  sg__httpupld_trim(handle);
+  ASSERT(h->reserved == 0);
+  ASSERT(fstat(h->fd, &sbuf) == 0);
+  ASSERT(sbuf.st_size == len);
+  ASSERT(sg__httpupld_save_cb(handle, false) == 0);
+  ASSERT(stat(dest_path, &sbuf) == 0);
+  ASSERT(sbuf.st_size == len);
+  sg__httpupld_free_cb(handle);
+
+  /* existing destination */
+  handle = NULL;
+  ASSERT(sg__httpupld_cb(srv, &handle, dir, "bar", "bar.txt", "", "") == 0);
+  ASSERT(sg__httpupld_write_cb(handle, 0, "ba", len - 1) == len - 1);
+  ASSERT(sg__httpupld_save_cb(handle, false) == EEXIST);
+  sg__httpupld_free_cb(handle);
+  handle = NULL;
+  ASSERT(sg__httpupld_cb(srv, &handle, dir, "bar", "bar.txt", "", "") == 0);
+  ASSERT(sg__httpupld_write_cb(handle, 0, "ba", len - 1) == len - 1);
+  ASSERT(sg__httpupld_save_cb(handle, true) == 0);
+  sg__httpupld_free_cb(handle);
+  ASSERT(stat(dest_path, &sbuf) == 0);
+  ASSERT(sbuf.st_size == len - 1);
+  handle = NULL;
+  ASSERT(sg__httpupld_cb(srv, &handle, dir, "bar", "bar.txt", "", "") == 0);
+  ASSERT(sg__httpupld_save_as_cb(handle, dir, true) == EISDIR);
+  sg__httpupld_free_cb(handle);
+
+  unlink(dest_path);
+  sg_free(dest_path);
+  sg_free(dir);
+  sg_httpsrv_free(srv);
+}
+
+static void test__httpupld_mem(void) {
+  const char *data;
+  char err[256], str[16], *dir, *dest_path;
+  struct sg_httpsrv *srv;
+  struct sg__httpupld *h;
+  struct stat sbuf;
+  void *handle = NULL;
+  int fd;
+  memset(err, 0, sizeof(err));
+  srv = sg_httpsrv_new2(NULL, dummy_httpreq_cb, dummy_err_cb, err);
+  ASSERT(sg_httpsrv_set_upld_mem_limit(srv, 8) == 0);
+  /* the directory of an upload kept in memory is checked when it spills */
+  ASSERT(sg__httpupld_cb(srv, &handle, "", "", "", "", "") == 0);
+  ASSERT(((struct sg__httpupld *) handle)->in_mem);
+  errno = 0;
+  ASSERT(sg__httpupld_write_cb(handle, 0, "abcdefghi", 9) == -1);
+  ASSERT(errno == ENOENT);
+  sg__httpupld_free_cb(handle);
+  handle = NULL;
+  dir = sg_tmpdir();
+  dest_path = sg__strjoin(PATH_SEP, dir, "bar.txt");
+  unlink(dest_path);
+
+  ASSERT(sg__httpupld_cb(srv, &handle, dir, "bar", "bar.txt", "", "") == 0);
+  h = handle;
+  ASSERT(h->in_mem);
+  ASSERT(h->fd == -1);
+  ASSERT(!h->path);
+  data = sg__httpupld_data(handle);
+  ASSERT(data && (strcmp(data, "") == 0));
+  sg__httpupld_reserve(handle, 1048576);
+  ASSERT(h->reserved == 0);
+  ASSERT(sg__httpupld_write_cb(handle, 0, "abcd", 4) == 4);
+  ASSERT(sg__httpupld_write_cb(handle, 0, "efgh", 4) == 4);
+  ASSERT(h->in_mem);
+  ASSERT(h->size == 8);
+  data = sg__httpupld_data(handle);
+  ASSERT(data && (memcmp(data, "abcdefgh", 8) == 0));
+  ASSERT(sg__httpupld_save_as_cb(handle, dir, false) == EISDIR);
+  ASSERT(sg__httpupld_save_cb(handle, false) == 0);
+  ASSERT(sg__httpupld_save_cb(handle, false) == EINVAL);
+  ASSERT(sg__httpupld_save_cb(handle, true) == EINVAL);
+  /* the content outlives the save */
+  ASSERT(sg__httpupld_data(handle) == data);
+  sg__httpupld_free_cb(handle);
+  fd = open(dest_path, O_RDONLY);
+  ASSERT(fd > -1);
+  ASSERT(fstat(fd, &sbuf) == 0);
+  ASSERT(sbuf.st_size == 8);
+  memset(str, 0, sizeof(str));
+  ASSERT(read(fd, str, sizeof(str)) == 8);
+  ASSERT(close(fd) == 0);
+  ASSERT(strcmp(str, "abcdefgh") == 0);
+  unlink(dest_path);
+
+  /* spilled to disk */
+  handle = NULL;
+  ASSERT(sg__httpupld_cb(srv, &handle, dir, "bar", "bar.txt", "", "") == 0);
+  h = handle;
+  ASSERT(sg__httpupld_write_cb(handle, 0, "abcdef", 6) == 6);
+  ASSERT(sg__httpupld_write_cb(handle, 0, "ghi", 3) == 3);
+  ASSERT(!h->in_mem);
+  ASSERT(!h->mem);
+  ASSERT(!h->dir);
+  ASSERT(h->fd != -1);
+  ASSERT(h->size == 9);
+  ASSERT(sg__httpupld_write_cb(handle, 0, "j", 1) == 1);
+  data = sg__httpupld_data(handle);
+  ASSERT(data && (memcmp(data, "abcdefghij", 10) == 0));
+  ASSERT(sg__httpupld_data(handle) == data);
+  ASSERT(sg__httpupld_save_cb(handle, false) == 0);
+  sg__httpupld_free_cb(handle);
+  ASSERT(stat(dest_path, &sbuf) == 0);
+  ASSERT(sbuf.st_size == 10);
+  unlink(dest_path);
+
+  /* data of a saved file */
+  handle = NULL;
+  ASSERT(sg__httpupld_cb(srv, &handle, dir, "bar", "bar.txt", "", "") == 0);
+  ASSERT(sg__httpupld_write_cb(handle, 0, "0123456789", 10) == 10);
+  ASSERT(sg__httpupld_save_cb(handle, false) == 0);
+  errno = 0;
+  ASSERT(!sg__httpupld_data(handle));
+  ASSERT(errno == EBADF);
+  sg__httpupld_free_cb(handle);
+  unlink(dest_path);
+
+  sg_free(dest_path);
+  sg_free(dir);
+  sg_httpsrv_free(srv);
+}
+
 static void test__httpupld_write_cb(void) {
   const ssize_t len = 3;
   char str[4];
@@ -660,6 +1250,40 @@ static void test_httpupld_size(struct sg_httpupld *upld) {
   ASSERT(sg_httpupld_size(upld) == 123);
 }
 
+static void test_httpupld_data(struct sg_httpupld *upld) {
+  struct sg__httpupld *h = sg_alloc(sizeof(struct sg__httpupld));
+  errno = 0;
+  ASSERT(!sg_httpupld_data(NULL));
+  ASSERT(errno == EINVAL);
+
+  upld->save_as_cb = dummy_httpuplds_save_as_cb;
+  errno = 0;
+  ASSERT(!sg_httpupld_data(upld));
+  ASSERT(errno == ENOTSUP);
+  h->fd = -1;
+  h->in_mem = true;
+  h->mem = sg__strdup("abc");
+  h->size = 3;
+  upld->handle = h;
+  upld->save_as_cb = sg__httpupld_save_as_cb;
+  ASSERT(memcmp(sg_httpupld_data(upld), "abc", 3) == 0);
+  upld->handle = NULL;
+  sg__httpupld_free_cb(h);
+}
+
+static void test_httpupld_digest(struct sg_httpupld *upld) {
+  errno = 0;
+  ASSERT(!sg_httpupld_digest(NULL, SG_DIGEST_SHA256));
+  ASSERT(errno == EINVAL);
+
+  errno = 0;
+  ASSERT(!sg_httpupld_digest(upld, (enum sg_digest) 3));
+  ASSERT(errno == EINVAL);
+  errno = 0;
+  ASSERT(!sg_httpupld_digest(upld, SG_DIGEST_CRC32C));
+  ASSERT(errno == ENOTSUP);
+}
+
 static void test_httpupld_save(struct sg_httpupld *upld) {
   ASSERT(sg_httpupld_save(NULL, false) == EINVAL);
 
@@ -681,9 +1305,18 @@ int main(void) {
   test__httpuplds_add(con);
   test__httpuplds_free();
   test__httpuplds_iter(con);
+  test__httpuplds_digest(con);
+  test__httpuplds_form(con);
   test__httpuplds_process(con);
+  test__httpuplds_begin(con);
+#ifdef SG_HTTP_COMPRESSION
+  test__httpuplds_inflate(con);
+#endif /* SG_HTTP_COMPRESSION */
+  test__httpuplds_sink(con);
   test__httpuplds_cleanup(con);
   test__httpupld_cb();
+  test__httpupld_reserve();
+  test__httpupld_mem();
   test__httpupld_write_cb();
   test__httpupld_free_cb();
   test__httpupld_save_cb();
@@ -698,6 +1331,8 @@ int main(void) {
   test_httpupld_mime(upld);
   test_httpupld_encoding(upld);
   test_httpupld_size(upld);
+  test_httpupld_data(upld);
+  test_httpupld_digest(upld);
   test_httpupld_save(upld);
   test_httpupld_save_as(upld);
   sg_free(upld);
@@ -0,0 +1,183 @@
+/*                         _
+ *   ___  __ _  __ _ _   _(_)
+ *  / __|/ _` |/ _` | | | | |
+ *  \__ \ (_| | (_| | |_| | |
+ *  |___/\__,_|\__, |\__,_|_|
+ *             |___/
+ *
+ * Cross-platform library which helps to develop web servers or frameworks.
+ *
+ * Copyright (C) 2016-2020 Silvio Clecio <silvioprog@gmail.com>
+ *
+ * Sagui library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * Sagui library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Sagui library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#define SG_EXTERN
+
+#include "sg_assert.h"
+
+#include <string.h>
+#include "sg_httpwrt.c"
+#include <sagui.h>
+
+static void dummy_drain_cb(void *cls, struct sg_httpwrt *wrt) {
+  (void) wrt;
+  (*(int *) cls)++;
+}
+
+static void test_httpwrt_new(struct sg_httpres *res) {
+  struct sg_httpwrt *wrt;
+  errno = 0;
+  ASSERT(!sg_httpwrt_new(NULL, 10, NULL, NULL, 200));
+  ASSERT(errno == EINVAL);
+  errno = 0;
+  ASSERT(!sg_httpwrt_new(res, 0, NULL, NULL, 200));
+  ASSERT(errno == EINVAL);
+  errno = 0;
+  ASSERT(!sg_httpwrt_new(res, 10, NULL, NULL, 99));
+  ASSERT(errno == EINVAL);
+  errno = 0;
+  ASSERT(!sg_httpwrt_new(res, 10, NULL, NULL, 600));
+  ASSERT(errno == EINVAL);
+
+  wrt = sg_httpwrt_new(res, 10, NULL, NULL, 201);
+  ASSERT(wrt);
+  ASSERT(res->handle);
+  ASSERT(res->status == 201);
+  ASSERT(wrt->con == res->con);
+  ASSERT(wrt->high_water == 10);
+  ASSERT(wrt->refs == 2);
+  errno = 0;
+  ASSERT(!sg_httpwrt_new(res, 10, NULL, NULL, 200));
+  ASSERT(errno == EALREADY);
+  ASSERT(sg_httpwrt_close(wrt) == 0);
+  MHD_destroy_response(res->handle);
+  res->handle = NULL;
+}
+
+static void test_httpwrt_write(struct sg_httpres *res) {
+  struct sg_httpwrt *wrt = sg_httpwrt_new(res, 6, NULL, NULL, 200);
+  char buf[16];
+  ASSERT(sg_httpwrt_write(NULL, "foo", 3) == EINVAL);
+  ASSERT(sg_httpwrt_write(wrt, NULL, 3) == EINVAL);
+  ASSERT(sg_httpwrt_write(wrt, "foo", 0) == EINVAL);
+
+  ASSERT(sg_httpwrt_write(wrt, "foo", 3) == 0);
+  ASSERT(sg_httpwrt_write(wrt, "bar", 3) == 0);
+  ASSERT(sg_httpwrt_buffered(wrt) == 6);
+  ASSERT(sg_httpwrt_write(wrt, "baz", 3) == EAGAIN);
+  ASSERT(wrt->blocked);
+  ASSERT(sg_httpwrt_buffered(wrt) == 6);
+  ASSERT(sg__httpwrt_read_cb(wrt, 0, buf, 4) == 4);
+  ASSERT(memcmp(buf, "foob", 4) == 0);
+  ASSERT(!wrt->blocked);
+  ASSERT(sg_httpwrt_write(wrt, "baz", 3) == 0);
+  ASSERT(sg_httpwrt_buffered(wrt) == 5);
+  ASSERT(sg__httpwrt_read_cb(wrt, 0, buf, sizeof(buf)) == 5);
+  ASSERT(memcmp(buf, "arbaz", 5) == 0);
+  ASSERT(wrt->head == 0);
+  ASSERT(wrt->size == 0);
+
+  ASSERT(sg_httpwrt_write(wrt, "foo", 3) == 0);
+  ASSERT(sg_httpwrt_close(wrt) == 0);
+  ASSERT(sg__httpwrt_read_cb(wrt, 0, buf, sizeof(buf)) == 3);
+  ASSERT(sg__httpwrt_read_cb(wrt, 0, buf, sizeof(buf)) ==
+         MHD_CONTENT_READER_END_OF_STREAM);
+  MHD_destroy_response(res->handle);
+  res->handle = NULL;
+}
+
+static void test_httpwrt_drain(struct sg_httpres *res) {
+  struct sg_httpwrt *wrt;
+  char buf[16];
+  int drained = 0;
+  wrt = sg_httpwrt_new(res, 3, dummy_drain_cb, &drained, 200);
+  ASSERT(sg_httpwrt_write(wrt, "foo", 3) == 0);
+  ASSERT(sg__httpwrt_read_cb(wrt, 0, buf, 1) == 1);
+  ASSERT(drained == 0);
+  ASSERT(sg_httpwrt_write(wrt, "bar", 3) == 0);
+  ASSERT(sg_httpwrt_write(wrt, "baz", 3) == EAGAIN);
+  ASSERT(sg__httpwrt_read_cb(wrt, 0, buf, 2) == 2);
+  ASSERT(drained == 0);
+  ASSERT(sg__httpwrt_read_cb(wrt, 0, buf, 1) == 1);
+  ASSERT(drained == 1);
+  ASSERT(sg_httpwrt_write(wrt, "baz", 3) == 0);
+  ASSERT(sg_httpwrt_write(wrt, "qux", 3) == EAGAIN);
+  MHD_destroy_response(res->handle);
+  res->handle = NULL;
+  ASSERT(drained == 2);
+  ASSERT(sg_httpwrt_write(wrt, "baz", 3) == EPIPE);
+  ASSERT(sg_httpwrt_flush(wrt) == EPIPE);
+  ASSERT(sg_httpwrt_close(wrt) == 0);
+}
+
+static void test_httpwrt_high_water(struct sg_httpres *res) {
+  struct sg_httpwrt *wrt;
+  char buf[16];
+  int drained = 0;
+  wrt = sg_httpwrt_new(res, 4, dummy_drain_cb, &drained, 200);
+  ASSERT(sg__httpwrt_read_cb(wrt, 0, buf, sizeof(buf)) == 0);
+  ASSERT(wrt->suspended);
+  ASSERT(sg_httpwrt_write(wrt, "foo", 3) == 0);
+  ASSERT(wrt->suspended);
+  ASSERT(sg_httpwrt_write(wrt, "bar", 3) == 0);
+  ASSERT(!wrt->suspended);
+  wrt->suspended = true;
+  ASSERT(sg_httpwrt_write(wrt, "baz", 3) == EAGAIN);
+  ASSERT(wrt->blocked);
+  ASSERT(!wrt->suspended);
+  ASSERT(sg__httpwrt_read_cb(wrt, 0, buf, sizeof(buf)) == 6);
+  ASSERT(drained == 1);
+  ASSERT(sg_httpwrt_close(wrt) == 0);
+  MHD_destroy_response(res->handle);
+  res->handle = NULL;
+}
+
+static void test_httpwrt_flush(struct sg_httpres *res) {
+  struct sg_httpwrt *wrt = sg_httpwrt_new(res, 10, NULL, NULL, 200);
+  ASSERT(sg_httpwrt_flush(NULL) == EINVAL);
+  ASSERT(sg_httpwrt_flush(wrt) == 0);
+  ASSERT(sg_httpwrt_write(wrt, "foo", 3) == 0);
+  ASSERT(sg_httpwrt_flush(wrt) == 0);
+  ASSERT(sg_httpwrt_buffered(wrt) == 3);
+  ASSERT(sg_httpwrt_close(wrt) == 0);
+  MHD_destroy_response(res->handle);
+  res->handle = NULL;
+}
+
+static void test_httpwrt_close(void) {
+  ASSERT(sg_httpwrt_close(NULL) == EINVAL);
+}
+
+static void test_httpwrt_buffered(void) {
+  errno = 0;
+  ASSERT(sg_httpwrt_buffered(NULL) == 0);
+  ASSERT(errno == EINVAL);
+}
+
+int main(void) {
+  struct MHD_Connection *con = sg_alloc(256);
+  struct sg_httpres *res = sg__httpres_new(con);
+  test_httpwrt_new(res);
+  test_httpwrt_write(res);
+  test_httpwrt_drain(res);
+  test_httpwrt_high_water(res);
+  test_httpwrt_flush(res);
+  test_httpwrt_close();
+  test_httpwrt_buffered();
+  sg__httpres_free(res);
+  sg_free(con);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,402 @@
+/*                         _
+ *   ___  __ _  __ _ _   _(_)
+ *  / __|/ _` |/ _` | | | | |
+ *  \__ \ (_| | (_| | |_| | |
+ *  |___/\__,_|\__, |\__,_|_|
+ *             |___/
+ *
+ * Cross-platform library which helps to develop web servers or frameworks.
+ *
+ * Copyright (C) 2016-2020 Silvio Clecio <silvioprog@gmail.com>
+ *
+ * Sagui library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * Sagui library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Sagui library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#define SG_EXTERN
+
+#include "sg_assert.h"
+
+#include <string.h>
+#include <sys/socket.h>
+#include "sg_httpws.c"
+#include <sagui.h>
+
+static char msg_buf[64];
+static size_t msg_size;
+static bool msg_binary;
+static unsigned int msg_count;
+static unsigned int close_code;
+
+static void dummy_httpreq_cb(void *cls, struct sg_httpreq *req,
+                             struct sg_httpres *res) {
+  (void) cls;
+  (void) req;
+  (void) res;
+}
+
+static void dummy_msg_cb(void *cls, struct sg_httpws *ws, bool binary,
+                         const void *buf, size_t size) {
+  ASSERT(cls == &msg_count);
+  ASSERT(ws);
+  ASSERT(size <= sizeof(msg_buf));
+  memcpy(msg_buf, buf, size);
+  msg_size = size;
+  msg_binary = binary;
+  msg_count++;
+}
+
+static void dummy_close_cb(void *cls, struct sg_httpws *ws,
+                           unsigned int code) {
+  (void) cls;
+  (void) ws;
+  close_code = code;
+}
+
+static void frame_add(struct sg_httpws *ws, unsigned char first,
+                      const char *payload, size_t size) {
+  const unsigned char mask[4] = {0x37, 0xfa, 0x21, 0x3d};
+  unsigned char hdr[SG__HTTPWS_MAX_HEADER_SIZE];
+  size_t len = sg__httpws_header(hdr, 0, false, size);
+  hdr[0] = first;
+  hdr[1] |= 0x80;
+  memcpy(hdr + len, mask, sizeof(mask));
+  ASSERT(sg__httpws_buf_write(&ws->in, hdr, len + sizeof(mask)) == 0);
+  ASSERT(sg__httpws_buf_write(&ws->in, payload, size) == 0);
+  sg__httpws_mask(ws->in.data + ws->in.size - size, size, mask);
+}
+
+static void test__httpws_sha1(void) {
+  const unsigned char abc[20] = {0xa9, 0x99, 0x3e, 0x36, 0x47, 0x06, 0x81,
+                                 0x6a, 0xba, 0x3e, 0x25, 0x71, 0x78, 0x50,
+                                 0xc2, 0x6c, 0x9c, 0xd0, 0xd8, 0x9d};
+  const unsigned char empty[20] = {0xda, 0x39, 0xa3, 0xee, 0x5e, 0x6b, 0x4b,
+                                   0x0d, 0x32, 0x55, 0xbf, 0xef, 0x95, 0x60,
+                                   0x18, 0x90, 0xaf, 0xd8, 0x07, 0x09};
+  const unsigned char two_blocks[20] = {
+    0x84, 0x98, 0x3e, 0x44, 0x1c, 0x3b, 0xd2, 0x6e, 0xba, 0xae,
+    0x4a, 0xa1, 0xf9, 0x51, 0x29, 0xe5, 0xe5, 0x46, 0x70, 0xf1};
+  const char *str = "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+  unsigned char digest[20];
+  sg__httpws_sha1("abc", 3, digest);
+  ASSERT(memcmp(digest, abc, sizeof(digest)) == 0);
+  sg__httpws_sha1("", 0, digest);
+  ASSERT(memcmp(digest, empty, sizeof(digest)) == 0);
+  sg__httpws_sha1(str, strlen(str), digest);
+  ASSERT(memcmp(digest, two_blocks, sizeof(digest)) == 0);
+}
+
+static void test__httpws_accept(void) {
+  char accept[29];
+  ASSERT(!sg__httpws_accept(NULL, accept));
+  ASSERT(!sg__httpws_accept("", accept));
+  ASSERT(sg__httpws_accept("dGhlIHNhbXBsZSBub25jZQ==", accept));
+  ASSERT(strcmp(accept, "s3pPLMBiTxaQ9kYGzzhZRbK+xOo=") == 0);
+}
+
+static void test__httpws_mask(void) {
+  const unsigned char mask[4] = {0x37, 0xfa, 0x21, 0x3d};
+  const unsigned char hello[5] = {0x7f, 0x9f, 0x4d, 0x51, 0x58};
+  char buf[37], orig[37];
+  size_t i;
+  memcpy(buf, hello, sizeof(hello));
+  sg__httpws_mask(buf, sizeof(hello), mask);
+  ASSERT(memcmp(buf, "Hello", 5) == 0);
+  for (i = 0; i < sizeof(buf); i++)
+    buf[i] = orig[i] = (char) i;
+  sg__httpws_mask(buf, sizeof(buf), mask);
+  for (i = 0; i < sizeof(buf); i++)
+    ASSERT((unsigned char) buf[i] == ((unsigned char) orig[i] ^ mask[i % 4]));
+  sg__httpws_mask(buf, sizeof(buf), mask);
+  ASSERT(memcmp(buf, orig, sizeof(buf)) == 0);
+}
+
+static void test__httpws_is_utf8(void) {
+  ASSERT(sg__httpws_is_utf8("", 0));
+  ASSERT(sg__httpws_is_utf8("Hello, world!", 13));
+  ASSERT(sg__httpws_is_utf8("h\xC3\xA9llo w\xC3\xB6rld", 14));
+  ASSERT(sg__httpws_is_utf8("\xE2\x82\xAC\xF0\x9F\x98\x80", 7));
+  ASSERT(sg__httpws_is_utf8("\xEF\xBF\xBF\xF4\x8F\xBF\xBF", 7));
+  ASSERT(!sg__httpws_is_utf8("abcdefgh\x80", 9));
+  ASSERT(!sg__httpws_is_utf8("\xC0\xAF", 2));
+  ASSERT(!sg__httpws_is_utf8("\xE0\x80\xAF", 3));
+  ASSERT(!sg__httpws_is_utf8("\xED\xA0\x80", 3));
+  ASSERT(!sg__httpws_is_utf8("\xF4\x90\x80\x80", 4));
+  ASSERT(!sg__httpws_is_utf8("\xF5\x80\x80\x80", 4));
+  ASSERT(!sg__httpws_is_utf8("\xE2\x82", 2));
+  ASSERT(!sg__httpws_is_utf8("\xE2\x28\xA1", 3));
+}
+
+static void test__httpws_parse(void) {
+  const unsigned char hello[] = {0x81, 0x85, 0x37, 0xfa, 0x21, 0x3d,
+                                 0x7f, 0x9f, 0x4d, 0x51, 0x58};
+  unsigned char buf[16];
+  struct sg__httpws_frame frame;
+  ASSERT(sg__httpws_parse(hello, 1, &frame) == 0);
+  ASSERT(sg__httpws_parse(hello, 5, &frame) == 0);
+  ASSERT(sg__httpws_parse(hello, sizeof(hello), &frame) == 6);
+  ASSERT(frame.fin);
+  ASSERT(frame.opcode == SG__HTTPWS_TEXT);
+  ASSERT(frame.size == 5);
+  ASSERT(memcmp(frame.mask, hello + 2, 4) == 0);
+
+  memcpy(buf, hello, sizeof(hello));
+  buf[1] = 0x05;
+  ASSERT(sg__httpws_parse(buf, sizeof(hello), &frame) == -1);
+  buf[1] = 0x85;
+  buf[0] = 0xC1;
+  ASSERT(sg__httpws_parse(buf, sizeof(hello), &frame) == -1);
+  buf[0] = 0x83;
+  ASSERT(sg__httpws_parse(buf, sizeof(hello), &frame) == -1);
+  buf[0] = 0x09;
+  ASSERT(sg__httpws_parse(buf, sizeof(hello), &frame) == -1);
+  buf[0] = 0x89;
+  buf[1] = 0xFE;
+  ASSERT(sg__httpws_parse(buf, sizeof(buf), &frame) == -1);
+
+  memset(buf, 0, sizeof(buf));
+  buf[0] = 0x82;
+  buf[1] = 0xFE;
+  buf[2] = 0x01;
+  buf[3] = 0x00;
+  ASSERT(sg__httpws_parse(buf, 7, &frame) == 0);
+  ASSERT(sg__httpws_parse(buf, 8, &frame) == 8);
+  ASSERT(frame.size == 256);
+  buf[1] = 0xFF;
+  buf[2] = 0;
+  buf[7] = 0x01;
+  ASSERT(sg__httpws_parse(buf, 13, &frame) == 0);
+  ASSERT(sg__httpws_parse(buf, 14, &frame) == 14);
+  ASSERT(frame.size == 65536);
+  buf[2] = 0x80;
+  ASSERT(sg__httpws_parse(buf, 14, &frame) == -1);
+}
+
+static void test__httpws_header(void) {
+  unsigned char buf[SG__HTTPWS_MAX_HEADER_SIZE];
+  ASSERT(sg__httpws_header(buf, SG__HTTPWS_TEXT, true, 5) == 2);
+  ASSERT(buf[0] == 0x81 && buf[1] == 5);
+  ASSERT(sg__httpws_header(buf, SG__HTTPWS_BINARY, false, 256) == 4);
+  ASSERT(buf[0] == 0x02 && buf[1] == 126 && buf[2] == 1 && buf[3] == 0);
+  ASSERT(sg__httpws_header(buf, SG__HTTPWS_BINARY, true, 65536) == 10);
+  ASSERT(buf[0] == 0x82 && buf[1] == 127 && buf[7] == 1 && buf[9] == 0);
+}
+
+static void test__httpws_process(void) {
+  struct sg_httpws *ws = sg__httpws_new(dummy_msg_cb, NULL, &msg_count, 16);
+  char last;
+  ASSERT(ws);
+  msg_count = 0;
+  frame_add(ws, 0x81, "Hello", 5);
+  frame_add(ws, 0x02, "ab", 2);
+  last = ws->in.data[--ws->in.size];
+  sg__httpws_process(ws);
+  ASSERT(msg_count == 1);
+  ASSERT(!msg_binary);
+  ASSERT(msg_size == 5 && memcmp(msg_buf, "Hello", 5) == 0);
+  ASSERT(ws->in.size == 7);
+  ASSERT(sg__httpws_buf_write(&ws->in, &last, 1) == 0);
+  frame_add(ws, 0x89, "hb", 2);
+  frame_add(ws, 0x00, "cd", 2);
+  frame_add(ws, 0x80, "e", 1);
+  sg__httpws_process(ws);
+  ASSERT(msg_count == 2);
+  ASSERT(msg_binary);
+  ASSERT(msg_size == 5 && memcmp(msg_buf, "abcde", 5) == 0);
+  ASSERT(ws->in.size == 0);
+  ASSERT(ws->msg_opcode == 0);
+  ASSERT(ws->out.size == 4);
+  ASSERT(memcmp(ws->out.data, "\x8A\x02hb", 4) == 0);
+  ws->out.size = 0;
+
+  ws->alive = false;
+  frame_add(ws, 0x8A, "", 0);
+  sg__httpws_process(ws);
+  ASSERT(ws->alive);
+
+  frame_add(ws, 0x80, "x", 1);
+  sg__httpws_process(ws);
+  ASSERT(ws->close_sent);
+  ASSERT(ws->close_code == SG__HTTPWS_PROTOCOL_ERROR);
+  ASSERT(memcmp(ws->out.data, "\x88\x02\x03\xEA", 4) == 0);
+  sg__httpws_free(ws);
+
+  ws = sg__httpws_new(dummy_msg_cb, NULL, &msg_count, 16);
+  frame_add(ws, 0x02, "0123456789", 10);
+  frame_add(ws, 0x80, "0123456789", 10);
+  sg__httpws_process(ws);
+  ASSERT(ws->close_code == SG__HTTPWS_TOO_BIG);
+  ASSERT(memcmp(ws->out.data, "\x88\x02\x03\xF1", 4) == 0);
+  sg__httpws_free(ws);
+
+  ws = sg__httpws_new(dummy_msg_cb, NULL, &msg_count, 16);
+  frame_add(ws, 0x88, "\x03\xE8" "bye", 5);
+  frame_add(ws, 0x81, "Hello", 5);
+  msg_count = 0;
+  sg__httpws_process(ws);
+  ASSERT(msg_count == 0);
+  ASSERT(ws->close_sent);
+  ASSERT(ws->close_code == SG__HTTPWS_NORMAL);
+  ASSERT(ws->out.size == 4);
+  ASSERT(memcmp(ws->out.data, "\x88\x02\x03\xE8", 4) == 0);
+  sg__httpws_process(ws);
+  ASSERT(msg_count == 0);
+  ASSERT(ws->in.size == 0);
+  sg__httpws_free(ws);
+
+  ws = sg__httpws_new(dummy_msg_cb, NULL, &msg_count, 16);
+  frame_add(ws, 0x81, "\xC3\x28", 2);
+  msg_count = 0;
+  sg__httpws_process(ws);
+  ASSERT(msg_count == 0);
+  ASSERT(ws->close_code == SG__HTTPWS_INVALID_DATA);
+  ASSERT(memcmp(ws->out.data, "\x88\x02\x03\xEF", 4) == 0);
+  sg__httpws_free(ws);
+
+  ws = sg__httpws_new(dummy_msg_cb, NULL, &msg_count, 16);
+  frame_add(ws, 0x01, "\xE2\x82", 2);
+  frame_add(ws, 0x80, "\xAC", 1);
+  frame_add(ws, 0x01, "\xE2\x82", 2);
+  frame_add(ws, 0x80, "x", 1);
+  sg__httpws_process(ws);
+  ASSERT(msg_count == 1);
+  ASSERT(msg_size == 3 && memcmp(msg_buf, "\xE2\x82\xAC", 3) == 0);
+  ASSERT(ws->close_code == SG__HTTPWS_INVALID_DATA);
+  sg__httpws_free(ws);
+
+  ws = sg__httpws_new(dummy_msg_cb, NULL, &msg_count, 16);
+  frame_add(ws, 0x88, "\x03\xED", 2);
+  sg__httpws_process(ws);
+  ASSERT(ws->close_code == SG__HTTPWS_PROTOCOL_ERROR);
+  ASSERT(memcmp(ws->out.data, "\x88\x02\x03\xEA", 4) == 0);
+  sg__httpws_free(ws);
+
+  ws = sg__httpws_new(dummy_msg_cb, NULL, &msg_count, 16);
+  frame_add(ws, 0x88, "\x13\x88", 2);
+  sg__httpws_process(ws);
+  ASSERT(ws->close_code == SG__HTTPWS_PROTOCOL_ERROR);
+  sg__httpws_free(ws);
+
+  ws = sg__httpws_new(dummy_msg_cb, NULL, &msg_count, 16);
+  frame_add(ws, 0x88, "\x03\xE8\xFF", 3);
+  sg__httpws_process(ws);
+  ASSERT(ws->close_code == SG__HTTPWS_INVALID_DATA);
+  sg__httpws_free(ws);
+
+  ws = sg__httpws_new(dummy_msg_cb, NULL, &msg_count, 16);
+  frame_add(ws, 0x88, "\x0F\xA0", 2);
+  sg__httpws_process(ws);
+  ASSERT(ws->close_code == 4000);
+  ASSERT(memcmp(ws->out.data, "\x88\x02\x0F\xA0", 4) == 0);
+  sg__httpws_free(ws);
+}
+
+static void test__httpws_flush(void) {
+  struct sg_httpws *ws = sg__httpws_new(dummy_msg_cb, dummy_close_cb, NULL, 16);
+  char buf[16];
+  int fds[2];
+  ASSERT(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+  ws->sock = fds[0];
+  ASSERT(sg_httpws_send(ws, false, "foo", 3) == 0);
+  ASSERT(sg_httpws_send(ws, true, "bar", 3) == 0);
+  sg__httpws_flush(ws);
+  ASSERT(ws->out.size == 0);
+  ASSERT(recv(fds[1], buf, sizeof(buf), 0) == 10);
+  ASSERT(memcmp(buf, "\x81\x03" "foo\x82\x03" "bar", 10) == 0);
+  close(fds[1]);
+  ASSERT(sg_httpws_send(ws, false, "foo", 3) == 0);
+  sg__httpws_flush(ws);
+  ASSERT(ws->closed);
+  ASSERT(ws->close_code == SG__HTTPWS_ABNORMAL);
+  ASSERT(sg_httpws_send(ws, false, "foo", 3) == ENOTCONN);
+  close(fds[0]);
+  sg__httpws_free(ws);
+}
+
+static void test_httpws_upgrade(struct sg_httpreq *req) {
+  ASSERT(sg_httpws_upgrade(NULL, dummy_msg_cb, NULL, NULL) == EINVAL);
+  ASSERT(sg_httpws_upgrade(req, NULL, NULL, NULL) == EINVAL);
+  req->res->handle = MHD_create_response_from_buffer(0, NULL,
+                                                     MHD_RESPMEM_PERSISTENT);
+  ASSERT(sg_httpws_upgrade(req, dummy_msg_cb, NULL, NULL) == EALREADY);
+  MHD_destroy_response(req->res->handle);
+  req->res->handle = NULL;
+}
+
+static void test_httpws_send(void) {
+  struct sg_httpws *ws = sg__httpws_new(dummy_msg_cb, NULL, NULL, 16);
+  ASSERT(sg_httpws_send(NULL, false, "foo", 3) == EINVAL);
+  ASSERT(sg_httpws_send(ws, false, NULL, 3) == EINVAL);
+  ASSERT(sg_httpws_send(ws, false, NULL, 0) == 0);
+  ASSERT(ws->out.size == 2);
+  ASSERT(memcmp(ws->out.data, "\x81\x00", 2) == 0);
+  ASSERT(sg__httpws_buf_grow(&ws->out, SG__HTTPWS_OUT_LIMIT) == 0);
+  ws->out.size = SG__HTTPWS_OUT_LIMIT;
+  ASSERT(sg_httpws_send(ws, false, "foo", 3) == EAGAIN);
+  ASSERT(ws->out.size == SG__HTTPWS_OUT_LIMIT);
+  frame_add(ws, 0x89, "", 0);
+  sg__httpws_process(ws);
+  ASSERT(ws->close_code == SG__HTTPWS_POLICY_VIOLATION);
+  ASSERT(ws->close_sent);
+  sg__httpws_free(ws);
+}
+
+static void test_httpws_close(void) {
+  struct sg_httpws *ws = sg__httpws_new(dummy_msg_cb, NULL, NULL, 16);
+  ASSERT(sg_httpws_close(NULL, 1000) == EINVAL);
+  ASSERT(sg_httpws_close(ws, 999) == EINVAL);
+  ASSERT(sg_httpws_close(ws, 1005) == EINVAL);
+  ASSERT(sg_httpws_close(ws, 1006) == EINVAL);
+  ASSERT(sg_httpws_close(ws, 5000) == EINVAL);
+  ASSERT(sg_httpws_close(ws, 4000) == 0);
+  ASSERT(ws->close_sent);
+  ASSERT(ws->close_code == 4000);
+  ASSERT(memcmp(ws->out.data, "\x88\x02\x0F\xA0", 4) == 0);
+  ASSERT(sg_httpws_close(ws, 1000) == ENOTCONN);
+  ASSERT(sg_httpws_send(ws, false, "foo", 3) == ENOTCONN);
+  sg__httpws_free(ws);
+}
+
+static void test_httpws_user_data(void) {
+  struct sg_httpws *ws = sg__httpws_new(dummy_msg_cb, NULL, NULL, 16);
+  ASSERT(sg_httpws_set_user_data(NULL, "foo") == EINVAL);
+  errno = 0;
+  ASSERT(!sg_httpws_user_data(NULL));
+  ASSERT(errno == EINVAL);
+  ASSERT(sg_httpws_set_user_data(ws, "foo") == 0);
+  ASSERT(strcmp(sg_httpws_user_data(ws), "foo") == 0);
+  sg__httpws_free(ws);
+}
+
+int main(void) {
+  struct sg_httpsrv *srv = sg_httpsrv_new(dummy_httpreq_cb, NULL);
+  struct MHD_Connection *con = sg_alloc(256);
+  struct sg_httpreq *req = sg__httpreq_new(srv, con, NULL, NULL, NULL);
+  test__httpws_sha1();
+  test__httpws_accept();
+  test__httpws_mask();
+  test__httpws_is_utf8();
+  test__httpws_parse();
+  test__httpws_header();
+  test__httpws_process();
+  test__httpws_flush();
+  test_httpws_upgrade(req);
+  test_httpws_send();
+  test_httpws_close();
+  test_httpws_user_data();
+  sg__httpreq_free(req);
+  sg_httpsrv_free(srv);
+  sg_free(con);
+  return EXIT_SUCCESS;
+}
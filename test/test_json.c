@@ -0,0 +1,280 @@
+/*                         _
+ *   ___  __ _  __ _ _   _(_)
+ *  / __|/ _` |/ _` | | | | |
+ *  \__ \ (_| | (_| | |_| | |
+ *  |___/\__,_|\__, |\__,_|_|
+ *             |___/
+ *
+ * Cross-platform library which helps to develop web servers or frameworks.
+ *
+ * Copyright (C) 2016-2020 Silvio Clecio <silvioprog@gmail.com>
+ *
+ * Sagui library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * Sagui library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Sagui library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#define SG_EXTERN
+
+#include "sg_assert.h"
+
+#include <string.h>
+#include <float.h>
+#include "sg_json.c"
+#include "sg_httpres.h"
+#include <sagui.h>
+
+static void check_dtoa(double val, const char *expected) {
+  char buf[SG__JSON_DTOA_SIZE + 1], *end;
+  end = sg__json_dtoa(val, buf);
+  *end = '\0';
+  ASSERT(strcmp(buf, expected) == 0);
+  ASSERT(strtod(buf, NULL) == val);
+}
+
+static void test__json_safelen(void) {
+  ASSERT(sg__json_safelen("", 0) == 0);
+  ASSERT(sg__json_safelen("abc", 3) == 3);
+  ASSERT(sg__json_safelen("abcdefghijklmnop", 16) == 16);
+  ASSERT(sg__json_safelen("abcdefghij\"klmnop", 17) == 10);
+  ASSERT(sg__json_safelen("abcdefghijklmno\\p", 17) == 15);
+  ASSERT(sg__json_safelen("abc\ndefghijklmnop", 17) == 3);
+  ASSERT(sg__json_safelen("abcdefgh\x1f", 9) == 8);
+  ASSERT(sg__json_safelen("\xc3\xa7\xc3\xa3o ol\xc3\xa1", 10) == 10);
+  ASSERT(sg__json_safelen("\x7f\x80\xff", 3) == 3);
+}
+
+static void test__json_utoa(void) {
+  char buf[20], *end = buf + sizeof(buf), *p;
+  p = sg__json_utoa(0, end);
+  ASSERT(memcmp(p, "0", (size_t) (end - p)) == 0);
+  p = sg__json_utoa(7, end);
+  ASSERT(memcmp(p, "7", (size_t) (end - p)) == 0);
+  p = sg__json_utoa(42, end);
+  ASSERT(memcmp(p, "42", (size_t) (end - p)) == 0);
+  p = sg__json_utoa(12345, end);
+  ASSERT(memcmp(p, "12345", (size_t) (end - p)) == 0);
+  p = sg__json_utoa(UINT64_MAX, end);
+  ASSERT((size_t) (end - p) == 20);
+  ASSERT(memcmp(p, "18446744073709551615", 20) == 0);
+}
+
+static void test__json_dtoa(void) {
+  check_dtoa(0.0, "0.0");
+  check_dtoa(-0.0, "-0.0");
+  check_dtoa(1.0, "1.0");
+  check_dtoa(-2.5, "-2.5");
+  check_dtoa(0.1, "0.1");
+  check_dtoa(0.3, "0.3");
+  check_dtoa(123.456, "123.456");
+  check_dtoa(1e-7, "1e-7");
+  check_dtoa(0.000001, "0.000001");
+  check_dtoa(1e15, "1000000000000000.0");
+  check_dtoa(1e21, "1e21");
+  check_dtoa(1.5e300, "1.5e300");
+  check_dtoa(5e-324, "5e-324");
+  check_dtoa(DBL_MAX, "1.7976931348623157e308");
+  check_dtoa(DBL_MIN, "2.2250738585072014e-308");
+  check_dtoa(-1.2345678901234567e-300, "-1.2345678901234568e-300");
+}
+
+static void test_json_new(void) {
+  struct sg_str *str = sg_str_new();
+  struct sg_json *json;
+  errno = 0;
+  ASSERT(!sg_json_new(NULL));
+  ASSERT(errno == EINVAL);
+  errno = 0;
+  ASSERT(!sg_json_new2(NULL));
+  ASSERT(errno == EINVAL);
+  json = sg_json_new(str);
+  ASSERT(json);
+  ASSERT(json->buf == str);
+  ASSERT(!json->wrt);
+  ASSERT(json->depth == 0);
+  sg_json_free(json);
+  sg_str_free(str);
+}
+
+static void test_json_free(void) {
+  sg_json_free(NULL);
+}
+
+static void test_json_object(void) {
+  struct sg_str *str = sg_str_new();
+  struct sg_json *json = sg_json_new(str);
+  ASSERT(sg_json_begin_object(NULL) == EINVAL);
+  ASSERT(sg_json_end_object(NULL) == EINVAL);
+  ASSERT(sg_json_key(NULL, "a") == EINVAL);
+  ASSERT(sg_json_key(json, "a") == EINVAL);
+  ASSERT(sg_json_end_object(json) == EINVAL);
+
+  ASSERT(sg_json_begin_object(json) == 0);
+  ASSERT(sg_json_key(json, NULL) == EINVAL);
+  ASSERT(sg_json_int(json, 1) == EINVAL);
+  ASSERT(sg_json_end_array(json) == EINVAL);
+  ASSERT(sg_json_key(json, "id") == 0);
+  ASSERT(sg_json_key(json, "id") == EINVAL);
+  ASSERT(sg_json_end_object(json) == EINVAL);
+  ASSERT(sg_json_int(json, -42) == 0);
+  ASSERT(sg_json_key(json, "name") == 0);
+  ASSERT(sg_json_string(json, "a\"b\\c\n\x01") == 0);
+  ASSERT(sg_json_key(json, "tags") == 0);
+  ASSERT(sg_json_begin_array(json) == 0);
+  ASSERT(sg_json_end_array(json) == 0);
+  ASSERT(sg_json_key(json, "empty") == 0);
+  ASSERT(sg_json_begin_object(json) == 0);
+  ASSERT(sg_json_end_object(json) == 0);
+  ASSERT(sg_json_end_object(json) == 0);
+  ASSERT(strcmp(sg_str_content(str),
+                "{\"id\":-42,\"name\":\"a\\\"b\\\\c\\n\\u0001\","
+                "\"tags\":[],\"empty\":{}}") == 0);
+  ASSERT(sg_json_begin_object(json) == EINVAL);
+  ASSERT(sg_json_null(json) == EINVAL);
+  sg_json_free(json);
+  sg_str_free(str);
+}
+
+static void test_json_array(void) {
+  struct sg_str *str = sg_str_new();
+  struct sg_json *json = sg_json_new(str);
+  unsigned int i;
+  ASSERT(sg_json_begin_array(NULL) == EINVAL);
+  ASSERT(sg_json_end_array(NULL) == EINVAL);
+  ASSERT(sg_json_end_array(json) == EINVAL);
+
+  ASSERT(sg_json_begin_array(json) == 0);
+  ASSERT(sg_json_key(json, "a") == EINVAL);
+  ASSERT(sg_json_end_object(json) == EINVAL);
+  ASSERT(sg_json_int(json, INT64_MIN) == 0);
+  ASSERT(sg_json_uint(json, UINT64_MAX) == 0);
+  ASSERT(sg_json_double(json, 0.5) == 0);
+  ASSERT(sg_json_double(json, HUGE_VAL) == EINVAL);
+  ASSERT(sg_json_double(json, NAN) == EINVAL);
+  ASSERT(sg_json_bool(json, true) == 0);
+  ASSERT(sg_json_bool(json, false) == 0);
+  ASSERT(sg_json_null(json) == 0);
+  ASSERT(sg_json_string(json, "") == 0);
+  ASSERT(sg_json_string(json, NULL) == EINVAL);
+  ASSERT(sg_json_begin_array(json) == 0);
+  ASSERT(sg_json_int(json, 0) == 0);
+  ASSERT(sg_json_end_array(json) == 0);
+  ASSERT(sg_json_end_array(json) == 0);
+  ASSERT(strcmp(sg_str_content(str),
+                "[-9223372036854775808,18446744073709551615,0.5,true,false,"
+                "null,\"\",[0]]") == 0);
+  sg_json_free(json);
+  sg_str_clear(str);
+
+  json = sg_json_new(str);
+  for (i = 0; i < SG__JSON_MAX_DEPTH; i++)
+    ASSERT(sg_json_begin_array(json) == 0);
+  ASSERT(sg_json_begin_array(json) == EOVERFLOW);
+  ASSERT(sg_json_begin_object(json) == EOVERFLOW);
+  for (i = 0; i < SG__JSON_MAX_DEPTH; i++)
+    ASSERT(sg_json_end_array(json) == 0);
+  ASSERT(sg_str_length(str) == SG__JSON_MAX_DEPTH * 2);
+  sg_json_free(json);
+  sg_str_free(str);
+}
+
+static void test_json_scalar(void) {
+  struct sg_str *str = sg_str_new();
+  struct sg_json *json = sg_json_new(str);
+  ASSERT(sg_json_string(NULL, "a") == EINVAL);
+  ASSERT(sg_json_int(NULL, 1) == EINVAL);
+  ASSERT(sg_json_uint(NULL, 1) == EINVAL);
+  ASSERT(sg_json_double(NULL, 1) == EINVAL);
+  ASSERT(sg_json_bool(NULL, true) == EINVAL);
+  ASSERT(sg_json_null(NULL) == EINVAL);
+
+  ASSERT(sg_json_string(json, "\xc3\xa7\t") == 0);
+  ASSERT(strcmp(sg_str_content(str), "\"\xc3\xa7\\t\"") == 0);
+  ASSERT(sg_json_string(json, "a") == EINVAL);
+  sg_json_free(json);
+  sg_str_free(str);
+}
+
+static void test_json_long_string(void) {
+  struct sg_str *str = sg_str_new();
+  struct sg_json *json = sg_json_new(str);
+  char val[1001];
+  memset(val, '"', sizeof(val) - 1);
+  val[sizeof(val) - 1] = '\0';
+  ASSERT(sg_json_string(json, val) == 0);
+  ASSERT(sg_str_length(str) == 2002);
+  sg_json_free(json);
+  sg_str_free(str);
+}
+
+static void test_json_flush(void) {
+  struct sg_str *str = sg_str_new();
+  struct sg_json *json = sg_json_new(str);
+  ASSERT(sg_json_flush(NULL) == EINVAL);
+  ASSERT(sg_json_flush(json) == 0);
+  sg_json_free(json);
+  sg_str_free(str);
+}
+
+static void test_json_wrt(struct sg_httpres *res) {
+  struct sg_httpwrt *wrt = sg_httpwrt_new(res, 4, NULL, NULL, 200);
+  struct sg_json *json = sg_json_new2(wrt);
+  unsigned int i;
+  ASSERT(json);
+  ASSERT(json->wrt == wrt);
+  ASSERT(sg_json_begin_array(json) == 0);
+  ASSERT(sg_json_int(json, 123) == 0);
+  ASSERT(sg_httpwrt_buffered(wrt) == 0);
+  ASSERT(sg_json_flush(json) == 0);
+  ASSERT(sg_httpwrt_buffered(wrt) == 4);
+  ASSERT(json->buf->i == 0);
+  ASSERT(sg_json_int(json, 4) == 0);
+  ASSERT(sg_json_flush(json) == EAGAIN);
+  ASSERT(json->buf->i == 2);
+  ASSERT(sg_httpwrt_buffered(wrt) == 4);
+  sg_json_free(json);
+  ASSERT(sg_httpwrt_close(wrt) == 0);
+  MHD_destroy_response(res->handle);
+  res->handle = NULL;
+
+  wrt = sg_httpwrt_new(res, SG__BLOCK_SIZE * 4, NULL, NULL, 200);
+  json = sg_json_new2(wrt);
+  ASSERT(sg_json_begin_array(json) == 0);
+  for (i = 0; i < SG__BLOCK_SIZE / 2; i++)
+    ASSERT(sg_json_null(json) == 0);
+  ASSERT(sg_httpwrt_buffered(wrt) > 0);
+  ASSERT(json->buf->i < SG__BLOCK_SIZE);
+  sg_json_free(json);
+  ASSERT(sg_httpwrt_close(wrt) == 0);
+  MHD_destroy_response(res->handle);
+  res->handle = NULL;
+}
+
+int main(void) {
+  struct MHD_Connection *con = sg_alloc(256);
+  struct sg_httpres *res = sg__httpres_new(con);
+  test__json_safelen();
+  test__json_utoa();
+  test__json_dtoa();
+  test_json_new();
+  test_json_free();
+  test_json_object();
+  test_json_array();
+  test_json_scalar();
+  test_json_long_string();
+  test_json_flush();
+  test_json_wrt(res);
+  sg__httpres_free(res);
+  sg_free(con);
+  return EXIT_SUCCESS;
+}
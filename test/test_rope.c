@@ -0,0 +1,243 @@
+/*                         _
+ *   ___  __ _  __ _ _   _(_)
+ *  / __|/ _` |/ _` | | | | |
+ *  \__ \ (_| | (_| | |_| | |
+ *  |___/\__,_|\__, |\__,_|_|
+ *             |___/
+ *
+ * Cross-platform library which helps to develop web servers or frameworks.
+ *
+ * Copyright (C) 2016-2020 Silvio Clecio <silvioprog@gmail.com>
+ *
+ * Sagui library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * Sagui library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Sagui library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+
+#define SG_EXTERN
+
+#include "sg_assert.h"
+
+#include <string.h>
+#include "sg_rope.c"
+#include <sagui.h>
+
+static char *rope_flatten(struct sg_rope *rope) {
+  struct sg__rope_chunk *chunk;
+  char *buf = sg_malloc(rope->size + 1), *p = buf;
+  for (chunk = rope->head; chunk; chunk = chunk->next) {
+    memcpy(p, chunk->data, chunk->size);
+    p += chunk->size;
+  }
+  *p = '\0';
+  return buf;
+}
+
+static void test__rope_chunk(void) {
+  struct sg__rope_chunk *chunk1, *chunk2;
+  unsigned int count = sg__rope_pool_count();
+  chunk1 = sg__rope_chunk_get();
+  ASSERT(chunk1);
+  ASSERT(chunk1->size == 0);
+  ASSERT(!chunk1->next);
+  sg__rope_chunk_put(chunk1);
+  ASSERT(sg__rope_pool_count() == count + 1);
+  chunk2 = sg__rope_chunk_get();
+  ASSERT(chunk2 == chunk1);
+  ASSERT(sg__rope_pool_count() == count);
+  sg__rope_chunk_put(chunk2);
+}
+
+static void test__rope_flatten(void) {
+  struct sg_rope *rope = sg_rope_new();
+  struct sg_str *str = sg_str_new();
+  char *val = sg_malloc(SG__ROPE_CHUNK_SIZE + 10);
+  memset(val, 'x', SG__ROPE_CHUNK_SIZE + 10);
+  ASSERT(sg__rope_flatten(rope, str) == 0);
+  ASSERT(sg_str_length(str) == 0);
+  ASSERT(sg_str_write(str, "abc", 3) == 0);
+  ASSERT(sg_rope_write(rope, val, SG__ROPE_CHUNK_SIZE + 10) == 0);
+  ASSERT(sg_rope_write(rope, "def", 3) == 0);
+  ASSERT(sg__rope_flatten(rope, str) == 0);
+  ASSERT(sg_str_length(str) == SG__ROPE_CHUNK_SIZE + 16);
+  ASSERT(str->n == SG__ROPE_CHUNK_SIZE + 17);
+  ASSERT(memcmp(sg_str_content(str), "abcxxx", 6) == 0);
+  ASSERT(strcmp(sg_str_content(str) + SG__ROPE_CHUNK_SIZE + 10, "xxxdef") ==
+         0);
+  sg_free(val);
+  sg_str_free(str);
+  sg_rope_free(rope);
+}
+
+static void test_rope_new(void) {
+  struct sg_rope *rope = sg_rope_new();
+  ASSERT(rope);
+  ASSERT(!rope->head);
+  ASSERT(rope->size == 0);
+  sg_rope_free(rope);
+}
+
+static void test_rope_free(void) {
+  struct sg_rope *rope = sg_rope_new();
+  sg_rope_free(NULL);
+  ASSERT(sg_rope_write(rope, "abc", 3) == 0);
+  sg_rope_free(rope);
+}
+
+static void test_rope_write(void) {
+  struct sg_rope *rope = sg_rope_new();
+  char *val, *buf;
+  size_t len = (SG__ROPE_CHUNK_SIZE * 2) + 100, i;
+  ASSERT(sg_rope_write(NULL, "abc", 3) == EINVAL);
+  ASSERT(sg_rope_write(rope, NULL, 3) == EINVAL);
+  ASSERT(sg_rope_write(rope, "abc", 0) == EINVAL);
+
+  ASSERT(sg_rope_write(rope, "abc", 3) == 0);
+  ASSERT(rope->count == 1);
+  ASSERT(rope->size == 3);
+  val = sg_malloc(len);
+  for (i = 0; i < len; i++)
+    val[i] = (char) ('a' + (i % 26));
+  ASSERT(sg_rope_write(rope, val, len) == 0);
+  ASSERT(rope->count == 3);
+  ASSERT(rope->size == len + 3);
+  ASSERT(rope->head->size == SG__ROPE_CHUNK_SIZE);
+  ASSERT(rope->head->next->size == SG__ROPE_CHUNK_SIZE);
+  ASSERT(rope->tail->size == 103);
+  buf = rope_flatten(rope);
+  ASSERT(memcmp(buf, "abc", 3) == 0);
+  ASSERT(memcmp(buf + 3, val, len) == 0);
+  sg_free(buf);
+  sg_free(val);
+  sg_rope_free(rope);
+}
+
+static void test_rope_printf(void) {
+  struct sg_rope *rope = sg_rope_new();
+  char *val, *buf;
+  size_t fill = SG__ROPE_CHUNK_SIZE - 5;
+  ASSERT(sg_rope_printf(NULL, "%d", 1) == EINVAL);
+  ASSERT(sg_rope_printf(rope, NULL) == EINVAL);
+
+  ASSERT(sg_rope_printf(rope, "%s", "") == 0);
+  ASSERT(rope->size == 0);
+  ASSERT(sg_rope_printf(rope, "%s%d", "abc", 123) == 0);
+  ASSERT(rope->count == 1);
+  ASSERT(rope->size == 6);
+  sg_rope_clear(rope);
+
+  /* spans two chunks */
+  val = sg_malloc(fill);
+  memset(val, 'x', fill);
+  ASSERT(sg_rope_write(rope, val, fill) == 0);
+  ASSERT(sg_rope_printf(rope, "%s,%d\n", "abcdef", 42) == 0);
+  ASSERT(rope->count == 2);
+  ASSERT(rope->head->size == SG__ROPE_CHUNK_SIZE);
+  ASSERT(rope->tail->size == 5);
+  ASSERT(rope->size == fill + 10);
+  buf = rope_flatten(rope);
+  ASSERT(memcmp(buf + fill, "abcdef,42\n", 10) == 0);
+  sg_free(buf);
+
+  /* fills the last chunk exactly */
+  sg_rope_clear(rope);
+  ASSERT(sg_rope_write(rope, val, fill) == 0);
+  ASSERT(sg_rope_printf(rope, "%d", 12345) == 0);
+  ASSERT(rope->count == 1);
+  ASSERT(rope->head->size == SG__ROPE_CHUNK_SIZE);
+  sg_free(val);
+
+  /* larger than a chunk */
+  sg_rope_clear(rope);
+  fill = SG__ROPE_CHUNK_SIZE + 10;
+  val = sg_malloc(fill + 1);
+  memset(val, 'y', fill);
+  val[fill] = '\0';
+  ASSERT(sg_rope_printf(rope, "<%s>", val) == 0);
+  ASSERT(rope->size == fill + 2);
+  ASSERT(rope->count == 2);
+  buf = rope_flatten(rope);
+  ASSERT(buf[0] == '<');
+  ASSERT(buf[fill] == 'y');
+  ASSERT(buf[fill + 1] == '>');
+  sg_free(buf);
+  sg_free(val);
+  sg_rope_free(rope);
+}
+
+static void test_rope_length(void) {
+  struct sg_rope *rope = sg_rope_new();
+  errno = 0;
+  ASSERT(sg_rope_length(NULL) == 0);
+  ASSERT(errno == EINVAL);
+  ASSERT(sg_rope_length(rope) == 0);
+  sg_rope_write(rope, "abc", 3);
+  sg_rope_printf(rope, "%d", 123);
+  ASSERT(sg_rope_length(rope) == 6);
+  sg_rope_free(rope);
+}
+
+static void test_rope_clear(void) {
+  struct sg_rope *rope = sg_rope_new();
+  ASSERT(sg_rope_clear(NULL) == EINVAL);
+  sg_rope_write(rope, "abc", 3);
+  ASSERT(sg_rope_clear(rope) == 0);
+  ASSERT(rope->size == 0);
+  ASSERT(rope->count == 0);
+  ASSERT(!rope->head);
+  ASSERT(!rope->tail);
+  ASSERT(sg_rope_write(rope, "def", 3) == 0);
+  ASSERT(rope->count == 1);
+  sg_rope_free(rope);
+}
+
+static void test_httpres_sendrope(struct sg_httpres *res) {
+  struct sg_rope *rope;
+  ASSERT(sg_httpres_sendrope(NULL, sg_rope_new(), "text/csv", 200) == EINVAL);
+  ASSERT(sg_httpres_sendrope(res, NULL, "text/csv", 200) == EINVAL);
+  ASSERT(sg_httpres_sendrope(res, sg_rope_new(), "text/csv", 99) == EINVAL);
+  ASSERT(sg_httpres_sendrope(res, sg_rope_new(), "text/csv", 600) == EINVAL);
+
+  rope = sg_rope_new();
+  ASSERT(sg_rope_printf(rope, "%s,%d\n", "a", 1) == 0);
+  ASSERT(sg_httpres_sendrope(res, rope, "text/csv", 201) == 0);
+  ASSERT(res->handle);
+  ASSERT(res->status == 201);
+  ASSERT(strcmp(sg_strmap_get(res->headers, MHD_HTTP_HEADER_CONTENT_TYPE),
+                "text/csv") == 0);
+  ASSERT(sg_httpres_sendrope(res, sg_rope_new(), NULL, 200) == EALREADY);
+  MHD_destroy_response(res->handle);
+  res->handle = NULL;
+
+  ASSERT(sg_httpres_sendrope(res, sg_rope_new(), NULL, 204) == 0);
+  ASSERT(res->handle);
+  ASSERT(res->status == 204);
+  MHD_destroy_response(res->handle);
+  res->handle = NULL;
+}
+
+int main(void) {
+  struct sg_httpres *res = sg__httpres_new(NULL);
+  test__rope_chunk();
+  test__rope_flatten();
+  test_rope_new();
+  test_rope_free();
+  test_rope_write();
+  test_rope_printf();
+  test_rope_length();
+  test_rope_clear();
+  test_httpres_sendrope(res);
+  sg__httpres_free(res);
+  return EXIT_SUCCESS;
+}
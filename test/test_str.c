@@ -28,6 +28,9 @@
 
 #include <errno.h>
 #include <string.h>
+#include <float.h>
+#include <math.h>
+#include "sg_str.h"
 #include <sagui.h>
 
 static void test_str_write(struct sg_str *str, const char *val, size_t len) {
@@ -101,6 +104,172 @@ static void test_str_clear(struct sg_str *str, const char *val, size_t len) {
   ASSERT(sg_str_length(str) == 0);
 }
 
+static void test_str_append_char(struct sg_str *str) {
+  unsigned int i;
+  ASSERT(sg_str_append_char(NULL, 'a') == EINVAL);
+
+  sg_str_clear(str);
+  ASSERT(sg_str_append_char(str, 'a') == 0);
+  ASSERT(sg_str_append_char(str, 'b') == 0);
+  ASSERT(strcmp(sg_str_content(str), "ab") == 0);
+  for (i = 0; i < 100; i++)
+    ASSERT(sg_str_append_char(str, 'c') == 0);
+  ASSERT(sg_str_length(str) == 102);
+  ASSERT(sg_str_content(str)[101] == 'c');
+  ASSERT(sg_str_content(str)[102] == '\0');
+}
+
+static void test_str_append_int(struct sg_str *str) {
+  ASSERT(sg_str_append_int(NULL, 1) == EINVAL);
+
+  sg_str_clear(str);
+  ASSERT(sg_str_append_int(str, 0) == 0);
+  ASSERT(sg_str_append_char(str, ' ') == 0);
+  ASSERT(sg_str_append_int(str, -123) == 0);
+  ASSERT(sg_str_append_char(str, ' ') == 0);
+  ASSERT(sg_str_append_int(str, INT64_MAX) == 0);
+  ASSERT(sg_str_append_char(str, ' ') == 0);
+  ASSERT(sg_str_append_int(str, INT64_MIN) == 0);
+  ASSERT(strcmp(sg_str_content(str),
+                "0 -123 9223372036854775807 -9223372036854775808") == 0);
+}
+
+static void test_str_append_uint(struct sg_str *str) {
+  ASSERT(sg_str_append_uint(NULL, 1) == EINVAL);
+
+  sg_str_clear(str);
+  ASSERT(sg_str_append_uint(str, 0) == 0);
+  ASSERT(sg_str_append_uint(str, 42) == 0);
+  ASSERT(sg_str_append_uint(str, UINT64_MAX) == 0);
+  ASSERT(strcmp(sg_str_content(str), "04218446744073709551615") == 0);
+}
+
+static void test_str_append_double(struct sg_str *str) {
+  ASSERT(sg_str_append_double(NULL, 1) == EINVAL);
+  ASSERT(sg_str_append_double(str, HUGE_VAL) == EINVAL);
+  ASSERT(sg_str_append_double(str, -HUGE_VAL) == EINVAL);
+  ASSERT(sg_str_append_double(str, NAN) == EINVAL);
+
+  sg_str_clear(str);
+  ASSERT(sg_str_append_double(str, 0.1) == 0);
+  ASSERT(strcmp(sg_str_content(str), "0.1") == 0);
+  sg_str_clear(str);
+  ASSERT(sg_str_append_double(str, -1.5) == 0);
+  ASSERT(strcmp(sg_str_content(str), "-1.5") == 0);
+  sg_str_clear(str);
+  ASSERT(sg_str_append_double(str, 10) == 0);
+  ASSERT(strcmp(sg_str_content(str), "10.0") == 0);
+  sg_str_clear(str);
+  ASSERT(sg_str_append_double(str, DBL_MAX) == 0);
+  ASSERT(strcmp(sg_str_content(str), "1.7976931348623157e308") == 0);
+  ASSERT(sg_str_append_double(str, -DBL_MIN) == 0);
+  ASSERT(strcmp(sg_str_content(str), "1.7976931348623157e308"
+                                     "-2.2250738585072014e-308") == 0);
+}
+
+static void test_str_reserve(void) {
+  struct sg_str *str = sg_str_new();
+  const char *d;
+  ASSERT(sg_str_reserve(NULL, 10) == EINVAL);
+
+  ASSERT(str->d == str->sbo);
+  ASSERT(sg_str_reserve(str, SG__STR_SBO_SIZE - 1) == 0);
+  ASSERT(str->d == str->sbo);
+  ASSERT(sg_str_reserve(str, 1000) == 0);
+  ASSERT(str->d != str->sbo);
+  ASSERT(str->n == 1001);
+  ASSERT(sg_str_length(str) == 0);
+  ASSERT(strcmp(sg_str_content(str), "") == 0);
+  d = str->d;
+  ASSERT(sg_str_reserve(str, 10) == 0);
+  ASSERT(str->d == d);
+  ASSERT(str->n == 1001);
+  memset(str->d, 'a', 1000);
+  str->d[1000] = '\0';
+  str->i = 1000;
+  ASSERT(sg_str_append_char(str, 'b') == 0);
+  ASSERT(str->n >= 2002);
+  sg_str_free(str);
+}
+
+static void test_str_shrink(void) {
+  struct sg_str *str = sg_str_new();
+  char val[100];
+  ASSERT(sg_str_shrink(NULL) == EINVAL);
+
+  ASSERT(sg_str_shrink(str) == 0);
+  ASSERT(str->d == str->sbo);
+  memset(val, 'a', sizeof(val));
+  ASSERT(sg_str_write(str, val, sizeof(val)) == 0);
+  ASSERT(sg_str_write(str, val, sizeof(val)) == 0);
+  ASSERT(str->n > 201);
+  ASSERT(sg_str_shrink(str) == 0);
+  ASSERT(str->n == 201);
+  ASSERT(sg_str_length(str) == 200);
+  ASSERT(sg_str_content(str)[200] == '\0');
+  sg_str_clear(str);
+  ASSERT(sg_str_write(str, "abc", 3) == 0);
+  ASSERT(sg_str_shrink(str) == 0);
+  ASSERT(str->d == str->sbo);
+  ASSERT(str->n == SG__STR_SBO_SIZE);
+  ASSERT(strcmp(sg_str_content(str), "abc") == 0);
+  sg_str_free(str);
+}
+
+static void test_str_detach(void) {
+  struct sg_str *str = sg_str_new();
+  char val[100], *buf;
+  size_t len;
+  errno = 0;
+  ASSERT(!sg_str_detach(NULL, &len));
+  ASSERT(errno == EINVAL);
+
+  buf = sg_str_detach(str, &len);
+  ASSERT(buf);
+  ASSERT(len == 0);
+  ASSERT(strcmp(buf, "") == 0);
+  sg_free(buf);
+
+  ASSERT(sg_str_write(str, "abc", 3) == 0);
+  buf = sg_str_detach(str, NULL);
+  ASSERT(strcmp(buf, "abc") == 0);
+  ASSERT(buf != str->sbo);
+  ASSERT(sg_str_length(str) == 0);
+  sg_free(buf);
+
+  memset(val, 'a', sizeof(val));
+  ASSERT(sg_str_write(str, val, sizeof(val)) == 0);
+  buf = str->d;
+  ASSERT(sg_str_detach(str, &len) == buf);
+  ASSERT(len == sizeof(val));
+  ASSERT(buf[sizeof(val)] == '\0');
+  ASSERT(str->d == str->sbo);
+  ASSERT(str->n == SG__STR_SBO_SIZE);
+  ASSERT(strcmp(sg_str_content(str), "") == 0);
+  ASSERT(sg_str_write(str, "def", 3) == 0);
+  ASSERT(strcmp(sg_str_content(str), "def") == 0);
+  sg_free(buf);
+  sg_str_free(str);
+}
+
+static void test_str_growth(void) {
+  struct sg_str *str = sg_str_new();
+  char val[SG__STR_SBO_SIZE * 3];
+  unsigned int i;
+  memset(val, 'x', sizeof(val));
+  ASSERT(sg_str_write(str, val, SG__STR_SBO_SIZE - 1) == 0);
+  ASSERT(str->d == str->sbo);
+  ASSERT(sg_str_append_char(str, 'y') == 0);
+  ASSERT(str->d != str->sbo);
+  ASSERT(sg_str_length(str) == SG__STR_SBO_SIZE);
+  ASSERT(str->d[SG__STR_SBO_SIZE - 1] == 'y');
+  for (i = 0; i < 100; i++)
+    ASSERT(sg_str_printf(str, "%.*s", (int) sizeof(val), val) == 0);
+  ASSERT(sg_str_length(str) == SG__STR_SBO_SIZE + (100 * sizeof(val)));
+  ASSERT(strlen(sg_str_content(str)) == sg_str_length(str));
+  sg_str_free(str);
+}
+
 int main(void) {
   struct sg_str *str;
   const char *val = "abc123def456";
@@ -115,6 +284,14 @@ int main(void) {
   test_str_content(str, val, len);
   test_str_length(str, val, len);
   test_str_clear(str, val, len);
+  test_str_append_char(str);
+  test_str_append_int(str);
+  test_str_append_uint(str);
+  test_str_append_double(str);
+  test_str_reserve();
+  test_str_shrink();
+  test_str_detach();
+  test_str_growth();
 
   sg_str_free(str);
   return EXIT_SUCCESS;
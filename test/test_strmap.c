@@ -39,6 +39,20 @@ static void test__strmap_new(void) {
   ASSERT(strcmp(pair->name, "ABC") == 0);
   ASSERT(strcmp(pair->val, "123") == 0);
   ASSERT(strcmp(pair->key, "abc") == 0);
+  ASSERT(pair->len == 3);
+  ASSERT(pair->val_len == 3);
+  ASSERT(pair->val_size > pair->val_len);
+  ASSERT(pair->key == pair->buf);
+  ASSERT(pair->val == SG__STRMAP_INLINE_VAL(pair));
+  sg__strmap_free(pair);
+}
+
+static void test__strmap_new2(void) {
+  struct sg_strmap *pair = sg__strmap_new2("ABC", "123456", 3);
+  ASSERT(pair);
+  ASSERT(strcmp(pair->name, "ABC") == 0);
+  ASSERT(strcmp(pair->val, "123") == 0);
+  ASSERT(pair->val_len == 3);
   sg__strmap_free(pair);
 }
 
@@ -46,6 +60,125 @@ static void test__strmap_free(void) {
   sg__strmap_free(NULL);
 }
 
+static void test__strmap_hash(void) {
+  const char *upper = "ACCEPT-ENCODING-AND-SOMETHING-LONGER@[`{";
+  const char *lower = "accept-encoding-and-something-longer@[`{";
+  size_t i, len = strlen(upper);
+  for (i = 0; i <= len; i++)
+    ASSERT(sg__strmap_hash(upper, i) == sg__strmap_hash(lower, i));
+  ASSERT(sg__strmap_hash("abc", 3) == sg__strmap_hash("abc", 3));
+  ASSERT(sg__strmap_hash("abc", 3) != sg__strmap_hash("abd", 3));
+  ASSERT(sg__strmap_hash("@", 1) != sg__strmap_hash("`", 1));
+  ASSERT(sg__strmap_hash("[", 1) != sg__strmap_hash("{", 1));
+  ASSERT(sg__strmap_hash("a", 1) != sg__strmap_hash("a", 2));
+}
+
+static void test__strmap_keycmp(void) {
+  const char *upper = "ACCEPT-ENCODING-AND-SOMETHING-LONGER@[`{";
+  const char *lower = "accept-encoding-and-something-longer@[`{";
+  size_t i, len = strlen(upper);
+  for (i = 0; i <= len; i++)
+    ASSERT(sg__strmap_keycmp(upper, lower, i) == 0);
+  ASSERT(sg__strmap_keycmp("abcdefghi", "abcdefghj", 9) != 0);
+  ASSERT(sg__strmap_keycmp("abcdefghi", "abcdefghj", 8) == 0);
+  ASSERT(sg__strmap_keycmp("@", "`", 1) != 0);
+  ASSERT(sg__strmap_keycmp("[", "{", 1) != 0);
+  ASSERT(sg__strmap_keycmp("\xc3\xa7", "\xc3\x87", 2) != 0);
+}
+
+static void test__strmap_lookup(void) {
+  struct sg_strmap *map = NULL, *pair;
+  char name[100];
+  memset(name, 'X', sizeof(name) - 1);
+  name[sizeof(name) - 1] = '\0';
+  ASSERT(sg_strmap_add(&map, name, "foo") == 0);
+  ASSERT(sg_strmap_add(&map, "Content-Type", "text/plain") == 0);
+  memset(name, 'x', sizeof(name) - 1);
+  ASSERT(sg__strmap_lookup(map, name, &pair) == 0);
+  ASSERT(strcmp(pair->val, "foo") == 0);
+  ASSERT(sg__strmap_lookup(map, "CONTENT-TYPE", &pair) == 0);
+  ASSERT(strcmp(pair->val, "text/plain") == 0);
+  ASSERT(sg__strmap_lookup(map, "content-typ", &pair) == ENOENT);
+  ASSERT(!pair);
+  sg_strmap_cleanup(&map);
+}
+
+static void test__strmap_small(void) {
+  struct sg_strmap *map = NULL, *pair;
+  char name[16], val[16];
+  unsigned int i;
+  ASSERT(sg_strmap_add(&map, "a", "1") == 0);
+  ASSERT(sg_strmap_add(&map, "b", "2") == 0);
+  ASSERT(sg_strmap_add(&map, "c", "3") == 0);
+  ASSERT(SG__STRMAP_IS_SMALL(map));
+  ASSERT(sg__strmap_find_hashed(map, "B", 1, sg__strmap_hash("b", 1)) ==
+         map->hh.next);
+  ASSERT(!sg__strmap_find_hashed(map, "b", 1, sg__strmap_hash("c", 1)));
+  ASSERT(!sg__strmap_find_hashed(NULL, "b", 1, sg__strmap_hash("b", 1)));
+  ASSERT(sg_strmap_rm(&map, "b") == 0);
+  ASSERT(sg_strmap_count(map) == 2);
+  ASSERT(strcmp(map->name, "a") == 0);
+  ASSERT(strcmp(((struct sg_strmap *) map->hh.next)->name, "c") == 0);
+  ASSERT(map->hh.tbl->tail == &((struct sg_strmap *) map->hh.next)->hh);
+  ASSERT(sg_strmap_rm(&map, "c") == 0);
+  ASSERT(map->hh.tbl->tail == &map->hh);
+  ASSERT(sg_strmap_add(&map, "d", "4") == 0);
+  ASSERT(sg_strmap_rm(&map, "a") == 0);
+  ASSERT(strcmp(map->name, "d") == 0);
+  ASSERT(!map->hh.prev);
+  ASSERT(sg_strmap_rm(&map, "d") == 0);
+  ASSERT(!map);
+
+  for (i = 0; i < SG__STRMAP_SMALL_MAX; i++) {
+    snprintf(name, sizeof(name), "Name-%u", i);
+    snprintf(val, sizeof(val), "%u", i);
+    ASSERT(sg_strmap_add(&map, name, val) == 0);
+  }
+  ASSERT(SG__STRMAP_IS_SMALL(map));
+  ASSERT(sg_strmap_add(&map, "Name-X", "x") == 0);
+  ASSERT(!SG__STRMAP_IS_SMALL(map));
+  ASSERT(sg_strmap_count(map) == SG__STRMAP_SMALL_MAX + 1);
+  for (i = 0; i < SG__STRMAP_SMALL_MAX; i++) {
+    snprintf(name, sizeof(name), "NAME-%u", i);
+    snprintf(val, sizeof(val), "%u", i);
+    ASSERT(sg_strmap_find(map, name, &pair) == 0);
+    ASSERT(strcmp(pair->val, val) == 0);
+    ASSERT(sg__strmap_find_hashed(map, pair->key, pair->len,
+                                  pair->hh.hashv) == pair);
+  }
+  ASSERT(strcmp(sg_strmap_get(map, "name-x"), "x") == 0);
+  for (i = 0, pair = map; pair; pair = pair->hh.next, i++)
+    if (i < SG__STRMAP_SMALL_MAX) {
+      snprintf(name, sizeof(name), "Name-%u", i);
+      ASSERT(strcmp(pair->name, name) == 0);
+    }
+  ASSERT(i == SG__STRMAP_SMALL_MAX + 1);
+  ASSERT(sg_strmap_set(&map, "name-0", "a long value, longer than the pair") ==
+         0);
+  ASSERT(strcmp(sg_strmap_get(map, "Name-0"),
+                "a long value, longer than the pair") == 0);
+  ASSERT(sg_strmap_rm(&map, "Name-1") == 0);
+  ASSERT(sg_strmap_find(map, "Name-1", &pair) == ENOENT);
+  ASSERT(sg_strmap_count(map) == SG__STRMAP_SMALL_MAX);
+  sg_strmap_cleanup(&map);
+}
+
+static void test__strmap_append(void) {
+  struct sg_strmap *pair = sg__strmap_new("abc", "");
+  char str[1024];
+  size_t i;
+  for (i = 0; i < sizeof(str); i += 8) {
+    memcpy(str + i, "01234567", 8);
+    ASSERT(sg__strmap_append(pair, "01234567", 8) == 0);
+  }
+  ASSERT(pair->val_len == sizeof(str));
+  ASSERT(strlen(pair->val) == sizeof(str));
+  ASSERT(memcmp(pair->val, str, sizeof(str)) == 0);
+  ASSERT(pair->val != SG__STRMAP_INLINE_VAL(pair));
+  ASSERT(strcmp(pair->name, "abc") == 0);
+  sg__strmap_free(pair);
+}
+
 static void test_strmap_name(struct sg_strmap *pair) {
   errno = 0;
   ASSERT(sg_strmap_name(NULL) == NULL);
@@ -82,6 +215,7 @@ static void test_strmap_add(struct sg_strmap **map, const char *name,
 
 static void test_strmap_set(struct sg_strmap **map, const char *name,
                             const char *val) {
+  struct sg_strmap *pair, *found;
   ASSERT(sg_strmap_set(NULL, name, val) == EINVAL);
   ASSERT(sg_strmap_set(map, NULL, val) == EINVAL);
   ASSERT(sg_strmap_set(map, name, NULL) == EINVAL);
@@ -97,6 +231,25 @@ static void test_strmap_set(struct sg_strmap **map, const char *name,
   ASSERT(sg_strmap_set(map, name, val) == 0);
   ASSERT(sg_strmap_set(map, name, val) == 0);
   ASSERT(sg_strmap_count(*map) == 1);
+
+  sg_strmap_cleanup(map);
+  ASSERT(sg_strmap_add(map, "abc", "123456") == 0);
+  ASSERT(sg_strmap_add(map, "def", "456") == 0);
+  ASSERT(sg_strmap_find(*map, "abc", &pair) == 0);
+  ASSERT(sg_strmap_set(map, "ABC", "789") == 0);
+  ASSERT(sg_strmap_find(*map, "abc", &found) == 0);
+  ASSERT(found == pair);
+  ASSERT(*map == pair);
+  ASSERT(strcmp(sg_strmap_name(pair), "ABC") == 0);
+  ASSERT(strcmp(sg_strmap_val(pair), "789") == 0);
+  ASSERT(pair->val_len == 3);
+  ASSERT(sg_strmap_set(map, "abc", "0123456789012345678901234567890123456789"
+                                   "0123456789") == 0);
+  ASSERT(sg_strmap_count(*map) == 2);
+  ASSERT(strcmp(sg_strmap_get(*map, "abc"),
+                "01234567890123456789012345678901234567890123456789") == 0);
+  ASSERT(strcmp(sg_strmap_get(*map, "def"), "456") == 0);
+  sg_strmap_cleanup(map);
 }
 
 static void test_strmap_find(struct sg_strmap **map, const char *name,
@@ -369,6 +522,50 @@ static void test_strmap_cleanup(struct sg_strmap **map) {
   ASSERT(sg_strmap_count(*map) == 0);
 }
 
+static void test_strmap_snap_new(void) {
+  struct sg_strmap_snap *snap;
+  struct sg_strmap *map = NULL;
+  snap = sg_strmap_snap_new(NULL);
+  ASSERT(snap);
+  ASSERT(!sg_strmap_snap_map(snap));
+  ASSERT(snap->refs == 1);
+  sg_strmap_snap_unref(snap);
+
+  sg_strmap_add(&map, "abc", "123");
+  sg_strmap_add(&map, "Def", "456");
+  snap = sg_strmap_snap_new(map);
+  ASSERT(snap);
+  ASSERT(sg_strmap_snap_map(snap) != map);
+  sg_strmap_set(&map, "abc", "789");
+  sg_strmap_cleanup(&map);
+  ASSERT(sg_strmap_count(sg_strmap_snap_map(snap)) == 2);
+  ASSERT(strcmp(sg_strmap_get(sg_strmap_snap_map(snap), "abc"), "123") == 0);
+  ASSERT(strcmp(sg_strmap_get(sg_strmap_snap_map(snap), "def"), "456") == 0);
+  sg_strmap_snap_unref(snap);
+}
+
+static void test_strmap_snap_ref(void) {
+  struct sg_strmap_snap *snap = sg_strmap_snap_new(NULL);
+  errno = 0;
+  ASSERT(!sg_strmap_snap_ref(NULL));
+  ASSERT(errno == EINVAL);
+  ASSERT(sg_strmap_snap_ref(snap) == snap);
+  ASSERT(snap->refs == 2);
+  sg_strmap_snap_unref(snap);
+  ASSERT(snap->refs == 1);
+  sg_strmap_snap_unref(snap);
+}
+
+static void test_strmap_snap_unref(void) {
+  sg_strmap_snap_unref(NULL);
+}
+
+static void test_strmap_snap_map(void) {
+  errno = 0;
+  ASSERT(!sg_strmap_snap_map(NULL));
+  ASSERT(errno == EINVAL);
+}
+
 int main(void) {
   struct sg_strmap *map = NULL, *pair;
   char name[] = "abç";
@@ -379,7 +576,13 @@ int main(void) {
   ASSERT(pair);
 
   test__strmap_new();
+  test__strmap_new2();
   test__strmap_free();
+  test__strmap_hash();
+  test__strmap_keycmp();
+  test__strmap_lookup();
+  test__strmap_small();
+  test__strmap_append();
   test_strmap_name(pair);
   test_strmap_val(pair);
   test_strmap_add(&map, name, val);
@@ -392,6 +595,10 @@ int main(void) {
   test_strmap_count(&map, name, val);
   test_strmap_next(&map);
   test_strmap_cleanup(&map);
+  test_strmap_snap_new();
+  test_strmap_snap_ref();
+  test_strmap_snap_unref();
+  test_strmap_snap_map();
 
   sg_strmap_cleanup(&map);
   return EXIT_SUCCESS;
@@ -0,0 +1,225 @@
+/*                         _
+ *   ___  __ _  __ _ _   _(_)
+ *  / __|/ _` |/ _` | | | | |
+ *  \__ \ (_| | (_| | |_| | |
+ *  |___/\__,_|\__, |\__,_|_|
+ *             |___/
+ *
+ * Cross-platform library which helps to develop web servers or frameworks.
+ *
+ * Copyright (C) 2016-2020 Silvio Clecio <silvioprog@gmail.com>
+ *
+ * Sagui library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * Sagui library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Sagui library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#define SG_EXTERN
+
+#include "sg_assert.h"
+
+#include <string.h>
+#include "sg_tmpl.c"
+#include <sagui.h>
+
+#ifndef TEST_TMPL_BASE_PATH
+#ifdef __ANDROID__
+#define TEST_TMPL_BASE_PATH SG_ANDROID_TESTS_DEST_DIR "/"
+#else /* __ANDROID__ */
+#ifdef _WIN32
+#define TEST_TMPL_BASE_PATH BINARY_DIR "/"
+#else /* _WIN32 */
+#define TEST_TMPL_BASE_PATH "/tmp/"
+#endif /* _WIN32 */
+#endif /* __ANDROID__ */
+#endif /* TEST_TMPL_BASE_PATH */
+
+static struct sg__tmpl_prog *compile(const char *src) {
+  return sg__tmpl_compile(sg__strdup(src), strlen(src));
+}
+
+static void test__tmpl_compile(void) {
+  struct sg__tmpl_prog *prog;
+  prog = compile("");
+  ASSERT(prog);
+  ASSERT(prog->count == 0);
+  ASSERT(prog->text_size == 0);
+  sg__tmpl_prog_unref(prog);
+
+  prog = compile("<p>{{ Name }}</p>{{{html}}}!{");
+  ASSERT(prog);
+  ASSERT(prog->count == 5);
+  ASSERT(prog->ins[0].op == SG__TMPL_TEXT);
+  ASSERT(prog->ins[0].len == 3);
+  ASSERT(memcmp(prog->ins[0].str, "<p>", 3) == 0);
+  ASSERT(prog->ins[1].op == SG__TMPL_VAR);
+  ASSERT(strcmp(prog->ins[1].str, "name") == 0);
+  ASSERT(prog->ins[1].len == 4);
+  ASSERT(prog->ins[2].op == SG__TMPL_TEXT);
+  ASSERT(memcmp(prog->ins[2].str, "</p>", 4) == 0);
+  ASSERT(prog->ins[3].op == SG__TMPL_RAW);
+  ASSERT(strcmp(prog->ins[3].str, "html") == 0);
+  ASSERT(prog->ins[4].op == SG__TMPL_TEXT);
+  ASSERT(memcmp(prog->ins[4].str, "!{", 2) == 0);
+  ASSERT(prog->text_size == 9);
+  sg__tmpl_prog_unref(prog);
+
+  errno = 0;
+  ASSERT(!compile("foo {{bar"));
+  ASSERT(errno == EINVAL);
+  errno = 0;
+  ASSERT(!compile("foo {{{bar}}"));
+  ASSERT(errno == EINVAL);
+  errno = 0;
+  ASSERT(!compile("foo {{ }}"));
+  ASSERT(errno == EINVAL);
+}
+
+static void test__tmpl_esc(void) {
+  const char *str = "<a href=\"x\">Tom & Jerry's</a>";
+  const char *esc =
+    "&lt;a href=&#34;x&#34;&gt;Tom &amp; Jerry&#39;s&lt;/a&gt;";
+  char buf[100], *p;
+  ASSERT(sg__tmpl_escsize("") == 0);
+  ASSERT(sg__tmpl_escsize("abc") == 3);
+  ASSERT(sg__tmpl_escsize(str) == strlen(esc));
+  p = sg__tmpl_esccpy(buf, str);
+  ASSERT((size_t) (p - buf) == strlen(esc));
+  ASSERT(memcmp(buf, esc, strlen(esc)) == 0);
+}
+
+static void test_tmpl_new(void) {
+  struct sg_tmpl *tmpl;
+  errno = 0;
+  ASSERT(!sg_tmpl_new(NULL, 0));
+  ASSERT(errno == EINVAL);
+  errno = 0;
+  ASSERT(!sg_tmpl_new("{{", 2));
+  ASSERT(errno == EINVAL);
+  tmpl = sg_tmpl_new("abc{{def}}", 3);
+  ASSERT(tmpl);
+  ASSERT(tmpl->prog->count == 1);
+  ASSERT(!tmpl->filename);
+  sg_tmpl_free(tmpl);
+}
+
+static void test_tmpl_load(void) {
+  const char *filename = TEST_TMPL_BASE_PATH "foo.tmpl";
+  struct sg_strmap *vars = NULL;
+  struct sg_tmpl *tmpl;
+  char *buf;
+  size_t size;
+  FILE *file;
+  errno = 0;
+  ASSERT(!sg_tmpl_load(NULL));
+  ASSERT(errno == EINVAL);
+  unlink(filename);
+  errno = 0;
+  ASSERT(!sg_tmpl_load(filename));
+  ASSERT(errno == ENOENT);
+
+  file = fopen(filename, "w");
+  ASSERT(file);
+  ASSERT(fputs("Hello, {{name}}!", file) >= 0);
+  ASSERT(fclose(file) == 0);
+  tmpl = sg_tmpl_load(filename);
+  ASSERT(tmpl);
+  ASSERT(strcmp(tmpl->filename, filename) == 0);
+  sg_strmap_add(&vars, "name", "World");
+  ASSERT(sg_tmpl_render(tmpl, vars, &buf, &size) == 0);
+  ASSERT(strcmp(buf, "Hello, World!") == 0);
+  sg_free(buf);
+
+  file = fopen(filename, "w");
+  ASSERT(file);
+  ASSERT(fputs("Bye, {{name}}.", file) >= 0);
+  ASSERT(fclose(file) == 0);
+  tmpl->checked = 0;
+  ASSERT(sg_tmpl_render(tmpl, vars, &buf, &size) == 0);
+  ASSERT(strcmp(buf, "Bye, World.") == 0);
+  sg_free(buf);
+
+  file = fopen(filename, "w");
+  ASSERT(file);
+  ASSERT(fputs("Oops, {{name", file) >= 0);
+  ASSERT(fclose(file) == 0);
+  tmpl->checked = 0;
+  ASSERT(sg_tmpl_render(tmpl, vars, &buf, &size) == 0);
+  ASSERT(strcmp(buf, "Bye, World.") == 0);
+  sg_free(buf);
+
+  sg_tmpl_free(tmpl);
+  sg_strmap_cleanup(&vars);
+  unlink(filename);
+}
+
+static void test_tmpl_free(void) {
+  sg_tmpl_free(NULL);
+}
+
+static void test_tmpl_render(void) {
+  const char *src = "<b>{{Name}}</b>{{{html}}}{{missing}}.";
+  struct sg_tmpl *tmpl = sg_tmpl_new(src, strlen(src));
+  struct sg_strmap *vars = NULL;
+  char *buf;
+  size_t size;
+  ASSERT(sg_tmpl_render(NULL, vars, &buf, &size) == EINVAL);
+  ASSERT(sg_tmpl_render(tmpl, vars, NULL, &size) == EINVAL);
+  ASSERT(sg_tmpl_render(tmpl, vars, &buf, NULL) == EINVAL);
+
+  ASSERT(sg_tmpl_render(tmpl, vars, &buf, &size) == 0);
+  ASSERT(size == strlen("<b></b>."));
+  ASSERT(strcmp(buf, "<b></b>.") == 0);
+  sg_free(buf);
+  sg_strmap_add(&vars, "NAME", "<Tom & Jerry>");
+  sg_strmap_add(&vars, "html", "<i>x</i>");
+  ASSERT(sg_tmpl_render(tmpl, vars, &buf, &size) == 0);
+  ASSERT(size == strlen("<b>&lt;Tom &amp; Jerry&gt;</b><i>x</i>."));
+  ASSERT(strcmp(buf, "<b>&lt;Tom &amp; Jerry&gt;</b><i>x</i>.") == 0);
+  sg_free(buf);
+  sg_strmap_cleanup(&vars);
+  sg_tmpl_free(tmpl);
+}
+
+static void test_httpres_sendtmpl(struct sg_httpres *res) {
+  const char *src = "<p>{{msg}}</p>";
+  struct sg_tmpl *tmpl = sg_tmpl_new(src, strlen(src));
+  struct sg_strmap *vars = NULL;
+  ASSERT(sg_httpres_sendtmpl(NULL, tmpl, vars, NULL, 200) == EINVAL);
+  ASSERT(sg_httpres_sendtmpl(res, NULL, vars, NULL, 200) == EINVAL);
+  ASSERT(sg_httpres_sendtmpl(res, tmpl, vars, NULL, 99) == EINVAL);
+  ASSERT(sg_httpres_sendtmpl(res, tmpl, vars, NULL, 600) == EINVAL);
+
+  sg_strmap_add(&vars, "msg", "foo");
+  ASSERT(sg_httpres_sendtmpl(res, tmpl, vars, "text/html", 201) == 0);
+  ASSERT(res->handle);
+  ASSERT(res->status == 201);
+  ASSERT(strcmp(sg_strmap_get(res->headers, MHD_HTTP_HEADER_CONTENT_TYPE),
+                "text/html") == 0);
+  ASSERT(sg_httpres_sendtmpl(res, tmpl, vars, NULL, 200) == EALREADY);
+  sg_strmap_cleanup(&vars);
+  sg_tmpl_free(tmpl);
+}
+
+int main(void) {
+  struct sg_httpres *res = sg__httpres_new(NULL);
+  test__tmpl_compile();
+  test__tmpl_esc();
+  test_tmpl_new();
+  test_tmpl_load();
+  test_tmpl_free();
+  test_tmpl_render();
+  test_httpres_sendtmpl(res);
+  sg__httpres_free(res);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,221 @@
+/*                         _
+ *   ___  __ _  __ _ _   _(_)
+ *  / __|/ _` |/ _` | | | | |
+ *  \__ \ (_| | (_| | |_| | |
+ *  |___/\__,_|\__, |\__,_|_|
+ *             |___/
+ *
+ * Cross-platform library which helps to develop web servers or frameworks.
+ *
+ * Copyright (C) 2016-2020 Silvio Clecio <silvioprog@gmail.com>
+ *
+ * Sagui library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * Sagui library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with Sagui library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#define SG_EXTERN
+
+#include "sg_assert.h"
+
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "sg_uring.c"
+#include <sagui.h>
+
+#define TEST_URING_PATH "/tmp/test_uring.txt"
+
+static unsigned resumed;
+
+static void dummy_resume_cb(void *cls) {
+  ASSERT(cls == &resumed);
+  resumed++;
+}
+
+static int file_open(int flags) {
+  int fd;
+  unlink(TEST_URING_PATH);
+  fd = open(TEST_URING_PATH, O_RDWR | O_CREAT | O_TRUNC, 0600);
+  ASSERT(fd != -1);
+  if (flags != O_RDWR) {
+    close(fd);
+    fd = open(TEST_URING_PATH, flags);
+    ASSERT(fd != -1);
+  }
+  return fd;
+}
+
+static void file_check(int fd, size_t size) {
+  char buf[4096];
+  size_t off = 0, i;
+  ssize_t ret;
+  while (off < size) {
+    ret = pread(fd, buf, sizeof(buf), (off_t) off);
+    ASSERT(ret > 0);
+    for (i = 0; i < (size_t) ret; i++)
+      ASSERT(buf[i] == (char) ((off + i) % 251));
+    off += (size_t) ret;
+  }
+  ASSERT(pread(fd, buf, sizeof(buf), (off_t) off) == 0);
+}
+
+static void file_write(struct sg__uring_file *file, size_t size,
+                       size_t chunk) {
+  char buf[8192];
+  size_t off = 0, len, i;
+  ASSERT(chunk <= sizeof(buf));
+  while (off < size) {
+    len = size - off < chunk ? size - off : chunk;
+    for (i = 0; i < len; i++)
+      buf[i] = (char) ((off + i) % 251);
+    ASSERT(sg__uring_write(file, buf, len) == 0);
+    off += len;
+    if ((off % (chunk * 4)) == 0)
+      ASSERT(sg__uring_flush(file, false) == 0);
+  }
+}
+
+static void test__uring_ring(void) {
+  struct sg__uring ring;
+  struct io_uring_sqe *sqe;
+  struct io_uring_cqe *cqe;
+  unsigned i;
+  ASSERT(sg__uring_init(&ring, 4) == 0);
+  ASSERT(ring.sq_entries == 4);
+  ASSERT(!sg__uring_cqe(&ring));
+  for (i = 0; i < 4; i++) {
+    sqe = sg__uring_sqe(&ring);
+    ASSERT(sqe);
+    sqe->opcode = IORING_OP_NOP;
+    sqe->user_data = i + 1;
+  }
+  ASSERT(!sg__uring_sqe(&ring));
+  ASSERT(sg__uring_submit(&ring) == 0);
+  for (i = 0; i < 4; i++) {
+    while (!(cqe = sg__uring_cqe(&ring)))
+      ASSERT(sg__uring_wait(&ring) == 0);
+    ASSERT(cqe->user_data == i + 1);
+    ASSERT(cqe->res == 0);
+    sg__uring_cqe_seen(&ring);
+  }
+  ASSERT(!sg__uring_cqe(&ring));
+  ASSERT(sg__uring_submit(&ring) == 0);
+  sg__uring_free(&ring);
+}
+
+static void test__uring_write(struct sg__uring_writer *writer) {
+  struct sg__uring_file file;
+  int fd = file_open(O_RDWR);
+  sg__uring_file_init(&file, writer, fd, &resumed);
+  ASSERT(file.slot == -1);
+  ASSERT(sg__uring_drain(&file) == 0);
+  file_write(&file, (SG__URING_SLOT_SIZE * 20) + 123, 4000);
+  ASSERT(sg__uring_drain(&file) == 0);
+  ASSERT(file.inflight == 0);
+  ASSERT(file.slot == -1);
+  ASSERT(writer->free_count == SG__URING_SLOTS);
+  file_check(fd, (SG__URING_SLOT_SIZE * 20) + 123);
+  close(fd);
+  unlink(TEST_URING_PATH);
+}
+
+static void test__uring_flush(struct sg__uring_writer *writer) {
+  struct sg__uring_file file;
+  int fd = file_open(O_RDWR);
+  sg__uring_file_init(&file, writer, fd, &resumed);
+  file_write(&file, 100, 100);
+  ASSERT(file.slot >= 0);
+  ASSERT(sg__uring_flush(&file, false) == 0);
+  ASSERT(file.slot >= 0);
+  ASSERT(sg__uring_flush(&file, true) == 0);
+  ASSERT(file.slot == -1);
+  ASSERT(sg__uring_drain(&file) == 0);
+  file_check(fd, 100);
+  close(fd);
+  unlink(TEST_URING_PATH);
+}
+
+static void test__uring_pause(struct sg__uring_writer *writer) {
+  struct sg__uring_file file;
+  int fd = file_open(O_RDWR);
+  sg__uring_file_init(&file, writer, fd, &resumed);
+  ASSERT(!sg__uring_pause(&file));
+  /* a paused file is resumed once its writes drain */
+  resumed = 0;
+  pthread_mutex_lock(&writer->mutex);
+  file.paused = true;
+  pthread_mutex_unlock(&writer->mutex);
+  ASSERT(sg__uring_pause(&file));
+  file_write(&file, SG__URING_SLOT_SIZE, 4096);
+  ASSERT(sg__uring_drain(&file) == 0);
+  ASSERT(resumed == 1);
+  ASSERT(!file.paused);
+  ASSERT(!sg__uring_pause(&file));
+  close(fd);
+  unlink(TEST_URING_PATH);
+}
+
+static void test__uring_error(struct sg__uring_writer *writer) {
+  struct sg__uring_file file;
+  int fd = file_open(O_RDONLY);
+  sg__uring_file_init(&file, writer, fd, &resumed);
+  file_write(&file, 10, 10);
+  ASSERT(sg__uring_drain(&file) == EBADF);
+  ASSERT(sg__uring_write(&file, "abc", 3) == EBADF);
+  ASSERT(sg__uring_flush(&file, true) == EBADF);
+  ASSERT(writer->free_count == SG__URING_SLOTS);
+  close(fd);
+  unlink(TEST_URING_PATH);
+}
+
+static void test__uring_exhausted(struct sg__uring_writer *writer) {
+  struct sg__uring_file files[SG__URING_SLOTS], file;
+  int fd = file_open(O_RDWR);
+  unsigned i;
+  /* partially filled buffers hold the whole pool */
+  for (i = 0; i < SG__URING_SLOTS; i++) {
+    sg__uring_file_init(&files[i], writer, fd, &resumed);
+    ASSERT(sg__uring_write(&files[i], "a", 1) == 0);
+  }
+  ASSERT(writer->free_count == 0);
+  sg__uring_file_init(&file, writer, fd, &resumed);
+  file_write(&file, 5000, 1000);
+  ASSERT(file.slot == -1);
+  ASSERT(file.inflight == 0);
+  file_check(fd, 5000);
+  for (i = 0; i < SG__URING_SLOTS; i++) {
+    files[i].slot = -1;
+    writer->free_slots[writer->free_count++] = i;
+  }
+  close(fd);
+  unlink(TEST_URING_PATH);
+}
+
+int main(void) {
+  struct sg__uring_writer *writer;
+  writer = sg__uring_writer_new(dummy_resume_cb);
+  if (!writer) {
+    /* e.g. io_uring disabled by the kernel */
+    ASSERT(errno == ENOSYS || errno == EPERM);
+    return EXIT_SUCCESS;
+  }
+  test__uring_ring();
+  test__uring_write(writer);
+  test__uring_flush(writer);
+  test__uring_pause(writer);
+  test__uring_error(writer);
+  test__uring_exhausted(writer);
+  sg__uring_writer_free(writer);
+  return EXIT_SUCCESS;
+}